@@ -0,0 +1,126 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Benchmark of the batch frame validation/extraction against the scalar path.
+ *
+ * Usage: frame-batch-bench [<frame count> [<rounds>]]
+ */
+#include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cb_frame_batch.h>
+#include <cb_uart.h>
+
+/* the CRC function is not part of the public headers, but exported by the library */
+uint8_t crc8_j1850(uint8_t *p, size_t len);
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_frames(uint8_t *frames, size_t count)
+{
+    size_t i;
+
+    srand(42);
+
+    for (i = 0; i < count; i++) {
+        uint8_t *f = frames + i * CB_UART_FRAME_SIZE;
+        unsigned int j;
+
+        f[0] = CB_UART_SOF;
+        f[1] = COM_CHARGE_STATE;
+        for (j = 2; j < 10; j++)
+            f[j] = rand();
+        f[10] = crc8_j1850(&f[1], 9);
+        f[11] = CB_UART_EOF;
+
+        /* corrupt about every 100th frame */
+        if (rand() % 100 == 0)
+            f[1 + rand() % 11] ^= 1 << (rand() % 8);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+    unsigned int rounds = argc > 2 ? strtoul(argv[2], NULL, 0) : 5;
+    uint8_t *frames, *status, *ref_status;
+    uint64_t *data, *col, *ref_col;
+    uint64_t mask = cb_frame_batch_mask(24, 6) | cb_frame_batch_mask(40, 3); /* contactors and CP state */
+    size_t ref_valid = 0;
+    int impl;
+
+    frames = malloc(count * CB_UART_FRAME_SIZE);
+    status = malloc(count);
+    ref_status = malloc(count);
+    data = malloc(count * sizeof(*data));
+    col = malloc(count * sizeof(*col));
+    ref_col = malloc(count * sizeof(*col));
+    if (!frames || !status || !ref_status || !data || !col || !ref_col) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    fill_frames(frames, count);
+    cb_frame_batch_decode(frames, count, NULL, data);
+
+    printf("%zu frames (%.1f MiB), best of %u rounds\n\n", count, count * CB_UART_FRAME_SIZE / 1048576.0, rounds);
+    printf("%-8s %14s %10s %14s\n", "impl", "validate/s", "MiB/s", "extract/s");
+
+    for (impl = CB_FRAME_BATCH_IMPL_SCALAR; impl < CB_FRAME_BATCH_IMPL_MAX; impl++) {
+        double best_validate = 1e9, best_extract = 1e9;
+        size_t valid = 0;
+        unsigned int r;
+
+        if (cb_frame_batch_select_impl(impl))
+            continue;
+
+        for (r = 0; r < rounds; r++) {
+            double t0 = now(), t1, t2;
+
+            valid = cb_frame_batch_validate(frames, count, status);
+            t1 = now();
+            cb_frame_batch_extract(data, count, mask, col);
+            t2 = now();
+
+            if (t1 - t0 < best_validate)
+                best_validate = t1 - t0;
+            if (t2 - t1 < best_extract)
+                best_extract = t2 - t1;
+        }
+
+        if (impl == CB_FRAME_BATCH_IMPL_SCALAR) {
+            ref_valid = valid;
+            memcpy(ref_status, status, count);
+            memcpy(ref_col, col, count * sizeof(*col));
+        } else if (valid != ref_valid || memcmp(ref_status, status, count) ||
+                   memcmp(ref_col, col, count * sizeof(*col))) {
+            fprintf(stderr, "%s: results differ from scalar implementation\n", cb_frame_batch_impl_to_str(impl));
+            return EXIT_FAILURE;
+        }
+
+        printf("%-8s %14.0f %10.1f %14.0f\n", cb_frame_batch_impl_to_str(impl),
+               count / best_validate, count * CB_UART_FRAME_SIZE / 1048576.0 / best_validate,
+               count / best_extract);
+    }
+
+    printf("\n%zu of %zu frames valid\n", ref_valid, count);
+
+    free(frames);
+    free(status);
+    free(ref_status);
+    free(data);
+    free(col);
+    free(ref_col);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,546 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Checks the libc calls and heap allocations per frame of the hot paths against
+ * fixed budgets, so that regressions are caught automatically.
+ *
+ * The library talks to a pseudo terminal like to a real UART, the harness plays
+ * the other side. Only the library calls are accounted, not the I/O of the harness.
+ * The exit code is non-zero if any scenario exceeds its budget.
+ *
+ * Usage: ra-budget [<options>]
+ *
+ * Options:
+ *         -n, --frames            count of frames per scenario (default: 1000)
+ *         -j, --json              print the results as JSON
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cb_async.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <crc8_j1850.h>
+#include <logging.h>
+#include <ra_protocol.h>
+#include <uart.h>
+#include "ra-syscount.h"
+
+/* command line options */
+static const struct option long_options[] = {
+    { "frames",             required_argument,      0,      'n' },
+    { "json",               no_argument,            0,      'j' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "n:jh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "count of frames per scenario (default: 1000)",
+    "print the results as JSON",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static unsigned int frames = 1000;
+static bool json;
+
+struct budget_env {
+    /* pseudo terminal: the library uses the slave side */
+    int master_fd;
+    struct uart_ctx uart;
+
+    struct safety_controller ctx;
+
+    uint8_t frame[CB_UART_FRAME_SIZE];
+    uint8_t status_rsp[7];
+    uint8_t payload[1024];
+    uint8_t data_pkt[4 + 1024 + 2];
+
+    /* accounted calls of the current scenario */
+    struct ra_syscount total;
+};
+
+struct scenario {
+    const char *name;
+    const char *desc;
+    int (*run)(struct budget_env *env);
+    /* allowed calls per frame, all others must not be used at all */
+    double budget[RA_SYSCOUNT_MAX];
+};
+
+/* discard everything the slave side has sent so far */
+static void drain_master(struct budget_env *env)
+{
+    uint8_t buf[4096];
+
+    while (read(env->master_fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+static void account(struct budget_env *env, const struct ra_syscount *before)
+{
+    struct ra_syscount after, diff;
+    unsigned int i;
+
+    ra_syscount_read(&after);
+    ra_syscount_sub(before, &after, &diff);
+
+    for (i = 0; i < RA_SYSCOUNT_MAX; i++)
+        env->total.count[i] += diff.count[i];
+}
+
+static int queue_frame(struct budget_env *env)
+{
+    if (write(env->master_fd, env->frame, sizeof(env->frame)) != sizeof(env->frame))
+        return -1;
+
+    return 0;
+}
+
+/* the receive loop of ra-raw */
+static int run_recv(struct budget_env *env)
+{
+    struct ra_syscount before;
+    enum cb_uart_com com;
+    uint64_t data;
+    unsigned int i;
+
+    for (i = 0; i < frames; i++) {
+        if (queue_frame(env))
+            return -1;
+
+        ra_syscount_read(&before);
+        if (cb_uart_recv(&env->uart, &com, &data))
+            return -1;
+        cb_proto_set_ts(&env->ctx, com);
+        cb_proto_store_frame(&env->ctx, com, data);
+        account(env, &before);
+    }
+
+    return 0;
+}
+
+/* a debug message callback which formats the message, like a logger would do */
+static void format_msg(const char *format, va_list args)
+{
+    char buf[256];
+
+    vsnprintf(buf, sizeof(buf), format, args);
+}
+
+static int run_recv_traced(struct budget_env *env)
+{
+    int rv;
+
+    env->uart.trace = true;
+    ra_utils_set_debug_msg_cb(format_msg);
+
+    rv = run_recv(env);
+
+    ra_utils_set_debug_msg_cb(NULL);
+    env->uart.trace = false;
+
+    return rv;
+}
+
+static void async_frame(struct cb_async *a, enum cb_uart_com com, uint64_t data, void *userdata)
+{
+    (void)a;
+    (void)com;
+    (void)data;
+
+    (*(unsigned int *)userdata)++;
+}
+
+static const struct cb_async_ops async_ops = {
+    .frame = async_frame,
+};
+
+/* a consumer of the asynchronous API, woken up by its event loop */
+static int run_async_recv(struct budget_env *env)
+{
+    struct ra_syscount before;
+    unsigned int received = 0;
+    struct cb_async *a;
+    unsigned int i;
+    int rv = 0;
+
+    a = cb_async_new(&env->uart, &env->ctx, &async_ops, &received);
+    if (!a)
+        return -1;
+
+    for (i = 0; i < frames; i++) {
+        if (queue_frame(env)) {
+            rv = -1;
+            break;
+        }
+
+        ra_syscount_read(&before);
+        rv = cb_async_process(a, POLLIN);
+        account(env, &before);
+        if (rv)
+            break;
+    }
+
+    cb_async_free(a);
+
+    if (!rv && received != frames) {
+        errno = EPROTO;
+        rv = -1;
+    }
+
+    return rv;
+}
+
+static int run_send(struct budget_env *env)
+{
+    struct ra_syscount before;
+    unsigned int i;
+
+    for (i = 0; i < frames; i++) {
+        ra_syscount_read(&before);
+        cb_proto_set_ts(&env->ctx, COM_CHARGE_CONTROL);
+        if (cb_uart_send(&env->uart, COM_CHARGE_CONTROL, i))
+            return -1;
+        account(env, &before);
+
+        drain_master(env);
+    }
+
+    return 0;
+}
+
+static int run_ra_write_data(struct budget_env *env)
+{
+    struct ra_syscount before;
+    unsigned int i;
+
+    for (i = 0; i < frames; i++) {
+        /* queue the status response of the boot firmware before sending */
+        if (write(env->master_fd, env->status_rsp, sizeof(env->status_rsp)) != sizeof(env->status_rsp))
+            return -1;
+
+        ra_syscount_read(&before);
+        if (ra_write_data(&env->uart, env->payload, sizeof(env->payload)))
+            return -1;
+        account(env, &before);
+
+        drain_master(env);
+    }
+
+    return 0;
+}
+
+static int run_ra_read_data(struct budget_env *env)
+{
+    struct ra_syscount before;
+    unsigned int i;
+
+    for (i = 0; i < frames; i++) {
+        /* queue the data packet of the boot firmware */
+        if (write(env->master_fd, env->data_pkt, sizeof(env->data_pkt)) != sizeof(env->data_pkt))
+            return -1;
+
+        ra_syscount_read(&before);
+        if (ra_read_data(&env->uart, env->payload, sizeof(env->payload), true))
+            return -1;
+        account(env, &before);
+
+        drain_master(env);
+    }
+
+    return 0;
+}
+
+static const struct scenario scenarios[] = {
+    {
+        "recv", "cb_uart_recv, cb_proto_set_ts and cb_proto_store_frame",
+        run_recv,
+        {
+            [RA_SYSCOUNT_READV] = 1,
+            [RA_SYSCOUNT_POLL] = 1,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 3,
+        },
+    },
+    {
+        "recv-traced", "the same with frame tracing enabled",
+        run_recv_traced,
+        {
+            [RA_SYSCOUNT_READV] = 1,
+            [RA_SYSCOUNT_POLL] = 1,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 4,
+            [RA_SYSCOUNT_MALLOC] = 1,
+            [RA_SYSCOUNT_FREE] = 1,
+        },
+    },
+    {
+        "async-recv", "cb_async_process on POLLIN",
+        run_async_recv,
+        {
+            [RA_SYSCOUNT_READ] = 2,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 3,
+        },
+    },
+    {
+        "send", "cb_proto_set_ts and cb_uart_send",
+        run_send,
+        {
+            [RA_SYSCOUNT_WRITEV] = 1,
+            [RA_SYSCOUNT_TCDRAIN] = 1,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 1,
+        },
+    },
+    {
+        "ra_write_data", "one 1 KiB bootloader data packet including the status response",
+        run_ra_write_data,
+        {
+            [RA_SYSCOUNT_READV] = 1,
+            [RA_SYSCOUNT_WRITEV] = 1,
+            [RA_SYSCOUNT_POLL] = 1,
+            [RA_SYSCOUNT_TCDRAIN] = 1,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 2,
+        },
+    },
+    {
+        "ra_read_data", "one 1 KiB bootloader data packet including the confirmation",
+        run_ra_read_data,
+        {
+            [RA_SYSCOUNT_READV] = 2,
+            [RA_SYSCOUNT_WRITEV] = 1,
+            [RA_SYSCOUNT_POLL] = 2,
+            [RA_SYSCOUNT_TCDRAIN] = 1,
+            [RA_SYSCOUNT_CLOCK_GETTIME] = 4,
+        },
+    },
+    {} /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+    const struct scenario *s;
+
+    fprintf(stderr,
+            "%s -- Check the libc calls and allocations per frame against budgets\n\n"
+            "Usage: %s [<options>]\n\n"
+            , p, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        fprintf(stderr, "\t-%c, --%-12s\t%s\n", op->val, op->name, *desc);
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr,
+            "\nScenarios:\n");
+
+    for (s = scenarios; s->name; s++)
+        fprintf(stderr, "\t%-18s\t%s\n", s->name, s->desc);
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    char *endptr;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'n':
+            errno = 0;
+            frames = strtoul(optarg, &endptr, 0);
+            if (errno || endptr == optarg || *endptr != '\0' || frames == 0) {
+                fprintf(stderr, "Error: invalid frame count '%s'.\n", optarg);
+                usage(program_invocation_short_name, EXIT_FAILURE);
+            }
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'h':
+            usage(program_invocation_short_name, EXIT_SUCCESS);
+            break;
+        default:
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        }
+    }
+
+    if (optind != argc)
+        usage(program_invocation_short_name, EXIT_FAILURE);
+}
+
+static int env_init(struct budget_env *env)
+{
+    char *slave_name;
+    size_t i;
+
+    memset(env, 0, sizeof(*env));
+    env->uart = (struct uart_ctx)INIT_UART_CTX;
+
+    for (i = 0; i < sizeof(env->payload); i++)
+        env->payload[i] = i * 13;
+
+    /* a valid Charge State frame */
+    env->frame[0] = CB_UART_SOF;
+    env->frame[1] = COM_CHARGE_STATE;
+    for (i = 2; i < 10; i++)
+        env->frame[i] = i * 0x11;
+    env->frame[10] = crc8_j1850(&env->frame[1], 9);
+    env->frame[11] = CB_UART_EOF;
+
+    /* positive status response to a data packet */
+    env->status_rsp[0] = 0x81; /* SOD */
+    env->status_rsp[1] = 0x00; /* LNH */
+    env->status_rsp[2] = 0x02; /* LNL */
+    env->status_rsp[3] = 0x13; /* RES: write command */
+    env->status_rsp[4] = 0x00; /* STS: OK */
+    env->status_rsp[5] = ra_checksum(&env->status_rsp[1], 4);
+    env->status_rsp[6] = 0x03; /* ETX */
+
+    /* data packet of the boot firmware answering a read command */
+    env->data_pkt[0] = 0x81; /* SOD */
+    env->data_pkt[1] = (sizeof(env->payload) + 1) >> 8; /* LNH */
+    env->data_pkt[2] = (sizeof(env->payload) + 1) & 0xff; /* LNL */
+    env->data_pkt[3] = 0x15; /* RES: read command */
+    memcpy(&env->data_pkt[4], env->payload, sizeof(env->payload));
+    env->data_pkt[sizeof(env->data_pkt) - 2] = ra_checksum(&env->data_pkt[1], sizeof(env->data_pkt) - 3);
+    env->data_pkt[sizeof(env->data_pkt) - 1] = 0x03; /* ETX */
+
+    env->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (env->master_fd < 0) {
+        fprintf(stderr, "Error: posix_openpt failed: %m\n");
+        return -1;
+    }
+
+    if (grantpt(env->master_fd) || unlockpt(env->master_fd) || !(slave_name = ptsname(env->master_fd))) {
+        fprintf(stderr, "Error: could not unlock the pty: %m\n");
+        goto close_out;
+    }
+
+    /* the name buffer of ptsname is static, but uart_ctx only keeps the pointer */
+    slave_name = strdup(slave_name);
+    if (!slave_name) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto close_out;
+    }
+
+    if (uart_open(&env->uart, slave_name, 115200)) {
+        fprintf(stderr, "Error: could not open '%s'\n", slave_name);
+        free(slave_name);
+        goto close_out;
+    }
+
+    return 0;
+
+close_out:
+    close(env->master_fd);
+    return -1;
+}
+
+static void env_close(struct budget_env *env)
+{
+    const char *slave_name = env->uart.device;
+
+    uart_close(&env->uart);
+    free((char *)slave_name);
+    close(env->master_fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct scenario *s;
+    struct budget_env env;
+    bool first = true;
+    int rv = EXIT_SUCCESS;
+
+    parse_cli(argc, argv);
+
+    if (env_init(&env))
+        return EXIT_FAILURE;
+
+    if (json)
+        printf("{\n  \"frames\": %u,\n  \"scenarios\": [", frames);
+
+    for (s = scenarios; s->name; s++) {
+        bool exceeded = false;
+        unsigned int i;
+
+        memset(&env.total, 0, sizeof(env.total));
+
+        if (s->run(&env)) {
+            fprintf(stderr, "Error: scenario '%s' failed: %m\n", s->name);
+            rv = EXIT_FAILURE;
+            continue;
+        }
+
+        if (json)
+            printf("%s\n    { \"name\": \"%s\", \"calls_per_frame\": {", first ? "" : ",", s->name);
+        else
+            printf("== %s: %s ==\n", s->name, s->desc);
+        first = false;
+
+        for (i = 0; i < RA_SYSCOUNT_MAX; i++) {
+            double per_frame = (double)env.total.count[i] / frames;
+            bool over = per_frame > s->budget[i];
+
+            if (json) {
+                printf("%s \"%s\": { \"measured\": %.3f, \"budget\": %.3f }",
+                       i ? "," : "", ra_syscount_name(i), per_frame, s->budget[i]);
+                continue;
+            }
+
+            if (per_frame == 0.0 && s->budget[i] == 0.0)
+                continue;
+
+            printf("  %-16s %8.3f / %-8.3f%s\n", ra_syscount_name(i), per_frame, s->budget[i],
+                   over ? "  EXCEEDED" : "");
+            exceeded |= over;
+        }
+
+        if (json) {
+            for (i = 0; i < RA_SYSCOUNT_MAX; i++)
+                exceeded |= (double)env.total.count[i] / frames > s->budget[i];
+            printf(" }, \"exceeded\": %s }", exceeded ? "true" : "false");
+        }
+
+        if (exceeded)
+            rv = EXIT_FAILURE;
+    }
+
+    if (json)
+        printf("\n  ]\n}\n");
+    else
+        printf("\n%s\n", rv == EXIT_SUCCESS ? "All scenarios are within their budgets." : "Scenarios failed or exceeded their budgets.");
+
+    env_close(&env);
+
+    return rv;
+}
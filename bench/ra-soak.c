@@ -0,0 +1,763 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Soak and load benchmark: runs ra-raw and an asynchronous library consumer
+ * (cb_async.h) against simulated safety controllers (ra-sim) for a long time
+ * and samples CPU time, RSS and read/write syscalls of all processes from /proc.
+ * At the end, it reports the cost per frame, the memory growth and the latency
+ * percentiles of the Charge Control responses (measured by ra-sim) and of the
+ * inquiries (measured by the library consumer).
+ *
+ * Usage: ra-soak [<options>] [-- <ra-sim options>]
+ *
+ *  Options:
+ *          -d, --duration          duration (in s, default: 3600)
+ *          -i, --interval          sample interval (in s, default: 10)
+ *          -c, --consumers         comma-separated list of consumers: raw, lib (default: raw,lib)
+ *          -s, --sim               path of ra-sim (default: from build tree)
+ *          -r, --raw               path of ra-raw (default: from build tree)
+ *          -o, --output            write all samples as CSV to this file
+ *          -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_async.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <tools.h>
+#include <uart.h>
+
+/* set by the build system */
+#ifndef RA_SIM_PATH
+#define RA_SIM_PATH "ra-sim"
+#endif
+#ifndef RA_RAW_PATH
+#define RA_RAW_PATH "ra-raw"
+#endif
+
+static const struct option long_options[] = {
+    { "duration",           required_argument,      0,      'd' },
+    { "interval",           required_argument,      0,      'i' },
+    { "consumers",          required_argument,      0,      'c' },
+    { "sim",                required_argument,      0,      's' },
+    { "raw",                required_argument,      0,      'r' },
+    { "output",             required_argument,      0,      'o' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "d:i:c:s:r:o:h";
+
+/* the library consumer inquires the firmware version this often, in ms */
+#define LIB_INQUIRY_INTERVAL 1000
+
+/* resolution and range of the RTT histogram of the library consumer */
+#define RTT_BUCKET_US 10
+#define RTT_BUCKETS 10000
+
+/* maximum count of values in a key/value statistics file */
+#define MAX_STATS 64
+
+enum consumer_kind {
+    CONSUMER_RAW,
+    CONSUMER_LIB,
+    CONSUMER_MAX,
+};
+
+static const char *consumer_names[CONSUMER_MAX] = { "raw", "lib" };
+
+/* resource usage of a process at one point in time */
+struct proc_sample {
+    double cpu_s;
+    unsigned long rss_kb;
+    unsigned long long syscalls; /* read and write like ones only, as counted by /proc/<pid>/io */
+};
+
+struct proc {
+    pid_t pid;
+    struct proc_sample first;
+    struct proc_sample last;
+    unsigned long rss_max_kb;
+    bool exited;
+    double exited_after;
+};
+
+struct consumer {
+    enum consumer_kind kind;
+    char link[64];
+    char sim_stats[64];
+    char lib_stats[64];
+    struct proc sim;
+    struct proc client;
+};
+
+/* key/value pairs as written by ra-sim and the library consumer */
+struct stats {
+    char key[MAX_STATS][32];
+    double value[MAX_STATS];
+    unsigned int count;
+};
+
+/* to simplify, these are globals */
+static unsigned int duration = 3600;
+static unsigned int interval = 10;
+static bool enabled[CONSUMER_MAX] = { true, true };
+static char *sim_path = RA_SIM_PATH;
+static char *raw_path = RA_RAW_PATH;
+static char *output_filename = NULL;
+static char **sim_args = NULL;
+static int sim_arg_count = 0;
+static char tmpdir[] = "/tmp/ra-soak-XXXXXX";
+
+static volatile sig_atomic_t terminate = 0;
+
+static void usage(char *p, int exitcode)
+{
+    fprintf(stderr,
+            "Usage: %s [<options>] [-- <ra-sim options>]\n\n"
+            "Options:\n"
+            "\t-d, --duration     duration (in s, default: 3600)\n"
+            "\t-i, --interval     sample interval (in s, default: 10)\n"
+            "\t-c, --consumers    comma-separated list of consumers: raw, lib (default: raw,lib)\n"
+            "\t-s, --sim          path of ra-sim (default: %s)\n"
+            "\t-r, --raw          path of ra-raw (default: %s)\n"
+            "\t-o, --output       write all samples as CSV to this file\n"
+            "\t-h, --help         print this usage and exit\n\n",
+            p, RA_SIM_PATH, RA_RAW_PATH);
+
+    exit(exitcode);
+}
+
+static void parse_consumers(char *list, char *p)
+{
+    char *saveptr = NULL;
+    char *name;
+    int i;
+
+    memset(enabled, 0, sizeof(enabled));
+
+    for (name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+        for (i = 0; i < CONSUMER_MAX; i++) {
+            if (strcmp(name, consumer_names[i]) == 0)
+                break;
+        }
+        if (i == CONSUMER_MAX) {
+            fprintf(stderr, "Error: unknown consumer '%s'.\n\n", name);
+            usage(p, EXIT_FAILURE);
+        }
+        enabled[i] = true;
+    }
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        case 'c':
+            parse_consumers(optarg, argv[0]);
+            break;
+        case 's':
+            sim_path = optarg;
+            break;
+        case 'r':
+            raw_path = optarg;
+            break;
+        case 'o':
+            output_filename = optarg;
+            break;
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            /* fall-through */
+        default:
+            usage(argv[0], rc);
+        }
+    }
+
+    if (!interval) {
+        fprintf(stderr, "Error: the sample interval must not be zero.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    /* the remaining arguments are passed to ra-sim */
+    sim_args = &argv[optind];
+    sim_arg_count = argc - optind;
+}
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    terminate = 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* waits for the given time or a signal */
+static void sleep_s(double s)
+{
+    struct timespec ts = { .tv_sec = (time_t)s, .tv_nsec = (long)((s - (time_t)s) * 1e9) };
+
+    nanosleep(&ts, NULL);
+}
+
+static int proc_read_sample(pid_t pid, struct proc_sample *sample)
+{
+    unsigned long utime, stime;
+    char path[64], line[512];
+    char *p;
+    FILE *f;
+
+    memset(sample, 0, sizeof(*sample));
+
+    /* CPU times: fields 14 and 15, counted after the command name which may contain spaces */
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    p = fgets(line, sizeof(line), f);
+    fclose(f);
+    if (!p || !(p = strrchr(line, ')')))
+        return -1;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return -1;
+    sample->cpu_s = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %lu", &sample->rss_kb) == 1)
+            break;
+    }
+    fclose(f);
+
+    /* might not be available, depending on the kernel configuration */
+    snprintf(path, sizeof(path), "/proc/%d/io", pid);
+    f = fopen(path, "r");
+    if (f) {
+        unsigned long long v;
+
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "syscr: %llu", &v) == 1 || sscanf(line, "syscw: %llu", &v) == 1)
+                sample->syscalls += v;
+        }
+        fclose(f);
+    }
+
+    return 0;
+}
+
+static void proc_sample(struct proc *proc, bool first, double elapsed)
+{
+    struct proc_sample s;
+
+    if (proc->pid <= 0 || proc->exited)
+        return;
+
+    /* a zombie has no memory anymore, so keep the last sample then */
+    if (waitpid(proc->pid, NULL, WNOHANG) != 0) {
+        proc->exited = true;
+        proc->exited_after = elapsed;
+        proc->pid = 0;
+        return;
+    }
+
+    if (proc_read_sample(proc->pid, &s))
+        return;
+
+    if (first)
+        proc->first = s;
+    proc->last = s;
+
+    if (s.rss_kb > proc->rss_max_kb)
+        proc->rss_max_kb = s.rss_kb;
+}
+
+static int stats_read(const char *filename, struct stats *st)
+{
+    char line[128];
+    FILE *f;
+
+    st->count = 0;
+
+    f = fopen(filename, "r");
+    if (!f)
+        return -1;
+
+    while (st->count < MAX_STATS && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%31s %lf", st->key[st->count], &st->value[st->count]) == 2)
+            st->count++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static double stats_get(const struct stats *st, const char *key)
+{
+    unsigned int i;
+
+    for (i = 0; i < st->count; i++) {
+        if (strcmp(st->key[i], key) == 0)
+            return st->value[i];
+    }
+
+    return 0;
+}
+
+/*
+ * The library consumer: answers each Charge State with a Charge Control frame
+ * like ra-raw does, and inquires the firmware version periodically.
+ */
+
+struct lib_consumer {
+    struct uart_ctx uart;
+    struct safety_controller ctx;
+    struct cb_async *async;
+
+    struct timespec inquiry_sent;
+    unsigned long inquiries;
+    unsigned long inquiries_lost;
+    unsigned long rx_errors;
+    unsigned long link_timeouts;
+
+    uint32_t rtt_hist[RTT_BUCKETS];
+    unsigned long rtt_count;
+    long long rtt_max_us;
+};
+
+static void lib_frame(struct cb_async *a, enum cb_uart_com com, uint64_t data, void *userdata)
+{
+    struct lib_consumer *lc = userdata;
+
+    (void)data;
+
+    if (com == COM_CHARGE_STATE)
+        cb_async_send(a, COM_CHARGE_CONTROL, lc->ctx.charge_control, NULL, NULL);
+}
+
+static void lib_timeout(struct cb_async *a, void *userdata)
+{
+    struct lib_consumer *lc = userdata;
+
+    (void)a;
+    lc->link_timeouts++;
+}
+
+static void lib_error(struct cb_async *a, int err, void *userdata)
+{
+    struct lib_consumer *lc = userdata;
+
+    (void)a;
+    (void)err;
+    lc->rx_errors++;
+}
+
+static void lib_inquiry_done(struct cb_async *a, int status, enum cb_uart_com com, uint64_t data, void *userdata)
+{
+    struct lib_consumer *lc = userdata;
+    struct timespec now;
+    long long us;
+    unsigned int bucket;
+
+    (void)a;
+    (void)com;
+    (void)data;
+
+    if (status) {
+        lc->inquiries_lost++;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    us = timespec_to_us(timespec_sub(now, lc->inquiry_sent));
+
+    bucket = us / RTT_BUCKET_US;
+    if (bucket >= RTT_BUCKETS)
+        bucket = RTT_BUCKETS - 1;
+
+    lc->rtt_hist[bucket]++;
+    lc->rtt_count++;
+    if (us > lc->rtt_max_us)
+        lc->rtt_max_us = us;
+}
+
+/* returns the upper bound of the bucket which contains the given per mille, in us */
+static long long rtt_permille(const struct lib_consumer *lc, unsigned int permille)
+{
+    unsigned long long target = (lc->rtt_count * permille + 999) / 1000;
+    unsigned long long sum = 0;
+    unsigned int i;
+
+    if (!lc->rtt_count)
+        return 0;
+
+    for (i = 0; i < RTT_BUCKETS; i++) {
+        sum += lc->rtt_hist[i];
+        if (sum >= target)
+            return (long long)(i + 1) * RTT_BUCKET_US;
+    }
+
+    return (long long)RTT_BUCKETS * RTT_BUCKET_US;
+}
+
+static int lib_consumer_run(const char *device, const char *stats_filename)
+{
+    static const struct cb_async_ops ops = { lib_frame, lib_timeout, lib_error };
+    struct lib_consumer *lc;
+    struct timespec next_inquiry;
+    FILE *f;
+
+    lc = calloc(1, sizeof(*lc));
+    if (!lc)
+        return EXIT_FAILURE;
+
+    lc->uart = (struct uart_ctx)INIT_UART_CTX;
+    if (uart_open(&lc->uart, device, 115200))
+        return EXIT_FAILURE;
+
+    lc->async = cb_async_new(&lc->uart, &lc->ctx, &ops, lc);
+    if (!lc->async)
+        return EXIT_FAILURE;
+
+    clock_gettime(CLOCK_MONOTONIC, &next_inquiry);
+
+    while (!terminate) {
+        struct pollfd pfd = { cb_async_get_fd(lc->async), cb_async_get_events(lc->async), 0 };
+        struct timespec now;
+        int timeout, inquiry_timeout;
+        int rv;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (timespec_compare(&next_inquiry, &now) <= 0) {
+            lc->inquiry_sent = now;
+            if (cb_async_inquiry(lc->async, COM_FW_VERSION, lib_inquiry_done, lc) == 0)
+                lc->inquiries++;
+            timespec_add_ms(&next_inquiry, LIB_INQUIRY_INTERVAL);
+            pfd.events = cb_async_get_events(lc->async);
+        }
+
+        timeout = cb_async_get_timeout(lc->async);
+        inquiry_timeout = timespec_to_ms(timespec_sub(next_inquiry, now)) + 1;
+        if (timeout < 0 || inquiry_timeout < timeout)
+            timeout = inquiry_timeout;
+
+        rv = poll(&pfd, 1, timeout);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (cb_async_process(lc->async, rv > 0 ? pfd.revents : 0))
+            break;
+    }
+
+    cb_async_free(lc->async);
+    uart_close(&lc->uart);
+
+    f = fopen(stats_filename, "w");
+    if (!f)
+        return EXIT_FAILURE;
+
+    fprintf(f, "inquiries %lu\n", lc->inquiries);
+    fprintf(f, "inquiries_lost %lu\n", lc->inquiries_lost);
+    fprintf(f, "rx_errors %lu\n", lc->rx_errors);
+    fprintf(f, "link_timeouts %lu\n", lc->link_timeouts);
+    fprintf(f, "inquiry_rtt_p50_us %lld\n", rtt_permille(lc, 500));
+    fprintf(f, "inquiry_rtt_p99_us %lld\n", rtt_permille(lc, 990));
+    fprintf(f, "inquiry_rtt_p999_us %lld\n", rtt_permille(lc, 999));
+    fprintf(f, "inquiry_rtt_max_us %lld\n", lc->rtt_max_us);
+    fclose(f);
+
+    free(lc);
+    return EXIT_SUCCESS;
+}
+
+static pid_t spawn(char *const argv[], bool quiet)
+{
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid != 0)
+        return pid;
+
+    if (quiet) {
+        int fd = open("/dev/null", O_WRONLY);
+
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+    }
+
+    execvp(argv[0], argv);
+    fprintf(stderr, "Error: could not execute '%s': %m\n", argv[0]);
+    _exit(127);
+}
+
+static int consumer_start(struct consumer *c)
+{
+    char *argv[sim_arg_count + 8];
+    struct stat st;
+    int i, n = 0;
+    double t;
+
+    snprintf(c->link, sizeof(c->link), "%s/%s.tty", tmpdir, consumer_names[c->kind]);
+    snprintf(c->sim_stats, sizeof(c->sim_stats), "%s/%s.sim", tmpdir, consumer_names[c->kind]);
+    snprintf(c->lib_stats, sizeof(c->lib_stats), "%s/%s.lib", tmpdir, consumer_names[c->kind]);
+
+    argv[n++] = sim_path;
+    argv[n++] = "-l";
+    argv[n++] = c->link;
+    argv[n++] = "-o";
+    argv[n++] = c->sim_stats;
+    for (i = 0; i < sim_arg_count; i++)
+        argv[n++] = sim_args[i];
+    argv[n] = NULL;
+
+    c->sim.pid = spawn(argv, true);
+    if (c->sim.pid < 0)
+        return -1;
+
+    /* wait for the pty to appear */
+    for (t = now_s(); lstat(c->link, &st) != 0; sleep_s(0.01)) {
+        if (now_s() - t > 5 || waitpid(c->sim.pid, NULL, WNOHANG) != 0) {
+            fprintf(stderr, "Error: ra-sim did not start\n");
+            return -1;
+        }
+    }
+
+    if (c->kind == CONSUMER_RAW) {
+        char *raw_argv[] = { raw_path, "-R", "-d", c->link, "-f", "jsonl", NULL };
+
+        c->client.pid = spawn(raw_argv, true);
+    } else {
+        fflush(stdout);
+        fflush(stderr);
+
+        c->client.pid = fork();
+        if (c->client.pid == 0)
+            _exit(lib_consumer_run(c->link, c->lib_stats));
+    }
+
+    return c->client.pid < 0 ? -1 : 0;
+}
+
+static void proc_stop(struct proc *proc)
+{
+    if (proc->pid <= 0)
+        return;
+
+    kill(proc->pid, SIGTERM);
+    waitpid(proc->pid, NULL, 0);
+    proc->pid = 0;
+}
+
+static void consumer_stop(struct consumer *c)
+{
+    /* stop the client first, so that the simulator sees all of its frames */
+    proc_stop(&c->client);
+    proc_stop(&c->sim);
+}
+
+static void print_report(struct consumer *consumers, unsigned int count, double elapsed)
+{
+    unsigned int i;
+
+    printf("\n%-8s %8s %10s %10s %9s %9s %9s %9s %9s %9s %9s\n",
+           "consumer", "frames", "cpu[s]", "cpu/fr[us]", "sysc/fr", "rss0[kB]", "rssmax", "rss-grow",
+           "cc_p50", "cc_p99", "cc_max");
+
+    for (i = 0; i < count; i++) {
+        struct consumer *c = &consumers[i];
+        struct proc *p = &c->client;
+        struct stats st;
+        double frames, cpu;
+
+        stats_read(c->sim_stats, &st);
+
+        /* everything the client received plus everything it sent */
+        frames = stats_get(&st, "tx_frames") + stats_get(&st, "rx_frames");
+        cpu = p->last.cpu_s - p->first.cpu_s;
+
+        printf("%-8s %8.0f %10.2f %10.2f %9.2f %9lu %9lu %9ld %7.2fms %7.2fms %7.2fms\n",
+               consumer_names[c->kind], frames, cpu,
+               frames ? cpu * 1e6 / frames : 0.0,
+               frames ? (p->last.syscalls - p->first.syscalls) / frames : 0.0,
+               p->first.rss_kb, p->rss_max_kb, (long)p->last.rss_kb - (long)p->first.rss_kb,
+               stats_get(&st, "cc_latency_p50_us") / 1000, stats_get(&st, "cc_latency_p99_us") / 1000,
+               stats_get(&st, "cc_latency_max_us") / 1000);
+    }
+
+    printf("\n");
+
+    for (i = 0; i < count; i++) {
+        struct consumer *c = &consumers[i];
+        struct stats st;
+
+        stats_read(c->sim_stats, &st);
+        if (c->client.exited)
+            printf("%s: exited prematurely after about %.0f s, see its error output\n",
+                   consumer_names[c->kind], c->client.exited_after);
+        printf("%s: ra-sim used %.2f s CPU, %0.f frames dropped, %.0f bad frames received, "
+               "CC latency p999 %.2f ms\n",
+               consumer_names[c->kind], c->sim.last.cpu_s - c->sim.first.cpu_s,
+               stats_get(&st, "tx_dropped"), stats_get(&st, "rx_bad_frames"),
+               stats_get(&st, "cc_latency_p999_us") / 1000);
+
+        if (c->kind == CONSUMER_LIB && stats_read(c->lib_stats, &st) == 0)
+            printf("%s: %.0f inquiries, %.0f lost, RTT p50 %.2f ms, p99 %.2f ms, p999 %.2f ms, max %.2f ms, "
+                   "%.0f receive errors\n",
+                   consumer_names[c->kind], stats_get(&st, "inquiries"), stats_get(&st, "inquiries_lost"),
+                   stats_get(&st, "inquiry_rtt_p50_us") / 1000, stats_get(&st, "inquiry_rtt_p99_us") / 1000,
+                   stats_get(&st, "inquiry_rtt_p999_us") / 1000, stats_get(&st, "inquiry_rtt_max_us") / 1000,
+                   stats_get(&st, "rx_errors"));
+    }
+
+    printf("\nduration %.0f s\n", elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction sa = { .sa_handler = signal_handler };
+    struct consumer consumers[CONSUMER_MAX];
+    unsigned int count = 0, i;
+    FILE *csv = NULL;
+    double start, next;
+    int rc = EXIT_FAILURE;
+
+    parse_cli(argc, argv);
+
+    if (!mkdtemp(tmpdir)) {
+        fprintf(stderr, "Error: could not create temporary directory: %m\n");
+        return EXIT_FAILURE;
+    }
+
+    if (output_filename) {
+        csv = fopen(output_filename, "w");
+        if (!csv) {
+            fprintf(stderr, "Error: could not open '%s': %m\n", output_filename);
+            goto rmdir_out;
+        }
+        fprintf(csv, "time,consumer,process,cpu_s,rss_kb,syscalls\n");
+    }
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    memset(consumers, 0, sizeof(consumers));
+    for (i = 0; i < CONSUMER_MAX; i++) {
+        if (!enabled[i])
+            continue;
+
+        consumers[count].kind = i;
+        if (consumer_start(&consumers[count++]))
+            goto stop_out;
+    }
+
+    /* let the initial inquiries settle before taking the first sample */
+    sleep_s(1);
+
+    start = now_s();
+    for (i = 0; i < count; i++) {
+        proc_sample(&consumers[i].client, true, 0);
+        proc_sample(&consumers[i].sim, true, 0);
+    }
+
+    printf("%8s %-8s %8s %8s %10s\n", "time[s]", "consumer", "cpu[%]", "rss[kB]", "syscalls/s");
+
+    for (next = start + interval; !terminate && next <= start + duration + 1e-3; next += interval) {
+        sleep_s(next - now_s());
+        if (terminate)
+            break;
+
+        for (i = 0; i < count; i++) {
+            struct consumer *c = &consumers[i];
+            struct proc_sample prev = c->client.last;
+
+            if (c->client.exited)
+                continue;
+
+            proc_sample(&c->client, false, next - start);
+            proc_sample(&c->sim, false, next - start);
+
+            if (c->client.exited) {
+                printf("%8.0f %-8s exited\n", next - start, consumer_names[c->kind]);
+                continue;
+            }
+
+            printf("%8.0f %-8s %8.2f %8lu %10.0f\n", next - start, consumer_names[c->kind],
+                   (c->client.last.cpu_s - prev.cpu_s) * 100 / interval, c->client.last.rss_kb,
+                   (double)(c->client.last.syscalls - prev.syscalls) / interval);
+
+            if (csv) {
+                fprintf(csv, "%.0f,%s,client,%.2f,%lu,%llu\n", next - start, consumer_names[c->kind],
+                        c->client.last.cpu_s, c->client.last.rss_kb, c->client.last.syscalls);
+                fprintf(csv, "%.0f,%s,sim,%.2f,%lu,%llu\n", next - start, consumer_names[c->kind],
+                        c->sim.last.cpu_s, c->sim.last.rss_kb, c->sim.last.syscalls);
+            }
+        }
+        fflush(stdout);
+    }
+
+    for (i = 0; i < count; i++)
+        consumer_stop(&consumers[i]);
+
+    print_report(consumers, count, now_s() - start);
+    rc = EXIT_SUCCESS;
+
+stop_out:
+    for (i = 0; i < count; i++) {
+        consumer_stop(&consumers[i]);
+        unlink(consumers[i].sim_stats);
+        unlink(consumers[i].lib_stats);
+    }
+    if (csv)
+        fclose(csv);
+rmdir_out:
+    rmdir(tmpdir);
+    return rc;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Startup time benchmark: runs each given command line repeatedly (with stdout and
+ * stderr redirected to /dev/null) and reports the median, min, max and median absolute
+ * deviation of the wall clock time from spawning to the exit of the process. It is meant
+ * to compare the individual tools against the multicall binary, e.g. with '-V', where the
+ * time is dominated by loading, relocation and libc startup.
+ *
+ * Usage: ra-startup [<options>] <command line> [<command line>...]
+ *
+ * Options:
+ *         -r, --repetitions       count of measured runs (default: 200)
+ *         -w, --warmup            count of discarded warmup runs (default: 10)
+ *         -j, --json              print the results as JSON
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* maximum count of arguments of a command line */
+#define MAX_ARGS 32
+
+extern char **environ;
+
+static const struct option long_options[] = {
+    { "repetitions",        required_argument,      0,      'r' },
+    { "warmup",             required_argument,      0,      'w' },
+    { "json",               no_argument,            0,      'j' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "r:w:jh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "count of measured runs (default: 200)",
+    "count of discarded warmup runs (default: 10)",
+    "print the results as JSON",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static unsigned int repetitions = 200;
+static unsigned int warmup = 10;
+static bool json;
+
+struct result {
+    double median;
+    double min;
+    double max;
+    double mad;
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s -- Startup time of commands\n\n"
+            "Usage: %s [<options>] <command line> [<command line>...]\n\n"
+            , p, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        fprintf(stderr, "\t-%c, --%-12s\t%s\n", op->val, op->name, *desc);
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+static unsigned int parse_uint(const char *s, unsigned int min)
+{
+    char *endptr;
+    unsigned long v;
+
+    errno = 0;
+    v = strtoul(s, &endptr, 0);
+    if (errno || endptr == s || *endptr != '\0' || v < min || v > 1000000) {
+        fprintf(stderr, "Error: invalid value '%s'.\n", s);
+        usage(program_invocation_short_name, EXIT_FAILURE);
+    }
+
+    return v;
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'r':
+            repetitions = parse_uint(optarg, 1);
+            break;
+        case 'w':
+            warmup = parse_uint(optarg, 0);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'h':
+            usage(program_invocation_short_name, EXIT_SUCCESS);
+            break;
+        default:
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc)
+        usage(program_invocation_short_name, EXIT_FAILURE);
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* split a command line at blanks, no quoting is supported */
+static int split_cmdline(char *cmdline, char *args[])
+{
+    char *saveptr, *token;
+    int n = 0;
+
+    for (token = strtok_r(cmdline, " \t", &saveptr); token; token = strtok_r(NULL, " \t", &saveptr)) {
+        if (n == MAX_ARGS)
+            return -1;
+        args[n++] = token;
+    }
+    args[n] = NULL;
+
+    return n ? 0 : -1;
+}
+
+/* returns the duration in us or a negative value on error */
+static double run_once(char *args[], posix_spawn_file_actions_t *actions)
+{
+    double start, end;
+    int status;
+    pid_t pid;
+
+    start = now_us();
+
+    errno = posix_spawnp(&pid, args[0], actions, NULL, args, environ);
+    if (errno)
+        return -1;
+
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+
+    end = now_us();
+
+    if (!WIFEXITED(status)) {
+        errno = ECHILD;
+        return -1;
+    }
+
+    return end - start;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double median_of_sorted(const double *v, unsigned int n)
+{
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static int measure(char *args[], posix_spawn_file_actions_t *actions, double *samples, struct result *result)
+{
+    unsigned int i;
+
+    for (i = 0; i < warmup + repetitions; i++) {
+        double t = run_once(args, actions);
+
+        if (t < 0)
+            return -1;
+        if (i >= warmup)
+            samples[i - warmup] = t;
+    }
+
+    qsort(samples, repetitions, sizeof(*samples), cmp_double);
+    result->min = samples[0];
+    result->max = samples[repetitions - 1];
+    result->median = median_of_sorted(samples, repetitions);
+
+    for (i = 0; i < repetitions; i++)
+        samples[i] = samples[i] > result->median ? samples[i] - result->median : result->median - samples[i];
+    qsort(samples, repetitions, sizeof(*samples), cmp_double);
+    result->mad = median_of_sorted(samples, repetitions);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    posix_spawn_file_actions_t actions;
+    char *args[MAX_ARGS + 1];
+    struct result result;
+    double *samples;
+    int i, rc = EXIT_SUCCESS;
+
+    parse_cli(argc, argv);
+
+    samples = malloc(repetitions * sizeof(*samples));
+    if (!samples) {
+        fprintf(stderr, "Error: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    /* the output of the commands is not of interest */
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    if (json)
+        printf("{ \"repetitions\": %u, \"results\": {", repetitions);
+    else
+        printf("%-48s %12s %12s %12s %8s\n", "command", "median us", "min us", "max us", "mad %");
+
+    for (i = optind; i < argc; i++) {
+        char *cmdline = strdup(argv[i]);
+
+        if (!cmdline || split_cmdline(cmdline, args)) {
+            fprintf(stderr, "Error: invalid command line '%s'.\n", argv[i]);
+            rc = EXIT_FAILURE;
+            free(cmdline);
+            break;
+        }
+
+        if (measure(args, &actions, samples, &result)) {
+            fprintf(stderr, "Error: running '%s' failed: %m\n", argv[i]);
+            rc = EXIT_FAILURE;
+            free(cmdline);
+            break;
+        }
+
+        if (json)
+            printf("%s\n  \"%s\": { \"median\": %.1f, \"min\": %.1f, \"max\": %.1f, \"mad\": %.1f }",
+                   i == optind ? "" : ",", argv[i], result.median, result.min, result.max, result.mad);
+        else
+            printf("%-48s %12.1f %12.1f %12.1f %8.1f\n", argv[i], result.median, result.min, result.max,
+                   100.0 * result.mad / result.median);
+
+        free(cmdline);
+    }
+
+    if (json)
+        printf("\n} }\n");
+
+    posix_spawn_file_actions_destroy(&actions);
+    free(samples);
+
+    return rc;
+}
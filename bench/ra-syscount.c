@@ -0,0 +1,200 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Shim library counting libc calls and heap allocations, see ra-syscount.h.
+ *
+ * Only calls through the dynamic linker are seen, i.e. calls from programs and
+ * shared libraries, but not libc-internal ones. clock_gettime and gettimeofday
+ * are usually served by the vDSO without entering the kernel, but they are
+ * counted anyway since they are not free on small targets either.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "ra-syscount.h"
+
+static uint64_t counters[RA_SYSCOUNT_MAX];
+
+static const char *names[RA_SYSCOUNT_MAX] = {
+    [RA_SYSCOUNT_READ]          = "read",
+    [RA_SYSCOUNT_WRITE]         = "write",
+    [RA_SYSCOUNT_READV]         = "readv",
+    [RA_SYSCOUNT_WRITEV]        = "writev",
+    [RA_SYSCOUNT_POLL]          = "poll",
+    [RA_SYSCOUNT_IOCTL]         = "ioctl",
+    [RA_SYSCOUNT_TCDRAIN]       = "tcdrain",
+    [RA_SYSCOUNT_CLOCK_GETTIME] = "clock_gettime",
+    [RA_SYSCOUNT_GETTIMEOFDAY]  = "gettimeofday",
+    [RA_SYSCOUNT_LOCALTIME_R]   = "localtime_r",
+    [RA_SYSCOUNT_MALLOC]        = "malloc",
+    [RA_SYSCOUNT_CALLOC]        = "calloc",
+    [RA_SYSCOUNT_REALLOC]       = "realloc",
+    [RA_SYSCOUNT_FREE]          = "free",
+};
+
+static inline void count(enum ra_syscount_id id)
+{
+    __atomic_fetch_add(&counters[id], 1, __ATOMIC_RELAXED);
+}
+
+/* resolve the next definition of a symbol, i.e. usually the one of libc */
+#define NEXT(fn) \
+        ({ \
+            static typeof(&fn) next_##fn; \
+            if (!next_##fn) \
+                next_##fn = (typeof(&fn))dlsym(RTLD_NEXT, #fn); \
+            next_##fn; \
+        })
+
+const char *ra_syscount_name(enum ra_syscount_id id)
+{
+    return id < RA_SYSCOUNT_MAX ? names[id] : "unknown";
+}
+
+void ra_syscount_read(struct ra_syscount *sc)
+{
+    unsigned int i;
+
+    for (i = 0; i < RA_SYSCOUNT_MAX; i++)
+        sc->count[i] = __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+}
+
+void ra_syscount_sub(const struct ra_syscount *a, const struct ra_syscount *b, struct ra_syscount *diff)
+{
+    unsigned int i;
+
+    for (i = 0; i < RA_SYSCOUNT_MAX; i++)
+        diff->count[i] = b->count[i] - a->count[i];
+}
+
+void ra_syscount_fprint(const struct ra_syscount *sc, FILE *f)
+{
+    unsigned int i;
+
+    for (i = 0; i < RA_SYSCOUNT_MAX; i++)
+        fprintf(f, "%-16s %12llu\n", names[i], (unsigned long long)sc->count[i]);
+}
+
+__attribute__((destructor))
+static void ra_syscount_report(void)
+{
+    struct ra_syscount sc;
+
+    if (!getenv("RA_SYSCOUNT_REPORT"))
+        return;
+
+    /* take the snapshot first, the output itself allocates */
+    ra_syscount_read(&sc);
+    fprintf(stderr, "== ra-syscount ==\n");
+    ra_syscount_fprint(&sc, stderr);
+}
+
+ssize_t read(int fd, void *buf, size_t count_)
+{
+    count(RA_SYSCOUNT_READ);
+    return NEXT(read)(fd, buf, count_);
+}
+
+ssize_t write(int fd, const void *buf, size_t count_)
+{
+    count(RA_SYSCOUNT_WRITE);
+    return NEXT(write)(fd, buf, count_);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    count(RA_SYSCOUNT_READV);
+    return NEXT(readv)(fd, iov, iovcnt);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    count(RA_SYSCOUNT_WRITEV);
+    return NEXT(writev)(fd, iov, iovcnt);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    count(RA_SYSCOUNT_POLL);
+    return NEXT(poll)(fds, nfds, timeout);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+    va_list args;
+    void *arg;
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    count(RA_SYSCOUNT_IOCTL);
+    return NEXT(ioctl)(fd, request, arg);
+}
+
+int tcdrain(int fd)
+{
+    count(RA_SYSCOUNT_TCDRAIN);
+    return NEXT(tcdrain)(fd);
+}
+
+int clock_gettime(clockid_t clockid, struct timespec *tp)
+{
+    count(RA_SYSCOUNT_CLOCK_GETTIME);
+    return NEXT(clock_gettime)(clockid, tp);
+}
+
+int gettimeofday(struct timeval *restrict tv, void *restrict tz)
+{
+    count(RA_SYSCOUNT_GETTIMEOFDAY);
+    return NEXT(gettimeofday)(tv, tz);
+}
+
+struct tm *localtime_r(const time_t *restrict timep, struct tm *restrict result)
+{
+    count(RA_SYSCOUNT_LOCALTIME_R);
+    return NEXT(localtime_r)(timep, result);
+}
+
+/* the allocator is wrapped via the libc internal entry points,
+ * since dlsym() itself might allocate memory
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    count(RA_SYSCOUNT_MALLOC);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    count(RA_SYSCOUNT_CALLOC);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count(RA_SYSCOUNT_REALLOC);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr)
+        count(RA_SYSCOUNT_FREE);
+    __libc_free(ptr);
+}
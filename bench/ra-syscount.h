@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Counters of the libc calls and heap allocations of a process.
+ *
+ * The shim library interposes the wrapped functions: either link it into a
+ * program (before libc, which the linker does anyway) and read the counters
+ * via ra_syscount_read(), or preload it into any program:
+ *
+ *   RA_SYSCOUNT_REPORT=1 LD_PRELOAD=libra-syscount.so ra-raw ...
+ *
+ * which prints the totals to stderr on exit.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum ra_syscount_id {
+    RA_SYSCOUNT_READ,
+    RA_SYSCOUNT_WRITE,
+    RA_SYSCOUNT_READV,
+    RA_SYSCOUNT_WRITEV,
+    RA_SYSCOUNT_POLL,
+    RA_SYSCOUNT_IOCTL,
+    RA_SYSCOUNT_TCDRAIN,
+    RA_SYSCOUNT_CLOCK_GETTIME,
+    RA_SYSCOUNT_GETTIMEOFDAY,
+    RA_SYSCOUNT_LOCALTIME_R,
+    RA_SYSCOUNT_MALLOC,
+    RA_SYSCOUNT_CALLOC,
+    RA_SYSCOUNT_REALLOC,
+    RA_SYSCOUNT_FREE,
+    RA_SYSCOUNT_MAX,
+};
+
+struct ra_syscount {
+    uint64_t count[RA_SYSCOUNT_MAX];
+};
+
+const char *ra_syscount_name(enum ra_syscount_id id);
+
+/* take a snapshot of the counters (of all threads) */
+void ra_syscount_read(struct ra_syscount *sc);
+
+/* diff = b - a */
+void ra_syscount_sub(const struct ra_syscount *a, const struct ra_syscount *b, struct ra_syscount *diff);
+
+void ra_syscount_fprint(const struct ra_syscount *sc, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,773 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Microbenchmarks of the library primitives: CRCs, frame encoding/decoding,
+ * protocol getters and dumps, parameter block migration and bootloader packets.
+ *
+ * Each benchmark is calibrated so that one repetition takes about the target
+ * time, then run for some warmup repetitions which are discarded, and finally
+ * for the given count of repetitions. The reported value is the median ns/op,
+ * accompanied by min, max and the median absolute deviation to judge stability.
+ *
+ * Usage: ra-utils-bench [<options>] [<filter>...]
+ *
+ * Only benchmarks whose name contains one of the filter strings are run.
+ *
+ * Options:
+ *         -r, --repetitions       count of measured repetitions (default: 15)
+ *         -w, --warmup            count of discarded warmup repetitions (default: 3)
+ *         -t, --target-time       target duration of one repetition in ms (default: 20)
+ *         -j, --json              print the results as JSON
+ *         -l, --list              list the available benchmarks and exit
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <crc8_j1850.h>
+#include <logging.h>
+#include <param_block.h>
+#include <param_block_crc8.h>
+#include <ra_protocol.h>
+#include <uart.h>
+
+/* command line options */
+static const struct option long_options[] = {
+    { "repetitions",        required_argument,      0,      'r' },
+    { "warmup",             required_argument,      0,      'w' },
+    { "target-time",        required_argument,      0,      't' },
+    { "json",               no_argument,            0,      'j' },
+    { "list",               no_argument,            0,      'l' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "r:w:t:jlh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "count of measured repetitions (default: 15)",
+    "count of discarded warmup repetitions (default: 3)",
+    "target duration of one repetition in ms (default: 20)",
+    "print the results as JSON",
+    "list the available benchmarks and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static unsigned int repetitions = 15;
+static unsigned int warmup = 3;
+static unsigned int target_time_ms = 20;
+static bool json;
+static bool list;
+
+/* shared state of the benchmarks */
+struct bench_env {
+    /* pseudo terminal as in-memory transport: the library uses the slave side */
+    int master_fd;
+    struct uart_ctx uart;
+
+    struct safety_controller ctx;
+
+    /* pre-built input data */
+    uint8_t crc_data[1024];
+    uint8_t frame[CB_UART_FRAME_SIZE];
+    uint8_t pb_unversioned[sizeof(struct unversioned_param_block)];
+    uint8_t pb_v1[sizeof(struct param_block_v1)];
+    uint8_t pb_v2[sizeof(struct param_block_v2)];
+    uint8_t status_rsp[7];
+    uint8_t payload[1024];
+
+    /* where the benchmarks accumulate their results, so that nothing is optimized out */
+    volatile uint64_t sink;
+};
+
+struct bench {
+    const char *name;
+    /* runs the benchmarked operation the given count of times */
+    int (*fn)(struct bench_env *env, uint64_t iterations);
+    /* the operation writes to stdout, which is redirected to /dev/null meanwhile */
+    bool writes_stdout;
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* discard everything the slave side has sent so far */
+static void drain_master(struct bench_env *env)
+{
+    uint8_t buf[4096];
+
+    while (read(env->master_fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+static int bench_crc8_j1850_frame(struct bench_env *env, uint64_t iterations)
+{
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        env->crc_data[0] = iterations;
+        sum += crc8_j1850(env->crc_data, 9);
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_crc8_j1850_1k(struct bench_env *env, uint64_t iterations)
+{
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        env->crc_data[0] = iterations;
+        sum += crc8_j1850(env->crc_data, sizeof(env->crc_data));
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_pb_crc8(struct bench_env *env, uint64_t iterations)
+{
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        env->crc_data[0] = iterations;
+        sum += pb_crc8(env->crc_data, sizeof(struct param_block_v2) - 1);
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_cb_uart_frame_pack(struct bench_env *env, uint64_t iterations)
+{
+    uint8_t buf[CB_UART_FRAME_SIZE];
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        cb_uart_frame_pack(&env->uart, buf, COM_CHARGE_CONTROL, iterations);
+        sum += buf[CB_UART_FRAME_SIZE - 2];
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_cb_uart_frame_unpack(struct bench_env *env, uint64_t iterations)
+{
+    enum cb_uart_com com;
+    uint64_t data, sum = 0;
+
+    while (iterations--) {
+        if (cb_uart_frame_unpack(&env->uart, env->frame, &com, &data))
+            return -1;
+        sum += data;
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_cb_uart_send(struct bench_env *env, uint64_t iterations)
+{
+    while (iterations--) {
+        if (cb_uart_send(&env->uart, COM_CHARGE_CONTROL, iterations))
+            return -1;
+        drain_master(env);
+    }
+
+    return 0;
+}
+
+static int bench_cb_uart_recv(struct bench_env *env, uint64_t iterations)
+{
+    enum cb_uart_com com;
+    uint64_t data, sum = 0;
+
+    while (iterations--) {
+        if (write(env->master_fd, env->frame, sizeof(env->frame)) != sizeof(env->frame))
+            return -1;
+        if (cb_uart_recv(&env->uart, &com, &data))
+            return -1;
+        sum += data;
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_cb_proto_getters(struct bench_env *env, uint64_t iterations)
+{
+    struct safety_controller *ctx = &env->ctx;
+    uint64_t sum = 0;
+    unsigned int i;
+
+    while (iterations--) {
+        sum += cb_proto_get_actual_pwm_active(ctx);
+        sum += cb_proto_get_actual_duty_cycle(ctx);
+        sum += cb_proto_get_cp_state(ctx);
+        sum += cb_proto_get_cp_errors(ctx);
+        sum += cb_proto_get_pp_state(ctx);
+        sum += cb_proto_get_hv_ready(ctx);
+        sum += cb_proto_get_rcm_state(ctx);
+        sum += cb_proto_get_safestate_reason(ctx);
+        sum += cb_proto_get_safe_state_active(ctx);
+        sum += cb_proto_estop_has_any_tripped(ctx);
+        for (i = 0; i < CB_PROTO_MAX_CONTACTORS; i++)
+            sum += cb_proto_contactorN_get_actual_state(ctx, i);
+        for (i = 0; i < CB_PROTO_MAX_PT1000S; i++)
+            sum += cb_proto_pt1000_get_temp(ctx, i);
+        sum += cb_proto_fw_get_major(ctx);
+        sum += cb_proto_errmsg_is_active(ctx);
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_cb_proto_store_frame(struct bench_env *env, uint64_t iterations)
+{
+    while (iterations--)
+        cb_proto_store_frame(&env->ctx, COM_CHARGE_STATE, env->ctx.charge_state ^ (iterations & 1));
+
+    return 0;
+}
+
+static int bench_cb_proto_dump(struct bench_env *env, uint64_t iterations)
+{
+    while (iterations--)
+        cb_proto_dump(&env->ctx);
+
+    return 0;
+}
+
+/* stands in for a debug message callback which formats the message, e.g. for a log */
+static void format_msg(const char *format, va_list args)
+{
+    char buf[256];
+
+    vsnprintf(buf, sizeof(buf), format, args);
+}
+
+static int bench_uart_dump_frame(struct bench_env *env, uint64_t iterations)
+{
+    int rv = 0;
+
+    ra_utils_set_debug_msg_cb(format_msg);
+
+    while (iterations--) {
+        if (uart_dump_frame(true, false, env->frame, sizeof(env->frame))) {
+            rv = -1;
+            break;
+        }
+    }
+
+    ra_utils_set_debug_msg_cb(NULL);
+    return rv;
+}
+
+static int bench_pb_parse(struct bench_env *env, const uint8_t *buf, size_t len, uint64_t iterations)
+{
+    struct param_block_v2 pb;
+    enum pb_layout layout;
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        if (pb_parse(buf, len, &pb, &layout))
+            return -1;
+        sum += pb.crc + layout;
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_pb_parse_unversioned(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_parse(env, env->pb_unversioned, sizeof(env->pb_unversioned), iterations);
+}
+
+static int bench_pb_parse_v1(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_parse(env, env->pb_v1, sizeof(env->pb_v1), iterations);
+}
+
+static int bench_pb_parse_v2(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_parse(env, env->pb_v2, sizeof(env->pb_v2), iterations);
+}
+
+static int bench_pb_read(struct bench_env *env, uint8_t *buf, size_t len, uint64_t iterations)
+{
+    struct param_block_v2 pb;
+    uint64_t sum = 0;
+    FILE *f;
+
+    while (iterations--) {
+        f = fmemopen(buf, len, "rb");
+        if (!f)
+            return -1;
+        if (pb_read(f, &pb)) {
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+        sum += pb.crc;
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_pb_read_unversioned(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_read(env, env->pb_unversioned, sizeof(env->pb_unversioned), iterations);
+}
+
+static int bench_pb_read_v1(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_read(env, env->pb_v1, sizeof(env->pb_v1), iterations);
+}
+
+static int bench_pb_read_v2(struct bench_env *env, uint64_t iterations)
+{
+    return bench_pb_read(env, env->pb_v2, sizeof(env->pb_v2), iterations);
+}
+
+static int bench_ra_checksum(struct bench_env *env, uint64_t iterations)
+{
+    uint64_t sum = 0;
+
+    while (iterations--) {
+        env->payload[0] = iterations;
+        /* about the size of a full data packet */
+        sum += ra_checksum(env->payload, sizeof(env->payload));
+    }
+
+    env->sink += sum;
+    return 0;
+}
+
+static int bench_ra_write_data(struct bench_env *env, uint64_t iterations)
+{
+    while (iterations--) {
+        /* queue the status response of the boot firmware before sending */
+        if (write(env->master_fd, env->status_rsp, sizeof(env->status_rsp)) != sizeof(env->status_rsp))
+            return -1;
+        if (ra_write_data(&env->uart, env->payload, sizeof(env->payload)))
+            return -1;
+        drain_master(env);
+    }
+
+    return 0;
+}
+
+static const struct bench benches[] = {
+    { "crc8_j1850/frame",            bench_crc8_j1850_frame,         false },
+    { "crc8_j1850/1k",               bench_crc8_j1850_1k,            false },
+    { "pb_crc8/v2",                  bench_pb_crc8,                  false },
+    { "cb_uart_frame_pack",          bench_cb_uart_frame_pack,       false },
+    { "cb_uart_frame_unpack",        bench_cb_uart_frame_unpack,     false },
+    { "cb_uart_send",                bench_cb_uart_send,             false },
+    { "cb_uart_recv",                bench_cb_uart_recv,             false },
+    { "cb_proto_getters",            bench_cb_proto_getters,         false },
+    { "cb_proto_store_frame",        bench_cb_proto_store_frame,     false },
+    { "cb_proto_dump",               bench_cb_proto_dump,            true  },
+    { "uart_dump_frame",             bench_uart_dump_frame,          false },
+    { "pb_parse/unversioned",        bench_pb_parse_unversioned,     false },
+    { "pb_parse/v1",                 bench_pb_parse_v1,              false },
+    { "pb_parse/v2",                 bench_pb_parse_v2,              false },
+    { "pb_read/unversioned",         bench_pb_read_unversioned,      false },
+    { "pb_read/v1",                  bench_pb_read_v1,               false },
+    { "pb_read/v2",                  bench_pb_read_v2,               false },
+    { "ra_checksum/1k",              bench_ra_checksum,              false },
+    { "ra_write_data/1k",            bench_ra_write_data,            false },
+    {} /* stop condition for iterator */
+};
+
+struct bench_result {
+    uint64_t iterations;
+    double median;
+    double min;
+    double max;
+    double mad;
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s -- Microbenchmarks of the libra-utils primitives\n\n"
+            "Usage: %s [<options>] [<filter>...]\n\n"
+            , p, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        fprintf(stderr, "\t-%c, --%-12s\t%s\n", op->val, op->name, *desc);
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+static unsigned int parse_uint(const char *s, unsigned int min)
+{
+    char *endptr;
+    unsigned long v;
+
+    errno = 0;
+    v = strtoul(s, &endptr, 0);
+    if (errno || endptr == s || *endptr != '\0' || v < min || v > 1000000) {
+        fprintf(stderr, "Error: invalid value '%s'.\n", s);
+        usage(program_invocation_short_name, EXIT_FAILURE);
+    }
+
+    return v;
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'r':
+            repetitions = parse_uint(optarg, 1);
+            break;
+        case 'w':
+            warmup = parse_uint(optarg, 0);
+            break;
+        case 't':
+            target_time_ms = parse_uint(optarg, 1);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'l':
+            list = true;
+            break;
+        case 'h':
+            usage(program_invocation_short_name, EXIT_SUCCESS);
+            break;
+        default:
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        }
+    }
+}
+
+static bool is_selected(const struct bench *b, int argc, char *argv[])
+{
+    int i;
+
+    if (argc == 0)
+        return true;
+
+    for (i = 0; i < argc; i++)
+        if (strstr(b->name, argv[i]))
+            return true;
+
+    return false;
+}
+
+static int env_init(struct bench_env *env)
+{
+    struct unversioned_param_block pb_unversioned = {};
+    struct param_block_v1 pb_v1;
+    struct param_block_v2 pb_v2;
+    uint8_t frame_data[9];
+    char *slave_name;
+    size_t i;
+
+    memset(env, 0, sizeof(*env));
+    env->uart = (struct uart_ctx)INIT_UART_CTX;
+
+    for (i = 0; i < sizeof(env->crc_data); i++)
+        env->crc_data[i] = i * 7;
+    for (i = 0; i < sizeof(env->payload); i++)
+        env->payload[i] = i * 13;
+
+    /* a valid Charge State frame */
+    frame_data[0] = COM_CHARGE_STATE;
+    for (i = 1; i < sizeof(frame_data); i++)
+        frame_data[i] = i * 0x11;
+    env->frame[0] = CB_UART_SOF;
+    memcpy(&env->frame[1], frame_data, sizeof(frame_data));
+    env->frame[10] = crc8_j1850(frame_data, sizeof(frame_data));
+    env->frame[11] = CB_UART_EOF;
+
+    /* give the getters and the dump something to work on */
+    cb_proto_store_frame(&env->ctx, COM_CHARGE_STATE, 0x0123456789abcdefULL);
+    cb_proto_store_frame(&env->ctx, COM_PT1000_STATE, 0x1000200030004000ULL);
+    cb_proto_store_frame(&env->ctx, COM_FW_VERSION, 0x0102030400000000ULL);
+    cb_proto_store_frame(&env->ctx, COM_ERROR_MESSAGE, 0x8102000300040000ULL);
+
+    /* parameter blocks in all layouts which need to be migrated */
+    pb_unversioned.sob = htole32(PB_MARKER);
+    for (i = 0; i < 4; i++)
+        pb_unversioned.temperature[i] = htole16(800 + i);
+    pb_unversioned.eob = htole32(PB_MARKER);
+    pb_unversioned.crc = pb_crc8((const uint8_t *)&pb_unversioned, sizeof(pb_unversioned) - 1);
+    memcpy(env->pb_unversioned, &pb_unversioned, sizeof(pb_unversioned));
+
+    pb_init_v1(&pb_v1);
+    pb_refresh_crc_v1(&pb_v1);
+    memcpy(env->pb_v1, &pb_v1, sizeof(pb_v1));
+
+    pb_init_v2(&pb_v2);
+    if (pb_encode(&pb_v2, env->pb_v2, sizeof(env->pb_v2)) < 0)
+        return -1;
+
+    /* positive status response to a data packet */
+    env->status_rsp[0] = 0x81; /* SOD */
+    env->status_rsp[1] = 0x00; /* LNH */
+    env->status_rsp[2] = 0x02; /* LNL */
+    env->status_rsp[3] = 0x13; /* RES: write command */
+    env->status_rsp[4] = 0x00; /* STS: OK */
+    env->status_rsp[5] = ra_checksum(&env->status_rsp[1], 4);
+    env->status_rsp[6] = 0x03; /* ETX */
+
+    /* the transport: the library talks to the pty slave as to a real UART */
+    env->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (env->master_fd < 0) {
+        fprintf(stderr, "Error: posix_openpt failed: %m\n");
+        return -1;
+    }
+
+    if (grantpt(env->master_fd) || unlockpt(env->master_fd) || !(slave_name = ptsname(env->master_fd))) {
+        fprintf(stderr, "Error: could not unlock the pty: %m\n");
+        goto close_out;
+    }
+
+    /* the name buffer of ptsname is static, but uart_ctx only keeps the pointer */
+    slave_name = strdup(slave_name);
+    if (!slave_name) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto close_out;
+    }
+
+    if (uart_open(&env->uart, slave_name, 115200)) {
+        fprintf(stderr, "Error: could not open '%s'\n", slave_name);
+        free(slave_name);
+        goto close_out;
+    }
+
+    return 0;
+
+close_out:
+    close(env->master_fd);
+    return -1;
+}
+
+static void env_close(struct bench_env *env)
+{
+    const char *slave_name = env->uart.device;
+
+    uart_close(&env->uart);
+    free((char *)slave_name);
+    close(env->master_fd);
+}
+
+/* returns the duration in ns or a negative value on error */
+static double run_once(struct bench_env *env, const struct bench *b, uint64_t iterations)
+{
+    double start = now_ns();
+
+    if (b->fn(env, iterations))
+        return -1.0;
+
+    return now_ns() - start;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int run_bench(struct bench_env *env, const struct bench *b, struct bench_result *result)
+{
+    double target_ns = target_time_ms * 1e6;
+    double *samples, elapsed;
+    uint64_t iterations = 1;
+    unsigned int i;
+
+    samples = calloc(repetitions, sizeof(*samples));
+    if (!samples)
+        return -1;
+
+    /* calibrate: grow the iteration count until one repetition is long enough */
+    while (1) {
+        elapsed = run_once(env, b, iterations);
+        if (elapsed < 0)
+            goto err_out;
+        if (elapsed >= target_ns / 2 || iterations >= (UINT64_C(1) << 40))
+            break;
+        iterations = elapsed > 0 && target_ns / elapsed < 2 ? iterations * 2
+                     : elapsed > 0 ? iterations * (uint64_t)(target_ns / elapsed)
+                     : iterations * 16;
+    }
+    if (elapsed > 0)
+        iterations = iterations * target_ns / elapsed;
+    if (!iterations)
+        iterations = 1;
+
+    for (i = 0; i < warmup; i++)
+        if (run_once(env, b, iterations) < 0)
+            goto err_out;
+
+    for (i = 0; i < repetitions; i++) {
+        elapsed = run_once(env, b, iterations);
+        if (elapsed < 0)
+            goto err_out;
+        samples[i] = elapsed / iterations;
+    }
+
+    qsort(samples, repetitions, sizeof(*samples), cmp_double);
+    result->iterations = iterations;
+    result->min = samples[0];
+    result->max = samples[repetitions - 1];
+    result->median = repetitions % 2 ? samples[repetitions / 2]
+                     : (samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+
+    for (i = 0; i < repetitions; i++)
+        samples[i] = samples[i] > result->median ? samples[i] - result->median : result->median - samples[i];
+    qsort(samples, repetitions, sizeof(*samples), cmp_double);
+    result->mad = repetitions % 2 ? samples[repetitions / 2]
+                  : (samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+
+    free(samples);
+    return 0;
+
+err_out:
+    free(samples);
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct bench *b;
+    struct bench_env *env;
+    bool first = true;
+    int devnull, saved_stdout;
+    int rv = EXIT_SUCCESS;
+
+    parse_cli(argc, argv);
+    argc -= optind;
+    argv += optind;
+
+    if (list) {
+        for (b = benches; b->name; b++)
+            printf("%s\n", b->name);
+        return EXIT_SUCCESS;
+    }
+
+    env = malloc(sizeof(*env));
+    if (!env) {
+        fprintf(stderr, "Error: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if (env_init(env)) {
+        free(env);
+        return EXIT_FAILURE;
+    }
+
+    devnull = open("/dev/null", O_WRONLY);
+    saved_stdout = dup(STDOUT_FILENO);
+    if (devnull < 0 || saved_stdout < 0) {
+        fprintf(stderr, "Error: could not prepare the stdout redirection: %m\n");
+        rv = EXIT_FAILURE;
+        goto close_out;
+    }
+
+    if (json)
+        printf("{\n  \"repetitions\": %u,\n  \"warmup\": %u,\n  \"target_time_ms\": %u,\n  \"results\": [",
+               repetitions, warmup, target_time_ms);
+    else
+        printf("%-24s %12s %12s %12s %12s %8s\n", "benchmark", "iterations", "median ns", "min ns", "max ns", "mad %");
+
+    for (b = benches; b->name; b++) {
+        struct bench_result result;
+        int brv;
+
+        if (!is_selected(b, argc, argv))
+            continue;
+
+        fflush(stdout);
+        if (b->writes_stdout)
+            dup2(devnull, STDOUT_FILENO);
+
+        brv = run_bench(env, b, &result);
+
+        if (b->writes_stdout) {
+            fflush(stdout);
+            dup2(saved_stdout, STDOUT_FILENO);
+        }
+
+        if (brv) {
+            fprintf(stderr, "Error: benchmark '%s' failed: %m\n", b->name);
+            rv = EXIT_FAILURE;
+            continue;
+        }
+
+        if (json) {
+            printf("%s\n    { \"name\": \"%s\", \"iterations\": %" PRIu64 ", \"ns_per_op\": "
+                   "{ \"median\": %.3f, \"min\": %.3f, \"max\": %.3f, \"mad\": %.3f } }",
+                   first ? "" : ",", b->name, result.iterations,
+                   result.median, result.min, result.max, result.mad);
+        } else {
+            printf("%-24s %12" PRIu64 " %12.2f %12.2f %12.2f %8.2f\n", b->name, result.iterations,
+                   result.median, result.min, result.max,
+                   result.median > 0 ? 100.0 * result.mad / result.median : 0.0);
+        }
+        first = false;
+    }
+
+    if (json)
+        printf("\n  ]\n}\n");
+
+close_out:
+    if (devnull >= 0)
+        close(devnull);
+    if (saved_stdout >= 0)
+        close(saved_stdout);
+    env_close(env);
+    free(env);
+
+    return rv;
+}
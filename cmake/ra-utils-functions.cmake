@@ -0,0 +1,121 @@
+# Build-time helpers to produce ready-to-flash artifacts, so that the target
+# neither needs to parse YAML nor to calculate digests at boot.
+#
+# ra_utils_compile_param_block(<target>
+#     YAML <file>...
+#     [OUTPUT_DIRECTORY <dir>]
+#     [DESTINATION <dir>])
+#
+#   Compiles each YAML file to <name>.bin with ra-pb-create and writes its digest
+#   <name>.bin.sha256 beside it. The target builds all of them and is part of 'all'.
+#   With DESTINATION, the blocks and the digests are installed there.
+#
+# ra_utils_firmware_manifest(<target>
+#     IMAGE <file>...
+#     [ERASE_UNIT_SIZE <bytes>]
+#     [OUTPUT_DIRECTORY <dir>]
+#     [DESTINATION <dir>])
+#
+#   Writes the digest <image>.sha256 and the erase unit manifest <image>.units for
+#   each firmware image. The manifest lists each erase unit of the image (default size:
+#   2048 bytes, the code flash block size of the safety controller) with its offset,
+#   length and whether it holds data or is blank (all 0xff).
+#
+# ra-pb-create is taken from RA_UTILS_PB_CREATE_EXECUTABLE if set, from the ra-pb-create
+# target of this project (unless cross-compiling), or searched in the PATH.
+
+set(_RA_UTILS_MANIFEST_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/ra-utils-manifest.cmake")
+
+function(_ra_utils_pb_create out_command out_depends)
+    if(RA_UTILS_PB_CREATE_EXECUTABLE)
+        set(${out_command} "${RA_UTILS_PB_CREATE_EXECUTABLE}" PARENT_SCOPE)
+        set(${out_depends} "${RA_UTILS_PB_CREATE_EXECUTABLE}" PARENT_SCOPE)
+    elseif(TARGET ra-pb-create AND NOT CMAKE_CROSSCOMPILING)
+        set(${out_command} "$<TARGET_FILE:ra-pb-create>" PARENT_SCOPE)
+        set(${out_depends} ra-pb-create PARENT_SCOPE)
+    else()
+        find_program(RA_UTILS_PB_CREATE_EXECUTABLE ra-pb-create)
+        if(NOT RA_UTILS_PB_CREATE_EXECUTABLE)
+            message(FATAL_ERROR "ra-pb-create not found, please set RA_UTILS_PB_CREATE_EXECUTABLE "
+                                "to an executable which runs on the build host")
+        endif()
+        set(${out_command} "${RA_UTILS_PB_CREATE_EXECUTABLE}" PARENT_SCOPE)
+        set(${out_depends} "${RA_UTILS_PB_CREATE_EXECUTABLE}" PARENT_SCOPE)
+    endif()
+endfunction()
+
+function(ra_utils_compile_param_block target)
+    cmake_parse_arguments(PARSE_ARGV 1 ARG "" "OUTPUT_DIRECTORY;DESTINATION" "YAML")
+
+    if(NOT ARG_YAML)
+        message(FATAL_ERROR "ra_utils_compile_param_block: no YAML files given")
+    endif()
+    if(NOT ARG_OUTPUT_DIRECTORY)
+        set(ARG_OUTPUT_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}")
+    endif()
+
+    _ra_utils_pb_create(pb_create pb_create_depends)
+
+    set(outputs)
+    foreach(yaml IN LISTS ARG_YAML)
+        get_filename_component(input "${yaml}" ABSOLUTE)
+        get_filename_component(name "${yaml}" NAME)
+        string(REGEX REPLACE "\\.ya?ml$" "" name "${name}")
+        set(bin "${ARG_OUTPUT_DIRECTORY}/${name}.bin")
+
+        add_custom_command(
+            OUTPUT "${bin}" "${bin}.sha256"
+            COMMAND ${CMAKE_COMMAND} -E make_directory "${ARG_OUTPUT_DIRECTORY}"
+            COMMAND ${pb_create} -i "${input}" -o "${bin}"
+            COMMAND ${CMAKE_COMMAND} -DIMAGE=${bin} -P "${_RA_UTILS_MANIFEST_SCRIPT}"
+            DEPENDS "${input}" ${pb_create_depends} "${_RA_UTILS_MANIFEST_SCRIPT}"
+            COMMENT "Compiling parameter block ${name}.bin"
+            VERBATIM
+        )
+        list(APPEND outputs "${bin}" "${bin}.sha256")
+    endforeach()
+
+    add_custom_target(${target} ALL DEPENDS ${outputs})
+
+    if(ARG_DESTINATION)
+        install(FILES ${outputs} DESTINATION "${ARG_DESTINATION}")
+    endif()
+endfunction()
+
+function(ra_utils_firmware_manifest target)
+    cmake_parse_arguments(PARSE_ARGV 1 ARG "" "ERASE_UNIT_SIZE;OUTPUT_DIRECTORY;DESTINATION" "IMAGE")
+
+    if(NOT ARG_IMAGE)
+        message(FATAL_ERROR "ra_utils_firmware_manifest: no firmware images given")
+    endif()
+    if(NOT ARG_ERASE_UNIT_SIZE)
+        set(ARG_ERASE_UNIT_SIZE 2048)
+    endif()
+    if(NOT ARG_OUTPUT_DIRECTORY)
+        set(ARG_OUTPUT_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}")
+    endif()
+
+    set(outputs)
+    foreach(image IN LISTS ARG_IMAGE)
+        get_filename_component(input "${image}" ABSOLUTE)
+        get_filename_component(name "${image}" NAME)
+        set(output "${ARG_OUTPUT_DIRECTORY}/${name}")
+
+        add_custom_command(
+            OUTPUT "${output}.sha256" "${output}.units"
+            COMMAND ${CMAKE_COMMAND} -E make_directory "${ARG_OUTPUT_DIRECTORY}"
+            COMMAND ${CMAKE_COMMAND} -DIMAGE=${input} -DOUTPUT=${output}
+                    -DERASE_UNIT_SIZE=${ARG_ERASE_UNIT_SIZE} -P "${_RA_UTILS_MANIFEST_SCRIPT}"
+            DEPENDS "${input}" "${_RA_UTILS_MANIFEST_SCRIPT}"
+            COMMENT "Generating digest and erase unit manifest for ${name}"
+            VERBATIM
+        )
+        list(APPEND outputs "${output}.sha256" "${output}.units")
+    endforeach()
+
+    add_custom_target(${target} ALL DEPENDS ${outputs})
+
+    if(ARG_DESTINATION)
+        install(FILES ${outputs} DESTINATION "${ARG_DESTINATION}")
+    endif()
+endfunction()
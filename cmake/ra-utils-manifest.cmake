@@ -0,0 +1,57 @@
+# Writes the digest and (optionally) the erase unit manifest of an image,
+# see ra-utils-functions.cmake.
+#
+# Usage: cmake -DIMAGE=<file> [-DOUTPUT=<prefix>] [-DERASE_UNIT_SIZE=<bytes>] -P ra-utils-manifest.cmake
+#
+# <prefix>.sha256 is in the format of sha256sum, so it can be checked with 'sha256sum -c'.
+# <prefix>.units starts with the key/value lines 'image', 'size', 'sha256' and
+# 'erase-unit-size', followed by one line 'unit <index> <offset> <length> <data|blank>'
+# per erase unit covered by the image; offsets are relative to the start of the image.
+
+if(NOT IMAGE)
+    message(FATAL_ERROR "IMAGE is required")
+endif()
+if(NOT OUTPUT)
+    set(OUTPUT "${IMAGE}")
+endif()
+
+get_filename_component(name "${IMAGE}" NAME)
+
+file(SHA256 "${IMAGE}" digest)
+file(WRITE "${OUTPUT}.sha256" "${digest}  ${name}\n")
+
+if(NOT ERASE_UNIT_SIZE)
+    return()
+endif()
+
+file(READ "${IMAGE}" content HEX)
+string(LENGTH "${content}" hex_length)
+math(EXPR size "${hex_length} / 2")
+
+set(manifest "image ${name}\nsize ${size}\nsha256 ${digest}\nerase-unit-size ${ERASE_UNIT_SIZE}\n")
+
+math(EXPR units "(${size} + ${ERASE_UNIT_SIZE} - 1) / ${ERASE_UNIT_SIZE}")
+if(units GREATER 0)
+    math(EXPR last "${units} - 1")
+    math(EXPR hex_unit_length "${ERASE_UNIT_SIZE} * 2")
+
+    foreach(i RANGE ${last})
+        math(EXPR offset "${i} * ${ERASE_UNIT_SIZE}")
+        math(EXPR hex_offset "${offset} * 2")
+
+        # the last unit might be shorter
+        string(SUBSTRING "${content}" ${hex_offset} ${hex_unit_length} unit)
+        string(LENGTH "${unit}" length)
+        math(EXPR length "${length} / 2")
+
+        if(unit MATCHES "^(ff)*$")
+            set(state "blank")
+        else()
+            set(state "data")
+        endif()
+
+        string(APPEND manifest "unit ${i} ${offset} ${length} ${state}\n")
+    endforeach()
+endif()
+
+file(WRITE "${OUTPUT}.units" "${manifest}")
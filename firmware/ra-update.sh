@@ -14,6 +14,8 @@ if [ -z "$FW_FILE" ]; then
     exit 1
 fi
 
+# the parameter block is usually compiled at build time, the YAML file is only a fallback
+PARAM_BIN_FILE="$(ls -1 $LIBDIR/*_parameter-block_only-contactor.bin 2>/dev/null)"
 PARAM_FILE="$(ls -1 $LIBDIR/*_parameter-block_only-contactor.yaml 2>/dev/null)"
 
 TARGET_VERSION="$(ra-update fw-info "$FW_FILE" 2>/dev/null)"
@@ -79,14 +81,17 @@ cur_version_eq() {
 # when upgrading from 0.1.0 we need to install a parameter block for the first time;
 # later we assume that a valid parameter block is already installed and we don't touch it
 if cur_version_eq "0.1.0"; then
-    pbfile_target_bin=$(mktemp)
-
-    ra-pb-create -i "$PARAM_FILE" -o "$pbfile_target_bin"
+    if [ -n "$PARAM_BIN_FILE" ]; then
+        pbfile_target_bin="$PARAM_BIN_FILE"
+    else
+        pbfile_target_bin=$(mktemp)
+        ra-pb-create -i "$PARAM_FILE" -o "$pbfile_target_bin"
+    fi
 
     echo -n "Installing Parameter Block..."
     ra-update -a data flash "$pbfile_target_bin"
 
-    rm -f "$pbfile_target_bin"
+    [ "$pbfile_target_bin" = "$PARAM_BIN_FILE" ] || rm -f "$pbfile_target_bin"
     echo "done."
 fi
 
@@ -146,6 +151,39 @@ if cur_version_lt "0.2.6"; then
     echo "done."
 fi
 
+# a patch made from the currently running firmware only rewrites the changed erase units;
+# ra-update checks the source firmware itself, this is to pick a patch file which leads
+# from the current firmware to the bundled one - since different platforms can share the
+# same git hash, the application checksum must match as well
+info_field() {
+    echo "$1" | grep "^$2:" | awk '{print $NF}'
+}
+
+CURRENT_GIT_HASH="$(info_field "$CMP_CURRENT_VERSION" "Git Hash")"
+CURRENT_CHECKSUM="$(info_field "$CMP_CURRENT_VERSION" "Firmware Checksum (CRC32)")"
+TARGET_GIT_HASH="$(info_field "$CMP_TARGET_VERSION" "Git Hash")"
+TARGET_CHECKSUM="$(info_field "$CMP_TARGET_VERSION" "Firmware Checksum (CRC32)")"
+
+for PATCH_FILE in $LIBDIR/*_fw_*.patch; do
+    [ -f "$PATCH_FILE" ] || continue
+    [ -n "$CURRENT_GIT_HASH" ] && [ -n "$CURRENT_CHECKSUM" ] || break
+    [ -n "$TARGET_GIT_HASH" ] && [ -n "$TARGET_CHECKSUM" ] || break
+
+    PATCH_INFO="$(ra-fw-patch --info "$PATCH_FILE" 2>/dev/null)"
+
+    [ "$(info_field "$PATCH_INFO" "Source Git Hash")" = "$CURRENT_GIT_HASH" ] || continue
+    [ "$(info_field "$PATCH_INFO" "Source Checksum (CRC32)")" = "$CURRENT_CHECKSUM" ] || continue
+    [ "$(info_field "$PATCH_INFO" "Target Git Hash")" = "$TARGET_GIT_HASH" ] || continue
+    [ "$(info_field "$PATCH_INFO" "Target Checksum (CRC32)")" = "$TARGET_CHECKSUM" ] || continue
+
+    echo -n "Patching Firmware..."
+    if ra-update patch "$PATCH_FILE"; then
+        echo "done."
+        exit 0
+    fi
+    echo "failed, falling back to full update."
+done
+
 echo -n "Updating Firmware..."
 ra-update flash "$FW_FILE"
 rv=$?
@@ -0,0 +1,546 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cb_async.h"
+#include "cb_metrics.h"
+#include "cb_uart.h"
+#include "logging.h"
+#include "tools.h"
+#include "uart.h"
+
+/* like cb_uart_recv: we expect at least one frame within this period, in ms */
+#define CB_ASYNC_RECV_TIMEOUT (CB_UART_RECV_INTERVAL + CB_UART_RECV_INTERVAL / 2)
+
+struct tx_entry {
+    uint8_t buf[CB_UART_FRAME_SIZE];
+    size_t written;
+
+    enum cb_uart_com com;
+    uint64_t data;
+
+    /* for inquiries: slot in the pending list which is armed once the frame is written */
+    int pending;
+
+    cb_async_done_cb done;
+    void *userdata;
+};
+
+struct pending {
+    bool used;
+    bool armed;
+
+    /* the expected response */
+    enum cb_uart_com com;
+    int action; /* -1 if not an action inquiry */
+
+    /* to answer the oldest inquiry first */
+    unsigned long long seq;
+
+    struct timespec deadline;
+
+    cb_async_done_cb done;
+    void *userdata;
+};
+
+struct cb_async {
+    struct uart_ctx *uart;
+    struct safety_controller *ctx;
+    const struct cb_async_ops *ops;
+    void *userdata;
+
+    /* file status flags of the fd before switching to non-blocking mode */
+    int saved_flags;
+
+    uint8_t rx_buf[4 * CB_UART_FRAME_SIZE];
+    size_t rx_len;
+
+    /* receive timeout, restarted with each valid frame */
+    struct timespec rx_deadline;
+
+    /* ring buffer of frames to send */
+    struct tx_entry tx[CB_ASYNC_MAX_TX_QUEUE];
+    unsigned int tx_head;
+    unsigned int tx_count;
+    bool flushing;
+
+    struct pending pending[CB_ASYNC_MAX_PENDING];
+    unsigned long long seq;
+
+    unsigned int inquiry_timeout;
+
+    /* an urgent Charge Control frame is queued but not written yet */
+    bool cc_queued;
+};
+
+static void now_plus_ms(struct timespec *ts, long long ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    timespec_add_ms(ts, ms);
+}
+
+static void report_error(struct cb_async *a, int err)
+{
+    if (a->ops && a->ops->error)
+        a->ops->error(a, err, a->userdata);
+}
+
+struct cb_async *cb_async_new(struct uart_ctx *uart, struct safety_controller *ctx,
+                              const struct cb_async_ops *ops, void *userdata)
+{
+    struct cb_async *a;
+
+    a = calloc(1, sizeof(*a));
+    if (!a)
+        return NULL;
+
+    a->saved_flags = fcntl(uart->fd, F_GETFL);
+    if (a->saved_flags < 0 || fcntl(uart->fd, F_SETFL, a->saved_flags | O_NONBLOCK) < 0) {
+        error("could not switch '%s' to non-blocking mode: %m", uart->device);
+        free(a);
+        return NULL;
+    }
+
+    a->uart = uart;
+    a->ctx = ctx;
+    a->ops = ops;
+    a->userdata = userdata;
+    a->inquiry_timeout = CB_ASYNC_INQUIRY_TIMEOUT;
+
+    now_plus_ms(&a->rx_deadline, CB_ASYNC_RECV_TIMEOUT);
+
+    return a;
+}
+
+void cb_async_free(struct cb_async *a)
+{
+    unsigned int i;
+
+    if (!a)
+        return;
+
+    fcntl(a->uart->fd, F_SETFL, a->saved_flags);
+
+    /* callbacks must not queue new requests now */
+    a->flushing = true;
+
+    while (a->tx_count) {
+        struct tx_entry *e = &a->tx[a->tx_head];
+
+        a->tx_head = (a->tx_head + 1) % CB_ASYNC_MAX_TX_QUEUE;
+        a->tx_count--;
+
+        /* inquiries are completed below */
+        if (e->pending < 0 && e->done)
+            e->done(a, ECANCELED, e->com, e->data, e->userdata);
+    }
+
+    for (i = 0; i < CB_ASYNC_MAX_PENDING; i++) {
+        struct pending *p = &a->pending[i];
+
+        if (p->used && p->done)
+            p->done(a, ECANCELED, p->com, 0, p->userdata);
+    }
+
+    free(a);
+}
+
+int cb_async_get_fd(struct cb_async *a)
+{
+    return a->uart->fd;
+}
+
+short cb_async_get_events(struct cb_async *a)
+{
+    return a->tx_count ? POLLIN | POLLOUT : POLLIN;
+}
+
+bool cb_async_get_deadline(struct cb_async *a, struct timespec *ts)
+{
+    unsigned int i;
+
+    /* the receive timeout is always running */
+    *ts = a->rx_deadline;
+
+    for (i = 0; i < CB_ASYNC_MAX_PENDING; i++) {
+        const struct pending *p = &a->pending[i];
+
+        if (p->armed && timespec_compare(&p->deadline, ts) < 0)
+            *ts = p->deadline;
+    }
+
+    /* a rate-limited urgent Charge Control frame */
+    if (a->ctx && !a->cc_queued) {
+        int timeout = cb_proto_cc_urgent_timeout(a->ctx);
+        struct timespec cc_deadline;
+
+        if (timeout >= 0) {
+            now_plus_ms(&cc_deadline, timeout);
+            if (timespec_compare(&cc_deadline, ts) < 0)
+                *ts = cc_deadline;
+        }
+    }
+
+    return true;
+}
+
+int cb_async_get_timeout(struct cb_async *a)
+{
+    struct timespec deadline, now;
+
+    if (!cb_async_get_deadline(a, &deadline))
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &deadline) >= 0)
+        return 0;
+
+    /* round up, so that the deadline has passed when we are called */
+    return timespec_to_ms(timespec_sub(deadline, now)) + 1;
+}
+
+void cb_async_set_inquiry_timeout(struct cb_async *a, unsigned int timeout_ms)
+{
+    a->inquiry_timeout = timeout_ms;
+}
+
+/* write as much of the queue as possible; returns -1 on fatal errors */
+static int tx_flush(struct cb_async *a)
+{
+    int rv = 0;
+
+    /* completion callbacks may queue further frames, the loop below picks them up */
+    if (a->flushing)
+        return 0;
+    a->flushing = true;
+
+    while (a->tx_count) {
+        struct tx_entry *e = &a->tx[a->tx_head];
+        struct tx_entry done;
+        ssize_t c;
+
+        c = write(a->uart->fd, &e->buf[e->written], sizeof(e->buf) - e->written);
+        if (c < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+
+            rv = -1;
+        } else {
+            e->written += c;
+            if (e->written < sizeof(e->buf))
+                continue;
+        }
+
+        /* dequeue before calling back, so that the callback can queue again */
+        done = *e;
+        a->tx_head = (a->tx_head + 1) % CB_ASYNC_MAX_TX_QUEUE;
+        a->tx_count--;
+
+        if (rv) {
+            int err = errno;
+
+            error("error while sending frame: %m");
+
+            /* an inquiry is completed with its own callback */
+            if (done.pending >= 0) {
+                struct pending *p = &a->pending[done.pending];
+
+                p->used = false;
+                done.com = p->com;
+                done.done = p->done;
+                done.userdata = p->userdata;
+            }
+            if (done.done)
+                done.done(a, err, done.com, done.data, done.userdata);
+            report_error(a, err);
+
+            errno = err;
+            break;
+        }
+
+        cb_uart_frame_sent(a->uart, done.com, done.data);
+
+        if (a->ctx && (done.com == COM_CHARGE_CONTROL || done.com == COM_CHARGE_CONTROL_2)) {
+            cb_proto_cc_sent(a->ctx, done.data);
+            a->cc_queued = false;
+        }
+
+        if (done.pending >= 0) {
+            struct pending *p = &a->pending[done.pending];
+
+            /* the response timeout starts now */
+            now_plus_ms(&p->deadline, a->inquiry_timeout);
+            p->armed = true;
+        } else if (done.done) {
+            done.done(a, 0, done.com, done.data, done.userdata);
+        }
+    }
+
+    a->flushing = false;
+
+    return rv;
+}
+
+static int tx_queue(struct cb_async *a, enum cb_uart_com com, uint64_t data, int pending,
+                    cb_async_done_cb done, void *userdata)
+{
+    struct tx_entry *e;
+
+    if (a->tx_count == CB_ASYNC_MAX_TX_QUEUE) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    e = &a->tx[(a->tx_head + a->tx_count) % CB_ASYNC_MAX_TX_QUEUE];
+    memset(e, 0, sizeof(*e));
+
+    cb_uart_frame_pack(a->uart, e->buf, com, data);
+    e->com = com;
+    e->data = data;
+    e->pending = pending;
+    e->done = done;
+    e->userdata = userdata;
+
+    a->tx_count++;
+
+    /* try to send it right now, so that the caller doesn't need to wait for POLLOUT;
+     * write errors are reported via the callbacks
+     */
+    tx_flush(a);
+
+    return 0;
+}
+
+int cb_async_send(struct cb_async *a, enum cb_uart_com com, uint64_t data, cb_async_done_cb done, void *userdata)
+{
+    return tx_queue(a, com, data, -1, done, userdata);
+}
+
+/* queue the Charge Control frame if an urgent change is due */
+static void cc_flush_urgent(struct cb_async *a)
+{
+    if (!a->ctx || a->cc_queued || cb_proto_cc_urgent_timeout(a->ctx) != 0)
+        return;
+
+    /* if the frame could be written right away, the urgent flag is already cleared */
+    if (tx_queue(a, cb_proto_cc_get_com(a->ctx), cb_proto_cc_get_data(a->ctx), -1, NULL, NULL) == 0)
+        a->cc_queued = a->ctx->cc_urgent;
+}
+
+int cb_async_cc_commit(struct cb_async *a)
+{
+    if (!a->ctx) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (cb_proto_cc_commit(a->ctx))
+        cc_flush_urgent(a);
+
+    return 0;
+}
+
+static int queue_inquiry(struct cb_async *a, enum cb_uart_com com, int action, uint64_t data,
+                         cb_async_done_cb done, void *userdata)
+{
+    unsigned int i;
+
+    for (i = 0; i < CB_ASYNC_MAX_PENDING; i++)
+        if (!a->pending[i].used)
+            break;
+
+    if (i == CB_ASYNC_MAX_PENDING) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    a->pending[i] = (struct pending){
+        .used = true,
+        .com = com,
+        .action = action,
+        .seq = a->seq++,
+        .done = done,
+        .userdata = userdata,
+    };
+
+    if (tx_queue(a, COM_INQUIRY, data, i, NULL, NULL)) {
+        a->pending[i].used = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+int cb_async_inquiry(struct cb_async *a, enum cb_uart_com com, cb_async_done_cb done, void *userdata)
+{
+    return queue_inquiry(a, com, -1, (uint64_t)com << 56, done, userdata);
+}
+
+int cb_async_action_inquiry(struct cb_async *a, uint8_t action, cb_async_done_cb done, void *userdata)
+{
+    return queue_inquiry(a, COM_ACTION, action, (uint64_t)COM_ACTION << 56 | (uint64_t)action << 48,
+                         done, userdata);
+}
+
+static void complete_inquiry(struct cb_async *a, enum cb_uart_com com, uint64_t data)
+{
+    struct pending *oldest = NULL;
+    unsigned int i;
+
+    for (i = 0; i < CB_ASYNC_MAX_PENDING; i++) {
+        struct pending *p = &a->pending[i];
+
+        if (!p->armed || p->com != com)
+            continue;
+
+        /* action confirmations carry the action in the upper byte */
+        if (p->action >= 0 && (int)(data >> 56) != p->action)
+            continue;
+
+        if (!oldest || p->seq < oldest->seq)
+            oldest = p;
+    }
+
+    if (!oldest)
+        return;
+
+    oldest->used = oldest->armed = false;
+
+    if (oldest->done)
+        oldest->done(a, 0, com, data, oldest->userdata);
+}
+
+static void dispatch_frame(struct cb_async *a, enum cb_uart_com com, uint64_t data)
+{
+    now_plus_ms(&a->rx_deadline, CB_ASYNC_RECV_TIMEOUT);
+
+    if (a->ctx) {
+        cb_proto_set_ts(a->ctx, com);
+        cb_proto_store_frame(a->ctx, com, data);
+    }
+
+    if (a->ops && a->ops->frame)
+        a->ops->frame(a, com, data, a->userdata);
+
+    complete_inquiry(a, com, data);
+}
+
+/* extract all complete frames from the receive buffer */
+static void rx_parse(struct cb_async *a)
+{
+    while (a->rx_len >= CB_UART_FRAME_SIZE) {
+        enum cb_uart_com com;
+        uint64_t data;
+        size_t skip;
+
+        if (a->rx_buf[0] == CB_UART_SOF &&
+            cb_uart_frame_unpack(a->uart, a->rx_buf, &com, &data) == 0) {
+            memmove(a->rx_buf, &a->rx_buf[CB_UART_FRAME_SIZE], a->rx_len - CB_UART_FRAME_SIZE);
+            a->rx_len -= CB_UART_FRAME_SIZE;
+
+            dispatch_frame(a, com, data);
+            continue;
+        }
+
+        /* out of sync or corrupted: resume at the next possible start of frame */
+        for (skip = 1; skip < a->rx_len; skip++)
+            if (a->rx_buf[skip] == CB_UART_SOF)
+                break;
+
+        memmove(a->rx_buf, &a->rx_buf[skip], a->rx_len - skip);
+        a->rx_len -= skip;
+
+        if (a->uart->metrics)
+            cb_metrics_count_resync(a->uart->metrics);
+
+        report_error(a, EBADMSG);
+    }
+}
+
+static int rx_read(struct cb_async *a)
+{
+    while (1) {
+        ssize_t c = read(a->uart->fd, &a->rx_buf[a->rx_len], sizeof(a->rx_buf) - a->rx_len);
+        if (c < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno == EINTR)
+                continue;
+
+            error("error while receiving: %m");
+            if (a->uart->metrics)
+                cb_metrics_count_rx_error(a->uart->metrics, CB_METRICS_RX_IO);
+            report_error(a, errno);
+            return -1;
+        }
+
+        if (c == 0)
+            return 0;
+
+        a->rx_len += c;
+        rx_parse(a);
+    }
+}
+
+static void check_deadlines(struct cb_async *a)
+{
+    struct timespec now;
+    unsigned int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (i = 0; i < CB_ASYNC_MAX_PENDING; i++) {
+        struct pending *p = &a->pending[i];
+
+        if (!p->armed || timespec_compare(&now, &p->deadline) < 0)
+            continue;
+
+        debug("inquiry for '%s' timed out", cb_uart_com_to_str(p->com));
+
+        p->used = p->armed = false;
+        if (p->done)
+            p->done(a, ETIMEDOUT, p->com, 0, p->userdata);
+    }
+
+    if (timespec_compare(&now, &a->rx_deadline) >= 0) {
+        now_plus_ms(&a->rx_deadline, CB_ASYNC_RECV_TIMEOUT);
+
+        if (a->uart->metrics)
+            cb_metrics_count_rx_error(a->uart->metrics, CB_METRICS_RX_TIMEOUT);
+
+        if (a->ops && a->ops->timeout)
+            a->ops->timeout(a, a->userdata);
+    }
+}
+
+int cb_async_process(struct cb_async *a, short revents)
+{
+    int rv = 0;
+
+    if (revents & (POLLERR | POLLNVAL)) {
+        report_error(a, EIO);
+        errno = EIO;
+        return -1;
+    }
+
+    if (revents & (POLLIN | POLLHUP))
+        rv |= rx_read(a);
+
+    cc_flush_urgent(a);
+
+    if (a->tx_count)
+        rv |= tx_flush(a);
+
+    check_deadlines(a);
+
+    return rv ? -1 : 0;
+}
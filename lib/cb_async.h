@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "cb_uart.h"
+#include "cb_protocol.h"
+
+/*
+ * Asynchronous, event-loop friendly access to the safety controller.
+ *
+ * Instead of blocking in cb_uart_recv(), the caller integrates the UART into
+ * its own event loop (poll, epoll, libuv, glib, sd-event...):
+ *
+ *   - watch cb_async_get_fd() for the events returned by cb_async_get_events()
+ *   - wake up at the latest after cb_async_get_timeout() ms (or at the absolute
+ *     time of cb_async_get_deadline())
+ *   - call cb_async_process() with the returned events (or 0 on timeout)
+ *
+ * cb_async_process() never blocks. Received frames, timeouts and errors are
+ * reported via callbacks, which may call the send functions again. Sending is
+ * non-blocking as well: frames are queued and written when the UART is ready;
+ * a completion callback reports when a frame was written or, for inquiries,
+ * when the requested frame was received.
+ *
+ * The UART must already be opened; it is switched to non-blocking mode
+ * while the async context exists. All functions must be called from the same
+ * thread, and cb_async_free() must not be called from within a callback.
+ */
+
+/* default time to wait for the response to an inquiry, in ms */
+#define CB_ASYNC_INQUIRY_TIMEOUT 100
+
+/* maximum count of queued frames and of unanswered inquiries */
+#define CB_ASYNC_MAX_TX_QUEUE 32
+#define CB_ASYNC_MAX_PENDING 16
+
+/* opaque context */
+struct cb_async;
+
+/* completion of a send request: status is 0 on success or a positive errno value,
+ * e.g. ETIMEDOUT when an inquiry was not answered; com and data carry the received
+ * response of an inquiry, or the sent frame otherwise
+ */
+typedef void (*cb_async_done_cb)(struct cb_async *a, int status, enum cb_uart_com com, uint64_t data, void *userdata);
+
+struct cb_async_ops {
+    /* a valid frame was received (and already stored in the context, if given) */
+    void (*frame)(struct cb_async *a, enum cb_uart_com com, uint64_t data, void *userdata);
+
+    /* no frame was received within CB_UART_RECV_INTERVAL plus margin; repeated while the link is silent */
+    void (*timeout)(struct cb_async *a, void *userdata);
+
+    /* a receive or send error occurred (errno value), e.g. EBADMSG for a corrupted frame;
+     * a fatal error is also returned by cb_async_process
+     */
+    void (*error)(struct cb_async *a, int err, void *userdata);
+};
+
+/* create a context for the given (opened) UART; if ctx is not NULL, received frames are
+ * stored in it (cb_proto_store_frame) and their timestamps are recorded;
+ * returns NULL on error
+ */
+struct cb_async *cb_async_new(struct uart_ctx *uart, struct safety_controller *ctx,
+                              const struct cb_async_ops *ops, void *userdata);
+
+/* restores the blocking mode of the UART; pending requests are completed with ECANCELED */
+void cb_async_free(struct cb_async *a);
+
+/* the fd to watch */
+int cb_async_get_fd(struct cb_async *a);
+
+/* the poll events to watch for: POLLIN, plus POLLOUT while frames are queued */
+short cb_async_get_events(struct cb_async *a);
+
+/* ms until cb_async_process must be called at the latest, -1 if there is no deadline */
+int cb_async_get_timeout(struct cb_async *a);
+
+/* the same as absolute CLOCK_MONOTONIC time; returns false if there is no deadline */
+bool cb_async_get_deadline(struct cb_async *a, struct timespec *ts);
+
+/* handle the given poll events (0 when called because of the timeout) without blocking;
+ * returns 0 on success, -1 with errno set on fatal errors of the fd
+ */
+int cb_async_process(struct cb_async *a, short revents);
+
+/* queue a frame; done (may be NULL) is called once it was written;
+ * returns -1 with errno set to ENOBUFS if the queue is full, write errors are reported via done
+ */
+int cb_async_send(struct cb_async *a, enum cb_uart_com com, uint64_t data, cb_async_done_cb done, void *userdata);
+
+/* queue an inquiry for the given COM; done is called with the response or ETIMEDOUT;
+ * returns -1 with errno set to EBUSY if too many inquiries are unanswered
+ */
+int cb_async_inquiry(struct cb_async *a, enum cb_uart_com com, cb_async_done_cb done, void *userdata);
+
+/* queue an action inquiry; done is called with the COM_ACTION response or ETIMEDOUT */
+int cb_async_action_inquiry(struct cb_async *a, uint8_t action, cb_async_done_cb done, void *userdata);
+
+/* commit a Charge Control transaction of the context (see cb_proto_cc_begin) and send
+ * safety-relevant changes immediately, rate-limited; Charge Control frames sent via
+ * cb_async_send are tracked as well; returns -1 with errno set to EINVAL without context
+ */
+int cb_async_cc_commit(struct cb_async *a);
+
+/* change the inquiry timeout (in ms) for subsequent inquiries */
+void cb_async_set_inquiry_timeout(struct cb_async *a, unsigned int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,439 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <endian.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "cb_uart.h"
+#include "cb_frame_batch.h"
+#include "crc8_j1850.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+/* pdep/pext on 64 bit operands only exist in 64 bit mode */
+#ifdef __x86_64__
+#define HAVE_X86_PEXT 1
+#endif
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+/*
+ * The CRC is calculated over COM and the 8 data bytes, i.e. always over 9 bytes.
+ * For a fixed message length a CRC is an affine function of the message bits:
+ *     crc(m) = crc(0) ^ L(m)
+ * with L being linear, so L can be split up into the contribution of each byte
+ * position, and further into the contribution of each nibble:
+ *     crc(m) = crc(0) ^ XOR_i (lo_i[m_i & 0xf] ^ hi_i[m_i >> 4])
+ * Such 16-entry tables fit into a SIMD register, so that the lookups for 16 or 32
+ * frames can be done with a single shuffle instruction each.
+ */
+#define CRC_LEN 9
+
+static uint8_t crc_lo[CRC_LEN][16] __attribute__((aligned(16)));
+static uint8_t crc_hi[CRC_LEN][16] __attribute__((aligned(16)));
+static uint8_t crc_zero;
+
+static size_t (*validate_fn)(const uint8_t *frames, size_t count, uint8_t *status);
+static enum cb_frame_batch_impl current_impl;
+#ifdef HAVE_X86_PEXT
+static bool use_pext;
+#endif
+
+static void crc_tables_init(void)
+{
+    uint8_t msg[CRC_LEN];
+    unsigned int i, v;
+
+    memset(msg, 0, sizeof(msg));
+    crc_zero = crc8_j1850(msg, sizeof(msg));
+
+    for (i = 0; i < CRC_LEN; i++) {
+        for (v = 0; v < 16; v++) {
+            msg[i] = v;
+            crc_lo[i][v] = crc8_j1850(msg, sizeof(msg)) ^ crc_zero;
+            msg[i] = v << 4;
+            crc_hi[i][v] = crc8_j1850(msg, sizeof(msg)) ^ crc_zero;
+        }
+        msg[i] = 0;
+    }
+}
+
+static size_t validate_scalar(const uint8_t *frames, size_t count, uint8_t *status)
+{
+    size_t valid = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *f = frames + i * CB_UART_FRAME_SIZE;
+        uint8_t s = 0;
+
+        if (f[0] != CB_UART_SOF)
+            s |= CB_FRAME_BAD_SOF;
+        if (f[11] != CB_UART_EOF)
+            s |= CB_FRAME_BAD_EOF;
+        if (crc8_j1850((uint8_t *)&f[1], CRC_LEN) != f[10])
+            s |= CB_FRAME_BAD_CRC;
+
+        status[i] = s;
+        if (!s)
+            valid++;
+    }
+
+    return valid;
+}
+
+/*
+ * 16x16 byte transpose: after four rounds of interleaving row i with row i + 8,
+ * register c holds byte c of all 16 input rows. Since we load 16 bytes per 12-byte
+ * frame, registers 0...11 hold the frame columns, the rest is ignored.
+ * This is a macro so that it can be used from functions with different target attributes.
+ */
+#define TRANSPOSE16(r, t, ZIPLO, ZIPHI) \
+    do { \
+        int _round, _i; \
+        for (_round = 0; _round < 4; _round++) { \
+            for (_i = 0; _i < 8; _i++) { \
+                t[2 * _i] = ZIPLO(r[_i], r[_i + 8]); \
+                t[2 * _i + 1] = ZIPHI(r[_i], r[_i + 8]); \
+            } \
+            memcpy(r, t, sizeof(t)); \
+        } \
+    } while (0)
+
+#ifdef HAVE_X86_SIMD
+
+__attribute__((target("ssse3")))
+static size_t validate_ssse3(const uint8_t *frames, size_t count, uint8_t *status)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i sof = _mm_set1_epi8((char)CB_UART_SOF);
+    const __m128i eof = _mm_set1_epi8(CB_UART_EOF);
+    const __m128i bad_sof = _mm_set1_epi8(CB_FRAME_BAD_SOF);
+    const __m128i bad_eof = _mm_set1_epi8(CB_FRAME_BAD_EOF);
+    const __m128i bad_crc = _mm_set1_epi8(CB_FRAME_BAD_CRC);
+    __m128i lo[CRC_LEN], hi[CRC_LEN];
+    size_t valid = 0, i = 0;
+    unsigned int p;
+
+    for (p = 0; p < CRC_LEN; p++) {
+        lo[p] = _mm_load_si128((const __m128i *)crc_lo[p]);
+        hi[p] = _mm_load_si128((const __m128i *)crc_hi[p]);
+    }
+
+    /* we load 16 bytes per frame, so the last frame of a group must not be the last one at all */
+    while (count - i > 16) {
+        __m128i r[16], t[16], crc, st;
+        unsigned int j;
+
+        for (j = 0; j < 16; j++)
+            r[j] = _mm_loadu_si128((const __m128i *)(frames + (i + j) * CB_UART_FRAME_SIZE));
+
+        TRANSPOSE16(r, t, _mm_unpacklo_epi8, _mm_unpackhi_epi8);
+
+        crc = _mm_set1_epi8(crc_zero);
+        for (p = 0; p < CRC_LEN; p++) {
+            __m128i v = r[1 + p];
+
+            crc = _mm_xor_si128(crc, _mm_shuffle_epi8(lo[p], _mm_and_si128(v, nibble)));
+            crc = _mm_xor_si128(crc, _mm_shuffle_epi8(hi[p], _mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+        }
+
+        st = _mm_andnot_si128(_mm_cmpeq_epi8(r[0], sof), bad_sof);
+        st = _mm_or_si128(st, _mm_andnot_si128(_mm_cmpeq_epi8(r[11], eof), bad_eof));
+        st = _mm_or_si128(st, _mm_andnot_si128(_mm_cmpeq_epi8(r[10], crc), bad_crc));
+
+        _mm_storeu_si128((__m128i *)(status + i), st);
+        valid += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(st, _mm_setzero_si128())));
+
+        i += 16;
+    }
+
+    return valid + validate_scalar(frames + i * CB_UART_FRAME_SIZE, count - i, status + i);
+}
+
+/* in the AVX2 variant, the lower lane processes frames 0...15 and the upper lane frames 16...31 */
+__attribute__((target("avx2")))
+static size_t validate_avx2(const uint8_t *frames, size_t count, uint8_t *status)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i sof = _mm256_set1_epi8((char)CB_UART_SOF);
+    const __m256i eof = _mm256_set1_epi8(CB_UART_EOF);
+    const __m256i bad_sof = _mm256_set1_epi8(CB_FRAME_BAD_SOF);
+    const __m256i bad_eof = _mm256_set1_epi8(CB_FRAME_BAD_EOF);
+    const __m256i bad_crc = _mm256_set1_epi8(CB_FRAME_BAD_CRC);
+    __m256i lo[CRC_LEN], hi[CRC_LEN];
+    size_t valid = 0, i = 0;
+    unsigned int p;
+
+    for (p = 0; p < CRC_LEN; p++) {
+        lo[p] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)crc_lo[p]));
+        hi[p] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)crc_hi[p]));
+    }
+
+    while (count - i > 32) {
+        __m256i r[16], t[16], crc, st;
+        unsigned int j;
+
+        for (j = 0; j < 16; j++) {
+            const uint8_t *f = frames + (i + j) * CB_UART_FRAME_SIZE;
+
+            r[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)f)),
+                                           _mm_loadu_si128((const __m128i *)(f + 16 * CB_UART_FRAME_SIZE)), 1);
+        }
+
+        TRANSPOSE16(r, t, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8);
+
+        crc = _mm256_set1_epi8(crc_zero);
+        for (p = 0; p < CRC_LEN; p++) {
+            __m256i v = r[1 + p];
+
+            crc = _mm256_xor_si256(crc, _mm256_shuffle_epi8(lo[p], _mm256_and_si256(v, nibble)));
+            crc = _mm256_xor_si256(crc, _mm256_shuffle_epi8(hi[p], _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+        }
+
+        st = _mm256_andnot_si256(_mm256_cmpeq_epi8(r[0], sof), bad_sof);
+        st = _mm256_or_si256(st, _mm256_andnot_si256(_mm256_cmpeq_epi8(r[11], eof), bad_eof));
+        st = _mm256_or_si256(st, _mm256_andnot_si256(_mm256_cmpeq_epi8(r[10], crc), bad_crc));
+
+        _mm256_storeu_si256((__m256i *)(status + i), st);
+        valid += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(st, _mm256_setzero_si256())));
+
+        i += 32;
+    }
+
+    /* the remainder is still worth to be processed in 16 frame groups */
+    return valid + validate_ssse3(frames + i * CB_UART_FRAME_SIZE, count - i, status + i);
+}
+
+#ifdef HAVE_X86_PEXT
+__attribute__((target("bmi2")))
+static void extract_pext(const uint64_t *data, size_t count, uint64_t mask, uint64_t *out)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        out[i] = _pext_u64(data[i], mask);
+}
+#endif /* HAVE_X86_PEXT */
+
+#endif /* HAVE_X86_SIMD */
+
+#ifdef HAVE_NEON
+
+static size_t validate_neon(const uint8_t *frames, size_t count, uint8_t *status)
+{
+    const uint8x16_t nibble = vdupq_n_u8(0x0f);
+    const uint8x16_t sof = vdupq_n_u8(CB_UART_SOF);
+    const uint8x16_t eof = vdupq_n_u8(CB_UART_EOF);
+    const uint8x16_t bad_sof = vdupq_n_u8(CB_FRAME_BAD_SOF);
+    const uint8x16_t bad_eof = vdupq_n_u8(CB_FRAME_BAD_EOF);
+    const uint8x16_t bad_crc = vdupq_n_u8(CB_FRAME_BAD_CRC);
+    uint8x16_t lo[CRC_LEN], hi[CRC_LEN];
+    size_t valid = 0, i = 0;
+    unsigned int p;
+
+    for (p = 0; p < CRC_LEN; p++) {
+        lo[p] = vld1q_u8(crc_lo[p]);
+        hi[p] = vld1q_u8(crc_hi[p]);
+    }
+
+    while (count - i > 16) {
+        uint8x16_t r[16], t[16], crc, st;
+        unsigned int j;
+
+        for (j = 0; j < 16; j++)
+            r[j] = vld1q_u8(frames + (i + j) * CB_UART_FRAME_SIZE);
+
+        TRANSPOSE16(r, t, vzip1q_u8, vzip2q_u8);
+
+        crc = vdupq_n_u8(crc_zero);
+        for (p = 0; p < CRC_LEN; p++) {
+            uint8x16_t v = r[1 + p];
+
+            crc = veorq_u8(crc, vqtbl1q_u8(lo[p], vandq_u8(v, nibble)));
+            crc = veorq_u8(crc, vqtbl1q_u8(hi[p], vshrq_n_u8(v, 4)));
+        }
+
+        st = vbicq_u8(bad_sof, vceqq_u8(r[0], sof));
+        st = vorrq_u8(st, vbicq_u8(bad_eof, vceqq_u8(r[11], eof)));
+        st = vorrq_u8(st, vbicq_u8(bad_crc, vceqq_u8(r[10], crc)));
+
+        vst1q_u8(status + i, st);
+        valid += vaddvq_u8(vandq_u8(vceqzq_u8(st), vdupq_n_u8(1)));
+
+        i += 16;
+    }
+
+    return valid + validate_scalar(frames + i * CB_UART_FRAME_SIZE, count - i, status + i);
+}
+
+#endif /* HAVE_NEON */
+
+bool cb_frame_batch_impl_supported(enum cb_frame_batch_impl impl)
+{
+    switch (impl) {
+    case CB_FRAME_BATCH_IMPL_AUTO:
+    case CB_FRAME_BATCH_IMPL_SCALAR:
+        return true;
+#ifdef HAVE_X86_SIMD
+    case CB_FRAME_BATCH_IMPL_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case CB_FRAME_BATCH_IMPL_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("ssse3");
+#endif
+#ifdef HAVE_NEON
+    case CB_FRAME_BATCH_IMPL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+int cb_frame_batch_select_impl(enum cb_frame_batch_impl impl)
+{
+    if (impl == CB_FRAME_BATCH_IMPL_AUTO) {
+        for (impl = CB_FRAME_BATCH_IMPL_MAX - 1; impl > CB_FRAME_BATCH_IMPL_SCALAR; impl--)
+            if (cb_frame_batch_impl_supported(impl))
+                break;
+    }
+
+    if (!cb_frame_batch_impl_supported(impl)) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    switch (impl) {
+#ifdef HAVE_X86_SIMD
+    case CB_FRAME_BATCH_IMPL_SSSE3:
+        validate_fn = validate_ssse3;
+        break;
+    case CB_FRAME_BATCH_IMPL_AVX2:
+        validate_fn = validate_avx2;
+        break;
+#endif
+#ifdef HAVE_NEON
+    case CB_FRAME_BATCH_IMPL_NEON:
+        validate_fn = validate_neon;
+        break;
+#endif
+    default:
+        validate_fn = validate_scalar;
+    }
+
+    current_impl = impl;
+
+#ifdef HAVE_X86_PEXT
+    /* forcing the scalar implementation disables all special instructions */
+    use_pext = impl != CB_FRAME_BATCH_IMPL_SCALAR && __builtin_cpu_supports("bmi2");
+#endif
+
+    return 0;
+}
+
+enum cb_frame_batch_impl cb_frame_batch_get_impl(void)
+{
+    return current_impl;
+}
+
+const char *cb_frame_batch_impl_to_str(enum cb_frame_batch_impl impl)
+{
+    switch (impl) {
+    case CB_FRAME_BATCH_IMPL_AUTO:
+        return "auto";
+    case CB_FRAME_BATCH_IMPL_SCALAR:
+        return "scalar";
+    case CB_FRAME_BATCH_IMPL_SSSE3:
+        return "ssse3";
+    case CB_FRAME_BATCH_IMPL_AVX2:
+        return "avx2";
+    case CB_FRAME_BATCH_IMPL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+/* tables and dispatching are set up once when the library is loaded */
+__attribute__((constructor))
+static void cb_frame_batch_init(void)
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+#endif
+    crc_tables_init();
+    cb_frame_batch_select_impl(CB_FRAME_BATCH_IMPL_AUTO);
+}
+
+size_t cb_frame_batch_validate(const uint8_t *frames, size_t count, uint8_t *status)
+{
+    return validate_fn(frames, count, status);
+}
+
+void cb_frame_batch_decode(const uint8_t *frames, size_t count, uint8_t *com, uint64_t *data)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *f = frames + i * CB_UART_FRAME_SIZE;
+
+        if (com)
+            com[i] = f[1];
+
+        if (data) {
+            uint64_t d;
+
+            memcpy(&d, &f[2], sizeof(d));
+            data[i] = be64toh(d);
+        }
+    }
+}
+
+void cb_frame_batch_extract(const uint64_t *data, size_t count, uint64_t mask, uint64_t *out)
+{
+    unsigned int shift;
+    uint64_t m;
+    size_t i;
+
+    if (!mask) {
+        memset(out, 0, count * sizeof(*out));
+        return;
+    }
+
+    /* contiguous masks (the common case) are a simple shift-and-mask which the compiler vectorizes */
+    shift = __builtin_ctzll(mask);
+    m = mask >> shift;
+    if ((m & (m + 1)) == 0) {
+        for (i = 0; i < count; i++)
+            out[i] = (data[i] >> shift) & m;
+        return;
+    }
+
+#ifdef HAVE_X86_PEXT
+    if (use_pext) {
+        extract_pext(data, count, mask, out);
+        return;
+    }
+#endif
+
+    for (i = 0; i < count; i++) {
+        uint64_t d = data[i], r = 0, bm = mask;
+        unsigned int pos = 0;
+
+        while (bm) {
+            unsigned int b = __builtin_ctzll(bm);
+
+            r |= ((d >> b) & 1) << pos++;
+            bm &= bm - 1;
+        }
+
+        out[i] = r;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bulk processing of raw UART frames, e.g. when analyzing captured traffic offline.
+ * The frames are expected as consecutive CB_UART_FRAME_SIZE byte chunks, exactly
+ * as they appear on the wire.
+ *
+ * The validation uses SIMD instructions (SSSE3/AVX2 on x86, NEON on aarch64) when
+ * the CPU supports them; the implementation is selected automatically at runtime.
+ */
+
+/* per-frame validation result flags, 0 means valid */
+#define CB_FRAME_BAD_SOF 0x1
+#define CB_FRAME_BAD_EOF 0x2
+#define CB_FRAME_BAD_CRC 0x4
+
+enum cb_frame_batch_impl {
+    CB_FRAME_BATCH_IMPL_AUTO = 0,
+    CB_FRAME_BATCH_IMPL_SCALAR,
+    CB_FRAME_BATCH_IMPL_SSSE3,
+    CB_FRAME_BATCH_IMPL_AVX2,
+    CB_FRAME_BATCH_IMPL_NEON,
+    CB_FRAME_BATCH_IMPL_MAX,
+};
+
+/* validate SOF, EOF and CRC of 'count' frames; stores the flags of each frame in 'status'
+ * and returns the count of valid frames
+ */
+size_t cb_frame_batch_validate(const uint8_t *frames, size_t count, uint8_t *status);
+
+/* split 'count' frames into a column of COM values and a column of data (host byte order);
+ * each of the output arrays may be NULL if not needed
+ */
+void cb_frame_batch_decode(const uint8_t *frames, size_t count, uint8_t *com, uint64_t *data);
+
+/* extract the bits selected by 'mask' from each data value and store them right-aligned
+ * (and packed, in case of a non-contiguous mask) in 'out'
+ */
+void cb_frame_batch_extract(const uint64_t *data, size_t count, uint64_t mask, uint64_t *out);
+
+/* helper to build a mask for a bitfield as used in the protocol description */
+static inline uint64_t cb_frame_batch_mask(unsigned int bit, unsigned int len)
+{
+    return (len >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1)) << bit;
+}
+
+/* returns whether the given implementation can be used on this CPU */
+bool cb_frame_batch_impl_supported(enum cb_frame_batch_impl impl);
+
+/* force a specific implementation (e.g. for benchmarking), or return to the automatic
+ * selection with CB_FRAME_BATCH_IMPL_AUTO; returns -1 with errno set to ENOTSUP
+ * if the implementation is not supported
+ */
+int cb_frame_batch_select_impl(enum cb_frame_batch_impl impl);
+
+/* returns the currently used implementation */
+enum cb_frame_batch_impl cb_frame_batch_get_impl(void);
+
+const char *cb_frame_batch_impl_to_str(enum cb_frame_batch_impl impl);
+
+#ifdef __cplusplus
+}
+#endif
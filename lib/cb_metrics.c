@@ -0,0 +1,667 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cb_metrics.h"
+#include "cb_proto_field.h"
+#include "logging.h"
+#include "tools.h"
+
+/* how long to wait for a HTTP request after accepting a connection, in ms */
+#define CB_METRICS_REQUEST_TIMEOUT 100
+
+/* upper limit for sending the response, in ms */
+#define CB_METRICS_SEND_TIMEOUT 1000
+
+static const uint64_t rtt_bounds_us[] = CB_METRICS_RTT_BOUNDS_US;
+
+_Static_assert(ARRAY_SIZE(rtt_bounds_us) + 1 == CB_METRICS_RTT_BUCKETS, "unexpected count of RTT buckets");
+
+static const char *rx_error_names[CB_METRICS_RX_ERROR_MAX] = {
+    [CB_METRICS_RX_TIMEOUT] = "timeout",
+    [CB_METRICS_RX_IO] = "io",
+    [CB_METRICS_RX_BAD_SOF] = "sof",
+    [CB_METRICS_RX_BAD_EOF] = "eof",
+    [CB_METRICS_RX_BAD_CRC] = "crc",
+};
+
+static inline void counter_inc(uint64_t *c)
+{
+    __atomic_fetch_add(c, 1, __ATOMIC_RELAXED);
+}
+
+static inline void counter_add(uint64_t *c, uint64_t v)
+{
+    __atomic_fetch_add(c, v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t counter_get(const uint64_t *c)
+{
+    return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return timespec_to_ns(ts);
+}
+
+void cb_metrics_count_rx(struct cb_metrics *m, uint8_t com)
+{
+    uint64_t sent_ns, rtt_us;
+    unsigned int i;
+
+    counter_inc(&m->rx_frames[com]);
+
+    /* answer to an inquiry? */
+    sent_ns = __atomic_exchange_n(&m->inquiry_pending_ns[com], 0, __ATOMIC_RELAXED);
+    if (!sent_ns)
+        return;
+
+    rtt_us = (now_ns() - sent_ns) / 1000;
+
+    for (i = 0; i < ARRAY_SIZE(rtt_bounds_us); i++)
+        if (rtt_us <= rtt_bounds_us[i])
+            break;
+
+    counter_inc(&m->rtt_buckets[i]);
+    counter_add(&m->rtt_sum_us, rtt_us);
+}
+
+void cb_metrics_count_tx(struct cb_metrics *m, uint8_t com, uint64_t data)
+{
+    counter_inc(&m->tx_frames[com]);
+
+    /* the requested COM is in the upper byte; a repeated inquiry restarts the measurement */
+    if (com == COM_INQUIRY)
+        __atomic_store_n(&m->inquiry_pending_ns[data >> 56], now_ns(), __ATOMIC_RELAXED);
+}
+
+void cb_metrics_count_rx_error(struct cb_metrics *m, enum cb_metrics_rx_error e)
+{
+    counter_inc(&m->rx_errors[e]);
+}
+
+void cb_metrics_count_resync(struct cb_metrics *m)
+{
+    counter_inc(&m->resyncs);
+}
+
+static void print_label_value(FILE *f, const char *s)
+{
+    for (; *s; s++) {
+        switch (*s) {
+        case '\\':
+            fputs("\\\\", f);
+            break;
+        case '"':
+            fputs("\\\"", f);
+            break;
+        case '\n':
+            fputs("\\n", f);
+            break;
+        default:
+            fputc(*s, f);
+        }
+    }
+}
+
+static void print_device_label(FILE *f, const struct cb_metrics_source *src)
+{
+    fputs("device=\"", f);
+    print_label_value(f, src->name ? src->name : "");
+    fputc('"', f);
+}
+
+static void print_com_counters(FILE *f, const char *family, const char *help,
+                               const struct cb_metrics_source *sources, unsigned int count, bool tx)
+{
+    unsigned int i, com;
+
+    fprintf(f, "# TYPE %s counter\n# HELP %s %s\n", family, family, help);
+
+    for (i = 0; i < count; i++) {
+        const uint64_t *frames = tx ? sources[i].metrics->tx_frames : sources[i].metrics->rx_frames;
+
+        for (com = 0; com <= COM_MAX; com++) {
+            uint64_t v = counter_get(&frames[com]);
+            const char *name;
+
+            if (!v)
+                continue;
+
+            fprintf(f, "%s_total{", family);
+            print_device_label(f, &sources[i]);
+
+            /* unknown COMs would all be named the same */
+            name = cb_uart_com_to_str(com);
+            if (strcmp(name, "UNKNOWN") == 0)
+                fprintf(f, ",com=\"0x%02x\"} %" PRIu64 "\n", com, v);
+            else
+                fprintf(f, ",com=\"%s\"} %" PRIu64 "\n", name, v);
+        }
+    }
+}
+
+static void print_link_metrics(FILE *f, const struct cb_metrics_source *sources, unsigned int count)
+{
+    unsigned int i, j;
+
+    print_com_counters(f, "ra_uart_rx_frames", "Received valid UART frames.", sources, count, false);
+    print_com_counters(f, "ra_uart_tx_frames", "Sent UART frames.", sources, count, true);
+
+    fprintf(f, "# TYPE ra_uart_rx_errors counter\n"
+               "# HELP ra_uart_rx_errors Failed UART frame receptions.\n");
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < CB_METRICS_RX_ERROR_MAX; j++) {
+            fputs("ra_uart_rx_errors_total{", f);
+            print_device_label(f, &sources[i]);
+            fprintf(f, ",kind=\"%s\"} %" PRIu64 "\n", rx_error_names[j], counter_get(&sources[i].metrics->rx_errors[j]));
+        }
+    }
+
+    fprintf(f, "# TYPE ra_uart_resyncs counter\n"
+               "# HELP ra_uart_resyncs Input flushes to re-synchronize with the safety controller.\n");
+    for (i = 0; i < count; i++) {
+        fputs("ra_uart_resyncs_total{", f);
+        print_device_label(f, &sources[i]);
+        fprintf(f, "} %" PRIu64 "\n", counter_get(&sources[i].metrics->resyncs));
+    }
+
+    fprintf(f, "# TYPE ra_inquiry_rtt_seconds histogram\n"
+               "# UNIT ra_inquiry_rtt_seconds seconds\n"
+               "# HELP ra_inquiry_rtt_seconds Time from sending an inquiry until the requested frame was received.\n");
+    for (i = 0; i < count; i++) {
+        const struct cb_metrics *m = sources[i].metrics;
+        uint64_t cumulative = 0;
+
+        for (j = 0; j < CB_METRICS_RTT_BUCKETS; j++) {
+            cumulative += counter_get(&m->rtt_buckets[j]);
+
+            fputs("ra_inquiry_rtt_seconds_bucket{", f);
+            print_device_label(f, &sources[i]);
+            if (j < ARRAY_SIZE(rtt_bounds_us))
+                /* OpenMetrics wants canonical floats, i.e. '1.0' instead of '1' */
+                fprintf(f, ",le=\"%g%s\"} %" PRIu64 "\n", rtt_bounds_us[j] / 1e6,
+                        rtt_bounds_us[j] % 1000000 ? "" : ".0", cumulative);
+            else
+                fprintf(f, ",le=\"+Inf\"} %" PRIu64 "\n", cumulative);
+        }
+
+        /* use the bucket total as count, so that both are consistent even while counting concurrently */
+        fputs("ra_inquiry_rtt_seconds_count{", f);
+        print_device_label(f, &sources[i]);
+        fprintf(f, "} %" PRIu64 "\n", cumulative);
+
+        fputs("ra_inquiry_rtt_seconds_sum{", f);
+        print_device_label(f, &sources[i]);
+        fprintf(f, "} %.6f\n", counter_get(&m->rtt_sum_us) / 1e6);
+    }
+}
+
+/* a field is known once any frame which carries it was received, e.g. the safe state
+ * of MCS controllers arrives with COM_CHARGE_STATE_2 */
+static bool field_is_known(const struct cb_metrics_source *src, const struct cb_proto_field *field)
+{
+    unsigned int com;
+
+    if (!src->ctx)
+        return false;
+
+    for (com = 0; com < ARRAY_SIZE(src->ctx->ts_recv_com); com++)
+        if (timespec_is_set(&src->ctx->ts_recv_com[com]) && cb_proto_field_is_carried_by(field, com))
+            return true;
+
+    return false;
+}
+
+static void print_field_metrics(FILE *f, const struct cb_metrics_source *sources, unsigned int count)
+{
+    unsigned int idx, i;
+
+    for (idx = 0; idx < cb_proto_field_count(); idx++) {
+        const struct cb_proto_field *field = cb_proto_field_by_index(idx);
+        bool header = false;
+
+        /* only the received values are interesting, not the ones we send */
+        if (field->com == COM_CHARGE_CONTROL || field->com == COM_CHARGE_CONTROL_2)
+            continue;
+
+        for (i = 0; i < count; i++) {
+            int32_t v;
+
+            if (!field_is_known(&sources[i], field))
+                continue;
+
+            if (!header) {
+                fprintf(f, "# TYPE ra_safety_%s gauge\n"
+                           "# HELP ra_safety_%s Field '%s' of %s.\n",
+                        field->name, field->name, field->name, cb_uart_com_to_str(field->com));
+                header = true;
+            }
+
+            v = field->get(sources[i].ctx);
+
+            fprintf(f, "ra_safety_%s{", field->name);
+            print_device_label(f, &sources[i]);
+
+            switch (field->type) {
+            case CB_PROTO_FIELD_ENUM:
+                /* the human readable state as label allows to show it without value mapping */
+                fputs(",state=\"", f);
+                print_label_value(f, field->to_str(v));
+                fprintf(f, "\"} %" PRId32 "\n", v);
+                break;
+            case CB_PROTO_FIELD_BOOL:
+                fprintf(f, "} %d\n", v ? 1 : 0);
+                break;
+            default:
+                if (field->scale > 1)
+                    fprintf(f, "} %g\n", (double)v / field->scale);
+                else
+                    fprintf(f, "} %" PRId32 "\n", v);
+            }
+        }
+    }
+}
+
+int cb_metrics_render(FILE *f, const struct cb_metrics_source *sources, unsigned int count)
+{
+    print_link_metrics(f, sources, count);
+    print_field_metrics(f, sources, count);
+
+    fputs("# EOF\n", f);
+
+    return ferror(f) ? -1 : 0;
+}
+
+int cb_metrics_write_textfile(const char *filename, const struct cb_metrics_source *sources, unsigned int count)
+{
+    char *tmpname;
+    FILE *f;
+    int fd, saved_errno;
+
+    /* the temporary name must not match the '*.prom' pattern of the textfile collector */
+    if (asprintf(&tmpname, "%s.XXXXXX", filename) < 0)
+        return -1;
+
+    fd = mkstemp(tmpname);
+    if (fd < 0) {
+        error("could not create temporary file for '%s': %m", filename);
+        goto free_out;
+    }
+
+    /* mkstemp creates the file readable for the owner only */
+    if (fchmod(fd, 0644))
+        goto close_out;
+
+    f = fdopen(fd, "w");
+    if (!f)
+        goto close_out;
+
+    if (cb_metrics_render(f, sources, count)) {
+        saved_errno = errno;
+        fclose(f);
+        errno = saved_errno;
+        goto unlink_out;
+    }
+
+    if (fclose(f))
+        goto unlink_out;
+
+    if (rename(tmpname, filename))
+        goto unlink_out;
+
+    free(tmpname);
+    return 0;
+
+close_out:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+unlink_out:
+    saved_errno = errno;
+    error("writing metrics to '%s' failed: %m", filename);
+    unlink(tmpname);
+    errno = saved_errno;
+
+free_out:
+    free(tmpname);
+    return -1;
+}
+
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* remove a stale socket file of a previous run */
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 4)) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return fd;
+}
+
+static int listen_tcp(const char *address)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+    struct addrinfo *res, *ai;
+    char *host = NULL, *port, *sep;
+    int fd = -1, rv;
+
+    /* without host, listen on the loopback interface only */
+    sep = strrchr(address, ':');
+    if (sep) {
+        host = strndup(address, sep - address);
+        if (!host)
+            return -1;
+        port = sep + 1;
+    } else {
+        port = (char *)address;
+    }
+
+    rv = getaddrinfo(host ? host : "localhost", port, &hints, &res);
+    free(host);
+    if (rv) {
+        error("could not resolve '%s': %s", address, gai_strerror(rv));
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        int one = 1;
+
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 4) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    return fd;
+}
+
+int cb_metrics_listen(const char *address)
+{
+    int fd;
+
+    if (strncmp(address, "unix:", 5) == 0)
+        fd = listen_unix(address + 5);
+    else
+        fd = listen_tcp(address);
+
+    if (fd < 0)
+        error("could not listen on '%s': %m", address);
+
+    return fd;
+}
+
+struct cb_metrics_conn {
+    int fd;
+
+    enum {
+        CONN_READ_REQUEST,
+        CONN_WRITE_RESPONSE,
+    } state;
+
+    /* end of the current state, CLOCK_MONOTONIC */
+    struct timespec deadline;
+
+    char request[4096];
+    size_t request_len;
+
+    char *response;
+    size_t response_len;
+    size_t response_sent;
+};
+
+struct cb_metrics_conn *cb_metrics_accept(int listen_fd)
+{
+    struct cb_metrics_conn *c;
+    int fd;
+
+    fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        /* the client might have gone meanwhile */
+        if (errno == EWOULDBLOCK || errno == ECONNABORTED)
+            errno = EAGAIN;
+        return NULL;
+    }
+
+    c = calloc(1, sizeof(*c));
+    if (!c) {
+        close(fd);
+        return NULL;
+    }
+
+    c->fd = fd;
+    c->state = CONN_READ_REQUEST;
+    clock_gettime(CLOCK_MONOTONIC, &c->deadline);
+    timespec_add_ms(&c->deadline, CB_METRICS_REQUEST_TIMEOUT);
+
+    return c;
+}
+
+int cb_metrics_conn_get_fd(struct cb_metrics_conn *c)
+{
+    return c->fd;
+}
+
+short cb_metrics_conn_get_events(struct cb_metrics_conn *c)
+{
+    return c->state == CONN_READ_REQUEST ? POLLIN : POLLOUT;
+}
+
+int cb_metrics_conn_get_timeout(struct cb_metrics_conn *c)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &c->deadline) >= 0)
+        return 0;
+
+    /* round up, so that the deadline has passed when we are called */
+    return timespec_to_ms(timespec_sub(c->deadline, now)) + 1;
+}
+
+static bool conn_deadline_passed(struct cb_metrics_conn *c)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return timespec_compare(&now, &c->deadline) >= 0;
+}
+
+/* read what is available of the request header; returns 1 while it is incomplete, 0 when
+ * it is complete (or cannot get any longer) and -1 on error */
+static int conn_read_request(struct cb_metrics_conn *c)
+{
+    while (c->request_len < sizeof(c->request) - 1) {
+        ssize_t len = recv(c->fd, &c->request[c->request_len], sizeof(c->request) - 1 - c->request_len, 0);
+
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        /* the client shut down its sending side */
+        if (len == 0)
+            return 0;
+
+        c->request_len += len;
+        c->request[c->request_len] = '\0';
+
+        if (strstr(c->request, "\r\n\r\n") || strstr(c->request, "\n\n"))
+            return 0;
+    }
+
+    return 0;
+}
+
+/* render the complete response, as HTTP response if the request looks like HTTP */
+static int conn_prepare_response(struct cb_metrics_conn *c, const struct cb_metrics_source *sources,
+                                 unsigned int count)
+{
+    bool http = c->request_len >= 4 && strncmp(c->request, "GET ", 4) == 0;
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f;
+
+    f = open_memstream(&body, &body_len);
+    if (!f)
+        return -1;
+
+    cb_metrics_render(f, sources, count);
+
+    if (fclose(f)) {
+        free(body);
+        return -1;
+    }
+
+    if (http) {
+        int len = asprintf(&c->response, "HTTP/1.0 200 OK\r\n"
+                                         "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                                         "Content-Length: %zu\r\n"
+                                         "Connection: close\r\n\r\n%s", body_len, body);
+        free(body);
+        if (len < 0) {
+            c->response = NULL;
+            return -1;
+        }
+        c->response_len = len;
+    } else {
+        c->response = body;
+        c->response_len = body_len;
+    }
+
+    c->state = CONN_WRITE_RESPONSE;
+    clock_gettime(CLOCK_MONOTONIC, &c->deadline);
+    timespec_add_ms(&c->deadline, CB_METRICS_SEND_TIMEOUT);
+
+    return 0;
+}
+
+/* send as much of the response as possible; returns 1 while incomplete, 0 when done and -1 on error */
+static int conn_write_response(struct cb_metrics_conn *c)
+{
+    while (c->response_sent < c->response_len) {
+        ssize_t len = send(c->fd, c->response + c->response_sent, c->response_len - c->response_sent,
+                           MSG_NOSIGNAL);
+
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        c->response_sent += len;
+    }
+
+    return 0;
+}
+
+int cb_metrics_conn_process(struct cb_metrics_conn *c, short revents,
+                            const struct cb_metrics_source *sources, unsigned int count)
+{
+    int rv;
+
+    if (c->state == CONN_READ_REQUEST) {
+        rv = 1;
+        if (revents)
+            rv = conn_read_request(c);
+        if (rv < 0)
+            return -1;
+
+        /* a client which sends nothing gets the plain metrics after the request timeout */
+        if (rv > 0 && !conn_deadline_passed(c))
+            return 1;
+
+        if (conn_prepare_response(c, sources, count))
+            return -1;
+    }
+
+    /* try to send right away, the socket is usually writable */
+    rv = conn_write_response(c);
+    if (rv <= 0)
+        return rv;
+
+    if (conn_deadline_passed(c)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return 1;
+}
+
+void cb_metrics_conn_free(struct cb_metrics_conn *c)
+{
+    if (!c)
+        return;
+
+    close(c->fd);
+    free(c->response);
+    free(c);
+}
+
+int cb_metrics_close(int listen_fd, const char *address)
+{
+    if (listen_fd < 0)
+        return 0;
+
+    if (strncmp(address, "unix:", 5) == 0)
+        unlink(address + 5);
+
+    return close(listen_fd);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include "cb_uart.h"
+#include "cb_protocol.h"
+
+/*
+ * Link and safety controller metrics in OpenMetrics text format, e.g. for
+ * node_exporter's textfile collector or for scraping via a local socket.
+ *
+ * The counters are maintained by the UART layer once a metrics instance is
+ * attached to a UART context (see uart_metrics_attach). Counting uses relaxed
+ * atomic increments only; all formatting happens when rendering. The states
+ * of the safety controller (CP, PP, contactors, temperatures...) are not
+ * counted but taken from the controller context at rendering time, using
+ * the field registry of cb_proto_field.h.
+ */
+
+/* kinds of receive errors */
+enum cb_metrics_rx_error {
+    CB_METRICS_RX_TIMEOUT,
+    CB_METRICS_RX_IO,
+    CB_METRICS_RX_BAD_SOF,
+    CB_METRICS_RX_BAD_EOF,
+    CB_METRICS_RX_BAD_CRC,
+    CB_METRICS_RX_ERROR_MAX,
+};
+
+/* upper bounds of the inquiry round trip time histogram buckets, in µs */
+#define CB_METRICS_RTT_BOUNDS_US { 1000, 2000, 5000, 10000, 20000, 30000, 50000, 100000, 200000, 500000, 1000000 }
+#define CB_METRICS_RTT_BUCKETS 12 /* including +Inf */
+
+struct cb_metrics {
+    uint64_t rx_frames[COM_MAX + 1];
+    uint64_t tx_frames[COM_MAX + 1];
+    uint64_t rx_errors[CB_METRICS_RX_ERROR_MAX];
+
+    /* input flushes to get in sync with the safety controller again */
+    uint64_t resyncs;
+
+    /* send time (CLOCK_MONOTONIC, ns) of an unanswered inquiry per requested COM, 0 if none */
+    uint64_t inquiry_pending_ns[COM_MAX + 1];
+
+    /* inquiry round trip times, non-cumulative */
+    uint64_t rtt_buckets[CB_METRICS_RTT_BUCKETS];
+    uint64_t rtt_sum_us;
+};
+
+#define INIT_CB_METRICS {}
+
+/* hot path, called by the UART layer */
+void cb_metrics_count_rx(struct cb_metrics *m, uint8_t com);
+void cb_metrics_count_tx(struct cb_metrics *m, uint8_t com, uint64_t data);
+void cb_metrics_count_rx_error(struct cb_metrics *m, enum cb_metrics_rx_error e);
+void cb_metrics_count_resync(struct cb_metrics *m);
+
+/* one safety controller to render metrics for */
+struct cb_metrics_source {
+    /* value of the 'device' label, e.g. the UART device name */
+    const char *name;
+
+    struct cb_metrics *metrics;
+
+    /* may be NULL, then only link metrics are rendered */
+    struct safety_controller *ctx;
+};
+
+/* write the metrics of all given sources in OpenMetrics text format, including the final '# EOF' */
+int cb_metrics_render(FILE *f, const struct cb_metrics_source *sources, unsigned int count);
+
+/* render into a temporary file which then atomically replaces the given file */
+int cb_metrics_write_textfile(const char *filename, const struct cb_metrics_source *sources, unsigned int count);
+
+/* open a non-blocking listening socket: 'unix:<path>', '<port>' or '<host>:<port>';
+ * returns the socket fd, or -1 on error
+ */
+int cb_metrics_listen(const char *address);
+
+/*
+ * A client connection of the listening socket. It is answered with the current metrics,
+ * as HTTP response if a HTTP request is received within a short time, as plain text
+ * otherwise. Like cb_async.h, a connection never blocks but is driven by the event loop
+ * of the application:
+ *   - watch cb_metrics_conn_get_fd() for the events returned by cb_metrics_conn_get_events()
+ *   - wake up at the latest after cb_metrics_conn_get_timeout() ms
+ *   - call cb_metrics_conn_process() with the returned events (or 0 on timeout)
+ *   - free the connection once cb_metrics_conn_process() does not return 1
+ */
+struct cb_metrics_conn;
+
+/* to be called when the listening socket is readable: accept a connection;
+ * returns NULL with errno EAGAIN when there is none (anymore), or on error
+ */
+struct cb_metrics_conn *cb_metrics_accept(int listen_fd);
+
+int cb_metrics_conn_get_fd(struct cb_metrics_conn *c);
+
+/* POLLIN while waiting for the request, POLLOUT while sending the response */
+short cb_metrics_conn_get_events(struct cb_metrics_conn *c);
+
+/* ms until cb_metrics_conn_process must be called at the latest */
+int cb_metrics_conn_get_timeout(struct cb_metrics_conn *c);
+
+/* returns 1 while the connection is in progress, 0 when the response was sent completely,
+ * -1 on error (e.g. ETIMEDOUT when the client does not read the response in time)
+ */
+int cb_metrics_conn_process(struct cb_metrics_conn *c, short revents,
+                            const struct cb_metrics_source *sources, unsigned int count);
+
+/* close the connection */
+void cb_metrics_conn_free(struct cb_metrics_conn *c);
+
+/* close the listening socket (and remove the socket file of unix sockets) */
+int cb_metrics_close(int listen_fd, const char *address);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,394 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cb_uart.h"
+#include "cb_protocol.h"
+#include "cb_proto_field.h"
+#include "logging.h"
+#include "tools.h"
+
+/* the registry below needs uniform getters, so we wrap the cb_proto_* functions */
+
+#define GETTER(name, expr) \
+    static int32_t get_##name(struct safety_controller *ctx) \
+    { \
+        return (expr); \
+    }
+
+#define ENUM_TO_STR(fn, type) \
+    static const char *fn##_wrapper(int32_t value) \
+    { \
+        return fn((type)value); \
+    }
+
+GETTER(pwm_active, cb_proto_get_actual_pwm_active(ctx))
+GETTER(duty_cycle, cb_proto_get_actual_duty_cycle(ctx))
+GETTER(cp_state, cb_proto_get_cp_state(ctx))
+GETTER(cp_errors, cb_proto_get_cp_errors(ctx))
+GETTER(pp_state, cb_proto_get_pp_state(ctx))
+GETTER(contactor1, cb_proto_contactorN_get_actual_state(ctx, 0))
+GETTER(contactor2, cb_proto_contactorN_get_actual_state(ctx, 1))
+GETTER(contactor3, cb_proto_contactorN_get_actual_state(ctx, 2))
+GETTER(hv_ready, cb_proto_get_hv_ready(ctx))
+GETTER(estop1, cb_proto_estopN_get_state(ctx, 0))
+GETTER(estop2, cb_proto_estopN_get_state(ctx, 1))
+GETTER(estop3, cb_proto_estopN_get_state(ctx, 2))
+GETTER(rcm_state, cb_proto_get_rcm_state(ctx))
+GETTER(safe_state_active, cb_proto_get_safe_state_active(ctx))
+GETTER(safe_state_reason, cb_proto_get_safestate_reason(ctx))
+GETTER(id_state, cb_proto_get_id_state(ctx))
+GETTER(ce_state, cb_proto_get_ce_state(ctx))
+GETTER(estop_reason, cb_proto_get_estop_reason(ctx))
+GETTER(pt1000_1, lround(cb_proto_pt1000_get_temp(ctx, 0) * 10))
+GETTER(pt1000_2, lround(cb_proto_pt1000_get_temp(ctx, 1) * 10))
+GETTER(pt1000_3, lround(cb_proto_pt1000_get_temp(ctx, 2) * 10))
+GETTER(pt1000_4, lround(cb_proto_pt1000_get_temp(ctx, 3) * 10))
+GETTER(pt1000_1_errors, cb_proto_pt1000_get_errors(ctx, 0))
+GETTER(pt1000_2_errors, cb_proto_pt1000_get_errors(ctx, 1))
+GETTER(pt1000_3_errors, cb_proto_pt1000_get_errors(ctx, 2))
+GETTER(pt1000_4_errors, cb_proto_pt1000_get_errors(ctx, 3))
+GETTER(errmsg_active, cb_proto_errmsg_is_active(ctx))
+GETTER(errmsg_module, cb_proto_errmsg_get_module(ctx))
+GETTER(errmsg_reason, cb_proto_errmsg_get_reason(ctx))
+GETTER(target_pwm_active, cb_proto_get_target_pwm_active(ctx))
+GETTER(target_duty_cycle, cb_proto_get_target_duty_cycle(ctx))
+GETTER(target_contactor1, cb_proto_contactorN_get_target_state(ctx, 0))
+GETTER(target_contactor2, cb_proto_contactorN_get_target_state(ctx, 1))
+GETTER(target_contactor3, cb_proto_contactorN_get_target_state(ctx, 2))
+GETTER(target_ccs_ready, cb_proto_get_target_ccs_ready(ctx))
+GETTER(confirmed_action, cb_proto_get_confirmed_action(ctx))
+
+ENUM_TO_STR(cb_proto_cp_state_to_str, enum cp_state)
+ENUM_TO_STR(cb_proto_pp_state_to_str, enum pp_state)
+ENUM_TO_STR(cb_proto_contactor_state_to_str, enum contactor_state)
+ENUM_TO_STR(cb_proto_estop_state_to_str, enum estop_state)
+ENUM_TO_STR(cb_proto_rcm_state_to_str, enum rcm_state)
+ENUM_TO_STR(cb_proto_safe_state_active_to_str, enum cs_safestate_active)
+ENUM_TO_STR(cb_proto_safestate_reason_to_str, enum cs1_safestate_reason)
+ENUM_TO_STR(cb_proto_id_state_to_str, enum cs2_id_state)
+ENUM_TO_STR(cb_proto_ce_state_to_str, enum cs2_ce_state)
+ENUM_TO_STR(cb_proto_estop_reason_to_str, enum cs2_estop_reason)
+ENUM_TO_STR(cb_proto_errmsg_module_to_str, enum errmsg_module)
+ENUM_TO_STR(cb_proto_ccs_ready_to_str, enum cc2_ccs_ready)
+ENUM_TO_STR(cb_proto_action_id_to_str, enum action_id)
+
+#define NUMBER(n, c, s)  { #n, c, CB_PROTO_FIELD_NUMBER, 0, s, get_##n, NULL }
+#define BOOL(n, c)       { #n, c, CB_PROTO_FIELD_BOOL, 2, 1, get_##n, NULL }
+#define ENUM(n, c, m, f) { #n, c, CB_PROTO_FIELD_ENUM, m, 1, get_##n, f##_wrapper }
+
+static const struct cb_proto_field fields[] = {
+    /* Charge State */
+    BOOL(pwm_active, COM_CHARGE_STATE),
+    NUMBER(duty_cycle, COM_CHARGE_STATE, 10),
+    ENUM(cp_state, COM_CHARGE_STATE, CP_STATE_MAX, cb_proto_cp_state_to_str),
+    NUMBER(cp_errors, COM_CHARGE_STATE, 1),
+    ENUM(pp_state, COM_CHARGE_STATE, PP_STATE_MAX, cb_proto_pp_state_to_str),
+    ENUM(contactor1, COM_CHARGE_STATE, CONTACTOR_STATE_MAX, cb_proto_contactor_state_to_str),
+    ENUM(contactor2, COM_CHARGE_STATE, CONTACTOR_STATE_MAX, cb_proto_contactor_state_to_str),
+    ENUM(contactor3, COM_CHARGE_STATE, CONTACTOR_STATE_MAX, cb_proto_contactor_state_to_str),
+    BOOL(hv_ready, COM_CHARGE_STATE),
+    ENUM(estop1, COM_CHARGE_STATE, ESTOP_STATE_MAX, cb_proto_estop_state_to_str),
+    ENUM(estop2, COM_CHARGE_STATE, ESTOP_STATE_MAX, cb_proto_estop_state_to_str),
+    ENUM(estop3, COM_CHARGE_STATE, ESTOP_STATE_MAX, cb_proto_estop_state_to_str),
+    ENUM(rcm_state, COM_CHARGE_STATE, RCM_STATE_MAX, cb_proto_rcm_state_to_str),
+    ENUM(safe_state_active, COM_CHARGE_STATE, CS_SAFESTATE_ACTIVE_MAX, cb_proto_safe_state_active_to_str),
+    ENUM(safe_state_reason, COM_CHARGE_STATE, CS1_SAFESTATE_REASON_MAX, cb_proto_safestate_reason_to_str),
+
+    /* Charge State 2 (MCS) */
+    ENUM(id_state, COM_CHARGE_STATE_2, CS2_ID_STATE_MAX, cb_proto_id_state_to_str),
+    ENUM(ce_state, COM_CHARGE_STATE_2, CS2_CE_STATE_MAX, cb_proto_ce_state_to_str),
+    ENUM(estop_reason, COM_CHARGE_STATE_2, CS2_ESTOP_REASON_MAX, cb_proto_estop_reason_to_str),
+
+    /* PT1000 State, temperatures in 0.1 °C */
+    NUMBER(pt1000_1, COM_PT1000_STATE, 10),
+    NUMBER(pt1000_2, COM_PT1000_STATE, 10),
+    NUMBER(pt1000_3, COM_PT1000_STATE, 10),
+    NUMBER(pt1000_4, COM_PT1000_STATE, 10),
+    NUMBER(pt1000_1_errors, COM_PT1000_STATE, 1),
+    NUMBER(pt1000_2_errors, COM_PT1000_STATE, 1),
+    NUMBER(pt1000_3_errors, COM_PT1000_STATE, 1),
+    NUMBER(pt1000_4_errors, COM_PT1000_STATE, 1),
+
+    /* Error Message */
+    BOOL(errmsg_active, COM_ERROR_MESSAGE),
+    ENUM(errmsg_module, COM_ERROR_MESSAGE, ERRMSG_MODULE_MAX, cb_proto_errmsg_module_to_str),
+    NUMBER(errmsg_reason, COM_ERROR_MESSAGE, 1),
+
+    /* Charge Control (sent by host) */
+    BOOL(target_pwm_active, COM_CHARGE_CONTROL),
+    NUMBER(target_duty_cycle, COM_CHARGE_CONTROL, 10),
+    BOOL(target_contactor1, COM_CHARGE_CONTROL),
+    BOOL(target_contactor2, COM_CHARGE_CONTROL),
+    BOOL(target_contactor3, COM_CHARGE_CONTROL),
+
+    /* Charge Control 2 (MCS, sent by host) */
+    ENUM(target_ccs_ready, COM_CHARGE_CONTROL_2, CC2_CCS_MAX, cb_proto_ccs_ready_to_str),
+
+    /* Action acknowledge */
+    ENUM(confirmed_action, COM_ACTION, ACTION_ID_MAX, cb_proto_action_id_to_str),
+};
+
+const struct cb_proto_field *cb_proto_field_by_index(unsigned int idx)
+{
+    if (idx >= ARRAY_SIZE(fields))
+        return NULL;
+
+    return &fields[idx];
+}
+
+unsigned int cb_proto_field_count(void)
+{
+    return ARRAY_SIZE(fields);
+}
+
+const struct cb_proto_field *cb_proto_field_find(const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(fields); ++i)
+        if (strcasecmp(fields[i].name, name) == 0)
+            return &fields[i];
+
+    return NULL;
+}
+
+bool cb_proto_field_is_carried_by(const struct cb_proto_field *field, enum cb_uart_com com)
+{
+    if (field->com == com)
+        return true;
+
+    /* the common part (e.g. safe state active) is also present in the MCS frames */
+    if (field->com == COM_CHARGE_STATE && com == COM_CHARGE_STATE_2)
+        return field->get == get_safe_state_active;
+
+    return false;
+}
+
+/* compare strings case-insensitive, but treat space, dash and underscore as equal,
+ * so that e.g. 'not-tripped' matches 'not tripped' */
+static bool loose_strequal(const char *a, const char *b)
+{
+    for (; *a && *b; a++, b++) {
+        bool a_sep = *a == ' ' || *a == '-' || *a == '_';
+        bool b_sep = *b == ' ' || *b == '-' || *b == '_';
+
+        if (a_sep && b_sep)
+            continue;
+
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+            return false;
+    }
+
+    return *a == *b;
+}
+
+int cb_proto_field_parse_value(const struct cb_proto_field *field, const char *s, int32_t *value)
+{
+    char *endptr;
+    double d;
+    int i;
+
+    switch (field->type) {
+    case CB_PROTO_FIELD_BOOL:
+        if (loose_strequal(s, "yes") || loose_strequal(s, "true") || loose_strequal(s, "on") || strcmp(s, "1") == 0) {
+            *value = 1;
+            return 0;
+        }
+        if (loose_strequal(s, "no") || loose_strequal(s, "false") || loose_strequal(s, "off") || strcmp(s, "0") == 0) {
+            *value = 0;
+            return 0;
+        }
+        return -1;
+
+    case CB_PROTO_FIELD_ENUM:
+        for (i = 0; i < field->max; ++i) {
+            if (loose_strequal(s, field->to_str(i))) {
+                *value = i;
+                return 0;
+            }
+        }
+        /* fallback to plain numbers */
+        errno = 0;
+        i = strtol(s, &endptr, 0);
+        if (errno != 0 || endptr == s || *endptr != '\0')
+            return -1;
+        *value = i;
+        return 0;
+
+    case CB_PROTO_FIELD_NUMBER:
+        errno = 0;
+        d = strtod(s, &endptr);
+        if (errno != 0 || endptr == s)
+            return -1;
+        /* allow units behind the number, e.g. '80 °C' or '5%' */
+        while (*endptr == ' ')
+            endptr++;
+        if (*endptr != '\0' && strcmp(endptr, "°C") != 0 && strcmp(endptr, "%") != 0)
+            return -1;
+        *value = lround(d * field->scale);
+        return 0;
+    }
+
+    return -1;
+}
+
+int cb_proto_field_value_to_str(const struct cb_proto_field *field, int32_t value, char *buf, size_t size)
+{
+    switch (field->type) {
+    case CB_PROTO_FIELD_BOOL:
+        return snprintf(buf, size, "%s", value ? "yes" : "no");
+    case CB_PROTO_FIELD_ENUM:
+        return snprintf(buf, size, "%s", field->to_str(value));
+    case CB_PROTO_FIELD_NUMBER:
+    default:
+        if (field->scale == 10)
+            return snprintf(buf, size, "%.1f", value / 10.0);
+        return snprintf(buf, size, "%" PRId32, value);
+    }
+}
+
+static const struct {
+    const char *str;
+    enum cb_proto_cond_op op;
+} cond_ops[] = {
+    /* longest operators first, so that e.g. '<=' is not taken as '<' */
+    { "==", CB_PROTO_COND_EQ },
+    { "!=", CB_PROTO_COND_NE },
+    { "<=", CB_PROTO_COND_LE },
+    { ">=", CB_PROTO_COND_GE },
+    { "<",  CB_PROTO_COND_LT },
+    { ">",  CB_PROTO_COND_GT },
+    { "=",  CB_PROTO_COND_EQ },
+};
+
+const char *cb_proto_cond_op_to_str(enum cb_proto_cond_op op)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(cond_ops); ++i)
+        if (cond_ops[i].op == op)
+            return cond_ops[i].str;
+
+    return "?";
+}
+
+static char *trim(char *s)
+{
+    char *e;
+
+    while (isspace((unsigned char)*s))
+        s++;
+
+    e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        e--;
+    *e = '\0';
+
+    return s;
+}
+
+int cb_proto_cond_parse(const char *s, struct cb_proto_cond *cond)
+{
+    char buf[128];
+    char *name, *value, *p;
+    unsigned int i;
+
+    if (strlen(s) >= sizeof(buf)) {
+        error("condition too long: '%s'", s);
+        errno = EINVAL;
+        return -1;
+    }
+    strcpy(buf, s);
+
+    /* find the first operator character */
+    p = strpbrk(buf, "=!<>");
+    if (!p) {
+        error("no comparison operator found in condition '%s'", s);
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(cond_ops); ++i)
+        if (strncmp(p, cond_ops[i].str, strlen(cond_ops[i].str)) == 0)
+            break;
+    if (i == ARRAY_SIZE(cond_ops)) {
+        error("invalid comparison operator in condition '%s'", s);
+        errno = EINVAL;
+        return -1;
+    }
+
+    cond->op = cond_ops[i].op;
+    value = trim(p + strlen(cond_ops[i].str));
+    *p = '\0';
+    name = trim(buf);
+
+    cond->field = cb_proto_field_find(name);
+    if (!cond->field) {
+        error("unknown field '%s'", name);
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (cb_proto_field_parse_value(cond->field, value, &cond->value)) {
+        error("invalid value '%s' for field '%s'", value, cond->field->name);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+bool cb_proto_cond_test(const struct cb_proto_cond *cond, int32_t value)
+{
+    switch (cond->op) {
+    case CB_PROTO_COND_EQ:
+        return value == cond->value;
+    case CB_PROTO_COND_NE:
+        return value != cond->value;
+    case CB_PROTO_COND_LT:
+        return value < cond->value;
+    case CB_PROTO_COND_LE:
+        return value <= cond->value;
+    case CB_PROTO_COND_GT:
+        return value > cond->value;
+    case CB_PROTO_COND_GE:
+        return value >= cond->value;
+    }
+
+    return false;
+}
+
+bool cb_proto_cond_eval(const struct cb_proto_cond *cond, struct safety_controller *ctx)
+{
+    return cb_proto_cond_test(cond, cond->field->get(ctx));
+}
+
+bool cb_proto_cond_may_match(const struct cb_proto_cond *cond, int32_t min, int32_t max)
+{
+    switch (cond->op) {
+    case CB_PROTO_COND_EQ:
+        return cond->value >= min && cond->value <= max;
+    case CB_PROTO_COND_NE:
+        return !(min == max && min == cond->value);
+    case CB_PROTO_COND_LT:
+        return min < cond->value;
+    case CB_PROTO_COND_LE:
+        return min <= cond->value;
+    case CB_PROTO_COND_GT:
+        return max > cond->value;
+    case CB_PROTO_COND_GE:
+        return max >= cond->value;
+    }
+
+    return true;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cb_uart.h"
+#include "cb_protocol.h"
+
+/*
+ * This is a registry of the decoded fields of the safety controller frames,
+ * so that tools can address them by name (e.g. in queries, conditions or
+ * machine-readable output) instead of hard-coding the cb_proto_* getters.
+ */
+
+/* how a field value is to be interpreted */
+enum cb_proto_field_type {
+    CB_PROTO_FIELD_NUMBER,
+    CB_PROTO_FIELD_BOOL,
+    CB_PROTO_FIELD_ENUM,
+};
+
+struct cb_proto_field {
+    /* name as used on command line, e.g. "contactor2" */
+    const char *name;
+
+    /* the frame type which carries this field */
+    enum cb_uart_com com;
+
+    enum cb_proto_field_type type;
+
+    /* enum fields: values are in range 0...max - 1 */
+    int max;
+
+    /* number fields: the raw value is the human value multiplied with this factor */
+    int scale;
+
+    /* returns the raw value of this field from the given context */
+    int32_t (*get)(struct safety_controller *ctx);
+
+    /* enum fields: returns the string representation of a value */
+    const char *(*to_str)(int32_t value);
+};
+
+/* returns the field with the given index, or NULL when index is out of range */
+const struct cb_proto_field *cb_proto_field_by_index(unsigned int idx);
+
+/* count of registered fields */
+unsigned int cb_proto_field_count(void);
+
+/* look up a field by name (case-insensitive), returns NULL if unknown */
+const struct cb_proto_field *cb_proto_field_find(const char *name);
+
+/* returns true if the given frame type updates this field */
+bool cb_proto_field_is_carried_by(const struct cb_proto_field *field, enum cb_uart_com com);
+
+/* convert a human value (number, 'yes'/'no', enum string) to the raw value;
+ * returns 0 on success, -1 if the string cannot be interpreted
+ */
+int cb_proto_field_parse_value(const struct cb_proto_field *field, const char *s, int32_t *value);
+
+/* format a raw value for humans, returns the same as snprintf */
+int cb_proto_field_value_to_str(const struct cb_proto_field *field, int32_t value, char *buf, size_t size);
+
+/* comparison operators for conditions */
+enum cb_proto_cond_op {
+    CB_PROTO_COND_EQ,
+    CB_PROTO_COND_NE,
+    CB_PROTO_COND_LT,
+    CB_PROTO_COND_LE,
+    CB_PROTO_COND_GT,
+    CB_PROTO_COND_GE,
+};
+
+/* a single condition like 'cp_state == C' */
+struct cb_proto_cond {
+    const struct cb_proto_field *field;
+    enum cb_proto_cond_op op;
+    int32_t value;
+};
+
+/* parse a string like 'contactor2 == undefined'; returns 0 on success, -1 on error */
+int cb_proto_cond_parse(const char *s, struct cb_proto_cond *cond);
+
+/* check a condition against a raw value */
+bool cb_proto_cond_test(const struct cb_proto_cond *cond, int32_t value);
+
+/* check a condition against the given context */
+bool cb_proto_cond_eval(const struct cb_proto_cond *cond, struct safety_controller *ctx);
+
+/* returns false if no value within the range [min, max] can fulfill the condition */
+bool cb_proto_cond_may_match(const struct cb_proto_cond *cond, int32_t min, int32_t max);
+
+const char *cb_proto_cond_op_to_str(enum cb_proto_cond_op op);
+
+#ifdef __cplusplus
+}
+#endif
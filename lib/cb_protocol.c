@@ -2,19 +2,20 @@
  * Copyright © 2024 chargebyte GmbH
  * SPDX-License-Identifier: Apache-2.0
  */
-#include <sys/time.h>
 #include <endian.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include "uart.h"
 #include "cb_uart.h"
 #include "cb_protocol.h"
 #include "logging.h"
+#include "tools.h"
 
 #define BITMASK(len) \
     ((1 << (len)) - 1)
@@ -258,6 +259,103 @@ void cb_proto_set_estop(struct safety_controller *ctx, bool estop)
     DATA_SET_BITS(ctx->charge_control, 60, 4, estop ? CC2_CCS_EMERGENCY_STOP : CC2_CCS_NOT_READY);
 }
 
+void cb_proto_cc_begin(struct safety_controller *ctx)
+{
+    if (!ctx->cc_transaction)
+        ctx->cc_committed = ctx->charge_control;
+
+    ctx->cc_transaction = true;
+}
+
+/* safety-relevant changes of the Charge Control are the ones which stop charging */
+static bool cc_is_urgent_change(struct safety_controller *ctx, uint64_t old, uint64_t new)
+{
+    unsigned int i;
+
+    if (ctx->mcs) {
+        if (DATA_GET_BITS(new, 60, 4) == CC2_CCS_EMERGENCY_STOP && DATA_GET_BITS(old, 60, 4) != CC2_CCS_EMERGENCY_STOP)
+            return true;
+    } else {
+        if (DATA_GET_BITS(old, 63, 1) && !DATA_GET_BITS(new, 63, 1))
+            return true;
+    }
+
+    for (i = 0; i < CB_PROTO_MAX_CONTACTORS; i++)
+        if (DATA_GET_BITS(old, 40 + i, 1) && !DATA_GET_BITS(new, 40 + i, 1))
+            return true;
+
+    return false;
+}
+
+bool cb_proto_cc_commit(struct safety_controller *ctx)
+{
+    ctx->cc_transaction = false;
+
+    /* re-evaluated on each commit: an urgent change which was reverted meanwhile needs no frame */
+    ctx->cc_urgent = cc_is_urgent_change(ctx, ctx->cc_sent, ctx->charge_control);
+
+    return ctx->cc_urgent;
+}
+
+enum cb_uart_com cb_proto_cc_get_com(struct safety_controller *ctx)
+{
+    return ctx->mcs ? COM_CHARGE_CONTROL_2 : COM_CHARGE_CONTROL;
+}
+
+uint64_t cb_proto_cc_get_data(struct safety_controller *ctx)
+{
+    return ctx->cc_transaction ? ctx->cc_committed : ctx->charge_control;
+}
+
+void cb_proto_cc_sent(struct safety_controller *ctx, uint64_t data)
+{
+    ctx->cc_sent = data;
+
+    /* also a periodic frame delivers a pending urgent change */
+    if (ctx->cc_urgent && data == cb_proto_cc_get_data(ctx)) {
+        ctx->cc_urgent = false;
+        clock_gettime(CLOCK_MONOTONIC, &ctx->cc_urgent_ts);
+    }
+}
+
+int cb_proto_cc_urgent_timeout(struct safety_controller *ctx)
+{
+    struct timespec now;
+    long long elapsed_us;
+
+    if (!ctx->cc_urgent)
+        return -1;
+
+    if (!timespec_is_set(&ctx->cc_urgent_ts))
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_us = timespec_to_us(timespec_sub(now, ctx->cc_urgent_ts));
+    if (elapsed_us >= CB_PROTO_CC_URGENT_MIN_GAP_MS * 1000)
+        return 0;
+
+    /* round up, so that the gap has passed when we are called */
+    return (CB_PROTO_CC_URGENT_MIN_GAP_MS * 1000 - elapsed_us + 999) / 1000;
+}
+
+int cb_proto_cc_send_urgent(struct safety_controller *ctx, struct uart_ctx *uart)
+{
+    enum cb_uart_com com = cb_proto_cc_get_com(ctx);
+    uint64_t data = cb_proto_cc_get_data(ctx);
+    int rv;
+
+    if (cb_proto_cc_urgent_timeout(ctx) != 0)
+        return 0;
+
+    cb_proto_set_ts(ctx, com);
+    rv = cb_uart_send(uart, com, data);
+    if (rv)
+        return rv;
+
+    cb_proto_cc_sent(ctx, data);
+    return 1;
+}
+
 bool cb_proto_errmsg_is_active(struct safety_controller *ctx)
 {
     return DATA_GET_BITS(ctx->error_message, 63, 1);
@@ -416,6 +514,59 @@ void cb_proto_set_partnumber_str(struct safety_controller *ctx)
     }
 }
 
+void cb_proto_store_frame(struct safety_controller *ctx, enum cb_uart_com com, uint64_t data)
+{
+    switch (com) {
+    case COM_CHARGE_STATE_2:
+        /* in case we connect to an already running firmware we could receive
+         * a Charge State 2 frame before we derived the platform from Firmware Version frame
+         * so set this already here too
+         */
+        cb_proto_set_mcs_mode(ctx, true);
+        __attribute__ ((fallthrough));
+    case COM_CHARGE_STATE:
+        ctx->charge_state = data;
+        break;
+    case COM_CHARGE_CONTROL_2:
+        cb_proto_set_mcs_mode(ctx, true);
+        __attribute__ ((fallthrough));
+    case COM_CHARGE_CONTROL:
+        ctx->charge_control = data;
+        break;
+    case COM_PT1000_STATE:
+        ctx->pt1000 = data;
+        break;
+    case COM_ERROR_MESSAGE:
+        ctx->error_message = data;
+        break;
+    case COM_FW_VERSION:
+        ctx->fw_version = data;
+        cb_proto_set_fw_version_str(ctx);
+        if (cb_proto_fw_get_platform_type(ctx) == FW_PLATFORM_TYPE_CCY)
+            cb_proto_set_mcs_mode(ctx, true);
+        break;
+    case COM_GIT_HASH:
+        ctx->git_hash = data;
+        cb_proto_set_git_hash_str(ctx);
+        break;
+    case COM_PARTNUMBER_1:
+        ctx->partnumber1 = data;
+        break;
+    case COM_PARTNUMBER_2:
+        ctx->partnumber2 = data;
+        cb_proto_set_partnumber_str(ctx);
+        break;
+    case COM_CHIPINFO:
+        ctx->chipinfo = data;
+        break;
+    case COM_ACTION:
+        ctx->action_ack = data;
+        break;
+    default:
+        /* not yet implemented */
+    }
+}
+
 enum action_id cb_proto_get_confirmed_action(struct safety_controller *ctx)
 {
     return DATA_GET_BITS(ctx->action_ack, 56, 8);
@@ -905,48 +1056,53 @@ const char *cb_proto_fw_application_type_to_str(enum fw_application_type type)
     }
 }
 
+void cb_proto_set_ts(struct safety_controller *ctx, uint8_t com)
+{
+    clock_gettime(CLOCK_REALTIME, &ctx->ts_recv_com[com]);
+}
+
 int cb_proto_set_ts_str(struct safety_controller *ctx, uint8_t com)
 {
-    char *buffer = ctx->ts_str_recv_com[com];
-    struct timeval tv;
+    cb_proto_set_ts(ctx, com);
+
+    return 0;
+}
+
+int cb_proto_ts_to_str(const struct timespec *ts, char *buffer, size_t len)
+{
     struct tm tm;
     size_t offset;
     int rv;
 
-    if (gettimeofday(&tv, NULL) < 0) {
-         error("gettimeofday() failed: %m");
-         return -1;
-    }
-
-    if (localtime_r(&tv.tv_sec, &tm) == NULL) {
+    if (localtime_r(&ts->tv_sec, &tm) == NULL) {
         error("localtime_r() failed: %m");
         return -1;
     }
 
-    offset = strftime(buffer, TS_STR_RECV_COM_BUFSIZE, "%Y-%m-%d %H:%M:%S", &tm);
+    offset = strftime(buffer, len, "%Y-%m-%d %H:%M:%S", &tm);
     if (offset < 1) {
         error("strftime() failed");
         return -1;
     }
 
-    rv = snprintf(&buffer[offset], TS_STR_RECV_COM_BUFSIZE - offset, ".%03ld", tv.tv_usec / 1000);
+    rv = snprintf(&buffer[offset], len - offset, ".%03ld", ts->tv_nsec / 1000000);
     if (rv < 0) {
-        error("strftime() failed");
+        error("snprintf() failed");
         return -1;
     }
 
-    return rv;
+    return offset + rv;
 }
 
 #define printfnl(fmt, ...) \
         do { \
-            printf(fmt "\r\n", ##__VA_ARGS__); \
+            fprintf(f, fmt "\r\n", ##__VA_ARGS__); \
         } while (0)
 
 #define THIS_BIT_AND_ANY_OF_THE_LOWER(src, bit) \
     (((src) & (bit)) && ((src) & ((bit) - 1)))
 
-void cb_proto_dump(struct safety_controller *ctx)
+void cb_proto_fdump(struct safety_controller *ctx, FILE *f)
 {
     unsigned int i;
 
@@ -960,9 +1116,9 @@ void cb_proto_dump(struct safety_controller *ctx)
 
         printfnl("Proximity Pilot: %s", cb_proto_pp_state_to_str(cb_proto_get_pp_state(ctx)));
 
-        printf("Emergency Stop Tripped:");
+        fprintf(f, "Emergency Stop Tripped:");
         for (i = 0; i < CB_PROTO_MAX_ESTOPS; ++i) {
-            printf(" ESTOP%d=%-11s ", i + 1, cb_proto_estop_state_to_str(cb_proto_estopN_get_state(ctx, i)));
+            fprintf(f, " ESTOP%d=%-11s ", i + 1, cb_proto_estop_state_to_str(cb_proto_estopN_get_state(ctx, i)));
         }
         printfnl("");
 
@@ -1007,11 +1163,11 @@ void cb_proto_dump(struct safety_controller *ctx)
     for (i = 0; i < CB_PROTO_MAX_PT1000S; ++i) {
         bool is_enabled = cb_proto_pt1000_is_active(ctx, i);
 
-        printf("Channel %d: enabled=%-3s temperature=", i + 1, is_enabled ? "yes" : "no");
+        fprintf(f, "Channel %d: enabled=%-3s temperature=", i + 1, is_enabled ? "yes" : "no");
         if (is_enabled)
-            printf("%5.1f °C", cb_proto_pt1000_get_temp(ctx, i));
+            fprintf(f, "%5.1f °C", cb_proto_pt1000_get_temp(ctx, i));
         else
-            printf("-n/a- °C");
+            fprintf(f, "-n/a- °C");
         printfnl(" (%s%s%s%s)",
                  cb_proto_pt1000_get_errors(ctx, i) ? "" : "-no flags set-",
                  (cb_proto_pt1000_get_errors(ctx, i) & PT1000_SELFTEST_FAILED) ? "selftest failed" : "",
@@ -1052,7 +1208,19 @@ void cb_proto_dump(struct safety_controller *ctx)
     printfnl("");
     printfnl("== Timestamps ==");
     for (i = 0; i < COM_MAX; ++i) {
-        if (strlen(ctx->ts_str_recv_com[i]))
-            printfnl("%-29s: %s", cb_uart_com_to_str(i), ctx->ts_str_recv_com[i]);
+        char buffer[TS_STR_RECV_COM_BUFSIZE];
+
+        if (!timespec_is_set(&ctx->ts_recv_com[i]))
+            continue;
+
+        if (cb_proto_ts_to_str(&ctx->ts_recv_com[i], buffer, sizeof(buffer)) < 0)
+            continue;
+
+        printfnl("%-29s: %s", cb_uart_com_to_str(i), buffer);
     }
 }
+
+void cb_proto_dump(struct safety_controller *ctx)
+{
+    cb_proto_fdump(ctx, stdout);
+}
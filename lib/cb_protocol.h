@@ -10,6 +10,8 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 #include "cb_uart.h"
 
 /* the MCU is responsive to UART messages after releasing reset line after this time, in ms */
@@ -24,6 +26,9 @@ extern "C" {
 /* the MCU sends Charge State messages with this periodicity, in ms */
 #define CB_PROTO_CHARGE_STATE_INTERVAL 100
 
+/* safety-relevant Charge Control changes are sent immediately, but at most once per this time, in ms */
+#define CB_PROTO_CC_URGENT_MIN_GAP_MS 10
+
 /* maximum supported contactors */
 #define CB_PROTO_MAX_CONTACTORS 3
 
@@ -210,7 +215,7 @@ struct error_message {
     uint16_t additional_data_2;
 } __attribute__((packed));
 
-/* buffer size for timestamp */
+/* buffer size for timestamp string, see cb_proto_ts_to_str() */
 #define TS_STR_RECV_COM_BUFSIZE 32
 
 /* holds the current MCU state */
@@ -254,8 +259,23 @@ struct safety_controller {
     /* string with parsed details of the part number */
     char partnumber_details[64];
 
-    /* plain text receive timestampes for each packet type */
-    char ts_str_recv_com[COM_MAX][TS_STR_RECV_COM_BUFSIZE];
+    /* receive/send timestamps (CLOCK_REALTIME) for each packet type;
+     * formatted only when dumping, see cb_proto_ts_to_str()
+     */
+    struct timespec ts_recv_com[COM_MAX];
+
+    /* Charge Control transactions, see cb_proto_cc_begin() */
+    bool cc_transaction;
+    uint64_t cc_committed;
+
+    /* last sent Charge Control data */
+    uint64_t cc_sent;
+
+    /* a safety-relevant change was committed but not sent yet */
+    bool cc_urgent;
+
+    /* time (CLOCK_MONOTONIC) when the last urgent change was sent, for rate limiting */
+    struct timespec cc_urgent_ts;
 };
 
 bool cb_proto_get_actual_pwm_active(struct safety_controller *ctx);
@@ -312,6 +332,33 @@ enum cc2_ccs_ready cb_proto_get_target_ccs_ready(struct safety_controller *ctx);
 void cb_proto_set_ccs_ready(struct safety_controller *ctx, bool ready);
 void cb_proto_set_estop(struct safety_controller *ctx, bool estop);
 
+/*
+ * Charge Control transactions: setter calls between cb_proto_cc_begin() and
+ * cb_proto_cc_commit() take effect together, i.e. Charge Control frames sent
+ * meanwhile still carry the previously committed state. Without a transaction,
+ * each setter call takes effect immediately, as before.
+ *
+ * A commit which is safety-relevant compared to the last sent frame (emergency
+ * stop, opening a contactor, PWM off) should not wait for the next periodic
+ * frame: cb_proto_cc_send_urgent() sends it right away, rate-limited by
+ * CB_PROTO_CC_URGENT_MIN_GAP_MS. This frame is sent in addition to the periodic
+ * ones, so their cadence is not affected.
+ */
+void cb_proto_cc_begin(struct safety_controller *ctx);
+
+/* returns true if the committed changes are safety-relevant and should be sent immediately */
+bool cb_proto_cc_commit(struct safety_controller *ctx);
+
+/* COM and data of the Charge Control frame to send */
+enum cb_uart_com cb_proto_cc_get_com(struct safety_controller *ctx);
+uint64_t cb_proto_cc_get_data(struct safety_controller *ctx);
+
+/* to be called whenever a Charge Control frame was sent, periodic or not */
+void cb_proto_cc_sent(struct safety_controller *ctx, uint64_t data);
+
+/* ms until a pending urgent frame may be sent: 0 if it is due, -1 if nothing is pending */
+int cb_proto_cc_urgent_timeout(struct safety_controller *ctx);
+
 /* Error Message related (accesses the last received error message) */
 bool cb_proto_errmsg_is_active(struct safety_controller *ctx);
 enum errmsg_module cb_proto_errmsg_get_module(struct safety_controller *ctx);
@@ -348,6 +395,9 @@ void cb_proto_set_fw_version_str(struct safety_controller *ctx);
 void cb_proto_set_git_hash_str(struct safety_controller *ctx);
 void cb_proto_set_partnumber_str(struct safety_controller *ctx);
 
+/* stores the payload of a received (or sent) frame in the context and updates derived values */
+void cb_proto_store_frame(struct safety_controller *ctx, enum cb_uart_com com, uint64_t data);
+
 enum action_id {
     ACTION_ID_NO_ACTION = 0x0,
     ACTION_ID_RCM_SELFTEST = 0x1,
@@ -379,8 +429,13 @@ const char *cb_proto_fw_application_type_to_str(enum fw_application_type type);
 
 const char *cb_proto_action_id_to_str(enum action_id action);
 
+void cb_proto_set_ts(struct safety_controller *ctx, uint8_t com);
+int cb_proto_ts_to_str(const struct timespec *ts, char *buffer, size_t len);
+
+/* compatibility wrapper, only remembers the timestamp now */
 int cb_proto_set_ts_str(struct safety_controller *ctx, uint8_t com);
 
+void cb_proto_fdump(struct safety_controller *ctx, FILE *f);
 void cb_proto_dump(struct safety_controller *ctx);
 
 /* low-level helpers */
@@ -392,6 +447,11 @@ int cb_send_uart_inquiry(struct uart_ctx *uart, uint8_t com);
 
 int cb_send_uart_action_inquiry(struct uart_ctx *uart, uint8_t action);
 
+/* send the Charge Control frame if an urgent change is pending and the rate limit allows it;
+ * returns 1 if sent, 0 if there was nothing to send (yet), -1 on error
+ */
+int cb_proto_cc_send_urgent(struct safety_controller *ctx, struct uart_ctx *uart);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,10 +13,8 @@
 #include "crc8_j1850.h"
 #include "cb_uart.h"
 #include "cb_can_mirror.h"
-
-/* frame start/end markers */
-#define CB_SOF 0xA5
-#define CB_EOF 0x03
+#include "cb_metrics.h"
+#include "frame_log.h"
 
 /* UART frame */
 struct uart_frame {
@@ -27,6 +25,8 @@ struct uart_frame {
     uint8_t eof;
 } __attribute__((packed));
 
+_Static_assert(sizeof(struct uart_frame) == CB_UART_FRAME_SIZE, "unexpected UART frame size");
+
 const char *cb_uart_com_to_str(enum cb_uart_com com)
 {
     switch (com) {
@@ -79,18 +79,17 @@ const char *cb_uart_com_to_str(enum cb_uart_com com)
     }
 }
 
-int cb_uart_send(struct uart_ctx *uart, enum cb_uart_com com, uint64_t data)
+void cb_uart_frame_pack(struct uart_ctx *uart, uint8_t *buf, enum cb_uart_com com, uint64_t data)
 {
     struct uart_frame frame;
-    ssize_t c;
 
     /* prepare packet */
     memset(&frame, 0, sizeof(frame));
-    frame.sof = CB_SOF;
+    frame.sof = CB_UART_SOF;
     frame.com = com;
     frame.data = htobe64(data);
     frame.crc = crc8_j1850(&frame.com, sizeof(frame.com) + sizeof(frame.data));
-    frame.eof = CB_EOF;
+    frame.eof = CB_UART_EOF;
 
     if (com == COM_INQUIRY) {
         uint8_t *c = &frame.com + 1;
@@ -102,41 +101,43 @@ int cb_uart_send(struct uart_ctx *uart, enum cb_uart_com com, uint64_t data)
     if (uart->trace)
         uart_dump_frame(true, true, (uint8_t *)&frame, sizeof(frame));
 
-    c = uart_write_drain(uart, (const uint8_t *)&frame, sizeof(frame));
-    if (c < 0)
-        return c;
+    memcpy(buf, &frame, sizeof(frame));
+}
 
+void cb_uart_frame_sent(struct uart_ctx *uart, enum cb_uart_com com, uint64_t data)
+{
     if (uart_can_mirror_enabled(uart))
         cb_can_mirror_write(uart->fd_can_mirror, com, htobe64(data));
 
-    return 0;
+    if (uart_frame_log_enabled(uart))
+        frame_log_append(uart->frame_log, com, data, FRAME_LOG_FLAG_TX, uart->frame_log_source);
+
+    if (uart->metrics)
+        cb_metrics_count_tx(uart->metrics, com, data);
 }
 
-int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
+int cb_uart_frame_unpack(struct uart_ctx *uart, const uint8_t *buf, enum cb_uart_com *com, uint64_t *data)
 {
     struct uart_frame frame;
     uint8_t crc;
-    ssize_t c;
 
-    /* Regarding the timeout: when this function is called, it it usually async to the interval/periodicity
-     * of the safety controller. Thus we expect at least after the CB_UART_RECV_INTERVAL a fully UART frame.
-     * We add half of the period as safety margin.
-     */
-    c = uart_read_with_timeout(uart, (uint8_t *)&frame, sizeof(frame), CB_UART_RECV_INTERVAL + CB_UART_RECV_INTERVAL / 2);
-    if (c < 0)
-        return c;
+    memcpy(&frame, buf, sizeof(frame));
 
     if (uart->trace)
         uart_dump_frame(true, false, (uint8_t *)&frame, sizeof(frame));
 
     /* check field patterns */
-    if (frame.sof != CB_SOF) {
-        error("SOF pattern mismatch: expected 0x%02x, got 0x%02" PRIx8, CB_SOF, frame.sof);
+    if (frame.sof != CB_UART_SOF) {
+        error("SOF pattern mismatch: expected 0x%02x, got 0x%02" PRIx8, CB_UART_SOF, frame.sof);
+        if (uart->metrics)
+            cb_metrics_count_rx_error(uart->metrics, CB_METRICS_RX_BAD_SOF);
         errno = EBADMSG;
         return -1;
     }
-    if (frame.eof != CB_EOF) {
-        error("EOF pattern mismatch: expected 0x%02x, got 0x%02" PRIx8, CB_EOF, frame.eof);
+    if (frame.eof != CB_UART_EOF) {
+        error("EOF pattern mismatch: expected 0x%02x, got 0x%02" PRIx8, CB_UART_EOF, frame.eof);
+        if (uart->metrics)
+            cb_metrics_count_rx_error(uart->metrics, CB_METRICS_RX_BAD_EOF);
         errno = EBADMSG;
         return -1;
     }
@@ -145,6 +146,8 @@ int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
     crc = crc8_j1850(&frame.com, sizeof(frame.com) + sizeof(frame.data));
     if (crc != frame.crc) {
         error("CRC pattern mismatch: expected 0x%02x, got 0x%02" PRIx8, crc, frame.crc);
+        if (uart->metrics)
+            cb_metrics_count_rx_error(uart->metrics, CB_METRICS_RX_BAD_CRC);
         errno = EBADMSG;
         return -1;
     }
@@ -156,6 +159,12 @@ int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
     if (uart_can_mirror_enabled(uart))
         cb_can_mirror_write(uart->fd_can_mirror, frame.com, frame.data);
 
+    if (uart_frame_log_enabled(uart))
+        frame_log_append(uart->frame_log, frame.com, be64toh(frame.data), 0, uart->frame_log_source);
+
+    if (uart->metrics)
+        cb_metrics_count_rx(uart->metrics, frame.com);
+
     if (com)
         *com = frame.com;
     if (data)
@@ -164,6 +173,41 @@ int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
     return 0;
 }
 
+int cb_uart_send(struct uart_ctx *uart, enum cb_uart_com com, uint64_t data)
+{
+    uint8_t buf[CB_UART_FRAME_SIZE];
+    ssize_t c;
+
+    cb_uart_frame_pack(uart, buf, com, data);
+
+    c = uart_write_drain(uart, buf, sizeof(buf));
+    if (c < 0)
+        return c;
+
+    cb_uart_frame_sent(uart, com, data);
+
+    return 0;
+}
+
+int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
+{
+    uint8_t buf[CB_UART_FRAME_SIZE];
+    ssize_t c;
+
+    /* Regarding the timeout: when this function is called, it it usually async to the interval/periodicity
+     * of the safety controller. Thus we expect at least after the CB_UART_RECV_INTERVAL a fully UART frame.
+     * We add half of the period as safety margin.
+     */
+    c = uart_read_with_timeout(uart, buf, sizeof(buf), CB_UART_RECV_INTERVAL + CB_UART_RECV_INTERVAL / 2);
+    if (c < 0) {
+        if (uart->metrics)
+            cb_metrics_count_rx_error(uart->metrics, errno == ETIMEDOUT ? CB_METRICS_RX_TIMEOUT : CB_METRICS_RX_IO);
+        return c;
+    }
+
+    return cb_uart_frame_unpack(uart, buf, com, data);
+}
+
 int cb_uart_recv_and_sync(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data)
 {
     unsigned int trial = CB_UART_MAX_SYNC_TRIALS;
@@ -183,6 +227,9 @@ retry:
             if (rv < 0)
                 return rv;
 
+            if (uart->metrics)
+                cb_metrics_count_resync(uart->metrics);
+
             if (trial)
                 goto retry;
         }
@@ -16,6 +16,13 @@ extern "C" {
 /* when being async to safety controller, try at least this times to get in sync */
 #define CB_UART_MAX_SYNC_TRIALS 3
 
+/* frame start/end markers */
+#define CB_UART_SOF 0xA5
+#define CB_UART_EOF 0x03
+
+/* size of a complete UART frame: SOF, COM, 8 byte data, CRC, EOF */
+#define CB_UART_FRAME_SIZE 12
+
 /* values for COM fields */
 enum cb_uart_com {
     COM_INQUIRY                   = 0xff,
@@ -56,6 +63,22 @@ int cb_uart_recv(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data);
 
 int cb_uart_recv_and_sync(struct uart_ctx *uart, enum cb_uart_com *com, uint64_t *data);
 
+/*
+ * Building blocks for callers doing the I/O themselves, e.g. non-blocking (see cb_async.h).
+ * Frame buffers are CB_UART_FRAME_SIZE bytes, exactly as on the wire.
+ */
+
+/* build a frame to send */
+void cb_uart_frame_pack(struct uart_ctx *uart, uint8_t *buf, enum cb_uart_com com, uint64_t data);
+
+/* to be called when a frame was sent completely: CAN mirror, frame log and metrics */
+void cb_uart_frame_sent(struct uart_ctx *uart, enum cb_uart_com com, uint64_t data);
+
+/* check and decode a received frame and pass it to CAN mirror, frame log and metrics;
+ * returns -1 with errno set to EBADMSG when SOF, EOF or CRC do not match
+ */
+int cb_uart_frame_unpack(struct uart_ctx *uart, const uint8_t *buf, enum cb_uart_com *com, uint64_t *data);
+
 #ifdef __cplusplus
 }
 #endif
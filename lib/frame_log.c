@@ -0,0 +1,201 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame_log.h"
+#include "logging.h"
+
+struct frame_log {
+    FILE *f;
+};
+
+static void frame_log_init_header(struct frame_log_header *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, FRAME_LOG_MAGIC, sizeof(hdr->magic));
+    hdr->version = htole16(FRAME_LOG_VERSION);
+    hdr->record_size = htole16(sizeof(struct frame_log_record));
+}
+
+static int frame_log_check_header(const struct frame_log_header *hdr)
+{
+    if (memcmp(hdr->magic, FRAME_LOG_MAGIC, sizeof(hdr->magic)) != 0) {
+        error("not a frame log file (magic mismatch)");
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (le16toh(hdr->version) != FRAME_LOG_VERSION ||
+        le16toh(hdr->record_size) != sizeof(struct frame_log_record)) {
+        error("unsupported frame log version %u (record size %u)",
+              le16toh(hdr->version), le16toh(hdr->record_size));
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct frame_log *frame_log_open(const char *filename)
+{
+    struct frame_log_header hdr;
+    struct frame_log *log;
+    struct stat sb;
+    int fd;
+
+    log = calloc(1, sizeof(*log));
+    if (!log)
+        return NULL;
+
+    fd = open(filename, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        goto err_free;
+
+    if (fstat(fd, &sb))
+        goto err_close;
+
+    if (sb.st_size == 0) {
+        frame_log_init_header(&hdr);
+        if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+            goto err_close;
+    } else {
+        off_t payload;
+
+        if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+            errno = EINVAL;
+            goto err_close;
+        }
+
+        if (frame_log_check_header(&hdr))
+            goto err_close;
+
+        /* drop a partially written record at the end, e.g. after power loss */
+        payload = sb.st_size - sizeof(hdr);
+        if (payload % sizeof(struct frame_log_record)) {
+            payload -= payload % sizeof(struct frame_log_record);
+            if (ftruncate(fd, sizeof(hdr) + payload))
+                goto err_close;
+        }
+    }
+
+    log->f = fdopen(fd, "a");
+    if (!log->f)
+        goto err_close;
+
+    return log;
+
+err_close:
+    close(fd);
+err_free:
+    free(log);
+    return NULL;
+}
+
+int frame_log_append_record(struct frame_log *log, const struct frame_log_record *record)
+{
+    if (fwrite(record, sizeof(*record), 1, log->f) != 1)
+        return -1;
+
+    return 0;
+}
+
+int frame_log_append(struct frame_log *log, uint8_t com, uint64_t data, uint8_t flags, uint8_t source)
+{
+    struct frame_log_record record;
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    memset(&record, 0, sizeof(record));
+    record.ts_ns = htole64((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+    record.data = htole64(data);
+    record.com = com;
+    record.flags = flags;
+    record.source = source;
+
+    return frame_log_append_record(log, &record);
+}
+
+int frame_log_flush(struct frame_log *log)
+{
+    return fflush(log->f);
+}
+
+int frame_log_close(struct frame_log *log)
+{
+    int rv;
+
+    if (!log)
+        return 0;
+
+    rv = fclose(log->f);
+    free(log);
+
+    return rv;
+}
+
+int frame_log_map(struct frame_log_map *map, const char *filename)
+{
+    struct stat sb;
+
+    memset(map, 0, sizeof(*map));
+
+    map->fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (map->fd < 0)
+        return -1;
+
+    if (fstat(map->fd, &sb))
+        goto err_close;
+
+    if ((size_t)sb.st_size < sizeof(struct frame_log_header)) {
+        error("'%s' is too short to be a frame log", filename);
+        errno = EINVAL;
+        goto err_close;
+    }
+
+    map->size = sb.st_size;
+    map->addr = mmap(NULL, map->size, PROT_READ, MAP_SHARED, map->fd, 0);
+    if (map->addr == MAP_FAILED)
+        goto err_close;
+
+    if (frame_log_check_header(map->addr))
+        goto err_unmap;
+
+    /* we usually scan sequentially, so give the kernel a hint */
+    madvise(map->addr, map->size, MADV_SEQUENTIAL);
+
+    map->records = (const struct frame_log_record *)((const uint8_t *)map->addr + sizeof(struct frame_log_header));
+    map->count = (map->size - sizeof(struct frame_log_header)) / sizeof(struct frame_log_record);
+
+    return 0;
+
+err_unmap:
+    munmap(map->addr, map->size);
+err_close:
+    close(map->fd);
+    map->fd = -1;
+    map->addr = NULL;
+    return -1;
+}
+
+void frame_log_unmap(struct frame_log_map *map)
+{
+    if (map->addr)
+        munmap(map->addr, map->size);
+    if (map->fd >= 0)
+        close(map->fd);
+
+    map->addr = NULL;
+    map->fd = -1;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A frame log is a simple binary recording of UART frames:
+ * a fixed header followed by fixed-size records, all fields little-endian.
+ * Fixed-size records allow tools to mmap the file and to address each
+ * frame directly by its index, e.g. to split scanning across threads.
+ */
+
+#define FRAME_LOG_MAGIC "RAFRMLOG"
+#define FRAME_LOG_VERSION 1
+
+/* record flags */
+#define FRAME_LOG_FLAG_TX 0x01
+
+struct frame_log_header {
+    char magic[8];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct frame_log_record {
+    /* receive/send timestamp (CLOCK_REALTIME) in ns */
+    uint64_t ts_ns;
+
+    /* payload as returned by cb_uart_recv, i.e. already in host order when decoded */
+    uint64_t data;
+
+    uint8_t com;
+    uint8_t flags;
+
+    /* allows to distinguish several controllers in one log */
+    uint8_t source;
+
+    uint8_t reserved[5];
+} __attribute__((packed));
+
+/* opaque writer handle */
+struct frame_log;
+
+/* open (or create) a log file for appending; returns NULL on error */
+struct frame_log *frame_log_open(const char *filename);
+
+/* append a frame, timestamped with the current time */
+int frame_log_append(struct frame_log *log, uint8_t com, uint64_t data, uint8_t flags, uint8_t source);
+
+/* append an already prepared record */
+int frame_log_append_record(struct frame_log *log, const struct frame_log_record *record);
+
+int frame_log_flush(struct frame_log *log);
+
+int frame_log_close(struct frame_log *log);
+
+/* read-only mapping of a complete log file */
+struct frame_log_map {
+    int fd;
+    void *addr;
+    size_t size;
+
+    /* points behind the header; a truncated record at the end is ignored */
+    const struct frame_log_record *records;
+    size_t count;
+};
+
+int frame_log_map(struct frame_log_map *map, const char *filename);
+void frame_log_unmap(struct frame_log_map *map);
+
+static inline uint64_t frame_log_record_ts(const struct frame_log_record *r)
+{
+    return le64toh(r->ts_ns);
+}
+
+static inline uint64_t frame_log_record_data(const struct frame_log_record *r)
+{
+    return le64toh(r->data);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,650 @@
+/*
+ * Copyright © 2025 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <endian.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "tools.h"
+#include "param_block_crc8.h"
+#include "param_block.h"
+
+
+int pb_str_to_version(const char *s, uint16_t *version)
+{
+    char *endptr;
+    long int val;
+
+    val = strtol(s, &endptr, 10);
+
+    /* conversion failed: no valid int*/
+    if (errno != 0 || endptr == s || *endptr != '\0')
+       return -1;
+
+    /* range check */
+    if (val < 1)
+        return -1;
+    if (val > UINT16_MAX)
+        return -1;
+
+    *version = val;
+
+    return 0;
+}
+
+int pb_version_to_str(char *buffer, size_t size, uint16_t version)
+{
+    return snprintf(buffer, size, "%" PRIu16, version);
+}
+
+int pb_str_to_temperature(const char *s, int16_t *temperature)
+{
+    char *endptr;
+    float val;
+    int32_t ival;
+
+    /* special case: disable[d], none or off */
+    if (strcasecmp(s, "disable") == 0 || strcasecmp(s, "disabled") == 0 ||
+        strcasecmp(s, "none") == 0 || strcasecmp(s, "off") == 0) {
+        *temperature = htole16(PB_CHANNEL_DISABLE_VALUE);
+        return 0;
+    }
+
+    val = strtof(s, &endptr);
+
+    /* conversion failed: no valid float, or suffix not '°C' (with possible single whitespace before) */
+    if (errno != 0 || endptr == s ||
+        // Important note: we want to use strcmp here because we want a dump binary comparison
+        // (our source code is UTF-8 and we expect the YAML also as UTF-8)
+        !(strcmp(endptr, "°C") == 0 || strcmp(endptr, " °C") == 0))
+       return -1;
+
+    /* we store it as int with 0.1 °C resolution, so multiply with 10
+     * and round the float to int */
+    ival = (int32_t)roundf(val * 10);
+
+    /* (silently) clamp to range -80.0 °C ... 200.0 °C */
+    if (ival > 2000) ival = 2000;
+    if (ival < -800) ival = -800;
+
+    *temperature = htole16(ival);
+
+    return 0;
+}
+
+int pb_temperature_to_str(char *buffer, size_t size, int16_t temperature)
+{
+    if (le16toh(temperature) == PB_CHANNEL_DISABLE_VALUE)
+        return snprintf(buffer, size, "%s", "disabled");
+    /* older firmware versions used another magic value */
+    if (le16toh(temperature) == PB_OLD_CHANNEL_DISABLE_VALUE)
+        return snprintf(buffer, size, "%s", "disabled");
+
+    return snprintf(buffer, size, "%.1f °C", (int16_t)le16toh(temperature) / 10.0f);
+}
+
+int pb_str_to_resistance_offset(const char *s, int16_t *offset)
+{
+    char *endptr;
+    float val;
+    int32_t ival;
+
+    val = strtof(s, &endptr);
+
+    /* conversion failed: no valid float, or suffix not 'Ω' (with possible single whitespace before) */
+    if (errno != 0 || endptr == s ||
+        // Important note 1: we want to use strcmp here because we want a dump binary comparison
+        // (our source code is UTF-8 and we expect the YAML also as UTF-8)
+        // Important note 2: there is a dedicated Ohm symbol in UTF-8 (U+2126 = 0xe2 0x84 0xa6),
+        // but very often the Greek letter Omega is also used. We accept both characters, but
+        // output the Omega version. Next line is Greek letter, second line
+        // is Ohm symbol - humans will probably see no difference.
+        !(strcmp(endptr, "Ω") == 0 || strcmp(endptr, " Ω") == 0 ||
+          strcmp(endptr, "Ω") == 0 || strcmp(endptr, " Ω") == 0))
+       return -1;
+
+    /* we store it as int with 0.001 Ω resolution, so multiply with 1000
+     * and round the float to int */
+    ival = (int32_t)roundf(val * 1000);
+
+    /* (silently) clamp to range -32.0 Ω ... 32.0 Ω */
+    if (ival >  32000) ival =  32000;
+    if (ival < -32000) ival = -32000;
+
+    *offset = htole16(ival);
+
+    return 0;
+}
+
+int pb_resistance_offset_to_str(char *buffer, size_t size, int16_t offset)
+{
+    return snprintf(buffer, size, "%.3f Ω", (int16_t)le16toh(offset) / 1000.0f);
+}
+
+static const char *contactor_type_to_string[PB_CONTACTOR_MAX] = {
+    "disabled",
+    "without-feedback",
+    "with-feedback-normally-open",
+    "with-feedback-normally-closed",
+};
+
+enum pb_contactor_type pb_str_to_contactor_type(const char *s)
+{
+    unsigned int i;
+
+    for (i = PB_CONTACTOR_NONE; i < PB_CONTACTOR_MAX; ++i)
+        if (strcasecmp(s, contactor_type_to_string[i]) == 0)
+            return i;
+
+    /* relaxed input handling: also accept 'none' */
+    if (strcasecmp(s, "none") == 0)
+        return PB_CONTACTOR_NONE;
+
+    /* transition: handle 'with-feedback' as 'normally closed' */
+    if (strcasecmp(s, "with-feedback") == 0)
+        return PB_CONTACTOR_WITH_FEEDBACK_NC;
+
+    return PB_CONTACTOR_MAX;
+}
+
+const char *pb_contactor_type_to_str(const enum pb_contactor_type type)
+{
+    if (type >= PB_CONTACTOR_MAX)
+        return "invalid";
+
+    return contactor_type_to_string[type];
+}
+
+int pb_str_to_contactor_time(const char *s, uint8_t *time)
+{
+    char *endptr;
+    unsigned long val;
+
+    val = strtoul(s, &endptr, 10);
+
+    /* conversion failed: no valid int, or suffix not 'ms' (with possible single whitespace before) */
+    if (errno != 0 || endptr == s ||
+        !(strcmp(endptr, "ms") == 0 || strcmp(endptr, " ms") == 0))
+       return -1;
+
+    /* we store it as unsigned int with 10 ms resolution, so divide by 10 */
+    val /= 10;
+
+    /* (silently) clamp to range */
+    if (val > 255) val = 255;
+
+    *time = val;
+
+    return 0;
+}
+
+int pb_contactor_time_to_str(char *buffer, size_t size, int8_t time)
+{
+    return snprintf(buffer, size, "%u ms", time * 10);
+}
+
+int pb_str_to_rcm_time(const char *s, uint8_t *time)
+{
+    char *endptr;
+    unsigned long val;
+
+    val = strtoul(s, &endptr, 10);
+
+    /* conversion failed: no valid int, or suffix not 'ms' (with possible single whitespace before) */
+    if (errno != 0 || endptr == s ||
+        !(strcmp(endptr, "ms") == 0 || strcmp(endptr, " ms") == 0))
+       return -1;
+
+    /* we store it as unsigned int with 20 ms resolution, so divide by 20 */
+    val /= 20;
+
+    /* (silently) clamp to range */
+    if (val > 255) val = 255;
+
+    *time = val;
+
+    return 0;
+}
+
+int pb_rcm_time_to_str(char *buffer, size_t size, int8_t time)
+{
+    return snprintf(buffer, size, "%u ms", time * 20);
+}
+
+static const char *pin_polarity_to_string[PB_PIN_POLARITY_MAX] = {
+    "disabled",
+    "active-low",
+    "active-high",
+};
+
+enum pb_pin_polarity_type pb_str_to_pin_polarity_type(const char *s)
+{
+    unsigned int i;
+
+    for (i = PB_PIN_POLARITY_NONE; i < PB_PIN_POLARITY_MAX; ++i)
+        if (strcasecmp(s, pin_polarity_to_string[i]) == 0)
+            return i;
+
+    /* relaxed input handling: also accept 'disable', 'none' or 'off' */
+    if (strcasecmp(s, "disable") == 0 || strcasecmp(s, "none") == 0 || strcasecmp(s, "off") == 0)
+        return PB_PIN_POLARITY_NONE;
+
+    return PB_PIN_POLARITY_MAX;
+}
+
+const char *pb_pin_polarity_type_to_str(const enum pb_pin_polarity_type type)
+{
+    if (type >= PB_PIN_POLARITY_MAX)
+        return "invalid";
+
+    return pin_polarity_to_string[type];
+}
+
+/* this function is only used to short-circuit the configuration at this point
+ * to make it more human-readable; in other words, it is used to document that
+ * a given block does not have (sub-)properties and that means that it is
+ * only allowed to disable a functionality. anything else is considered an
+ * error (and would probably also be not valid YAML either). */
+int pb_str_to_disabled_flag(const char *s, bool *flag)
+{
+    char *endptr;
+
+    /* special case: disable[d], none or off */
+    if (strcasecmp(s, "disable") == 0 || strcasecmp(s, "disabled") == 0 ||
+        strcasecmp(s, "none") == 0 || strcasecmp(s, "off") == 0) {
+        *flag = false;
+        return 0;
+    }
+
+    return 1;
+}
+
+bool pb_is_pt1000_enabled(const struct param_block_v1 *param_block, unsigned char n)
+{
+    return param_block->temperature[n] != htole16(PB_CHANNEL_DISABLE_VALUE);
+}
+
+bool pb_is_contactor_enabled(const struct param_block_v1 *param_block, unsigned char n)
+{
+    return param_block->contactor_type[n] != PB_CONTACTOR_NONE;
+}
+
+bool pb_is_rcm_enabled(const struct param_block_v2 *param_block)
+{
+    return param_block->rcm_fault_polarity != PB_PIN_POLARITY_NONE &&
+           param_block->rcm_test_polarity != PB_PIN_POLARITY_NONE;
+}
+
+void pb_refresh_crc_v1(struct param_block_v1 *param_block)
+{
+    param_block->crc = pb_crc8((const uint8_t *)param_block, sizeof(*param_block) - 1);
+}
+
+void pb_refresh_crc_v2(struct param_block_v2 *param_block)
+{
+    param_block->crc = pb_crc8((const uint8_t *)param_block, sizeof(*param_block) - 1);
+}
+
+static bool pb_check_unversioned_param_block_crc(const struct unversioned_param_block *param_block)
+{
+    return param_block->crc == pb_crc8((const uint8_t *)param_block, sizeof(*param_block) - 1);
+}
+
+bool pb_check_crc_v1(const struct param_block_v1 *param_block)
+{
+    return param_block->crc == pb_crc8((const uint8_t *)param_block, sizeof(*param_block) - 1);
+}
+
+bool pb_check_crc_v2(const struct param_block_v2 *param_block)
+{
+    return param_block->crc == pb_crc8((const uint8_t *)param_block, sizeof(*param_block) - 1);
+}
+
+void pb_init_v1(struct param_block_v1 *param_block)
+{
+    int i;
+
+    memset(param_block, 0, sizeof(*param_block));
+
+    param_block->sob = htole32(PB_MARKER);
+    param_block->eob = htole32(PB_MARKER);
+
+    param_block->version = 1;
+
+    for (i = 0; i < ARRAY_SIZE(param_block->temperature); i++)
+        param_block->temperature[i] = htole16(PB_CHANNEL_DISABLE_VALUE);
+
+    pb_refresh_crc_v1(param_block);
+}
+
+/* the YAML representation is either printed to a stream or formatted into a buffer */
+struct pb_writer {
+    FILE *f;
+
+    char *buffer;
+    size_t size;
+    size_t len; /* what the complete output needs, might be more than size */
+};
+
+static void pb_printf(struct pb_writer *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void pb_printf(struct pb_writer *w, const char *fmt, ...)
+{
+    va_list ap;
+    int rv;
+
+    va_start(ap, fmt);
+
+    if (w->f) {
+        vfprintf(w->f, fmt, ap);
+    } else {
+        /* once the buffer is exhausted, only the required length is determined */
+        if (w->len < w->size)
+            rv = vsnprintf(w->buffer + w->len, w->size - w->len, fmt, ap);
+        else
+            rv = vsnprintf(NULL, 0, fmt, ap);
+
+        if (rv > 0)
+            w->len += rv;
+    }
+
+    va_end(ap);
+}
+
+static void pb_dump_v1(struct pb_writer *w, const struct param_block_v1 *param_block)
+{
+    char buffer[32];
+    int i;
+
+    pb_printf(w, "pt1000s:\n");
+    for (i = 0; i < ARRAY_SIZE(param_block->temperature); i++) {
+        pb_temperature_to_str(buffer, sizeof(buffer), param_block->temperature[i]);
+
+        if (pb_is_pt1000_enabled(param_block, i)) {
+            pb_printf(w, "  - abort-temperature: %s\n", buffer);
+
+            pb_resistance_offset_to_str(buffer, sizeof(buffer), param_block->temperature_resistance_offset[i]);
+            pb_printf(w, "    resistance-offset: %s\n", buffer);
+        } else {
+            pb_printf(w, "  - %s\n", buffer);
+        }
+    }
+    pb_printf(w, "\n");
+
+    pb_printf(w, "contactors:\n");
+    for (i = 0; i < ARRAY_SIZE(param_block->contactor_type); i++) {
+        if (pb_is_contactor_enabled(param_block, i)) {
+            pb_printf(w, "  - type: %s\n", pb_contactor_type_to_str(param_block->contactor_type[i]));
+
+            pb_contactor_time_to_str(buffer, sizeof(buffer), param_block->contactor_close_time[i]);
+            pb_printf(w, "    close-time: %s\n", buffer);
+
+            pb_contactor_time_to_str(buffer, sizeof(buffer), param_block->contactor_open_time[i]);
+            pb_printf(w, "    open-time: %s\n", buffer);
+        } else {
+            pb_printf(w, "  - %s\n", pb_contactor_type_to_str(param_block->contactor_type[i]));
+        }
+    }
+
+    pb_printf(w, "\n");
+
+    pb_printf(w, "estops:\n");
+    for (i = 0; i < ARRAY_SIZE(param_block->estop); i++)
+        pb_printf(w, "  - %s\n", pb_pin_polarity_type_to_str(param_block->estop[i]));
+}
+
+void pb_init_v2(struct param_block_v2 *param_block)
+{
+    int i;
+
+    memset(param_block, 0, sizeof(*param_block));
+
+    param_block->sob = htole32(PB_MARKER);
+    param_block->eob = htole32(PB_MARKER);
+
+    param_block->version = 2;
+
+    for (i = 0; i < ARRAY_SIZE(param_block->temperature); i++)
+        param_block->temperature[i] = htole16(PB_CHANNEL_DISABLE_VALUE);
+
+    pb_refresh_crc_v2(param_block);
+}
+
+static void pb_dump_v2(struct pb_writer *w, const struct param_block_v2 *param_block)
+{
+    char buffer[32];
+
+    if (pb_is_rcm_enabled(param_block)) {
+        pb_printf(w, "rcm:\n");
+        pb_printf(w, "  fault-polarity: %s\n", pb_pin_polarity_type_to_str(param_block->rcm_fault_polarity));
+        pb_printf(w, "  test-polarity: %s\n", pb_pin_polarity_type_to_str(param_block->rcm_test_polarity));
+
+        pb_rcm_time_to_str(buffer, sizeof(buffer), param_block->rcm_test_trigger_time);
+        pb_printf(w, "  test-trigger-time: %s\n", buffer);
+
+        pb_rcm_time_to_str(buffer, sizeof(buffer), param_block->rcm_test_check_tripped_time);
+        pb_printf(w, "  test-check-tripped-time: %s\n", buffer);
+
+        pb_rcm_time_to_str(buffer, sizeof(buffer), param_block->rcm_test_check_normal_time);
+        pb_printf(w, "  test-check-normal-time: %s\n", buffer);
+    } else {
+        pb_printf(w, "rcm: disabled\n");
+    }
+}
+
+void pb_init(struct param_block_v2 *param_block)
+{
+    pb_init_v2(param_block);
+}
+
+const char *pb_validate(const struct param_block_v2 *param_block)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(param_block->contactor_type); i++)
+        if (param_block->contactor_type[i] >= PB_CONTACTOR_MAX)
+            return "invalid contactor type";
+
+    for (i = 0; i < ARRAY_SIZE(param_block->estop); i++)
+        if (param_block->estop[i] >= PB_PIN_POLARITY_MAX)
+            return "invalid estop pin polarity";
+
+    if (param_block->rcm_fault_polarity >= PB_PIN_POLARITY_MAX || param_block->rcm_test_polarity >= PB_PIN_POLARITY_MAX)
+        return "invalid RCM pin polarity";
+
+    /* check RCM configuration for plausibility */
+    if (param_block->rcm_fault_polarity == PB_PIN_POLARITY_NONE && param_block->rcm_test_polarity != PB_PIN_POLARITY_NONE)
+        return "invalid RCM pin polarity configuration: RCM fault pin polarity is also required";
+
+    if (param_block->rcm_fault_polarity != PB_PIN_POLARITY_NONE) {
+        if (param_block->rcm_test_polarity == PB_PIN_POLARITY_NONE)
+            return "invalid RCM pin polarity configuration: RCM test pin polarity is required";
+        if (param_block->rcm_test_trigger_time == 0)
+            return "invalid RCM timing: test-trigger-time must not be zero";
+        if (param_block->rcm_test_check_tripped_time == 0)
+            return "invalid RCM timing: test-check-tripped-time must not be zero";
+        if (param_block->rcm_test_check_normal_time == 0)
+            return "invalid RCM timing: test-check-normal-time must not be zero";
+    }
+
+    return NULL;
+}
+
+static void pb_dump_all(struct pb_writer *w, const struct param_block_v2 *param_block)
+{
+    pb_printf(w, "version: %u\n", param_block->version);
+    pb_printf(w, "\n");
+
+    pb_dump_v1(w, (const struct param_block_v1 *)param_block);
+
+    if (param_block->version >= 2) {
+        pb_printf(w, "\n");
+        pb_dump_v2(w, param_block);
+    }
+}
+
+void pb_dump(const struct param_block_v2 *param_block)
+{
+    struct pb_writer w = { .f = stdout };
+
+    pb_dump_all(&w, param_block);
+}
+
+size_t pb_format_yaml(char *buffer, size_t size, const struct param_block_v2 *param_block)
+{
+    struct pb_writer w = { .buffer = buffer, .size = size };
+
+    if (size > 0)
+        buffer[0] = '\0';
+
+    pb_dump_all(&w, param_block);
+
+    return w.len;
+}
+
+static void pb_migrate_unversioned_to_v1(struct unversioned_param_block *old, struct param_block_v1 *new)
+{
+    int i;
+
+    /* we assume and rely on that the new parameter block has enough space */
+    memcpy(new->temperature, old->temperature, sizeof(new->temperature));
+    memcpy(new->contactor_type, old->contactor, sizeof(old->contactor));
+    memcpy(new->estop, old->estop, sizeof(old->estop));
+
+    /* old version only supported CONTACTOR_WITH_FEEDBACK which is now PB_CONTACTOR_WITH_FEEDBACK_NO but
+     * we migrate it to PB_CONTACTOR_WITH_FEEDBACK_NC since this is the documented and recommended setting
+     * note: we iterate over the size of the old array but modify the new one
+     */
+    for (i = 0; i < ARRAY_SIZE(old->contactor); i++)
+        if (old->contactor[i] == PB_CONTACTOR_WITH_FEEDBACK_NO)
+            new->contactor_type[i] = PB_CONTACTOR_WITH_FEEDBACK_NC;
+
+    pb_refresh_crc_v1(new);
+}
+
+static void pb_migrate_v1_to_v2(struct param_block_v1 *old, struct param_block_v2 *new)
+{
+    /* copy the whole data block from v1 to v2 which has the same structure */
+    memcpy(&new->temperature, &old->temperature,
+           offsetof(struct param_block_v1, eob) - offsetof(struct param_block_v1, temperature));
+
+    pb_refresh_crc_v2(new);
+}
+
+int pb_parse(const uint8_t *buf, size_t len, struct param_block_v2 *param_block, enum pb_layout *layout)
+{
+    struct unversioned_param_block pb_unversioned;
+    struct param_block_v1 pb_v1;
+
+    /* try the older, smaller parameter block first */
+    if (len < sizeof(pb_unversioned))
+        return -1;
+    memcpy(&pb_unversioned, buf, sizeof(pb_unversioned));
+
+    /* we have to check the parameter block in order due to backwards compatibility */
+
+    /* check whether parameter block has expected magic value at the beginning */
+    if (pb_unversioned.sob != htole32(PB_MARKER))
+        return PB_READ_ERROR_MAGIC;
+
+    /* if the second marker also matches, then this is probably an old version */
+    if (pb_unversioned.eob == htole32(PB_MARKER)) {
+        if (layout)
+            *layout = PB_LAYOUT_UNVERSIONED;
+
+        /* let's migrate it without prior looking at the CRC */
+        pb_init_v1(&pb_v1);
+        pb_migrate_unversioned_to_v1(&pb_unversioned, &pb_v1);
+
+        pb_init_v2(param_block);
+        pb_migrate_v1_to_v2(&pb_v1, param_block);
+
+        /* check CRC */
+        if (!pb_check_unversioned_param_block_crc(&pb_unversioned))
+            return PB_READ_ERROR_CRC;
+
+        return 0;
+    }
+
+    /* looks not like an old (unversioned) parameter block, try the v1 size */
+    if (len < sizeof(pb_v1))
+        return -1;
+    memcpy(&pb_v1, buf, sizeof(pb_v1));
+
+    /* now let's check whether the second marker matches for v1 and the version number indicates v1 */
+    if (pb_v1.eob == htole32(PB_MARKER) && pb_v1.version == 1) {
+        if (layout)
+            *layout = PB_LAYOUT_V1;
+
+        /* let's migrate it without prior looking at the CRC */
+        pb_init_v2(param_block);
+        pb_migrate_v1_to_v2(&pb_v1, param_block);
+
+        /* check CRC */
+        if (!pb_check_crc_v1(&pb_v1))
+            return PB_READ_ERROR_CRC;
+
+        return 0;
+    }
+
+    /* looks not like an older parameter block, try the current size */
+    if (len < sizeof(*param_block))
+        return -1;
+    memcpy(param_block, buf, sizeof(*param_block));
+
+    /* now check the second magic value */
+    if (param_block->eob != htole32(PB_MARKER))
+        return PB_READ_ERROR_MAGIC;
+
+    if (layout)
+        *layout = PB_LAYOUT_V2;
+
+    /* check CRC */
+    if (!pb_check_crc_v2(param_block))
+        return PB_READ_ERROR_CRC;
+
+    return 0;
+}
+
+int pb_read(FILE *f, struct param_block_v2 *param_block)
+{
+    uint8_t buf[sizeof(*param_block)];
+    size_t len;
+
+    /* read as much as the largest layout needs, older (smaller) ones are detected in the data */
+    len = fread(buf, 1, sizeof(buf), f);
+    if (ferror(f))
+        return -1;
+
+    return pb_parse(buf, len, param_block, NULL);
+}
+
+int pb_encode(const struct param_block_v2 *param_block, uint8_t *buf, size_t size)
+{
+    struct param_block_v2 *out = (struct param_block_v2 *)buf;
+
+    if (size < sizeof(*param_block))
+        return -1;
+
+    memcpy(buf, param_block, sizeof(*param_block));
+    out->crc = pb_crc8(buf, sizeof(*param_block) - 1);
+
+    return sizeof(*param_block);
+}
+
+int pb_write(struct param_block_v2 *param_block, FILE *f)
+{
+    pb_refresh_crc_v2(param_block);
+
+    if (fwrite(param_block, sizeof(*param_block), 1, f) != 1)
+        return -1;
+
+    return 0;
+}
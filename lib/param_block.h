@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2024 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "cb_protocol.h"
+
+#define PB_MARKER 0xC001F00D
+#define PB_CHANNEL_DISABLE_VALUE 0x1fff
+#define PB_OLD_CHANNEL_DISABLE_VALUE 0x8000
+
+/* pre-versioned parameter block structure */
+struct unversioned_param_block {
+    uint32_t sob;
+    int16_t temperature[4]; // use fixed sizes here since this version will not change anymore
+    uint8_t contactor[2]; // this version only supports 2 contactors
+    uint8_t estop[3]; // use fixed sizes here since this version will not change anymore
+    uint32_t eob;
+    uint8_t crc;
+} __attribute__((packed));
+
+struct param_block_v1 {
+    uint32_t sob;
+
+    uint16_t version;
+
+    int16_t temperature[CB_PROTO_MAX_PT1000S];
+    int16_t temperature_resistance_offset[CB_PROTO_MAX_PT1000S]; // offset for temperature sensor resistance in 10mOhm
+
+    uint8_t contactor_type[CB_PROTO_MAX_CONTACTORS];
+    uint8_t contactor_close_time[CB_PROTO_MAX_CONTACTORS]; // close time for HV contactor in multiples of 10ms
+    uint8_t contactor_open_time[CB_PROTO_MAX_CONTACTORS]; // open time for HV contactor in multiples of 10ms
+
+    uint8_t estop[CB_PROTO_MAX_ESTOPS];
+    uint32_t eob;
+    uint8_t crc;
+} __attribute__((packed));
+
+/* latest parameter version this code understands */
+#define PARAMETER_BLOCK_VERSION 2
+
+struct param_block_v2 {
+    uint32_t sob;
+
+    uint16_t version;
+
+    int16_t temperature[CB_PROTO_MAX_PT1000S];
+    int16_t temperature_resistance_offset[CB_PROTO_MAX_PT1000S]; // offset for temperature sensor resistance in 10mOhm
+
+    uint8_t contactor_type[CB_PROTO_MAX_CONTACTORS];
+    uint8_t contactor_close_time[CB_PROTO_MAX_CONTACTORS]; // close time for HV contactor in multiples of 10ms
+    uint8_t contactor_open_time[CB_PROTO_MAX_CONTACTORS]; // open time for HV contactor in multiples of 10ms
+
+    uint8_t estop[CB_PROTO_MAX_ESTOPS];  // 0 = disabled, 1 = active-low, 2 = active-high
+
+    uint8_t rcm_fault_polarity; // 0 = disabled, 1 = active-low, 2 = active-high
+    uint8_t rcm_test_polarity; // 0 = disabled, 1 = active-low, 2 = active-high
+    uint8_t rcm_test_trigger_time; // time to hold the test trigger output in multiples of 20ms
+    uint8_t rcm_test_check_tripped_time; // time to check feedback pin for TRIPPPED after test start, in multiples of 20ms
+    uint8_t rcm_test_check_normal_time; // time to check feedback pin for NORMAL after trigger was released, in multiples of 20ms
+
+    uint32_t eob;
+    uint8_t crc;
+} __attribute__((packed));
+
+
+enum pb_contactor_type {
+    PB_CONTACTOR_NONE = 0,
+    PB_CONTACTOR_WITHOUT_FEEDBACK,
+    PB_CONTACTOR_WITH_FEEDBACK_NO,
+    PB_CONTACTOR_WITH_FEEDBACK_NC,
+    PB_CONTACTOR_MAX,
+};
+
+enum pb_pin_polarity_type {
+    PB_PIN_POLARITY_NONE = 0,
+    PB_PIN_POLARITY_ACTIVE_LOW,
+    PB_PIN_POLARITY_ACTIVE_HIGH,
+    PB_PIN_POLARITY_MAX,
+};
+
+int pb_str_to_version(const char *s, uint16_t *version);
+int pb_version_to_str(char *buffer, size_t size, uint16_t version);
+
+int pb_str_to_temperature(const char *s, int16_t *temperature);
+int pb_temperature_to_str(char *buffer, size_t size, int16_t temperature);
+
+int pb_str_to_resistance_offset(const char *s, int16_t *offset);
+int pb_resistance_offset_to_str(char *buffer, size_t size, int16_t offset);
+
+enum pb_contactor_type pb_str_to_contactor_type(const char *s);
+const char *pb_contactor_type_to_str(const enum pb_contactor_type type);
+
+int pb_str_to_contactor_time(const char *s, uint8_t *time);
+int pb_contactor_time_to_str(char *buffer, size_t size, int8_t time);
+
+int pb_str_to_rcm_time(const char *s, uint8_t *time);
+int pb_rcm_time_to_str(char *buffer, size_t size, int8_t time);
+
+enum pb_pin_polarity_type pb_str_to_pin_polarity_type(const char *s);
+const char *pb_pin_polarity_type_to_str(const enum pb_pin_polarity_type type);
+
+int pb_str_to_disabled_flag(const char *s, bool *flag);
+
+bool pb_is_pt1000_enabled(const struct param_block_v1 *param_block, unsigned char n);
+bool pb_is_contactor_enabled(const struct param_block_v1 *param_block, unsigned char n);
+
+bool pb_is_rcm_enabled(const struct param_block_v2 *param_block);
+
+void pb_refresh_crc_v1(struct param_block_v1 *param_block);
+void pb_refresh_crc_v2(struct param_block_v2 *param_block);
+
+/* returns true if the CRC is correct */
+bool pb_check_crc_v1(const struct param_block_v1 *param_block);
+bool pb_check_crc_v2(const struct param_block_v2 *param_block);
+
+void pb_init_v1(struct param_block_v1 *param_block);
+void pb_init_v2(struct param_block_v2 *param_block);
+
+void pb_init(struct param_block_v2 *param_block);
+
+/* checks the settings of a parameter block for plausibility (not the CRC);
+ * returns NULL if fine, or a description of the first problem found
+ */
+const char *pb_validate(const struct param_block_v2 *param_block);
+
+/* print the YAML representation of the parameter block to stdout */
+void pb_dump(const struct param_block_v2 *param_block);
+
+/* the same into the given buffer which is always terminated (if size > 0);
+ * returns the length of the complete representation like snprintf, so the buffer
+ * was too small if the return value is >= size
+ */
+size_t pb_format_yaml(char *buffer, size_t size, const struct param_block_v2 *param_block);
+
+/* error return values for pb_read */
+#define PB_READ_SUCCESS     0
+#define PB_READ_ERROR_MAGIC 1
+#define PB_READ_ERROR_CRC   2
+
+/* the original layout of a parameter block, older ones are migrated when reading */
+enum pb_layout {
+    PB_LAYOUT_UNVERSIONED = 0,
+    PB_LAYOUT_V1,
+    PB_LAYOUT_V2,
+    PB_LAYOUT_MAX,
+};
+
+/* returns 0 on success, -1 on generic error, or one of the PB_READ_... values above */
+int pb_read(FILE *f, struct param_block_v2 *param_block);
+
+/* the same for a memory buffer, e.g. a data flash dump (-1 means that the buffer is too short);
+ * layout (if not NULL) returns the detected original layout unless the markers do not match
+ */
+int pb_parse(const uint8_t *buf, size_t len, struct param_block_v2 *param_block, enum pb_layout *layout);
+
+/* store the parameter block with a freshly calculated CRC into the given buffer (the passed
+ * block is not modified); returns the count of bytes written, or -1 if the buffer is too small
+ */
+int pb_encode(const struct param_block_v2 *param_block, uint8_t *buf, size_t size);
+
+/* refreshes the CRC of the passed block and writes it to the given file */
+int pb_write(struct param_block_v2 *param_block, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,7 +6,7 @@
 #include <stdio.h>
 #include "param_block_crc8.h"
 
-static uint8_t crc8_table[256] = {
+static const uint8_t crc8_table[256] = {
     0x00, 0x2f, 0x5e, 0x71, 0xbc, 0x93, 0xe2, 0xcd, 0x57, 0x78, 0x09, 0x26, 0xeb, 0xc4, 0xb5, 0x9a,
     0xae, 0x81, 0xf0, 0xdf, 0x12, 0x3d, 0x4c, 0x63, 0xf9, 0xd6, 0xa7, 0x88, 0x45, 0x6a, 0x1b, 0x34,
     0x73, 0x5c, 0x2d, 0x02, 0xcf, 0xe0, 0x91, 0xbe, 0x24, 0x0b, 0x7a, 0x55, 0x98, 0xb7, 0xc6, 0xe9,
@@ -25,7 +25,7 @@ static uint8_t crc8_table[256] = {
     0xd8, 0xf7, 0x86, 0xa9, 0x64, 0x4b, 0x3a, 0x15, 0x8f, 0xa0, 0xd1, 0xfe, 0x33, 0x1c, 0x6d, 0x42
 };
 
-uint8_t crc8(uint8_t *p, size_t len)
+uint8_t pb_crc8(const uint8_t *p, size_t len)
 {
     const uint8_t *ptr = p;
     uint8_t _crc = 0xff;
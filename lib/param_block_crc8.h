@@ -0,0 +1,19 @@
+/*
+ * Copyright © 2025 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-8 as used by the firmware for the parameter block */
+uint8_t pb_crc8(const uint8_t *p, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
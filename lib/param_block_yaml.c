@@ -0,0 +1,532 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <yaml.h>
+#include "param_block.h"
+#include "param_block_yaml.h"
+
+#define PRINT_EVENT(f, indent, type, start_end) \
+        fprintf((f), "%*s%s %s\n", (indent) * 2, "", (type), (start_end))
+
+/* the indent is passed by reference, so that concurrent parsers do not share it */
+static void print_event_type(FILE *diag, int *indent, yaml_event_type_t type)
+{
+    switch (type) {
+    case YAML_STREAM_START_EVENT:   PRINT_EVENT(diag, (*indent)++, "Stream", "start"); break;
+    case YAML_STREAM_END_EVENT:     PRINT_EVENT(diag, --(*indent), "Stream", "end"); break;
+    case YAML_DOCUMENT_START_EVENT: PRINT_EVENT(diag, (*indent)++, "Document", "start"); break;
+    case YAML_DOCUMENT_END_EVENT:   PRINT_EVENT(diag, --(*indent), "Document", "end"); break;
+    case YAML_MAPPING_START_EVENT:  PRINT_EVENT(diag, (*indent)++, "Mapping", "start"); break;
+    case YAML_MAPPING_END_EVENT:    PRINT_EVENT(diag, --(*indent), "Mapping", "end"); break;
+    case YAML_SEQUENCE_START_EVENT: PRINT_EVENT(diag, (*indent)++, "Sequence", "start"); break;
+    case YAML_SEQUENCE_END_EVENT:   PRINT_EVENT(diag, --(*indent), "Sequence", "end"); break;
+    case YAML_SCALAR_EVENT:         /* Handled below */ break;
+    default: fprintf(diag, "%*sOther event: %d\n", *indent * 2, "", type); break;
+    }
+}
+
+enum param_block_state {
+    PBS_NONE,
+    PBS_VERSION,
+    PBS_PT1000S, /* in the array */
+    PBS_PT1000,  /* in a specific array item */
+    PBS_PT1000_TEMP,
+    PBS_PT1000_OFFSET,
+    PBS_CONTACTORS, /* in the array */
+    PBS_CONTACTOR, /* in a specific array item */
+    PBS_CONTACTOR_TYPE,
+    PBS_CONTACTOR_CLOSE_TIME,
+    PBS_CONTACTOR_OPEN_TIME,
+    PBS_ESTOPS,
+    PBS_RCM_SCALAR,
+    PBS_RCM_MAPPING,
+    PBS_RCM_FAULT_POLARITY,
+    PBS_RCM_TEST_POLARITY,
+    PBS_RCM_TRIGGER_TIME,
+    PBS_RCM_CHECK_TRIPPED_TIME,
+    PBS_RCM_CHECK_NORMAL_TIME,
+    PBS_MAX,
+};
+
+static const char *param_block_state_str[PBS_MAX] = {
+    "PBS_NONE",
+    "PBS_VERSION",
+    "PBS_PT1000S",
+    "PBS_PT1000",
+    "PBS_PT1000_TEMP",
+    "PBS_PT1000_OFFSET",
+    "PBS_CONTACTORS",
+    "PBS_CONTACTOR",
+    "PBS_CONTACTOR_TYPE",
+    "PBS_CONTACTOR_CLOSE_TIME",
+    "PBS_CONTACTOR_OPEN_TIME",
+    "PBS_ESTOPS",
+    "PBS_RCM_SCALAR",
+    "PBS_RCM_MAPPING",
+    "PBS_RCM_FAULT_POLARITY",
+    "PBS_RCM_TEST_POLARITY",
+    "PBS_RCM_TRIGGER_TIME",
+    "PBS_RCM_CHECK_TRIPPED_TIME",
+    "PBS_RCM_CHECK_NORMAL_TIME",
+};
+
+int pb_yaml_parse_document(yaml_parser_t *parser, struct param_block_v2 *param_block, FILE *diag, bool debug)
+{
+    enum param_block_state param_block_state = PBS_NONE;
+    yaml_event_t event;
+    bool in_document = false;
+    bool content_error = false;
+    int indent = 0;
+    int current_temperature_idx = -1;
+    int current_contactor_idx = -1;
+    int current_estop_idx = -1;
+    bool parsing_done = false;
+    uint16_t tmp_u16;
+    int16_t tmp_i16;
+    bool rcm_config = false;
+    const char *problem;
+
+    pb_init(param_block);
+
+    while (!parsing_done) {
+        /* the caller reports the problem, it knows the position of the stream within the file */
+        if (!yaml_parser_parse(parser, &event))
+            return PB_YAML_ERROR_SYNTAX;
+
+        /* after an error, the remaining events of the document are only consumed */
+        if (content_error &&
+            event.type != YAML_DOCUMENT_END_EVENT &&
+            event.type != YAML_STREAM_END_EVENT &&
+            event.type != YAML_NO_EVENT) {
+            yaml_event_delete(&event);
+            continue;
+        }
+
+        if (debug) {
+            print_event_type(diag, &indent, event.type);
+
+            if (event.type == YAML_SCALAR_EVENT) {
+                PRINT_EVENT(diag, indent, "Scalar:", event.data.scalar.value);
+                fprintf(diag, "%*sparam_block_state: %s\n", indent * 2, "", param_block_state_str[param_block_state]);
+            }
+        }
+
+        switch (event.type) {
+        case YAML_SEQUENCE_END_EVENT:
+            switch (param_block_state) {
+            case PBS_PT1000S:
+            case PBS_CONTACTORS:
+            case PBS_ESTOPS:
+                param_block_state = PBS_NONE;
+                break;
+            default:
+                /* nothing */;
+            }
+            break;
+
+        case YAML_MAPPING_START_EVENT:
+            switch (param_block_state) {
+            case PBS_PT1000S:
+                param_block_state = PBS_PT1000;
+                current_temperature_idx++;
+                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1) {
+                    /* we only warn when more values than allowed are given */
+                    fprintf(diag, "Warning: ignoring surplus temperature value (#%u)\n",
+                            current_temperature_idx + 1);
+                }
+                break;
+            case PBS_CONTACTORS:
+                param_block_state = PBS_CONTACTOR;
+                current_contactor_idx++;
+                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1) {
+                    /* we only warn when more values than allowed are given */
+                    fprintf(diag, "Warning: ignoring surplus contactor configuration (#%u)\n",
+                            current_contactor_idx + 1);
+                }
+                break;
+            case PBS_RCM_SCALAR:
+                param_block_state = PBS_RCM_MAPPING;
+                break;
+
+            default:
+                /* nothing */;
+            }
+            break;
+
+        case YAML_MAPPING_END_EVENT:
+            switch (param_block_state) {
+            case PBS_PT1000:
+                param_block_state = PBS_PT1000S;
+                break;
+            case PBS_CONTACTOR:
+                param_block_state = PBS_CONTACTORS;
+                break;
+            case PBS_RCM_MAPPING:
+                param_block_state = PBS_RCM_SCALAR;
+                break;
+
+            default:
+                /* nothing */;
+            }
+            break;
+
+        case YAML_SCALAR_EVENT:
+            switch (param_block_state) {
+            case PBS_NONE:
+                if (strcasecmp(event.data.scalar.value, "version") == 0)
+                    param_block_state = PBS_VERSION;
+                else if (strcasecmp(event.data.scalar.value, "pt1000s") == 0)
+                    param_block_state = PBS_PT1000S;
+                else if (strcasecmp(event.data.scalar.value, "contactors") == 0)
+                    param_block_state = PBS_CONTACTORS;
+                else if (strcasecmp(event.data.scalar.value, "estops") == 0)
+                    param_block_state = PBS_ESTOPS;
+                else if (strcasecmp(event.data.scalar.value, "rcm") == 0)
+                    param_block_state = PBS_RCM_SCALAR;
+                break;
+            case PBS_VERSION:
+                param_block_state = PBS_NONE;
+                if (pb_str_to_version(event.data.scalar.value, &tmp_u16)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a version value (allowed range: 1-%" PRIu16 ")\n",
+                            event.data.scalar.value, UINT16_MAX);
+                    content_error = true;
+                    break;
+                }
+                param_block->version = tmp_u16;
+                if (param_block->version != PARAMETER_BLOCK_VERSION) {
+                    fprintf(diag, "Warning: setting version to %" PRIu16 ", but file structure is version %u\n",
+                            param_block->version, PARAMETER_BLOCK_VERSION);
+                }
+                break;
+            case PBS_PT1000:
+                if (strcasecmp(event.data.scalar.value, "abort-temperature") == 0)
+                    param_block_state = PBS_PT1000_TEMP;
+                else if (strcasecmp(event.data.scalar.value, "resistance-offset") == 0)
+                    param_block_state = PBS_PT1000_OFFSET;
+                break;
+            case PBS_PT1000S:
+                current_temperature_idx++;
+                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1) {
+                    /* we only warn when more values than allowed are given */
+                    fprintf(diag, "Warning: ignoring surplus temperature value (#%u): %s\n",
+                            current_temperature_idx + 1, event.data.scalar.value);
+                    break;
+                }
+                if (pb_str_to_temperature(event.data.scalar.value, &tmp_i16)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a temperature value. Unit (°C) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                param_block->temperature[current_temperature_idx] = tmp_i16;
+                break;
+            case PBS_PT1000_TEMP:
+                param_block_state = PBS_PT1000;
+                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1)
+                    break;
+                if (pb_str_to_temperature(event.data.scalar.value, &tmp_i16)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a temperature value. Unit (°C) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                param_block->temperature[current_temperature_idx] = tmp_i16;
+                break;
+            case PBS_PT1000_OFFSET:
+                param_block_state = PBS_PT1000;
+                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1)
+                    break;
+                if (pb_str_to_resistance_offset(event.data.scalar.value, &tmp_i16)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a temperature resistance offset. Unit (Ω) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                param_block->temperature_resistance_offset[current_temperature_idx] = tmp_i16;
+                break;
+            case PBS_CONTACTOR:
+                if (strcasecmp(event.data.scalar.value, "type") == 0)
+                    param_block_state = PBS_CONTACTOR_TYPE;
+                else if (strcasecmp(event.data.scalar.value, "close-time") == 0)
+                    param_block_state = PBS_CONTACTOR_CLOSE_TIME;
+                else if (strcasecmp(event.data.scalar.value, "open-time") == 0)
+                    param_block_state = PBS_CONTACTOR_OPEN_TIME;
+                break;
+            case PBS_CONTACTORS:
+                current_contactor_idx++;
+                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1) {
+                    /* we only warn when more values than allowed are given */
+                    fprintf(diag, "Warning: ignoring surplus contactor configuration (#%u): %s\n",
+                            current_contactor_idx + 1, event.data.scalar.value);
+                    break;
+                }
+                param_block->contactor_type[current_contactor_idx] =
+                    pb_str_to_contactor_type(event.data.scalar.value);
+                if (param_block->contactor_type[current_contactor_idx] == PB_CONTACTOR_MAX) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a contactor configuration.\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_CONTACTOR_TYPE:
+                param_block_state = PBS_CONTACTOR;
+                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
+                    break;
+                param_block->contactor_type[current_contactor_idx] =
+                    pb_str_to_contactor_type(event.data.scalar.value);
+                if (param_block->contactor_type[current_contactor_idx] == PB_CONTACTOR_MAX) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a contactor type configuration.\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_CONTACTOR_CLOSE_TIME:
+                param_block_state = PBS_CONTACTOR;
+                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
+                    break;
+                if (pb_str_to_contactor_time(event.data.scalar.value, &param_block->contactor_close_time[current_contactor_idx])) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid contactor close time. Unit (ms) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_CONTACTOR_OPEN_TIME:
+                param_block_state = PBS_CONTACTOR;
+                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
+                    break;
+                if (pb_str_to_contactor_time(event.data.scalar.value, &param_block->contactor_open_time[current_contactor_idx])) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid contactor open time. Unit (ms) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_ESTOPS:
+                current_estop_idx++;
+                if (current_estop_idx > CB_PROTO_MAX_ESTOPS - 1) {
+                    /* we only warn when more values than allowed are given */
+                    fprintf(diag, "Warning: ignoring surplus estop configuration (#%u): %s\n",
+                            current_estop_idx + 1, event.data.scalar.value);
+                    break;
+                }
+                param_block->estop[current_estop_idx] =
+                    pb_str_to_pin_polarity_type(event.data.scalar.value);
+                if (param_block->estop[current_estop_idx] == PB_PIN_POLARITY_MAX) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a estop configuration.\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_SCALAR:
+                param_block_state = PBS_NONE;
+                if (pb_str_to_disabled_flag(event.data.scalar.value, &rcm_config)) {
+                    fprintf(diag, "Error: Value '%s' not allowed in this context (expected a 'disabled' flag)\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_MAPPING:
+                if (strcasecmp(event.data.scalar.value, "fault-polarity") == 0)
+                    param_block_state = PBS_RCM_FAULT_POLARITY;
+                else if (strcasecmp(event.data.scalar.value, "test-polarity") == 0)
+                    param_block_state = PBS_RCM_TEST_POLARITY;
+                else if (strcasecmp(event.data.scalar.value, "test-trigger-time") == 0)
+                    param_block_state = PBS_RCM_TRIGGER_TIME;
+                else if (strcasecmp(event.data.scalar.value, "test-check-tripped-time") == 0)
+                    param_block_state = PBS_RCM_CHECK_TRIPPED_TIME;
+                else if (strcasecmp(event.data.scalar.value, "test-check-normal-time") == 0)
+                    param_block_state = PBS_RCM_CHECK_NORMAL_TIME;
+                break;
+            case PBS_RCM_FAULT_POLARITY:
+                param_block_state = PBS_RCM_MAPPING;
+                param_block->rcm_fault_polarity = pb_str_to_pin_polarity_type(event.data.scalar.value);
+                if (param_block->rcm_fault_polarity == PB_PIN_POLARITY_MAX) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid pin configuration for RCM fault pin.\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_TEST_POLARITY:
+                param_block_state = PBS_RCM_MAPPING;
+                param_block->rcm_test_polarity = pb_str_to_pin_polarity_type(event.data.scalar.value);
+                if (param_block->rcm_test_polarity == PB_PIN_POLARITY_MAX) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid pin configuration for RCM test pin.\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_TRIGGER_TIME:
+                param_block_state = PBS_RCM_MAPPING;
+                if (pb_str_to_rcm_time(event.data.scalar.value, &param_block->rcm_test_trigger_time)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid RCM test trigger time. Unit (ms) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_CHECK_TRIPPED_TIME:
+                param_block_state = PBS_RCM_MAPPING;
+                if (pb_str_to_rcm_time(event.data.scalar.value, &param_block->rcm_test_check_tripped_time)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid time for RCM tripped check. Unit (ms) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            case PBS_RCM_CHECK_NORMAL_TIME:
+                param_block_state = PBS_RCM_MAPPING;
+                if (pb_str_to_rcm_time(event.data.scalar.value, &param_block->rcm_test_check_normal_time)) {
+                    fprintf(diag, "Error: Cannot convert '%s' to a valid time for RCM normal check. Unit (ms) missing or wrong whitespace?\n",
+                            event.data.scalar.value);
+                    content_error = true;
+                    break;
+                }
+                break;
+            }
+            break;
+
+        case YAML_DOCUMENT_START_EVENT:
+            in_document = true;
+            break;
+
+        case YAML_DOCUMENT_END_EVENT:
+            parsing_done = true;
+            break;
+
+        case YAML_STREAM_END_EVENT:
+        case YAML_NO_EVENT: /* the stream end was already consumed */
+            parsing_done = true;
+            break;
+
+        default:
+            break;
+        }
+
+        yaml_event_delete(&event);
+    }
+
+    if (!in_document)
+        return PB_YAML_END_OF_STREAM;
+    if (content_error)
+        return PB_YAML_ERROR_CONTENT;
+
+    /* special case: no properties found at all, e.g. libyaml could not parse, e.g. due to wrong YAML file encoding */
+    if (current_temperature_idx == -1 &&
+        current_contactor_idx == -1 &&
+        current_estop_idx == -1) {
+        fprintf(diag, "Error: no or wrong input data - YAML file is probably not UTF-8 encoded.\n");
+        goto err_out;
+    }
+    /* check that we saw at least the expected count of parameters, warn otherwise */
+    if (current_temperature_idx < CB_PROTO_MAX_PT1000S - 1)
+        fprintf(diag, "Warning: only %d temperature value(s) set instead of expected %d.\n", current_temperature_idx + 1, CB_PROTO_MAX_PT1000S);
+    if (current_contactor_idx < CB_PROTO_MAX_CONTACTORS - 1)
+        fprintf(diag, "Warning: only %d contactor configuration(s) set instead of expected %d.\n", current_contactor_idx + 1, CB_PROTO_MAX_CONTACTORS);
+    if (current_estop_idx < CB_PROTO_MAX_ESTOPS - 1)
+        fprintf(diag, "Warning: only %d estop configuration(s) set instead of expected %d.\n", current_estop_idx + 1, CB_PROTO_MAX_ESTOPS);
+    /* check the settings for plausibility, e.g. the RCM configuration */
+    problem = pb_validate(param_block);
+    if (problem) {
+        fprintf(diag, "Error: %s\n", problem);
+        goto err_out;
+    }
+
+    return PB_YAML_SUCCESS;
+
+err_out:
+    return PB_YAML_ERROR_CONTENT;
+}
+
+void pb_yaml_print_syntax_error(yaml_parser_t *parser, FILE *diag, size_t line_offset)
+{
+    fprintf(diag, "YAML parse error: %s (line %zu, column %zu)\n",
+            parser->problem ?: "unknown problem",
+            line_offset + parser->problem_mark.line + 1, parser->problem_mark.column + 1);
+}
+
+/* parse exactly one document from the parser with already configured input */
+static int pb_yaml_parse_single(yaml_parser_t *parser, struct param_block_v2 *param_block, FILE *diag, bool debug)
+{
+    yaml_event_t event;
+    int rv = -1;
+
+    switch (pb_yaml_parse_document(parser, param_block, diag, debug)) {
+    case PB_YAML_SUCCESS:
+        /* a single document is expected */
+        if (!yaml_parser_parse(parser, &event)) {
+            pb_yaml_print_syntax_error(parser, diag, 0);
+            break;
+        }
+        if (event.type == YAML_STREAM_END_EVENT)
+            rv = 0;
+        else
+            fprintf(diag, "Error: only a single YAML document is allowed here.\n");
+        yaml_event_delete(&event);
+        break;
+    case PB_YAML_END_OF_STREAM:
+        fprintf(diag, "Error: no YAML document found.\n");
+        break;
+    case PB_YAML_ERROR_SYNTAX:
+        pb_yaml_print_syntax_error(parser, diag, 0);
+        break;
+    default:
+        /* already reported */;
+    }
+
+    return rv;
+}
+
+int pb_read_yaml(FILE *f, struct param_block_v2 *param_block, bool debug)
+{
+    yaml_parser_t yaml_parser;
+    int rv;
+
+    if (!yaml_parser_initialize(&yaml_parser)) {
+        fprintf(stderr, "Error while initializing YAML parser.\n");
+        return -1;
+    }
+
+    yaml_parser_set_input_file(&yaml_parser, f);
+
+    rv = pb_yaml_parse_single(&yaml_parser, param_block, stderr, debug);
+
+    yaml_parser_delete(&yaml_parser);
+
+    return rv;
+}
+
+int pb_parse_yaml(const char *buf, size_t len, struct param_block_v2 *param_block, FILE *diag)
+{
+    yaml_parser_t yaml_parser;
+    int rv;
+
+    if (!yaml_parser_initialize(&yaml_parser)) {
+        fprintf(diag, "Error while initializing YAML parser.\n");
+        return -1;
+    }
+
+    yaml_parser_set_input_string(&yaml_parser, (const unsigned char *)buf, len);
+
+    rv = pb_yaml_parse_single(&yaml_parser, param_block, diag, false);
+
+    yaml_parser_delete(&yaml_parser);
+
+    return rv;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <yaml.h>
+#include "param_block.h"
+
+/* return values for pb_yaml_parse_document */
+#define PB_YAML_SUCCESS         0
+#define PB_YAML_END_OF_STREAM   1 /* no further document in the stream */
+#define PB_YAML_ERROR_CONTENT   2 /* invalid document, parsing can continue with the next one */
+#define PB_YAML_ERROR_SYNTAX    3 /* YAML syntax error, the stream cannot be parsed any further */
+
+/* parse the next document of the stream of an initialized parser into param_block (the CRC is
+ * not updated); warnings and errors about the content are reported on diag, with debug set the
+ * YAML events are traced there as well; syntax errors are left to the caller, see below;
+ * each parser may be used by a different thread concurrently
+ */
+int pb_yaml_parse_document(yaml_parser_t *parser, struct param_block_v2 *param_block, FILE *diag, bool debug);
+
+/* report the syntax error of the parser, line_offset is added to the line of the problem
+ * for streams which start within a file
+ */
+void pb_yaml_print_syntax_error(yaml_parser_t *parser, FILE *diag, size_t line_offset);
+
+/* parse the YAML representation of a parameter block (as printed by pb_dump) from the given
+ * file into param_block, exactly one document is expected; warnings and errors are reported
+ * on stderr; returns 0 on success, -1 on error
+ */
+int pb_read_yaml(FILE *f, struct param_block_v2 *param_block, bool debug);
+
+/* the same for the YAML text in the given buffer (which needs not to be terminated);
+ * warnings and errors are reported on diag
+ */
+int pb_parse_yaml(const char *buf, size_t len, struct param_block_v2 *param_block, FILE *diag);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,6 +13,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include "uart.h"
 #include "logging.h"
 #include "tools.h"
@@ -224,23 +225,6 @@ struct rwe_cmd {
 
 #define MAX_DATA_PACKET_PAYLOAD 1024
 
-/* we define the structure with maximum payload since we want to transmit/receive
- * as much data as possible in a single packet */
-struct data_pkt {
-    uint8_t sod;
-    union {
-        struct {
-            uint8_t lnh;
-            uint8_t lnl;
-        } __attribute__((packed));
-        uint16_t length;
-    } __attribute__((packed));
-    uint8_t res;
-    uint8_t data[MAX_DATA_PACKET_PAYLOAD];
-    uint8_t sum;
-    uint8_t etx;
-} __attribute__((packed));
-
 int ra_comm_setup(struct uart_ctx *uart)
 {
     uint8_t response_byte;
@@ -305,7 +289,7 @@ int ra_comm_setup(struct uart_ctx *uart)
     return 0;
 }
 
-static void ra_update_checksum(const uint8_t *buf, size_t len, uint8_t *sum)
+uint8_t ra_checksum(const uint8_t *buf, size_t len)
 {
     uint8_t chksum = 0;
 
@@ -314,7 +298,12 @@ static void ra_update_checksum(const uint8_t *buf, size_t len, uint8_t *sum)
         chksum += *buf++;
 
     /* calculate 2s complement */
-    *sum = 0x00 - chksum;
+    return 0x00 - chksum;
+}
+
+static void ra_update_checksum(const uint8_t *buf, size_t len, uint8_t *sum)
+{
+    *sum = ra_checksum(buf, len);
 }
 
 /* returns 1 if checksum is invalid */
@@ -638,39 +627,34 @@ int ra_rwe_cmd(struct uart_ctx *uart, enum rwe_command rwe, uint32_t start_addr,
 
 int ra_write_data(struct uart_ctx *uart, const uint8_t *payload, size_t len)
 {
-    struct data_pkt data_pkt;
+    struct common_data_header header;
+    struct common_data_trailer trailer;
     struct status_rsp status_rsp;
-    uint8_t *p;
+    struct iovec iov[3];
     ssize_t c;
 
     /* safety check */
-    if (len > sizeof(data_pkt.data)) {
+    if (len > MAX_DATA_PACKET_PAYLOAD) {
         errno = EFBIG;
         return -1;
     }
 
-    data_pkt.sod = SOD;
-    data_pkt.length = htobe16(len + 1);
-    data_pkt.res = WRITE_CMD;
-    memcpy(&data_pkt.data, payload, len);
+    header.sod = SOD;
+    header.length = htobe16(len + 1);
+    header.res = WRITE_CMD;
 
-    /* the data to write might be shorter than our full packet length,
-     * so we must determine where to place SUM and ETX;
-     * first let's point it to SUM */
-    p = (uint8_t *)&data_pkt;
-    p += sizeof(struct common_data_header) + len;
+    /* checksum without SOD, SUM itself and without ETX; since the checksum is the negated
+     * sum, the parts can be summed up separately and the payload is not copied at all */
+    trailer.sum = ra_checksum(&header.lnh, sizeof(header) - 1) + ra_checksum(payload, len);
+    trailer.etx = ETX;
 
-    /* checksum without SOH, SUM itself and without ETX */
-    ra_update_checksum(&data_pkt.lnh, len + 3, p);
-
-    /* let's add ETX finally */
-    p++;
-    *p = ETX;
+    iov[0] = (struct iovec){ &header, sizeof(header) };
+    iov[1] = (struct iovec){ (void *)payload, len };
+    iov[2] = (struct iovec){ &trailer, sizeof(trailer) };
 
     debug("sending data packet");
 
-    c = uart_write_drain(uart, (const uint8_t *)&data_pkt,
-                         sizeof(struct common_data_header) + len + sizeof(struct common_data_trailer));
+    c = uart_writev_drain(uart, iov, 3);
     if (c < 0)
         return c;
 
@@ -696,88 +680,86 @@ int ra_write_data(struct uart_ctx *uart, const uint8_t *payload, size_t len)
     return 0;
 }
 
-static bool ra_is_invalid_data_pkt(struct data_pkt *data_pkt, const uint8_t cmd)
+/* we assume that caller knows how much data will be available */
+int ra_read_data(struct uart_ctx *uart, uint8_t *buffer, size_t bufsize, bool ack)
 {
-    size_t len = be16toh(data_pkt->length);
-    uint8_t *p;
+    struct common_data_header header;
+    struct common_data_trailer trailer;
+    struct iovec iov[2];
+    size_t len;
+    ssize_t c;
 
-    /* check header first */
-    if (// invalid SOD
-        data_pkt->sod != SOD
-        // invalid length
-        || (len == 0 || len > MAX_DATA_PACKET_PAYLOAD + 1)
-        // res is neither cmd nor ERR(cmd)
-        || (data_pkt->res != cmd && data_pkt->res != (cmd | RES_ERR_MASK))) {
-        debug("header looks ugly");
-        return true;
+    /* safety check */
+    if (bufsize > MAX_DATA_PACKET_PAYLOAD) {
+        errno = EFBIG;
+        return -1;
     }
 
-    /* point to packet start first */
-    p = (uint8_t *)data_pkt;
-    p += sizeof(struct common_data_header) + len;
+    debug("waiting for data packet");
 
-    /* now p should point to the ETX byte, so let's check it */
-    if (*p != ETX) {
-        debug("wrong byte at calculated ETX position, seeing 0x%02" PRIx8 " there instead of 0x%02x", *p, ETX);
-        return true;
+    /* read the header first: in case of an error, a short status packet is sent instead */
+    c = uart_read_with_timeout(uart, (uint8_t *)&header, sizeof(header), RESPONSE_TIMEOUT);
+    if (c < 0) {
+        if (errno == ETIMEDOUT)
+            error("timeout while receiving data packet header");
+        return c;
     }
 
-    /* re-use this pointer to point to SUM byte */
-    p--;
+    len = be16toh(header.length);
 
-    /* finally check checksum */
-    if (ra_is_checksum_invalid(&data_pkt->lnh, len + 2 /* length field itself */, *p)) {
-        debug("checksum mismatch");
-        return true;
+    if (header.sod != SOD || (header.res != READ_CMD && header.res != (READ_CMD | RES_ERR_MASK))) {
+        error("unexpected response for data packet");
+        uart_dump_frame(false, false, (uint8_t *)&header, sizeof(header));
+        return -1;
     }
 
-    return false;
-}
+    if (header.res != READ_CMD) {
+        struct status_rsp status_rsp;
 
-/* we assume that caller knows how much data will be available */
-int ra_read_data(struct uart_ctx *uart, uint8_t *buffer, size_t bufsize, bool ack)
-{
-    struct data_pkt data_pkt;
-    ssize_t c;
+        /* this should be a status error packet, so fetch its remaining bytes */
+        memcpy(&status_rsp, &header, sizeof(header));
+        c = uart_read_with_timeout(uart, (uint8_t *)&status_rsp + sizeof(header),
+                                   sizeof(status_rsp) - sizeof(header), RESPONSE_TIMEOUT);
+        if (c < 0 || ra_is_invalid_status_pkt(&status_rsp, READ_CMD)) {
+            error("unexpected response for data packet");
+            uart_dump_frame(false, false, (uint8_t *)&status_rsp, c < 0 ? sizeof(header) : sizeof(status_rsp));
+            return -1;
+        }
 
-    /* safety check */
-    if (bufsize > sizeof(data_pkt.data)) {
-        errno = EFBIG;
+        error("received status error instead of data packet: RES=0x%02" PRIx8 ", STS=0x%02" PRIx8 " (%s)",
+              status_rsp.res, status_rsp.sts, statuscode_str(status_rsp.sts));
         return -1;
     }
 
-    memset(&data_pkt, 0, sizeof(data_pkt));
+    if (len != bufsize + 1) {
+        error("unexpected data packet length: expected %zu, got %zu", bufsize + 1, len);
+        uart_dump_frame(false, false, (uint8_t *)&header, sizeof(header));
+        return -1;
+    }
 
-    debug("waiting for data packet");
+    /* the payload lands directly in the destination buffer */
+    iov[0] = (struct iovec){ buffer, bufsize };
+    iov[1] = (struct iovec){ &trailer, sizeof(trailer) };
 
-    c = uart_read_with_timeout(uart, (uint8_t *)&data_pkt,
-                               bufsize + sizeof(struct common_data_header) + sizeof(struct common_data_trailer),
-                               RESPONSE_TIMEOUT);
+    c = uart_readv_with_timeout(uart, iov, 2, RESPONSE_TIMEOUT);
     if (c < 0) {
-        if (errno == ETIMEDOUT) {
-            error("timeout while receiving data packet, what we got so far follows (dump of full buffer):");
-            uart_dump_frame(false, false, (uint8_t *)&data_pkt, sizeof(data_pkt));
-        }
+        if (errno == ETIMEDOUT)
+            error("timeout while receiving data packet payload");
         return c;
     }
 
-    if (ra_is_invalid_data_pkt(&data_pkt, READ_CMD)) {
+    if (trailer.etx != ETX) {
         error("unexpected response for data packet");
-        uart_dump_frame(false, false, (uint8_t *)&data_pkt, sizeof(data_pkt));
+        debug("wrong byte at ETX position, seeing 0x%02" PRIx8 " there instead of 0x%02x", trailer.etx, ETX);
         return -1;
     }
 
-    if (data_pkt.res != READ_CMD) {
-        /* in this case this should be an status error packet, thus we can cast */
-        struct status_rsp *status_rsp = (struct status_rsp *)&data_pkt;
-        error("received status error instead of data packet: RES=0x%02" PRIx8 ", STS=0x%02" PRIx8 " (%s)",
-              status_rsp->res, status_rsp->sts, statuscode_str(status_rsp->sts));
+    if ((uint8_t)(ra_checksum(&header.lnh, sizeof(header) - 1) + ra_checksum(buffer, bufsize)) != trailer.sum) {
+        error("unexpected response for data packet");
+        debug("checksum mismatch");
         return -1;
     }
 
-    /* copy data */
-    memcpy(buffer, &data_pkt.data, bufsize);
-
     /* respond with status packet if desired */
     if (ack) {
         struct status_rsp status_rsp = { SOD, 0x00, 0x02, READ_CMD, STATUSCODE_OK, 0xe9, ETX };
@@ -821,7 +803,7 @@ int ra_read(struct uart_ctx *uart, uint8_t *buffer, uint32_t start_addr, size_t
     return 0;
 }
 
-int ra_write(struct uart_ctx *uart, uint32_t start_addr, uint8_t *buffer, size_t len)
+int ra_write(struct uart_ctx *uart, uint32_t start_addr, const uint8_t *buffer, size_t len)
 {
     uint32_t end_addr = start_addr + len - 1;
     size_t already_written = 0;
@@ -21,6 +21,9 @@ int ra_set_baudrate(struct uart_ctx *uart, int baudrate);
 
 int ra_inquiry(struct uart_ctx *uart);
 
+/* checksum over the given packet bytes (without SOD/SOH, SUM itself and ETX) */
+uint8_t ra_checksum(const uint8_t *buf, size_t len);
+
 /* Note: the following structures and their fields are documented in the
  * Renesas RA family's system specification document for the standard boot firmware
  */
@@ -102,7 +105,7 @@ int ra_read_data(struct uart_ctx *uart, uint8_t *buffer, size_t bufsize, bool ac
  */
 
 int ra_read(struct uart_ctx *uart, uint8_t *buffer, uint32_t start_addr, size_t len);
-int ra_write(struct uart_ctx *uart, uint32_t start_addr, uint8_t *buffer, size_t len);
+int ra_write(struct uart_ctx *uart, uint32_t start_addr, const uint8_t *buffer, size_t len);
 
 /* retrieve chip information */
 struct ra_flash_area_info {
@@ -79,6 +79,11 @@ long long timespec_to_us(struct timespec ts)
     return ((long long)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
 }
 
+long long timespec_to_ns(struct timespec ts)
+{
+    return ((long long)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
 int msleep(int ms)
 {
     struct timespec req, rem;
@@ -27,8 +27,12 @@ extern "C" {
 #define ARRAY_SIZE(x)          (sizeof(x) / sizeof((x)[0]))
 #endif
 
+#ifndef DIV_ROUND_UP
+#define DIV_ROUND_UP(N, S) (((N) + (S) - 1) / (S))
+#endif
+
 #ifndef ROUND_UP
-#define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
+#define ROUND_UP(N, S) (DIV_ROUND_UP(N, S) * (S))
 #endif
 
 bool timespec_is_set(const struct timespec *ts);
@@ -39,6 +43,7 @@ void timespec_add_ms(struct timespec *ts, long long msec);
 int timespec_compare(const struct timespec *lhs, const struct timespec *rhs);
 long long timespec_to_ms(struct timespec ts);
 long long timespec_to_us(struct timespec ts);
+long long timespec_to_ns(struct timespec ts);
 int msleep(int ms);
 int compare_version(const char *val, const char *ref);
 
@@ -20,6 +20,7 @@
 #include "tools.h"
 #include "logging.h"
 #include "cb_can_mirror.h"
+#include "frame_log.h"
 
 static speed_t baudrate_to_speed(int baudrate)
 {
@@ -286,17 +287,44 @@ int uart_wait_frame(struct uart_ctx *ctx, int timeout_ms)
     return 0;
 }
 
-ssize_t uart_write_drain(struct uart_ctx *ctx, const uint8_t *buf, size_t count)
+/* skip the given count of already transferred bytes */
+static void uart_iov_advance(struct iovec **iov, int *iovcnt, size_t count)
+{
+    while (*iovcnt && count >= (*iov)->iov_len) {
+        count -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovcnt)--;
+    }
+
+    if (*iovcnt) {
+        (*iov)->iov_base = (uint8_t *)(*iov)->iov_base + count;
+        (*iov)->iov_len -= count;
+    }
+}
+
+static size_t uart_iov_length(const struct iovec *iov, int iovcnt)
+{
+    size_t len = 0;
+
+    while (iovcnt--)
+        len += iov++->iov_len;
+
+    return len;
+}
+
+ssize_t uart_writev_drain(struct uart_ctx *ctx, struct iovec *iov, int iovcnt)
 {
+    size_t count = uart_iov_length(iov, iovcnt);
     size_t bytes_written = 0;
     int rv;
 
     while (bytes_written < count) {
-        ssize_t c = write(ctx->fd, &buf[bytes_written], count - bytes_written);
+        ssize_t c = writev(ctx->fd, iov, iovcnt);
         if (c < 0)
             return c;
 
         bytes_written += c;
+        uart_iov_advance(&iov, &iovcnt, c);
     }
 
     rv = tcdrain(ctx->fd);
@@ -306,9 +334,17 @@ ssize_t uart_write_drain(struct uart_ctx *ctx, const uint8_t *buf, size_t count)
     return bytes_written;
 }
 
-ssize_t uart_read_with_timeout(struct uart_ctx *ctx, uint8_t *buf, size_t count, int timeout_ms)
+ssize_t uart_write_drain(struct uart_ctx *ctx, const uint8_t *buf, size_t count)
+{
+    struct iovec iov = { (void *)buf, count };
+
+    return uart_writev_drain(ctx, &iov, 1);
+}
+
+ssize_t uart_readv_with_timeout(struct uart_ctx *ctx, struct iovec *iov, int iovcnt, int timeout_ms)
 {
     struct timespec ts_timeout, ts_now;
+    size_t count = uart_iov_length(iov, iovcnt);
     size_t bytes_read = 0;
     int rv;
 
@@ -337,16 +373,24 @@ ssize_t uart_read_with_timeout(struct uart_ctx *ctx, uint8_t *buf, size_t count,
         if (rv)
             return rv;
 
-        c = read(ctx->fd, &buf[bytes_read], count - bytes_read);
+        c = readv(ctx->fd, iov, iovcnt);
         if (c < 0)
             return c;
 
         bytes_read += c;
+        uart_iov_advance(&iov, &iovcnt, c);
     }
 
     return bytes_read;
 }
 
+ssize_t uart_read_with_timeout(struct uart_ctx *ctx, uint8_t *buf, size_t count, int timeout_ms)
+{
+    struct iovec iov = { buf, count };
+
+    return uart_readv_with_timeout(ctx, &iov, 1, timeout_ms);
+}
+
 bool uart_can_mirror_enabled(struct uart_ctx *ctx)
 {
     return ctx->fd_can_mirror != -1;
@@ -366,3 +410,43 @@ int uart_can_mirror_disable(struct uart_ctx *ctx)
 {
     return cb_can_mirror_close(ctx->fd_can_mirror);
 }
+
+bool uart_frame_log_enabled(struct uart_ctx *ctx)
+{
+    return ctx->frame_log != NULL;
+}
+
+int uart_frame_log_enable(struct uart_ctx *ctx, const char *filename, uint8_t source)
+{
+    ctx->frame_log = frame_log_open(filename);
+    if (!ctx->frame_log)
+        return -1;
+
+    ctx->frame_log_source = source;
+    ctx->frame_log_attached = false;
+    return 0;
+}
+
+void uart_frame_log_attach(struct uart_ctx *ctx, struct frame_log *log, uint8_t source)
+{
+    ctx->frame_log = log;
+    ctx->frame_log_source = source;
+    ctx->frame_log_attached = true;
+}
+
+int uart_frame_log_disable(struct uart_ctx *ctx)
+{
+    int rv = 0;
+
+    if (!ctx->frame_log_attached)
+        rv = frame_log_close(ctx->frame_log);
+
+    ctx->frame_log = NULL;
+    ctx->frame_log_attached = false;
+    return rv;
+}
+
+void uart_metrics_attach(struct uart_ctx *ctx, struct cb_metrics *metrics)
+{
+    ctx->metrics = metrics;
+}
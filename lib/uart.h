@@ -12,8 +12,13 @@ extern "C" {
 #include <stdint.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <sys/uio.h>
 #include <termios.h>
 
+/* forward declarations so that it is not necessary to include frame_log.h and cb_metrics.h */
+struct frame_log;
+struct cb_metrics;
+
 struct uart_ctx {
     /* pointer to uart device */
     const char *device;
@@ -38,6 +43,18 @@ struct uart_ctx {
 
     /* file descriptor of CAN mirror */
     int fd_can_mirror;
+
+    /* binary recording of sent and received frames */
+    struct frame_log *frame_log;
+
+    /* source id stored in each frame log record */
+    uint8_t frame_log_source;
+
+    /* the frame log is shared with other UARTs and not owned by this context */
+    bool frame_log_attached;
+
+    /* link metrics, maintained if set */
+    struct cb_metrics *metrics;
 };
 
 #define INIT_UART_CTX { .fd = -1, .fd_can_mirror = -1 }
@@ -61,6 +78,12 @@ ssize_t uart_write_drain(struct uart_ctx *ctx, const uint8_t *buf, size_t count)
 /* read bytes (looped), with overall timeout in ms */
 ssize_t uart_read_with_timeout(struct uart_ctx *ctx, uint8_t *buf, size_t count, int timeout_ms);
 
+/* the same for several buffers, filled/sent in order without copying;
+ * the passed iovec array is modified during the operation
+ */
+ssize_t uart_writev_drain(struct uart_ctx *ctx, struct iovec *iov, int iovcnt);
+ssize_t uart_readv_with_timeout(struct uart_ctx *ctx, struct iovec *iov, int iovcnt, int timeout_ms);
+
 /* return whether CAN mirroring is enabled */
 bool uart_can_mirror_enabled(struct uart_ctx *ctx);
 
@@ -70,6 +93,25 @@ int uart_can_mirror_enable(struct uart_ctx *ctx, const char *can_device);
 /* disable CAN mirroring and close the CAN device */
 int uart_can_mirror_disable(struct uart_ctx *ctx);
 
+/* return whether frame recording is enabled */
+bool uart_frame_log_enabled(struct uart_ctx *ctx);
+
+/* open the given frame log file and record all frames into it (appending) */
+int uart_frame_log_enable(struct uart_ctx *ctx, const char *filename, uint8_t source);
+
+/* record all frames into an already opened frame log, e.g. one shared by several UARTs;
+ * the source id allows to distinguish them
+ */
+void uart_frame_log_attach(struct uart_ctx *ctx, struct frame_log *log, uint8_t source);
+
+/* stop recording and close the frame log file (unless attached) */
+int uart_frame_log_disable(struct uart_ctx *ctx);
+
+/* count sent and received frames, receive errors and inquiry round trip times
+ * in the given metrics instance; NULL stops counting
+ */
+void uart_metrics_attach(struct uart_ctx *ctx, struct cb_metrics *metrics);
+
 #ifdef __cplusplus
 }
 #endif
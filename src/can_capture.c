@@ -0,0 +1,532 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <linux/can.h>
+#include <endian.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <logging.h>
+#include "can_capture.h"
+
+/* pcap magics (in file byte order as read in host order) */
+#define PCAP_MAGIC_US           0xa1b2c3d4
+#define PCAP_MAGIC_NS           0xa1b23c4d
+#define PCAP_MAGIC_US_SWAPPED   0xd4c3b2a1
+#define PCAP_MAGIC_NS_SWAPPED   0x4d3cb2a1
+
+/* pcapng block types */
+#define PCAPNG_BT_SHB           0x0a0d0d0a
+#define PCAPNG_BT_IDB           0x00000001
+#define PCAPNG_BT_SPB           0x00000003
+#define PCAPNG_BT_EPB           0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_OPT_IF_TSRESOL   9
+
+/* the only link type we understand: SocketCAN header with CAN ID in network byte order */
+#define LINKTYPE_CAN_SOCKETCAN  227
+
+/* maximum count of interfaces within a pcapng section we track */
+#define PCAPNG_MAX_INTERFACES   16
+
+/* SocketCAN pseudo header in pcap files */
+struct socketcan_hdr {
+    uint32_t can_id;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t res0;
+    uint8_t res1;
+} __attribute__((packed));
+
+static uint32_t get_u32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t get_u16(const uint8_t *p, bool swap)
+{
+    uint16_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+enum can_capture_format can_capture_detect(const uint8_t *buf, size_t len)
+{
+    uint32_t magic;
+
+    if (len >= 4) {
+        memcpy(&magic, buf, sizeof(magic));
+
+        switch (magic) {
+        case PCAP_MAGIC_US:
+        case PCAP_MAGIC_NS:
+        case PCAP_MAGIC_US_SWAPPED:
+        case PCAP_MAGIC_NS_SWAPPED:
+            return CAN_CAPTURE_PCAP;
+        case PCAPNG_BT_SHB:
+            return CAN_CAPTURE_PCAPNG;
+        }
+    }
+
+    /* candump lines start with whitespace, a timestamp in braces or the interface name */
+    if (len && (buf[0] == ' ' || buf[0] == '(' || (buf[0] >= 'a' && buf[0] <= 'z') || (buf[0] >= 'A' && buf[0] <= 'Z')))
+        return CAN_CAPTURE_CANDUMP;
+
+    return CAN_CAPTURE_UNKNOWN;
+}
+
+const char *can_capture_format_to_str(enum can_capture_format format)
+{
+    switch (format) {
+    case CAN_CAPTURE_CANDUMP:
+        return "candump";
+    case CAN_CAPTURE_PCAP:
+        return "pcap";
+    case CAN_CAPTURE_PCAPNG:
+        return "pcapng";
+    default:
+        return "unknown";
+    }
+}
+
+/* fill the frame from a SocketCAN pseudo header + data; returns false if too short */
+static bool socketcan_to_frame(const uint8_t *p, size_t caplen, struct can_capture_frame *frame)
+{
+    struct socketcan_hdr hdr;
+
+    if (caplen < sizeof(hdr))
+        return false;
+
+    memcpy(&hdr, p, sizeof(hdr));
+    frame->can_id = be32toh(hdr.can_id);
+    frame->len = hdr.len > 8 ? 8 : hdr.len;
+    if (caplen < sizeof(hdr) + frame->len)
+        frame->len = caplen - sizeof(hdr);
+
+    memset(frame->data, 0, sizeof(frame->data));
+    memcpy(frame->data, p + sizeof(hdr), frame->len);
+
+    return true;
+}
+
+static int parse_pcap(const uint8_t *buf, size_t len, can_capture_cb cb, void *arg)
+{
+    uint32_t magic, linktype;
+    bool swap, nsec;
+    size_t pos = 24;
+    int rv;
+
+    if (len < 24) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    memcpy(&magic, buf, sizeof(magic));
+    swap = magic == PCAP_MAGIC_US_SWAPPED || magic == PCAP_MAGIC_NS_SWAPPED;
+    nsec = magic == PCAP_MAGIC_NS || magic == PCAP_MAGIC_NS_SWAPPED;
+
+    /* the upper bits might carry FCS information */
+    linktype = get_u32(buf + 20, swap) & 0x0fffffff;
+    if (linktype != LINKTYPE_CAN_SOCKETCAN) {
+        error("unsupported pcap link type %u (expected %u, SocketCAN)", linktype, LINKTYPE_CAN_SOCKETCAN);
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    while (pos + 16 <= len) {
+        struct can_capture_frame frame;
+        uint32_t ts_sec = get_u32(buf + pos, swap);
+        uint32_t ts_frac = get_u32(buf + pos + 4, swap);
+        uint32_t caplen = get_u32(buf + pos + 8, swap);
+
+        pos += 16;
+        if (caplen > len - pos) {
+            /* truncated capture, e.g. still being written */
+            debug("pcap: truncated record at end of file");
+            break;
+        }
+
+        if (socketcan_to_frame(buf + pos, caplen, &frame)) {
+            frame.ts_ns = (uint64_t)ts_sec * 1000000000ULL + (nsec ? ts_frac : (uint64_t)ts_frac * 1000);
+
+            rv = cb(&frame, arg);
+            if (rv)
+                return rv;
+        }
+
+        pos += caplen;
+    }
+
+    return 0;
+}
+
+struct pcapng_if {
+    uint16_t linktype;
+
+    /* timestamp units per second */
+    uint64_t ts_per_sec;
+};
+
+static uint64_t pcapng_ts_to_ns(const struct pcapng_if *iface, uint64_t ts)
+{
+    if (iface->ts_per_sec == 1000000000ULL)
+        return ts;
+    if (iface->ts_per_sec == 1000000ULL)
+        return ts * 1000;
+
+    return (uint64_t)((unsigned __int128)ts * 1000000000ULL / iface->ts_per_sec);
+}
+
+static void pcapng_parse_idb(const uint8_t *body, size_t body_len, bool swap, struct pcapng_if *iface)
+{
+    size_t pos = 8;
+
+    iface->linktype = get_u16(body, swap);
+    iface->ts_per_sec = 1000000;
+
+    /* walk the options to find if_tsresol */
+    while (pos + 4 <= body_len) {
+        uint16_t code = get_u16(body + pos, swap);
+        uint16_t olen = get_u16(body + pos + 2, swap);
+
+        pos += 4;
+        if (code == 0 || pos + olen > body_len)
+            break;
+
+        if (code == PCAPNG_OPT_IF_TSRESOL && olen >= 1) {
+            uint8_t res = body[pos];
+            unsigned int i;
+
+            iface->ts_per_sec = 1;
+            for (i = 0; i < (res & 0x7f) && i < 63; i++)
+                iface->ts_per_sec *= (res & 0x80) ? 2 : 10;
+        }
+
+        pos += (olen + 3) & ~3u;
+    }
+}
+
+static int parse_pcapng(const uint8_t *buf, size_t len, can_capture_cb cb, void *arg)
+{
+    struct pcapng_if ifaces[PCAPNG_MAX_INTERFACES];
+    unsigned int if_count = 0;
+    bool swap = false;
+    size_t pos = 0;
+    int rv;
+
+    while (pos + 12 <= len) {
+        uint32_t type, block_len;
+        const uint8_t *body;
+        size_t body_len;
+
+        memcpy(&type, buf + pos, sizeof(type));
+
+        /* the byte order is defined by each section header */
+        if (type == PCAPNG_BT_SHB) {
+            uint32_t bom;
+
+            memcpy(&bom, buf + pos + 8, sizeof(bom));
+            if (bom == PCAPNG_BYTE_ORDER_MAGIC) {
+                swap = false;
+            } else if (bom == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC)) {
+                swap = true;
+            } else {
+                error("pcapng: invalid byte order magic");
+                errno = EBADMSG;
+                return -1;
+            }
+            if_count = 0;
+        } else {
+            type = swap ? __builtin_bswap32(type) : type;
+        }
+
+        block_len = get_u32(buf + pos + 4, swap);
+        if (block_len < 12 || block_len % 4) {
+            error("pcapng: invalid block length %u", block_len);
+            errno = EBADMSG;
+            return -1;
+        }
+        if (block_len > len - pos) {
+            debug("pcapng: truncated block at end of file");
+            break;
+        }
+
+        body = buf + pos + 8;
+        body_len = block_len - 12;
+
+        switch (type) {
+        case PCAPNG_BT_IDB:
+            if (body_len < 8)
+                break;
+            if (if_count == PCAPNG_MAX_INTERFACES) {
+                error("pcapng: too many interfaces (max. %d)", PCAPNG_MAX_INTERFACES);
+                errno = ENOTSUP;
+                return -1;
+            }
+            pcapng_parse_idb(body, body_len, swap, &ifaces[if_count]);
+            if (ifaces[if_count].linktype != LINKTYPE_CAN_SOCKETCAN)
+                debug("pcapng: ignoring interface %u with link type %u", if_count, ifaces[if_count].linktype);
+            if_count++;
+            break;
+
+        case PCAPNG_BT_EPB: {
+            struct can_capture_frame frame;
+            uint32_t if_id, caplen;
+            uint64_t ts;
+
+            if (body_len < 20)
+                break;
+
+            if_id = get_u32(body, swap);
+            ts = (uint64_t)get_u32(body + 4, swap) << 32 | get_u32(body + 8, swap);
+            caplen = get_u32(body + 12, swap);
+
+            if (if_id >= if_count || ifaces[if_id].linktype != LINKTYPE_CAN_SOCKETCAN || caplen > body_len - 20)
+                break;
+
+            if (socketcan_to_frame(body + 20, caplen, &frame)) {
+                frame.ts_ns = pcapng_ts_to_ns(&ifaces[if_id], ts);
+
+                rv = cb(&frame, arg);
+                if (rv)
+                    return rv;
+            }
+            break;
+        }
+
+        case PCAPNG_BT_SPB: {
+            struct can_capture_frame frame;
+
+            /* simple packets belong to the first interface and have no timestamp */
+            if (if_count == 0 || ifaces[0].linktype != LINKTYPE_CAN_SOCKETCAN || body_len < 4)
+                break;
+
+            if (socketcan_to_frame(body + 4, body_len - 4, &frame)) {
+                frame.ts_ns = 0;
+
+                rv = cb(&frame, arg);
+                if (rv)
+                    return rv;
+            }
+            break;
+        }
+
+        default:
+            /* skip all other blocks */
+            break;
+        }
+
+        pos += block_len;
+    }
+
+    return 0;
+}
+
+static int hexval(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* candump's absolute time is formatted as local time, converting is expensive,
+ * so remember the last date/time which changes only once per second
+ */
+struct candump_state {
+    char last_datetime[19];
+    time_t last_t;
+};
+
+/* parse '(1709294400.123456)' or '(2024-03-01 12:00:00.123456)' at *p */
+static bool candump_parse_ts(struct candump_state *state, const uint8_t **pp, const uint8_t *end, uint64_t *ts_ns)
+{
+    const uint8_t *p = *pp + 1; /* skip '(' */
+    uint64_t sec = 0, frac = 0, scale = 1000000000ULL;
+
+    if (end - p >= 19 && p[4] == '-' && p[10] == ' ') {
+        if (memcmp(p, state->last_datetime, sizeof(state->last_datetime)) != 0) {
+            struct tm tm = {};
+            unsigned int i;
+            int v[6] = {};
+            int field = 0;
+
+            for (i = 0; i < 19; i++) {
+                if (p[i] >= '0' && p[i] <= '9')
+                    v[field] = v[field] * 10 + (p[i] - '0');
+                else if (++field >= 6)
+                    return false;
+            }
+
+            tm.tm_year = v[0] - 1900;
+            tm.tm_mon = v[1] - 1;
+            tm.tm_mday = v[2];
+            tm.tm_hour = v[3];
+            tm.tm_min = v[4];
+            tm.tm_sec = v[5];
+            tm.tm_isdst = -1;
+
+            state->last_t = mktime(&tm);
+            memcpy(state->last_datetime, p, sizeof(state->last_datetime));
+        }
+
+        sec = state->last_t;
+        p += 19;
+    } else {
+        while (p < end && *p >= '0' && *p <= '9')
+            sec = sec * 10 + (*p++ - '0');
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            scale /= 10;
+            frac += (*p - '0') * scale;
+        }
+    }
+
+    if (p >= end || *p != ')')
+        return false;
+
+    *ts_ns = sec * 1000000000ULL + frac;
+    *pp = p + 1;
+    return true;
+}
+
+static const uint8_t *skip_blanks(const uint8_t *p, const uint8_t *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+/* parse a single line, returns false if this is not a (classic) CAN frame line */
+static bool candump_parse_line(struct candump_state *state, const uint8_t *p, const uint8_t *end,
+                               struct can_capture_frame *frame)
+{
+    unsigned int id_digits = 0;
+    int h, l;
+
+    frame->ts_ns = 0;
+    frame->can_id = 0;
+    frame->len = 0;
+    memset(frame->data, 0, sizeof(frame->data));
+
+    p = skip_blanks(p, end);
+    if (p < end && *p == '(') {
+        if (!candump_parse_ts(state, &p, end, &frame->ts_ns))
+            return false;
+        p = skip_blanks(p, end);
+    }
+
+    /* interface name */
+    while (p < end && *p != ' ' && *p != '\t')
+        p++;
+    p = skip_blanks(p, end);
+
+    /* CAN ID */
+    while (p < end && (h = hexval(*p)) >= 0) {
+        frame->can_id = (frame->can_id << 4) | h;
+        id_digits++;
+        p++;
+    }
+    if (id_digits == 0)
+        return false;
+
+    /* 8 digits are used for extended frame format */
+    if (id_digits > 3)
+        frame->can_id |= CAN_EFF_FLAG;
+
+    if (p < end && *p == '#') {
+        /* candump -L format: ID#DATA, CAN FD uses '##' and remote frames 'R' */
+        p++;
+        if (p < end && (*p == '#' || *p == 'R'))
+            return false;
+
+        while (p + 1 < end && frame->len < 8 && (h = hexval(p[0])) >= 0 && (l = hexval(p[1])) >= 0) {
+            frame->data[frame->len++] = (h << 4) | l;
+            p += 2;
+        }
+
+        return true;
+    }
+
+    /* default format: ID   [N]  XX XX ... */
+    p = skip_blanks(p, end);
+    if (p >= end || *p != '[')
+        return false;
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        ;
+    if (p >= end || *p != ']')
+        return false;
+    p++;
+
+    while (frame->len < 8) {
+        p = skip_blanks(p, end);
+        if (p + 1 >= end || (h = hexval(p[0])) < 0 || (l = hexval(p[1])) < 0)
+            break;
+        frame->data[frame->len++] = (h << 4) | l;
+        p += 2;
+    }
+
+    /* 'remote request' lines don't carry data */
+    return frame->len > 0 || p >= end || *p != 'r';
+}
+
+static int parse_candump(const uint8_t *buf, size_t len, can_capture_cb cb, void *arg)
+{
+    struct candump_state state = {};
+    const uint8_t *p = buf, *end = buf + len;
+    unsigned long skipped = 0;
+    int rv;
+
+    while (p < end) {
+        const uint8_t *eol = memchr(p, '\n', end - p);
+        struct can_capture_frame frame;
+
+        if (!eol)
+            eol = end;
+
+        if (eol > p) {
+            if (candump_parse_line(&state, p, eol, &frame)) {
+                rv = cb(&frame, arg);
+                if (rv)
+                    return rv;
+            } else {
+                skipped++;
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    if (skipped)
+        debug("candump: skipped %lu lines which are not classic CAN frames", skipped);
+
+    return 0;
+}
+
+int can_capture_parse(const uint8_t *buf, size_t len, can_capture_cb cb, void *arg)
+{
+    switch (can_capture_detect(buf, len)) {
+    case CAN_CAPTURE_CANDUMP:
+        return parse_candump(buf, len, cb, arg);
+    case CAN_CAPTURE_PCAP:
+        return parse_pcap(buf, len, cb, arg);
+    case CAN_CAPTURE_PCAPNG:
+        return parse_pcapng(buf, len, cb, arg);
+    default:
+        error("unknown capture file format");
+        errno = EINVAL;
+        return -1;
+    }
+}
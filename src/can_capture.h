@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Parsers for CAN traffic captures as created from the CAN mirror,
+ * i.e. text output of 'candump' (default, '-t a/A/d/z' and '-L' formats)
+ * as well as pcap and pcapng files with SocketCAN link type.
+ * The parsers work on a complete in-memory buffer (usually a mmap'ed file).
+ */
+
+enum can_capture_format {
+    CAN_CAPTURE_UNKNOWN = 0,
+    CAN_CAPTURE_CANDUMP,
+    CAN_CAPTURE_PCAP,
+    CAN_CAPTURE_PCAPNG,
+};
+
+struct can_capture_frame {
+    /* timestamp in ns, 0 if not present in capture */
+    uint64_t ts_ns;
+
+    /* CAN ID including the SocketCAN flags (CAN_EFF_FLAG etc.) */
+    uint32_t can_id;
+
+    uint8_t len;
+    uint8_t data[8];
+};
+
+/* called for each frame; a non-zero return value stops parsing and is returned */
+typedef int (*can_capture_cb)(const struct can_capture_frame *frame, void *arg);
+
+enum can_capture_format can_capture_detect(const uint8_t *buf, size_t len);
+
+const char *can_capture_format_to_str(enum can_capture_format format);
+
+/* parse the whole buffer and call the callback for each CAN frame;
+ * returns 0 on success, -1 (with errno set) for malformed input
+ * or the non-zero return value of the callback
+ */
+int can_capture_parse(const uint8_t *buf, size_t len, can_capture_cb cb, void *arg);
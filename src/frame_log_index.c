@@ -0,0 +1,330 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cb_proto_field.h>
+#include <cb_protocol.h>
+#include <frame_log.h>
+#include <logging.h>
+#include <tools.h>
+#include "frame_log_index.h"
+
+#define FRAME_LOG_INDEX_MAGIC "RAFRMIDX"
+#define FRAME_LOG_INDEX_VERSION 1
+
+/* the index is a local cache only, so it is stored in host byte order */
+struct frame_log_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_records;
+    uint32_t field_count;
+    uint32_t field_checksum;
+    uint64_t record_count;
+
+    /* timestamp of the first log record, to detect a replaced log file */
+    uint64_t first_ts;
+} __attribute__((packed));
+
+/* a checksum over the field registry so that a changed registry invalidates the index */
+static uint32_t field_checksum(void)
+{
+    uint32_t hash = 2166136261u; /* FNV-1a */
+    unsigned int i;
+
+    for (i = 0; i < cb_proto_field_count(); i++) {
+        const struct cb_proto_field *f = cb_proto_field_by_index(i);
+        const char *p;
+
+        for (p = f->name; *p; p++)
+            hash = (hash ^ (uint8_t)*p) * 16777619u;
+        hash = (hash ^ f->com) * 16777619u;
+    }
+
+    return hash;
+}
+
+static char *index_filename(const char *log_filename)
+{
+    char *fn;
+
+    if (asprintf(&fn, "%s.idx", log_filename) < 0)
+        return NULL;
+
+    return fn;
+}
+
+void frame_log_index_seed_ctx(const struct frame_log_index_block *block, struct safety_controller *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->charge_state = block->seed_charge_state;
+    ctx->charge_control = block->seed_charge_control;
+    ctx->pt1000 = block->seed_pt1000;
+    ctx->error_message = block->seed_error_message;
+    ctx->mcs = block->seed_mcs;
+}
+
+static void block_seed(struct frame_log_index_block *block, const struct safety_controller *ctx)
+{
+    memset(block, 0, sizeof(*block));
+    block->seed_charge_state = ctx->charge_state;
+    block->seed_charge_control = ctx->charge_control;
+    block->seed_pt1000 = ctx->pt1000;
+    block->seed_error_message = ctx->error_message;
+    block->seed_mcs = ctx->mcs;
+}
+
+/* (re-)builds the blocks starting at the given one up to the end of the log */
+static int index_build(struct frame_log_index *idx, const struct frame_log_map *map, size_t first_block)
+{
+    unsigned int field_count = cb_proto_field_count();
+    uint64_t fields_by_com[COM_MAX + 1];
+    struct safety_controller ctx = {};
+    size_t block_count, b;
+    unsigned int i;
+
+    /* a bitmask of the fields which can change by a frame of the given type */
+    for (i = 0; i <= COM_MAX; i++) {
+        unsigned int f;
+
+        fields_by_com[i] = 0;
+        for (f = 0; f < field_count; f++)
+            if (cb_proto_field_is_carried_by(cb_proto_field_by_index(f), i))
+                fields_by_com[i] |= (uint64_t)1 << f;
+    }
+
+    block_count = (map->count + FRAME_LOG_INDEX_BLOCK_RECORDS - 1) / FRAME_LOG_INDEX_BLOCK_RECORDS;
+    if (block_count == 0) {
+        idx->block_count = 0;
+        idx->record_count = 0;
+        return 0;
+    }
+
+    if (block_count != idx->block_count) {
+        struct frame_log_index_block *blocks;
+
+        blocks = realloc(idx->blocks, block_count * sizeof(*blocks));
+        if (!blocks)
+            return -1;
+
+        idx->blocks = blocks;
+    }
+
+    if (first_block < idx->block_count && first_block < block_count)
+        frame_log_index_seed_ctx(&idx->blocks[first_block], &ctx);
+    else
+        first_block = 0;
+
+    for (b = first_block; b < block_count; b++) {
+        struct frame_log_index_block *block = &idx->blocks[b];
+        size_t start = b * FRAME_LOG_INDEX_BLOCK_RECORDS;
+        size_t end = min(start + FRAME_LOG_INDEX_BLOCK_RECORDS, map->count);
+        size_t r;
+
+        block_seed(block, &ctx);
+
+        for (i = 0; i < field_count; i++)
+            block->min[i] = block->max[i] = cb_proto_field_by_index(i)->get(&ctx);
+
+        block->first_ts = frame_log_record_ts(&map->records[start]);
+
+        for (r = start; r < end; r++) {
+            const struct frame_log_record *rec = &map->records[r];
+            uint64_t mask = fields_by_com[rec->com];
+
+            cb_proto_store_frame(&ctx, rec->com, frame_log_record_data(rec));
+
+            while (mask) {
+                unsigned int f = __builtin_ctzll(mask);
+                int32_t v = cb_proto_field_by_index(f)->get(&ctx);
+
+                if (v < block->min[f])
+                    block->min[f] = v;
+                if (v > block->max[f])
+                    block->max[f] = v;
+
+                mask &= mask - 1;
+            }
+        }
+
+        block->last_ts = frame_log_record_ts(&map->records[end - 1]);
+    }
+
+    idx->block_count = block_count;
+    idx->record_count = map->count;
+
+    return 0;
+}
+
+static int index_read(struct frame_log_index *idx, const char *filename, const struct frame_log_map *map)
+{
+    struct frame_log_index_header hdr;
+    size_t block_count;
+    FILE *f;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        return -1;
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+        goto err_out;
+
+    if (memcmp(hdr.magic, FRAME_LOG_INDEX_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != FRAME_LOG_INDEX_VERSION ||
+        hdr.block_records != FRAME_LOG_INDEX_BLOCK_RECORDS ||
+        hdr.field_count != cb_proto_field_count() ||
+        hdr.field_checksum != field_checksum())
+        goto err_out;
+
+    /* the log must have been extended only */
+    if (hdr.record_count > map->count ||
+        (hdr.record_count && hdr.first_ts != frame_log_record_ts(&map->records[0])))
+        goto err_out;
+
+    block_count = (hdr.record_count + FRAME_LOG_INDEX_BLOCK_RECORDS - 1) / FRAME_LOG_INDEX_BLOCK_RECORDS;
+
+    idx->blocks = calloc(block_count ? block_count : 1, sizeof(*idx->blocks));
+    if (!idx->blocks)
+        goto err_out;
+
+    if (fread(idx->blocks, sizeof(*idx->blocks), block_count, f) != block_count) {
+        free(idx->blocks);
+        idx->blocks = NULL;
+        goto err_out;
+    }
+
+    idx->block_count = block_count;
+    idx->record_count = hdr.record_count;
+
+    fclose(f);
+    return 0;
+
+err_out:
+    fclose(f);
+    errno = EINVAL;
+    return -1;
+}
+
+static int index_write(const struct frame_log_index *idx, const char *filename, const struct frame_log_map *map)
+{
+    struct frame_log_index_header hdr;
+    char *tmpfn;
+    FILE *f;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, FRAME_LOG_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.version = FRAME_LOG_INDEX_VERSION;
+    hdr.block_records = FRAME_LOG_INDEX_BLOCK_RECORDS;
+    hdr.field_count = cb_proto_field_count();
+    hdr.field_checksum = field_checksum();
+    hdr.record_count = idx->record_count;
+    if (map->count)
+        hdr.first_ts = frame_log_record_ts(&map->records[0]);
+
+    /* write to a temporary file first, so that readers never see a partial index */
+    if (asprintf(&tmpfn, "%s.tmp", filename) < 0)
+        return -1;
+
+    f = fopen(tmpfn, "wb");
+    if (!f)
+        goto err_free;
+
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(idx->blocks, sizeof(*idx->blocks), idx->block_count, f) != idx->block_count) {
+        fclose(f);
+        goto err_unlink;
+    }
+
+    if (fclose(f))
+        goto err_unlink;
+
+    if (rename(tmpfn, filename))
+        goto err_unlink;
+
+    free(tmpfn);
+    return 0;
+
+err_unlink:
+    unlink(tmpfn);
+err_free:
+    free(tmpfn);
+    return -1;
+}
+
+int frame_log_index_load(struct frame_log_index *idx, const char *log_filename,
+                         const struct frame_log_map *map, bool save)
+{
+    size_t first_block = 0;
+    char *fn;
+    int rv = 0;
+
+    memset(idx, 0, sizeof(*idx));
+
+    if (cb_proto_field_count() > FRAME_LOG_INDEX_MAX_FIELDS) {
+        error("too many fields registered to build an index");
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    fn = index_filename(log_filename);
+    if (!fn)
+        return -1;
+
+    if (index_read(idx, fn, map) == 0) {
+        if (idx->record_count == map->count)
+            goto out;
+
+        /* the last block might be incomplete, so re-build from there */
+        debug("index '%s' covers %zu of %zu records, updating", fn, idx->record_count, map->count);
+        if (idx->record_count)
+            first_block = (idx->record_count - 1) / FRAME_LOG_INDEX_BLOCK_RECORDS;
+    } else {
+        debug("building index for '%s'", log_filename);
+    }
+
+    rv = index_build(idx, map, first_block);
+    if (rv)
+        goto out;
+
+    if (save && index_write(idx, fn, map))
+        /* not fatal, e.g. read-only directory */
+        debug("could not write index '%s': %m", fn);
+
+out:
+    free(fn);
+    return rv;
+}
+
+void frame_log_index_free(struct frame_log_index *idx)
+{
+    free(idx->blocks);
+    idx->blocks = NULL;
+    idx->block_count = 0;
+    idx->record_count = 0;
+}
+
+size_t frame_log_index_find_ts(const struct frame_log_index *idx, uint64_t ts)
+{
+    size_t lo = 0, hi = idx->block_count;
+
+    /* the log is assumed to be recorded in time order, so block end times are ascending */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (idx->blocks[mid].last_ts < ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
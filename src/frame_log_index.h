@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cb_protocol.h>
+#include <frame_log.h>
+
+/*
+ * A sparse index over a frame log: the log is split into blocks of a fixed
+ * count of records, and for each block we remember the time range, the
+ * decoder state at the beginning of the block and the value range of each
+ * registered cb_proto field within the block.
+ * This allows to start scanning at any block (e.g. in parallel) and to skip
+ * blocks which cannot match a query at all.
+ *
+ * The index is stored beside the log as '<log>.idx' and is only a cache:
+ * when it does not fit the log or this tool anymore, it is rebuilt.
+ */
+
+/* count of records per block */
+#define FRAME_LOG_INDEX_BLOCK_RECORDS 4096
+
+/* upper limit of fields we can summarize */
+#define FRAME_LOG_INDEX_MAX_FIELDS 64
+
+struct frame_log_index_block {
+    /* time range of the records within this block */
+    uint64_t first_ts;
+    uint64_t last_ts;
+
+    /* decoder state before the first record of this block */
+    uint64_t seed_charge_state;
+    uint64_t seed_charge_control;
+    uint64_t seed_pt1000;
+    uint64_t seed_error_message;
+    uint8_t seed_mcs;
+    uint8_t reserved[7];
+
+    /* value ranges of all fields while within this block (incl. seed state) */
+    int32_t min[FRAME_LOG_INDEX_MAX_FIELDS];
+    int32_t max[FRAME_LOG_INDEX_MAX_FIELDS];
+};
+
+struct frame_log_index {
+    /* count of records covered by the blocks */
+    size_t record_count;
+
+    size_t block_count;
+    struct frame_log_index_block *blocks;
+};
+
+/* load the index file for the given log and bring it up-to-date with the mapped log;
+ * if 'save' is set, the updated index is written back;
+ * returns 0 on success, -1 on error
+ */
+int frame_log_index_load(struct frame_log_index *idx, const char *log_filename,
+                         const struct frame_log_map *map, bool save);
+
+void frame_log_index_free(struct frame_log_index *idx);
+
+/* restore the decoder state at the start of the given block */
+void frame_log_index_seed_ctx(const struct frame_log_index_block *block, struct safety_controller *ctx);
+
+/* returns the first block which might contain records with ts >= the given one */
+size_t frame_log_index_find_ts(const struct frame_log_index *idx, uint64_t ts);
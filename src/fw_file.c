@@ -130,7 +130,7 @@ void fw_version_app_infoblock_to_host_endianess(struct version_app_infoblock *p)
     p->parameter_version = le16toh(p->parameter_version);
 }
 
-bool fw_valid_version_app_infoblock(struct version_app_infoblock *p)
+bool fw_valid_version_app_infoblock(const struct version_app_infoblock *p)
 {
     return p->start_magic_pattern == INFO_MAGIC_PATTERN
            && p->end_magic_pattern == INFO_MAGIC_PATTERN;
@@ -41,7 +41,7 @@ int fw_mmap_outfile(const char *filename, uint8_t **content, unsigned long files
 void fw_version_app_infoblock_to_host_endianess(struct version_app_infoblock *p);
 
 void fw_dump_version_app_infoblock(struct version_app_infoblock *p);
-bool fw_valid_version_app_infoblock(struct version_app_infoblock *p);
+bool fw_valid_version_app_infoblock(const struct version_app_infoblock *p);
 
 /* note: inversed logic - returns true in case the infoblock is invalid */
 bool fw_print_amended_version_app_infoblock(struct version_app_infoblock *p, const char *header);
@@ -0,0 +1,263 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tools.h>
+#include "fw_file.h"
+#include "fw_patch.h"
+
+uint32_t fw_patch_crc32(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    int i;
+
+    /* bitwise is fast enough for the size of firmware images */
+    while (len--) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+/* read the infoblock of an image and convert it to host endianness */
+static int fw_patch_get_infoblock(const uint8_t *image, size_t len, struct version_app_infoblock *info)
+{
+    if (len < CODE_FIRMWARE_INFORMATION_START_ADDRESS + sizeof(*info))
+        return -1;
+
+    memcpy(info, &image[CODE_FIRMWARE_INFORMATION_START_ADDRESS], sizeof(*info));
+    fw_version_app_infoblock_to_host_endianess(info);
+
+    return fw_valid_version_app_infoblock(info) ? 0 : -1;
+}
+
+/* copy an erase unit of an image, the part behind the image is padded like erased flash */
+static void fw_patch_get_unit(uint8_t *unit, const uint8_t *image, size_t len, size_t offset, size_t erase_unit_size)
+{
+    size_t n = (offset < len) ? min(len - offset, erase_unit_size) : 0;
+
+    memcpy(unit, image + offset, n);
+    memset(unit + n, 0xff, erase_unit_size - n);
+}
+
+static bool fw_patch_is_blank(const uint8_t *p, size_t len)
+{
+    while (len--)
+        if (*p++ != 0xff)
+            return false;
+
+    return true;
+}
+
+int fw_patch_create(const uint8_t *src, size_t src_len, const uint8_t *dst, size_t dst_len,
+                    size_t erase_unit_size, FILE *f)
+{
+    struct version_app_infoblock src_info, dst_info;
+    struct fw_patch_header *header;
+    struct fw_patch_unit *unit;
+    uint8_t *buf, *src_unit, *dst_unit;
+    size_t units, count = 0, data_offset, len, offset;
+    int rv = -1;
+
+    if (erase_unit_size == 0 || erase_unit_size > UINT32_MAX ||
+        fw_patch_get_infoblock(src, src_len, &src_info) ||
+        fw_patch_get_infoblock(dst, dst_len, &dst_info)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    units = (max(src_len, dst_len) + erase_unit_size - 1) / erase_unit_size;
+    if (units > UINT16_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    /* the patch can get at most as large as the header, the table and all units */
+    buf = malloc(sizeof(*header) + units * (sizeof(*unit) + erase_unit_size) + 2 * erase_unit_size);
+    if (!buf)
+        return -1;
+
+    header = (struct fw_patch_header *)buf;
+    unit = (struct fw_patch_unit *)(buf + sizeof(*header));
+    src_unit = buf + sizeof(*header) + units * (sizeof(*unit) + erase_unit_size);
+    dst_unit = src_unit + erase_unit_size;
+
+    /* first pass: count the differing units, so that the data starts behind the table */
+    for (offset = 0; offset < units * erase_unit_size; offset += erase_unit_size) {
+        fw_patch_get_unit(src_unit, src, src_len, offset, erase_unit_size);
+        fw_patch_get_unit(dst_unit, dst, dst_len, offset, erase_unit_size);
+
+        if (memcmp(src_unit, dst_unit, erase_unit_size) != 0)
+            count++;
+    }
+
+    data_offset = sizeof(*header) + count * sizeof(*unit);
+    len = data_offset;
+
+    for (offset = 0; offset < units * erase_unit_size; offset += erase_unit_size) {
+        fw_patch_get_unit(src_unit, src, src_len, offset, erase_unit_size);
+        fw_patch_get_unit(dst_unit, dst, dst_len, offset, erase_unit_size);
+
+        if (memcmp(src_unit, dst_unit, erase_unit_size) == 0)
+            continue;
+
+        unit->offset = htole32(offset);
+        if (fw_patch_is_blank(dst_unit, erase_unit_size)) {
+            unit->length = 0;
+            unit->data_offset = 0;
+        } else {
+            unit->length = htole32(erase_unit_size);
+            unit->data_offset = htole32(len);
+            memcpy(buf + len, dst_unit, erase_unit_size);
+            len += erase_unit_size;
+        }
+        unit++;
+    }
+
+    memset(header, 0, sizeof(*header));
+    header->magic = htole32(FW_PATCH_MAGIC);
+    header->version = htole16(FW_PATCH_VERSION);
+    header->unit_count = htole16(count);
+    header->erase_unit_size = htole32(erase_unit_size);
+    header->src_git_hash = htole64(src_info.git_hash);
+    header->src_application_checksum = htole32(src_info.application_checksum);
+    header->dst_git_hash = htole64(dst_info.git_hash);
+    header->dst_application_checksum = htole32(dst_info.application_checksum);
+    header->dst_size = htole32(dst_len);
+    header->crc = htole32(fw_patch_crc32(buf + offsetof(struct fw_patch_header, version),
+                                         len - offsetof(struct fw_patch_header, version)));
+
+    if (fwrite(buf, len, 1, f) != 1)
+        goto free_out;
+
+    rv = count;
+
+free_out:
+    free(buf);
+    return rv;
+}
+
+int fw_patch_parse(const uint8_t *buf, size_t len, struct fw_patch *patch)
+{
+    struct fw_patch_header *h = &patch->header;
+    const struct fw_patch_unit *unit;
+    size_t i, table_end, prev_end = 0;
+
+    if (len < sizeof(*h))
+        goto err_out;
+
+    memcpy(h, buf, sizeof(*h));
+    h->magic = le32toh(h->magic);
+    h->crc = le32toh(h->crc);
+    h->version = le16toh(h->version);
+    h->unit_count = le16toh(h->unit_count);
+    h->erase_unit_size = le32toh(h->erase_unit_size);
+    h->src_git_hash = le64toh(h->src_git_hash);
+    h->src_application_checksum = le32toh(h->src_application_checksum);
+    h->dst_git_hash = le64toh(h->dst_git_hash);
+    h->dst_application_checksum = le32toh(h->dst_application_checksum);
+    h->dst_size = le32toh(h->dst_size);
+
+    if (h->magic != FW_PATCH_MAGIC || h->version != FW_PATCH_VERSION || h->erase_unit_size == 0)
+        goto err_out;
+
+    if (h->crc != fw_patch_crc32(buf + offsetof(struct fw_patch_header, version),
+                                 len - offsetof(struct fw_patch_header, version)))
+        goto err_out;
+
+    table_end = sizeof(*h) + (size_t)h->unit_count * sizeof(*unit);
+    if (len < table_end)
+        goto err_out;
+
+    /* check the table once, so that users can rely on it */
+    unit = (const struct fw_patch_unit *)(buf + sizeof(*h));
+    for (i = 0; i < h->unit_count; i++, unit++) {
+        uint32_t offset = le32toh(unit->offset);
+        uint32_t length = le32toh(unit->length);
+        uint32_t data_offset = le32toh(unit->data_offset);
+
+        if (offset % h->erase_unit_size != 0 || (i > 0 && offset < prev_end))
+            goto err_out;
+        if (length != 0 && length != h->erase_unit_size)
+            goto err_out;
+        if (length && (data_offset < table_end || data_offset > len || len - data_offset < length))
+            goto err_out;
+
+        prev_end = (size_t)offset + h->erase_unit_size;
+    }
+
+    patch->buf = buf;
+    patch->len = len;
+
+    return 0;
+
+err_out:
+    errno = EINVAL;
+    return -1;
+}
+
+int fw_patch_foreach_unit(const struct fw_patch *patch, bool reverse,
+                          int (*cb)(uint32_t offset, const uint8_t *data, size_t length, void *ctx), void *ctx)
+{
+    const struct fw_patch_unit *table = (const struct fw_patch_unit *)(patch->buf + sizeof(patch->header));
+    size_t i;
+    int rv;
+
+    for (i = 0; i < patch->header.unit_count; i++) {
+        const struct fw_patch_unit *unit = &table[reverse ? patch->header.unit_count - 1 - i : i];
+        uint32_t length = le32toh(unit->length);
+
+        rv = cb(le32toh(unit->offset), length ? patch->buf + le32toh(unit->data_offset) : NULL, length, ctx);
+        if (rv)
+            return rv;
+    }
+
+    return 0;
+}
+
+bool fw_patch_matches_src(const struct fw_patch *patch, const struct version_app_infoblock *info)
+{
+    return fw_valid_version_app_infoblock(info) &&
+           info->git_hash == patch->header.src_git_hash &&
+           info->application_checksum == patch->header.src_application_checksum;
+}
+
+bool fw_patch_matches_dst(const struct fw_patch *patch, const struct version_app_infoblock *info)
+{
+    return fw_valid_version_app_infoblock(info) &&
+           info->git_hash == patch->header.dst_git_hash &&
+           info->application_checksum == patch->header.dst_application_checksum;
+}
+
+void fw_patch_dump(const struct fw_patch *patch)
+{
+    const struct fw_patch_unit *unit = (const struct fw_patch_unit *)(patch->buf + sizeof(patch->header));
+    size_t i, data_units = 0;
+
+    for (i = 0; i < patch->header.unit_count; i++)
+        if (unit[i].length)
+            data_units++;
+
+    printf("Source Git Hash:           %016" PRIx64 "\n", patch->header.src_git_hash);
+    printf("Source Checksum (CRC32):   0x%08" PRIx32 "\n", patch->header.src_application_checksum);
+    printf("Target Git Hash:           %016" PRIx64 "\n", patch->header.dst_git_hash);
+    printf("Target Checksum (CRC32):   0x%08" PRIx32 "\n", patch->header.dst_application_checksum);
+    printf("Target Size:               %" PRIu32 "\n", patch->header.dst_size);
+    printf("Erase Unit Size:           %" PRIu32 "\n", patch->header.erase_unit_size);
+    printf("Units to Write:            %zu\n", data_units);
+    printf("Units to Erase only:       %zu\n", patch->header.unit_count - data_units);
+
+    for (i = 0; i < patch->header.unit_count; i++)
+        printf("  0x%08" PRIx32 " %s\n", le32toh(unit[i].offset), unit[i].length ? "write" : "erase");
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "fw_file.h"
+
+/*
+ * A patch file describes how to turn the code flash content of a known source firmware
+ * into a target firmware by rewriting only the erase units which differ.
+ *
+ * It starts with the header below, followed by the table of unit records in ascending
+ * offset order and then the data of the units (erase_unit_size bytes each). Units which
+ * are blank (all 0xff) in the target firmware have no data, they only need to be erased.
+ * All values are little-endian.
+ */
+struct fw_patch_header {
+    uint32_t magic;                    ///< FW_PATCH_MAGIC
+    uint32_t crc;                      ///< CRC32 over the remaining file after this field
+    uint16_t version;                  ///< FW_PATCH_VERSION
+    uint16_t unit_count;               ///< count of unit records following the header
+    uint32_t erase_unit_size;          ///< erase unit size of the code flash the patch was made for
+    uint64_t src_git_hash;             ///< git hash of the firmware which must be present on the MCU
+    uint32_t src_application_checksum; ///< application checksum of this firmware
+    uint64_t dst_git_hash;             ///< git hash of the resulting firmware
+    uint32_t dst_application_checksum; ///< application checksum of the resulting firmware
+    uint32_t dst_size;                 ///< size of the resulting firmware image
+} __attribute__((packed));
+
+struct fw_patch_unit {
+    uint32_t offset;                   ///< offset relative to the start of the code flash
+    uint32_t length;                   ///< length of the data: 0 (erase only) or erase_unit_size
+    uint32_t data_offset;              ///< position of the data within the patch file
+} __attribute__((packed));
+
+/* value of the magic field: 'RAFP' */
+#define FW_PATCH_MAGIC 0x50464152
+
+/* latest patch file version this code understands */
+#define FW_PATCH_VERSION 1
+
+/* a parsed patch file, the header is converted to host endianness */
+struct fw_patch {
+    struct fw_patch_header header;
+
+    /* the (still mapped) file */
+    const uint8_t *buf;
+    size_t len;
+};
+
+/* CRC32 (IEEE 802.3) as used for the patch file */
+uint32_t fw_patch_crc32(const uint8_t *p, size_t len);
+
+/* compare source and target firmware images erase unit by erase unit and write the patch
+ * for the differing units to the given file; both images must carry a valid version app
+ * infoblock; returns the count of units in the patch or -1 on error (errno is set)
+ */
+int fw_patch_create(const uint8_t *src, size_t src_len, const uint8_t *dst, size_t dst_len,
+                    size_t erase_unit_size, FILE *f);
+
+/* check and parse a patch file in memory; returns 0 on success, -1 on error (errno is set) */
+int fw_patch_parse(const uint8_t *buf, size_t len, struct fw_patch *patch);
+
+/* call the given callback for each unit of a parsed patch in ascending offset order, or
+ * descending if reverse is set (data is NULL for units which only need to be erased);
+ * stops at the first callback which returns non-zero and returns its value, otherwise 0
+ */
+int fw_patch_foreach_unit(const struct fw_patch *patch, bool reverse,
+                          int (*cb)(uint32_t offset, const uint8_t *data, size_t length, void *ctx), void *ctx);
+
+/* returns true if the given infoblock (host endianness) describes the source or target
+ * firmware of the patch respectively
+ */
+bool fw_patch_matches_src(const struct fw_patch *patch, const struct version_app_infoblock *info);
+bool fw_patch_matches_dst(const struct fw_patch *patch, const struct version_app_infoblock *info);
+
+void fw_patch_dump(const struct fw_patch *patch);
@@ -0,0 +1,620 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <tools.h>
+#include "fw_store.h"
+
+/* first line of a manifest and its format version */
+#define FW_STORE_MANIFEST_MAGIC "# ra-utils snapshot"
+#define FW_STORE_MANIFEST_VERSION 1
+
+#define FW_STORE_HASH_STR_SIZE (2 * FW_STORE_HASH_SIZE + 1)
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror32(uint32_t x, unsigned int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_block(uint32_t *h, const uint8_t *p)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, hh, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+
+    for (i = 16; i < 64; i++)
+        w[i] = w[i - 16] + (ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+               w[i - 7] + (ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+    for (i = 0; i < 64; i++) {
+        t1 = hh + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+/* SHA-256 over a buffer in memory, chunks are small enough to not need a streaming API */
+static void fw_store_sha256(const uint8_t *p, size_t len, struct fw_store_hash *hash)
+{
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    uint64_t bits = (uint64_t)len * 8;
+    uint8_t tail[128];
+    size_t rest, tail_len;
+    int i;
+
+    for (rest = len; rest >= 64; rest -= 64, p += 64)
+        sha256_block(h, p);
+
+    /* padding: 0x80, zeros and the message length in bits, in one or two blocks */
+    tail_len = (rest < 56) ? 64 : 128;
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, p, rest);
+    tail[rest] = 0x80;
+    for (i = 0; i < 8; i++)
+        tail[tail_len - 1 - i] = bits >> (8 * i);
+
+    sha256_block(h, tail);
+    if (tail_len == 128)
+        sha256_block(h, tail + 64);
+
+    for (i = 0; i < 8; i++) {
+        hash->b[4 * i] = h[i] >> 24;
+        hash->b[4 * i + 1] = h[i] >> 16;
+        hash->b[4 * i + 2] = h[i] >> 8;
+        hash->b[4 * i + 3] = h[i];
+    }
+}
+
+char *fw_store_hash_to_str(const struct fw_store_hash *hash, char *buf)
+{
+    int i;
+
+    for (i = 0; i < FW_STORE_HASH_SIZE; i++)
+        sprintf(&buf[2 * i], "%02x", hash->b[i]);
+
+    return buf;
+}
+
+static int fw_store_hash_from_str(const char *s, struct fw_store_hash *hash)
+{
+    unsigned int v;
+    int i;
+
+    for (i = 0; i < FW_STORE_HASH_SIZE; i++) {
+        if (sscanf(&s[2 * i], "%2x", &v) != 1)
+            return -1;
+        hash->b[i] = v;
+    }
+
+    return 0;
+}
+
+static int fw_store_mkdir(const char *path)
+{
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+
+    return 0;
+}
+
+int fw_store_open(struct fw_store *store, const char *dir, bool create)
+{
+    static const char *subdirs[] = { "chunks", "snapshots", "firmware" };
+    struct stat st;
+    char *path;
+    unsigned int i;
+    int rv;
+
+    store->dir = strdup(dir);
+    if (!store->dir)
+        return -1;
+
+    if (create && fw_store_mkdir(dir))
+        goto err_out;
+
+    for (i = 0; i < ARRAY_SIZE(subdirs); i++) {
+        if (asprintf(&path, "%s/%s", dir, subdirs[i]) < 0)
+            goto err_out;
+
+        if (create)
+            rv = fw_store_mkdir(path);
+        else
+            rv = stat(path, &st);
+        free(path);
+
+        if (rv)
+            goto err_out;
+    }
+
+    return 0;
+
+err_out:
+    free(store->dir);
+    store->dir = NULL;
+    return -1;
+}
+
+void fw_store_close(struct fw_store *store)
+{
+    free(store->dir);
+    store->dir = NULL;
+}
+
+void fw_snapshot_free(struct fw_snapshot *snap)
+{
+    free(snap->chunks);
+    snap->chunks = NULL;
+    snap->chunk_count = 0;
+}
+
+static char *fw_store_chunk_path(struct fw_store *store, const struct fw_store_hash *hash, bool subdir_only)
+{
+    char hex[FW_STORE_HASH_STR_SIZE];
+    char *path;
+    int rv;
+
+    fw_store_hash_to_str(hash, hex);
+
+    if (subdir_only)
+        rv = asprintf(&path, "%s/chunks/%.2s", store->dir, hex);
+    else
+        rv = asprintf(&path, "%s/chunks/%.2s/%s", store->dir, hex, hex + 2);
+
+    return (rv < 0) ? NULL : path;
+}
+
+/* write a file via a temporary file in the same directory, so that the store never
+ * contains partial chunks or manifests */
+static int fw_store_write_file(const char *path, const void *buf, size_t len)
+{
+    const char *base = strrchr(path, '/');
+    int saved_errno;
+    char *tmp_path;
+    FILE *f;
+
+    /* hidden, so that it is never taken for a snapshot */
+    base = base ? base + 1 : path;
+    if (asprintf(&tmp_path, "%.*s.%s.%d.tmp", (int)(base - path), path, base, (int)getpid()) < 0)
+        return -1;
+
+    f = fopen(tmp_path, "wb");
+    if (!f)
+        goto err_out;
+
+    if (len && fwrite(buf, len, 1, f) != 1) {
+        saved_errno = errno;
+        fclose(f);
+        errno = saved_errno;
+        goto unlink_out;
+    }
+
+    if (fclose(f) == EOF)
+        goto unlink_out;
+
+    if (rename(tmp_path, path))
+        goto unlink_out;
+
+    free(tmp_path);
+    return 0;
+
+unlink_out:
+    saved_errno = errno;
+    unlink(tmp_path);
+    errno = saved_errno;
+err_out:
+    free(tmp_path);
+    return -1;
+}
+
+static int fw_store_put_chunk(struct fw_store *store, const struct fw_store_hash *hash,
+                              const uint8_t *buf, size_t len)
+{
+    char *path, *dir;
+    int rv = -1;
+
+    path = fw_store_chunk_path(store, hash, false);
+    if (!path)
+        return -1;
+
+    /* content-addressed: an existing chunk has the same content */
+    if (access(path, F_OK) == 0) {
+        rv = 0;
+        goto free_out;
+    }
+
+    dir = fw_store_chunk_path(store, hash, true);
+    if (!dir)
+        goto free_out;
+
+    rv = fw_store_mkdir(dir);
+    free(dir);
+    if (rv)
+        goto free_out;
+
+    rv = fw_store_write_file(path, buf, len);
+    if (rv == 0)
+        rv = 1;
+
+free_out:
+    free(path);
+    return rv;
+}
+
+int fw_store_put(struct fw_store *store, const uint8_t *buf, size_t len, size_t erase_unit_size,
+                 struct fw_snapshot *snap)
+{
+    unsigned int i, count;
+    size_t offset, n;
+    int rv, added = 0;
+
+    if (erase_unit_size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    count = (len + erase_unit_size - 1) / erase_unit_size;
+
+    snap->chunks = calloc(count ?: 1, sizeof(*snap->chunks));
+    if (!snap->chunks)
+        return -1;
+
+    snap->chunk_count = count;
+    snap->size = len;
+    snap->erase_unit_size = erase_unit_size;
+
+    for (i = 0, offset = 0; i < count; i++, offset += erase_unit_size) {
+        n = min(len - offset, erase_unit_size);
+
+        fw_store_sha256(buf + offset, n, &snap->chunks[i]);
+
+        rv = fw_store_put_chunk(store, &snap->chunks[i], buf + offset, n);
+        if (rv < 0) {
+            fw_snapshot_free(snap);
+            return -1;
+        }
+        added += rv;
+    }
+
+    return added;
+}
+
+int fw_store_get_chunk(struct fw_store *store, const struct fw_store_hash *hash, uint8_t *buf, size_t len)
+{
+    struct fw_store_hash check;
+    int saved_errno;
+    char *path;
+    FILE *f;
+
+    path = fw_store_chunk_path(store, hash, false);
+    if (!path)
+        return -1;
+
+    f = fopen(path, "rb");
+    saved_errno = errno;
+    free(path);
+    if (!f) {
+        errno = saved_errno;
+        return -1;
+    }
+
+    if ((len && fread(buf, len, 1, f) != 1) || fgetc(f) != EOF) {
+        fclose(f);
+        errno = EBADMSG;
+        return -1;
+    }
+    fclose(f);
+
+    fw_store_sha256(buf, len, &check);
+    if (memcmp(&check, hash, sizeof(check)) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+int fw_store_restore(struct fw_store *store, const struct fw_snapshot *snap, uint8_t *buf)
+{
+    size_t offset;
+    unsigned int i;
+
+    for (i = 0, offset = 0; i < snap->chunk_count; i++, offset += snap->erase_unit_size) {
+        if (fw_store_get_chunk(store, &snap->chunks[i], buf + offset,
+                               min(snap->size - offset, snap->erase_unit_size)))
+            return -1;
+    }
+
+    return 0;
+}
+
+/* snapshot names are plain file names */
+static bool fw_store_valid_name(const char *name)
+{
+    return name[0] != '\0' && name[0] != '.' && !strchr(name, '/') && strlen(name) <= NAME_MAX - 16;
+}
+
+static int fw_store_write_manifest(struct fw_store *store, const char *subdir, const char *name,
+                                   const struct fw_snapshot *snap)
+{
+    char hex[FW_STORE_HASH_STR_SIZE];
+    char *path = NULL, *buf = NULL;
+    size_t len = 0;
+    unsigned int i;
+    FILE *f;
+    int rv = -1;
+
+    if (!fw_store_valid_name(name)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* the manifest is built in memory and then written in one go */
+    f = open_memstream(&buf, &len);
+    if (!f)
+        return -1;
+
+    fprintf(f, FW_STORE_MANIFEST_MAGIC "\n");
+    fprintf(f, "version %d\n", FW_STORE_MANIFEST_VERSION);
+    fprintf(f, "area %s\n", snap->area);
+    fprintf(f, "size %zu\n", snap->size);
+    fprintf(f, "erase-unit-size %zu\n", snap->erase_unit_size);
+    if (snap->has_firmware)
+        fprintf(f, "firmware %016" PRIx64 " %08" PRIx32 "\n", snap->git_hash, snap->application_checksum);
+    if (snap->from_store)
+        fprintf(f, "from-store %zu\n", snap->from_store);
+    fprintf(f, "chunks %u\n", snap->chunk_count);
+    for (i = 0; i < snap->chunk_count; i++)
+        fprintf(f, "%08zx %s\n", i * snap->erase_unit_size, fw_store_hash_to_str(&snap->chunks[i], hex));
+
+    if (fclose(f) == EOF)
+        goto free_out;
+
+    if (asprintf(&path, "%s/%s/%s", store->dir, subdir, name) < 0) {
+        path = NULL;
+        goto free_out;
+    }
+
+    rv = fw_store_write_file(path, buf, len);
+
+free_out:
+    free(path);
+    free(buf);
+    return rv;
+}
+
+static int fw_store_read_manifest(struct fw_store *store, const char *subdir, const char *name,
+                                  struct fw_snapshot *snap)
+{
+    char line[256], hex[FW_STORE_HASH_STR_SIZE];
+    unsigned int version, i = 0;
+    size_t offset;
+    char *path;
+    FILE *f;
+
+    memset(snap, 0, sizeof(*snap));
+
+    if (!fw_store_valid_name(name)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (asprintf(&path, "%s/%s/%s", store->dir, subdir, name) < 0)
+        return -1;
+
+    f = fopen(path, "r");
+    free(path);
+    if (!f)
+        return -1;
+
+    if (!fgets(line, sizeof(line), f) || strncmp(line, FW_STORE_MANIFEST_MAGIC "\n", sizeof(line)) != 0)
+        goto inval_out;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (!snap->chunks) {
+            if (sscanf(line, "version %u", &version) == 1) {
+                if (version != FW_STORE_MANIFEST_VERSION)
+                    goto inval_out;
+            } else if (sscanf(line, "area %15s", snap->area) == 1) {
+                continue;
+            } else if (sscanf(line, "size %zu", &snap->size) == 1) {
+                continue;
+            } else if (sscanf(line, "erase-unit-size %zu", &snap->erase_unit_size) == 1) {
+                continue;
+            } else if (sscanf(line, "firmware %" SCNx64 " %" SCNx32,
+                              &snap->git_hash, &snap->application_checksum) == 2) {
+                snap->has_firmware = true;
+            } else if (sscanf(line, "from-store %zu", &snap->from_store) == 1) {
+                continue;
+            } else if (sscanf(line, "chunks %u", &snap->chunk_count) == 1) {
+                if (snap->erase_unit_size == 0 || snap->from_store > snap->size ||
+                    snap->chunk_count != (snap->size + snap->erase_unit_size - 1) / snap->erase_unit_size)
+                    goto inval_out;
+
+                snap->chunks = calloc(snap->chunk_count ?: 1, sizeof(*snap->chunks));
+                if (!snap->chunks)
+                    goto err_out;
+            } else {
+                goto inval_out;
+            }
+            continue;
+        }
+
+        if (i >= snap->chunk_count ||
+            sscanf(line, "%zx %64s", &offset, hex) != 2 ||
+            offset != i * snap->erase_unit_size ||
+            strlen(hex) != FW_STORE_HASH_STR_SIZE - 1 ||
+            fw_store_hash_from_str(hex, &snap->chunks[i]))
+            goto inval_out;
+        i++;
+    }
+
+    if (!snap->chunks || i != snap->chunk_count)
+        goto inval_out;
+
+    fclose(f);
+    return 0;
+
+inval_out:
+    errno = EINVAL;
+err_out:
+    fclose(f);
+    fw_snapshot_free(snap);
+    return -1;
+}
+
+int fw_store_save_snapshot(struct fw_store *store, const char *name, const struct fw_snapshot *snap)
+{
+    return fw_store_write_manifest(store, "snapshots", name, snap);
+}
+
+int fw_store_load_snapshot(struct fw_store *store, const char *name, struct fw_snapshot *snap)
+{
+    return fw_store_read_manifest(store, "snapshots", name, snap);
+}
+
+static void fw_store_firmware_name(char *buf, size_t len, uint64_t git_hash, uint32_t application_checksum)
+{
+    snprintf(buf, len, "%016" PRIx64 "-%08" PRIx32, git_hash, application_checksum);
+}
+
+int fw_store_save_firmware(struct fw_store *store, const struct fw_snapshot *snap, size_t application_size)
+{
+    struct fw_snapshot app = *snap;
+    char name[32];
+
+    if (!snap->has_firmware || application_size == 0 || application_size > snap->size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    app.chunk_count = (application_size + snap->erase_unit_size - 1) / snap->erase_unit_size;
+    app.size = min(app.chunk_count * snap->erase_unit_size, snap->size);
+    app.from_store = 0;
+
+    fw_store_firmware_name(name, sizeof(name), snap->git_hash, snap->application_checksum);
+
+    return fw_store_write_manifest(store, "firmware", name, &app);
+}
+
+int fw_store_load_firmware(struct fw_store *store, uint64_t git_hash, uint32_t application_checksum,
+                           struct fw_snapshot *snap)
+{
+    char name[32];
+
+    fw_store_firmware_name(name, sizeof(name), git_hash, application_checksum);
+
+    if (fw_store_read_manifest(store, "firmware", name, snap))
+        return -1;
+
+    if (!snap->has_firmware || snap->git_hash != git_hash ||
+        snap->application_checksum != application_checksum) {
+        fw_snapshot_free(snap);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+bool fw_store_has_firmware(struct fw_store *store, uint64_t git_hash, uint32_t application_checksum)
+{
+    struct fw_snapshot app = {};
+
+    if (fw_store_load_firmware(store, git_hash, application_checksum, &app))
+        return false;
+
+    fw_snapshot_free(&app);
+    return true;
+}
+
+static int fw_store_cmp_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+int fw_store_foreach_snapshot(struct fw_store *store, int (*cb)(const char *name, void *ctx), void *ctx)
+{
+    char **names = NULL, **tmp;
+    size_t count = 0, i;
+    struct dirent *de;
+    char *path;
+    DIR *dir;
+    int rv = 0;
+
+    if (asprintf(&path, "%s/snapshots", store->dir) < 0)
+        return -1;
+
+    dir = opendir(path);
+    free(path);
+    if (!dir)
+        return -1;
+
+    /* collect the names first to present them sorted */
+    while ((de = readdir(dir))) {
+        if (!fw_store_valid_name(de->d_name))
+            continue;
+
+        tmp = realloc(names, (count + 1) * sizeof(*names));
+        if (!tmp)
+            goto err_out;
+        names = tmp;
+
+        names[count] = strdup(de->d_name);
+        if (!names[count])
+            goto err_out;
+        count++;
+    }
+
+    qsort(names, count, sizeof(*names), fw_store_cmp_names);
+
+    for (i = 0; i < count && rv == 0; i++)
+        rv = cb(names[i], ctx);
+
+    goto free_out;
+
+err_out:
+    rv = -1;
+free_out:
+    for (i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    closedir(dir);
+    return rv;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A snapshot store keeps flash dumps deduplicated: each dump is split into erase units,
+ * every unit is stored once as a chunk file named by its SHA-256 and a snapshot is only
+ * a small text manifest listing the chunk hashes. The store directory looks like this:
+ *
+ *   <dir>/chunks/<first two hex digits>/<remaining hex digits>
+ *   <dir>/snapshots/<name>
+ *   <dir>/firmware/<git hash>-<application checksum>
+ *
+ * The manifests below 'firmware' have the same format and remember which chunks make up
+ * the application of a firmware identified by its version app infoblock, so that these
+ * units need not be read again from another MCU running the same firmware.
+ */
+
+#define FW_STORE_HASH_SIZE 32
+
+struct fw_store_hash {
+    uint8_t b[FW_STORE_HASH_SIZE];
+};
+
+struct fw_store {
+    char *dir;
+};
+
+struct fw_snapshot {
+    /* flash area the dump was taken from: "code", "data" or "image" for imported files */
+    char area[16];
+
+    /* size of the dump and of the chunks */
+    size_t size;
+    size_t erase_unit_size;
+
+    /* identification of the firmware in the dump, if it contains a valid infoblock */
+    bool has_firmware;
+    uint64_t git_hash;
+    uint32_t application_checksum;
+
+    /* count of bytes at the start of the dump which were not read from the flash but taken
+     * from the firmware known in the store (0: everything was read) */
+    size_t from_store;
+
+    /* one hash per erase unit, the last unit may be shorter */
+    unsigned int chunk_count;
+    struct fw_store_hash *chunks;
+};
+
+/* open a store, the directory and its subdirectories are created if requested;
+ * returns 0 on success, -1 on error (errno is set) */
+int fw_store_open(struct fw_store *store, const char *dir, bool create);
+void fw_store_close(struct fw_store *store);
+
+/* split the given buffer into chunks, add the missing ones to the store and describe them
+ * in the snapshot; returns the count of newly stored chunks or -1 on error (errno is set) */
+int fw_store_put(struct fw_store *store, const uint8_t *buf, size_t len, size_t erase_unit_size,
+                 struct fw_snapshot *snap);
+
+/* read a chunk and check its hash; returns 0 on success, -1 on error (errno is set,
+ * EBADMSG if the content does not match the hash) */
+int fw_store_get_chunk(struct fw_store *store, const struct fw_store_hash *hash, uint8_t *buf, size_t len);
+
+/* reassemble the content of a snapshot into buf (snap->size bytes); returns 0 on success,
+ * -1 on error (errno is set) */
+int fw_store_restore(struct fw_store *store, const struct fw_snapshot *snap, uint8_t *buf);
+
+/* write or read the manifest of a named snapshot; returns 0 on success, -1 on error
+ * (errno is set, EINVAL for malformed names or manifests) */
+int fw_store_save_snapshot(struct fw_store *store, const char *name, const struct fw_snapshot *snap);
+int fw_store_load_snapshot(struct fw_store *store, const char *name, struct fw_snapshot *snap);
+
+/* remember the chunks of the application in a code flash snapshot (which must have
+ * a firmware identification) or look them up by git hash and application checksum;
+ * the looked up snapshot only covers the application, rounded up to full chunks */
+int fw_store_save_firmware(struct fw_store *store, const struct fw_snapshot *snap, size_t application_size);
+int fw_store_load_firmware(struct fw_store *store, uint64_t git_hash, uint32_t application_checksum,
+                           struct fw_snapshot *snap);
+bool fw_store_has_firmware(struct fw_store *store, uint64_t git_hash, uint32_t application_checksum);
+
+/* call the callback for each snapshot name in the store; stops at the first callback
+ * which returns non-zero and returns its value, otherwise 0 (-1 on error) */
+int fw_store_foreach_snapshot(struct fw_store *store, int (*cb)(const char *name, void *ctx), void *ctx);
+
+void fw_snapshot_free(struct fw_snapshot *snap);
+
+/* format a hash as lower-case hex string, buf must hold 2 * FW_STORE_HASH_SIZE + 1 chars */
+char *fw_store_hash_to_str(const struct fw_store_hash *hash, char *buf);
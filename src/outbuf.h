@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <cb_proto_field.h>
+
+/*
+ * Formatting with printf is the bottleneck when decoding millions of frames,
+ * so we use a simple output buffer with specialized append helpers.
+ * Nothing is allocated while formatting, so this is also suitable for
+ * continuous streaming at full frame rate.
+ * Since the append helpers flush implicitly, a write error is remembered and
+ * reported by the next explicit ob_flush().
+ */
+#define OUTBUF_SIZE (256 * 1024)
+
+struct outbuf {
+    FILE *f;
+    size_t len;
+    int err;
+    char buf[OUTBUF_SIZE];
+};
+
+static inline int ob_flush(struct outbuf *ob)
+{
+    if (ob->len && fwrite(ob->buf, 1, ob->len, ob->f) != ob->len && !ob->err)
+        ob->err = errno ?: EIO;
+    ob->len = 0;
+
+    if (ob->err) {
+        errno = ob->err;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ensure that at least n bytes are available */
+static inline char *ob_reserve(struct outbuf *ob, size_t n)
+{
+    if (ob->len + n > sizeof(ob->buf))
+        ob_flush(ob);
+
+    return ob->buf + ob->len;
+}
+
+static inline void ob_putc(struct outbuf *ob, char c)
+{
+    *ob_reserve(ob, 1) = c;
+    ob->len++;
+}
+
+static inline void ob_puts(struct outbuf *ob, const char *s)
+{
+    size_t n = strlen(s);
+
+    memcpy(ob_reserve(ob, n), s, n);
+    ob->len += n;
+}
+
+static inline void ob_u64(struct outbuf *ob, uint64_t v, unsigned int min_digits)
+{
+    char tmp[24];
+    unsigned int n = 0;
+
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v || n < min_digits);
+
+    ob_reserve(ob, n);
+    while (n)
+        ob->buf[ob->len++] = tmp[--n];
+}
+
+static inline void ob_i32(struct outbuf *ob, int32_t v)
+{
+    if (v < 0) {
+        ob_putc(ob, '-');
+        ob_u64(ob, -(int64_t)v, 1);
+    } else {
+        ob_u64(ob, v, 1);
+    }
+}
+
+static inline void ob_hex64(struct outbuf *ob, uint64_t v)
+{
+    static const char digits[] = "0123456789abcdef";
+    char *p = ob_reserve(ob, 18);
+    int i;
+
+    *p++ = '0';
+    *p++ = 'x';
+    for (i = 60; i >= 0; i -= 4)
+        *p++ = digits[(v >> i) & 0xf];
+
+    ob->len += 18;
+}
+
+/* local time, formatting is cached per second */
+static inline void ob_ts_text(struct outbuf *ob, uint64_t ts_ns)
+{
+    static time_t cached_sec = (time_t)-1;
+    static char cached[24];
+    time_t sec = ts_ns / 1000000000ULL;
+
+    if (ts_ns == 0) {
+        ob_puts(ob, "-");
+        return;
+    }
+
+    if (sec != cached_sec) {
+        struct tm tm;
+
+        localtime_r(&sec, &tm);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S.", &tm);
+        cached_sec = sec;
+    }
+
+    ob_puts(ob, cached);
+    ob_u64(ob, (ts_ns % 1000000000ULL) / 1000, 6);
+}
+
+/* seconds since epoch with microseconds, as number */
+static inline void ob_ts_epoch(struct outbuf *ob, uint64_t ts_ns)
+{
+    ob_u64(ob, ts_ns / 1000000000ULL, 1);
+    ob_putc(ob, '.');
+    ob_u64(ob, (ts_ns % 1000000000ULL) / 1000, 6);
+}
+
+/* JSON uses true/false for booleans, text and CSV yes/no; enum strings can be quoted */
+static inline void ob_field_value(struct outbuf *ob, const struct cb_proto_field *field, int32_t v,
+                                  bool json, bool quote)
+{
+    switch (field->type) {
+    case CB_PROTO_FIELD_BOOL:
+        if (json)
+            ob_puts(ob, v ? "true" : "false");
+        else
+            ob_puts(ob, v ? "yes" : "no");
+        break;
+    case CB_PROTO_FIELD_ENUM:
+        /* enum strings don't contain quotes, but might contain commas */
+        if (quote)
+            ob_putc(ob, '"');
+        ob_puts(ob, field->to_str(v));
+        if (quote)
+            ob_putc(ob, '"');
+        break;
+    case CB_PROTO_FIELD_NUMBER:
+        if (field->scale == 10) {
+            if (v < 0) {
+                ob_putc(ob, '-');
+                v = -v;
+            }
+            ob_i32(ob, v / 10);
+            ob_putc(ob, '.');
+            ob_putc(ob, '0' + v % 10);
+        } else {
+            ob_i32(ob, v);
+        }
+        break;
+    }
+}
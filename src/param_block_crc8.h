@@ -1,10 +0,0 @@
-/*
- * Copyright © 2025 chargebyte GmbH
- * SPDX-License-Identifier: Apache-2.0
- */
-#pragma once
-
-#include <stdint.h>
-#include <stdio.h>
-
-uint8_t crc8(uint8_t *p, size_t len);
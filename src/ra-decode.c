@@ -0,0 +1,571 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This is a command line tool to decode captures of the CAN mirror (see ra-raw -M)
+ * back into safety controller semantics. Supported input formats are text output of
+ * candump (default, '-t a/A/d/z' and '-L' log format) and pcap/pcapng files
+ * with SocketCAN link type (e.g. captured by Wireshark/tcpdump).
+ *
+ * Usage: ra-decode [<options>] <capture file> [<capture file>...]
+ *
+ * Options:
+ *         -f, --format            output format: text (state transitions), json, csv or log (default: text)
+ *         -o, --output            write output to this file (required for format 'log')
+ *         -a, --all               text format: print each frame, not only state transitions
+ *         -v, --verbose           verbose operation
+ *         -V, --version           print version and exit
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <linux/can.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_proto_field.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <frame_log.h>
+#include <logging.h>
+#include <tools.h>
+#include <version.h>
+#include "can_capture.h"
+#include "outbuf.h"
+
+/* fallback if not set by build system */
+#ifndef PACKAGE_STRING
+#define PACKAGE_STRING "ra-utils (unknown version)"
+#endif
+
+/* command line options */
+static const struct option long_options[] = {
+    { "format",             required_argument,      0,      'f' },
+    { "output",             required_argument,      0,      'o' },
+    { "all",                no_argument,            0,      'a' },
+
+    { "verbose",            no_argument,            0,      'v' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "f:o:avVh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "output format: text (state transitions), json, csv or log (default: text)",
+    "write output to this file (required for format 'log')",
+    "text format: print each frame, not only state transitions",
+
+    "verbose operation",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to decode captured CAN mirror traffic\n\n"
+            "Usage: %s [<options>] <capture file> [<capture file>...]\n\n",
+            p, PACKAGE_STRING, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-12s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-12s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* upper limit of registered fields we can handle */
+#define FRAME_FIELDS_MAX 64
+
+/* maximum length of a formatted field value */
+#define CSV_CELL_MAX 48
+
+enum output_format {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_CSV,
+    FORMAT_LOG,
+};
+
+/* to simplify, these are globals */
+static bool verbose = false;
+static bool all_frames = false;
+static enum output_format format = FORMAT_TEXT;
+static const char *output_filename = NULL;
+
+static void debug_cb(const char *format, va_list args)
+{
+    if (verbose) {
+        fprintf(stderr, "debug: ");
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+    }
+}
+
+static void error_cb(const char *format, va_list args)
+{
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'f':
+            if (strcmp(optarg, "text") == 0) {
+                format = FORMAT_TEXT;
+            } else if (strcmp(optarg, "json") == 0) {
+                format = FORMAT_JSON;
+            } else if (strcmp(optarg, "csv") == 0) {
+                format = FORMAT_CSV;
+            } else if (strcmp(optarg, "log") == 0) {
+                format = FORMAT_LOG;
+            } else {
+                fprintf(stderr, "Error: unknown output format '%s'.\n\n", optarg);
+                usage(argv[0], EXIT_FAILURE);
+            }
+            break;
+        case 'o':
+            output_filename = optarg;
+            break;
+        case 'a':
+            all_frames = true;
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            /* fall-through */
+        default:
+            usage(argv[0], rc);
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "Error: at least one capture file is required.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    if (format == FORMAT_LOG && !output_filename) {
+        fprintf(stderr, "Error: format 'log' requires an output file.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+}
+
+/* decoder state, shared across all input files so that they can be given in chronological order */
+struct decoder {
+    struct outbuf *ob;
+    struct frame_log *log;
+    struct safety_controller ctx;
+
+    /* field indexes carried by each frame type */
+    uint8_t fields_by_com[COM_MAX + 1][FRAME_FIELDS_MAX];
+    uint8_t field_count_by_com[COM_MAX + 1];
+
+    /* last seen value of each field */
+    int32_t values[FRAME_FIELDS_MAX];
+    bool seen[FRAME_FIELDS_MAX];
+
+    /* CSV: formatted value of each field, re-formatted only when a frame carries it */
+    char cells[FRAME_FIELDS_MAX][CSV_CELL_MAX];
+    uint8_t cell_len[FRAME_FIELDS_MAX];
+
+    /* CSV: all cells joined, rebuilt only when a cell changed */
+    char row[FRAME_FIELDS_MAX * (CSV_CELL_MAX + 1)];
+    size_t row_len;
+    bool row_dirty;
+
+    /* statistics */
+    unsigned long frames;
+    unsigned long ignored;
+};
+
+static void decoder_init(struct decoder *dec, struct outbuf *ob)
+{
+    unsigned int count = cb_proto_field_count();
+    unsigned int com, f;
+
+    memset(dec, 0, sizeof(*dec));
+    dec->ob = ob;
+
+    /* initial values in CSV output reflect the zero-initialized context */
+    for (f = 0; f < count && f < FRAME_FIELDS_MAX; f++) {
+        const struct cb_proto_field *field = cb_proto_field_by_index(f);
+        size_t start;
+
+        ob_reserve(ob, CSV_CELL_MAX);
+        start = ob->len;
+        ob_field_value(ob, field, field->get(&dec->ctx), false, true);
+        dec->cell_len[f] = ob->len - start;
+        memcpy(dec->cells[f], ob->buf + start, dec->cell_len[f]);
+        ob->len = start;
+    }
+    dec->row_dirty = true;
+
+    for (com = 0; com <= COM_MAX; com++)
+        for (f = 0; f < count && f < FRAME_FIELDS_MAX; f++)
+            if (cb_proto_field_is_carried_by(cb_proto_field_by_index(f), com))
+                dec->fields_by_com[com][dec->field_count_by_com[com]++] = f;
+}
+
+static void print_csv_header(struct outbuf *ob)
+{
+    unsigned int f;
+
+    ob_puts(ob, "ts,com,data");
+    for (f = 0; f < cb_proto_field_count(); f++) {
+        ob_putc(ob, ',');
+        ob_puts(ob, cb_proto_field_by_index(f)->name);
+    }
+    ob_putc(ob, '\n');
+}
+
+/* the CAN mirror does not know the direction, but these frame types are only sent by the host */
+static bool com_is_tx(uint8_t com)
+{
+    return com == COM_CHARGE_CONTROL || com == COM_CHARGE_CONTROL_2 || com == COM_INQUIRY;
+}
+
+/* additional information on frames which carry no (registered) fields */
+static void text_frame_info(struct decoder *dec, uint8_t com, uint64_t ts_ns)
+{
+    struct outbuf *ob = dec->ob;
+    const char *label, *value;
+
+    switch (com) {
+    case COM_FW_VERSION:
+        label = "fw_version";
+        value = dec->ctx.fw_version_str;
+        break;
+    case COM_GIT_HASH:
+        label = "git_hash";
+        value = dec->ctx.git_hash_str;
+        break;
+    case COM_PARTNUMBER_2:
+        label = "partnumber";
+        value = dec->ctx.partnumber_str;
+        break;
+    default:
+        return;
+    }
+
+    ob_ts_text(ob, ts_ns);
+    ob_putc(ob, ' ');
+    ob_puts(ob, label);
+    ob_puts(ob, ": ");
+    ob_puts(ob, value);
+    ob_putc(ob, '\n');
+}
+
+static int decode_frame(const struct can_capture_frame *frame, void *arg)
+{
+    struct decoder *dec = arg;
+    struct outbuf *ob = dec->ob;
+    uint8_t com;
+    uint64_t data;
+    unsigned int i;
+    bool first = true;
+
+    /* the CAN mirror uses extended frames with the COM value as ID and always 8 data bytes */
+    if (!(frame->can_id & CAN_EFF_FLAG) || (frame->can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) ||
+        (frame->can_id & CAN_EFF_MASK) > 0xff || frame->len != 8) {
+        dec->ignored++;
+        return 0;
+    }
+
+    com = frame->can_id & 0xff;
+    memcpy(&data, frame->data, sizeof(data));
+    data = be64toh(data);
+
+    dec->frames++;
+
+    cb_proto_store_frame(&dec->ctx, com, data);
+
+    switch (format) {
+    case FORMAT_LOG: {
+        struct frame_log_record rec = {};
+
+        rec.ts_ns = htole64(frame->ts_ns);
+        rec.data = htole64(data);
+        rec.com = com;
+        rec.flags = com_is_tx(com) ? FRAME_LOG_FLAG_TX : 0;
+
+        if (frame_log_append_record(dec->log, &rec)) {
+            error("writing to '%s' failed: %m", output_filename);
+            return -1;
+        }
+        break;
+    }
+
+    case FORMAT_JSON:
+        ob_puts(ob, "{\"ts\":");
+        ob_ts_epoch(ob, frame->ts_ns);
+        ob_puts(ob, ",\"com\":\"");
+        ob_puts(ob, cb_uart_com_to_str(com));
+        ob_puts(ob, "\",\"data\":\"");
+        ob_hex64(ob, data);
+        ob_puts(ob, "\",\"fields\":{");
+        for (i = 0; i < dec->field_count_by_com[com]; i++) {
+            const struct cb_proto_field *field = cb_proto_field_by_index(dec->fields_by_com[com][i]);
+
+            if (i)
+                ob_putc(ob, ',');
+            ob_putc(ob, '"');
+            ob_puts(ob, field->name);
+            ob_puts(ob, "\":");
+            ob_field_value(ob, field, field->get(&dec->ctx), true, true);
+        }
+        ob_puts(ob, "}}\n");
+        break;
+
+    case FORMAT_CSV:
+        ob_ts_epoch(ob, frame->ts_ns);
+        ob_putc(ob, ',');
+        ob_puts(ob, cb_uart_com_to_str(com));
+        ob_putc(ob, ',');
+        ob_hex64(ob, data);
+        /* format the fields of this frame into the cache first */
+        for (i = 0; i < dec->field_count_by_com[com]; i++) {
+            unsigned int f = dec->fields_by_com[com][i];
+            const struct cb_proto_field *field = cb_proto_field_by_index(f);
+            size_t start, len;
+
+            ob_reserve(ob, CSV_CELL_MAX);
+            start = ob->len;
+            ob_field_value(ob, field, field->get(&dec->ctx), false, true);
+            len = ob->len - start;
+            ob->len = start;
+
+            if (len != dec->cell_len[f] || memcmp(dec->cells[f], ob->buf + start, len) != 0) {
+                dec->cell_len[f] = len;
+                memcpy(dec->cells[f], ob->buf + start, len);
+                dec->row_dirty = true;
+            }
+        }
+
+        if (dec->row_dirty) {
+            dec->row_len = 0;
+            for (i = 0; i < cb_proto_field_count(); i++) {
+                dec->row[dec->row_len++] = ',';
+                memcpy(dec->row + dec->row_len, dec->cells[i], dec->cell_len[i]);
+                dec->row_len += dec->cell_len[i];
+            }
+            dec->row[dec->row_len++] = '\n';
+            dec->row_dirty = false;
+        }
+
+        memcpy(ob_reserve(ob, dec->row_len), dec->row, dec->row_len);
+        ob->len += dec->row_len;
+        break;
+
+    case FORMAT_TEXT:
+        if (all_frames) {
+            ob_ts_text(ob, frame->ts_ns);
+            ob_putc(ob, ' ');
+            ob_puts(ob, cb_uart_com_to_str(com));
+            ob_putc(ob, ' ');
+            ob_hex64(ob, data);
+            ob_putc(ob, '\n');
+        }
+
+        text_frame_info(dec, com, frame->ts_ns);
+
+        for (i = 0; i < dec->field_count_by_com[com]; i++) {
+            unsigned int f = dec->fields_by_com[com][i];
+            const struct cb_proto_field *field = cb_proto_field_by_index(f);
+            int32_t v = field->get(&dec->ctx);
+
+            if (dec->seen[f] && dec->values[f] == v)
+                continue;
+
+            if (first && !all_frames) {
+                ob_ts_text(ob, frame->ts_ns);
+                ob_putc(ob, ' ');
+                ob_puts(ob, cb_uart_com_to_str(com));
+                ob_putc(ob, '\n');
+            }
+            first = false;
+
+            ob_puts(ob, "    ");
+            ob_puts(ob, field->name);
+            ob_puts(ob, ": ");
+            if (dec->seen[f]) {
+                ob_field_value(ob, field, dec->values[f], false, false);
+                ob_puts(ob, " -> ");
+            }
+            ob_field_value(ob, field, v, false, false);
+            ob_putc(ob, '\n');
+
+            dec->values[f] = v;
+            dec->seen[f] = true;
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static int decode_file(struct decoder *dec, const char *filename)
+{
+    struct stat sb;
+    void *addr;
+    int fd, rv;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error("could not open '%s': %m", filename);
+        return -1;
+    }
+
+    if (fstat(fd, &sb)) {
+        error("could not stat '%s': %m", filename);
+        close(fd);
+        return -1;
+    }
+
+    if (sb.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        error("could not map '%s': %m", filename);
+        return -1;
+    }
+
+    madvise(addr, sb.st_size, MADV_SEQUENTIAL);
+
+    debug("'%s' looks like a %s file", filename, can_capture_format_to_str(can_capture_detect(addr, sb.st_size)));
+
+    rv = can_capture_parse(addr, sb.st_size, decode_frame, dec);
+    if (rv < 0 && errno != 0)
+        error("decoding '%s' failed: %m", filename);
+
+    munmap(addr, sb.st_size);
+    return rv;
+}
+
+int main(int argc, char *argv[])
+{
+    struct decoder *dec;
+    struct outbuf *ob;
+    int rc = EXIT_SUCCESS;
+    int i;
+
+    /* register debug and error message callbacks */
+    ra_utils_set_error_msg_cb(error_cb);
+    ra_utils_set_debug_msg_cb(debug_cb);
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    if (cb_proto_field_count() > FRAME_FIELDS_MAX) {
+        error("too many fields registered");
+        return EXIT_FAILURE;
+    }
+
+    ob = calloc(1, sizeof(*ob));
+    dec = calloc(1, sizeof(*dec));
+    if (!ob || !dec) {
+        error("out of memory");
+        return EXIT_FAILURE;
+    }
+
+    ob->f = stdout;
+    decoder_init(dec, ob);
+
+    if (format == FORMAT_LOG) {
+        dec->log = frame_log_open(output_filename);
+        if (!dec->log) {
+            error("opening '%s' failed: %m", output_filename);
+            return EXIT_FAILURE;
+        }
+    } else if (output_filename) {
+        ob->f = fopen(output_filename, "w");
+        if (!ob->f) {
+            error("opening '%s' failed: %m", output_filename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (format == FORMAT_CSV)
+        print_csv_header(ob);
+
+    for (i = optind; i < argc; i++) {
+        if (decode_file(dec, argv[i])) {
+            rc = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    if (ob_flush(ob)) {
+        error("writing the output failed: %m");
+        rc = EXIT_FAILURE;
+    }
+
+    debug("%lu frames decoded, %lu CAN frames ignored", dec->frames, dec->ignored);
+
+    if (dec->log && frame_log_close(dec->log)) {
+        error("closing '%s' failed: %m", output_filename);
+        rc = EXIT_FAILURE;
+    }
+
+    if (ob->f != stdout && fclose(ob->f)) {
+        error("closing '%s' failed: %m", output_filename);
+        rc = EXIT_FAILURE;
+    }
+
+    free(dec);
+    free(ob);
+
+    return rc;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Command line tool to create a patch file which turns a known source firmware into a
+ * target firmware by rewriting only the differing erase units of the code flash.
+ * The patch is applied with 'ra-update patch <patch-file>'.
+ *
+ * Usage: ra-fw-patch [<options>] <source-image> <target-image> <patch-file>
+ *        ra-fw-patch --info <patch-file>
+ *
+ * Options:
+ *         -e, --erase-unit-size   erase unit size of the MCU's code flash (default: 2048)
+ *         -i, --info              print the content of the given patch file
+ *         -V, --version           print version and exit
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tools.h>
+#include <version.h>
+#include "fw_file.h"
+#include "fw_patch.h"
+#include "stringify.h"
+
+/* the code flash block size of the safety controller */
+#define DEFAULT_ERASE_UNIT_SIZE 2048
+
+/* command line options */
+static const struct option long_options[] = {
+    { "erase-unit-size",    required_argument,      0,      'e' },
+    { "info",               no_argument,            0,      'i' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "e:iVh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "erase unit size of the MCU's code flash (default: " __stringify(DEFAULT_ERASE_UNIT_SIZE) ")",
+    "print the content of the given patch file",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to create firmware patch files\n\n"
+            "Usage: %s [<options>] <source-image> <target-image> <patch-file>\n"
+            "       %s --info <patch-file>\n\n"
+            , p, PACKAGE_STRING, p, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-15s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-15s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* to keep things easy, we use global variables here */
+static unsigned long erase_unit_size = DEFAULT_ERASE_UNIT_SIZE;
+static bool info;
+static char *src_filename;
+static char *dst_filename;
+static char *patch_filename;
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+    char *endptr;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'e':
+            erase_unit_size = strtoul(optarg, &endptr, 0);
+            if (endptr == optarg || *endptr != '\0' || erase_unit_size == 0) {
+                fprintf(stderr, "Invalid erase unit size '%s'.\n", optarg);
+                usage(argv[0], rc);
+            }
+            break;
+        case 'i':
+            info = true;
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            usage(argv[0], rc);
+            break;
+        case 0:
+            /* getopt_long() set a variable by reference */
+            break;
+        default:
+            rc = EXIT_FAILURE;
+            fprintf(stderr, "Unknown option '%c'.\n", (char)c);
+            usage(argv[0], rc);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (info) {
+        if (argc != 1)
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        patch_filename = argv[0];
+        return;
+    }
+
+    if (argc != 3)
+        usage(program_invocation_short_name, EXIT_FAILURE);
+
+    src_filename = argv[0];
+    dst_filename = argv[1];
+    patch_filename = argv[2];
+}
+
+static int print_info(void)
+{
+    struct fw_patch patch;
+    unsigned long len;
+    uint8_t *buf;
+
+    if (fw_mmap_infile(patch_filename, &buf, &len)) {
+        fprintf(stderr, "Error: could not open '%s': %m\n", patch_filename);
+        return EXIT_FAILURE;
+    }
+
+    if (fw_patch_parse(buf, len, &patch)) {
+        fprintf(stderr, "Error: '%s' is not a valid patch file.\n", patch_filename);
+        return EXIT_FAILURE;
+    }
+
+    fw_patch_dump(&patch);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long src_len, dst_len;
+    uint8_t *src, *dst;
+    char *tmp_filename;
+    FILE *f;
+    int rv;
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    if (info)
+        return print_info();
+
+    if (fw_mmap_infile(src_filename, &src, &src_len)) {
+        fprintf(stderr, "Error: could not open '%s': %m\n", src_filename);
+        return EXIT_FAILURE;
+    }
+
+    if (fw_mmap_infile(dst_filename, &dst, &dst_len)) {
+        fprintf(stderr, "Error: could not open '%s': %m\n", dst_filename);
+        return EXIT_FAILURE;
+    }
+
+    /* the patch is written to a temporary file and renamed into place, so that a bundle
+     * never contains a partial patch */
+    if (asprintf(&tmp_filename, "%s.tmp", patch_filename) < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    f = fopen(tmp_filename, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: could not create '%s': %m\n", tmp_filename);
+        return EXIT_FAILURE;
+    }
+
+    rv = fw_patch_create(src, src_len, dst, dst_len, erase_unit_size, f);
+    if (rv < 0) {
+        if (errno == EINVAL)
+            fprintf(stderr, "Error: both images must contain a valid version app infoblock.\n");
+        else
+            fprintf(stderr, "Error: creating the patch failed: %m\n");
+        goto err_out;
+    }
+
+    if (fclose(f) == EOF) {
+        f = NULL;
+        fprintf(stderr, "Error: writing '%s' failed: %m\n", tmp_filename);
+        goto err_out;
+    }
+    f = NULL;
+
+    if (rename(tmp_filename, patch_filename)) {
+        fprintf(stderr, "Error: renaming '%s' to '%s' failed: %m\n", tmp_filename, patch_filename);
+        goto err_out;
+    }
+
+    printf("%d of %lu erase units differ.\n", rv,
+           (max(src_len, dst_len) + erase_unit_size - 1) / erase_unit_size);
+
+    return EXIT_SUCCESS;
+
+err_out:
+    if (f)
+        fclose(f);
+    unlink(tmp_filename);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,488 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Command line tool to inspect and use a snapshot store filled by 'ra-update --store <dir> dump'.
+ * The store keeps each erase unit only once, so that many dumps of the same firmware
+ * only cost a small manifest each.
+ *
+ * Usage: ra-fw-store [<options>] <command> [<parameter>...]
+ *
+ * Commands:
+ *         list                          -- list all snapshots in the store
+ *         info <snapshot>               -- print the details of a snapshot
+ *         restore <snapshot> <filename> -- write the content of a snapshot to the given file
+ *         diff <snapshot> <snapshot>    -- list the erase units which differ between two snapshots
+ *         import <filename> <snapshot>  -- add an existing dump to the store
+ *
+ * Options:
+ *         -s, --store             snapshot store directory (required)
+ *         -a, --flash-area        flash area of an imported file (code, data or image, default: image)
+ *         -e, --erase-unit-size   erase unit size of an imported file (default: 2048)
+ *         -V, --version           print version and exit
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <tools.h>
+#include <version.h>
+#include "fw_file.h"
+#include "fw_store.h"
+#include "stringify.h"
+
+/* the code flash block size of the safety controller */
+#define DEFAULT_ERASE_UNIT_SIZE 2048
+
+/* the possible command arguments which are understood by this tool */
+enum cmd {
+    CMD_LIST,
+    CMD_INFO,
+    CMD_RESTORE,
+    CMD_DIFF,
+    CMD_IMPORT,
+    CMD_MAX
+};
+
+static const char *cmd_strings[CMD_MAX] = {
+    "list",
+    "info",
+    "restore",
+    "diff",
+    "import",
+};
+
+static const char *cmd_args[CMD_MAX] = {
+    NULL,
+    "<snapshot>",
+    "<snapshot> <filename>",
+    "<snapshot> <snapshot>",
+    "<filename> <snapshot>",
+};
+
+static const int cmd_argc[CMD_MAX] = { 0, 1, 2, 2, 2 };
+
+static const char *cmd_descs[CMD_MAX] = {
+    "list all snapshots in the store",
+    "print the details of a snapshot",
+    "write the content of a snapshot to the given file",
+    "list the erase units which differ between two snapshots",
+    "add an existing dump to the store",
+};
+
+/* command line options */
+static const struct option long_options[] = {
+    { "store",              required_argument,      0,      's' },
+    { "flash-area",         required_argument,      0,      'a' },
+    { "erase-unit-size",    required_argument,      0,      'e' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "s:a:e:Vh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "snapshot store directory (required)",
+    "flash area of an imported file (code, data or image, default: image)",
+    "erase unit size of an imported file (default: " __stringify(DEFAULT_ERASE_UNIT_SIZE) ")",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+    int max_cmd_len = 0;
+    int i;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to inspect and use a firmware snapshot store\n\n"
+            "Usage: %s [<options>] <command> [<parameter>...]\n\n"
+            "Commands:\n",
+            p, PACKAGE_STRING, p);
+
+    /* determine the maximum length over all commands - we need it for pretty printing */
+    for (i = 0; i < CMD_MAX; i++)
+        max_cmd_len = max(max_cmd_len, strlen(cmd_strings[i]) + (cmd_args[i] ? strlen(cmd_args[i]) : 0));
+
+    for (i = 0; i < CMD_MAX; i++) {
+        int field_length = max_cmd_len - strlen(cmd_strings[i]);
+
+        fprintf(stderr, "\t%s %-*s -- %s\n", cmd_strings[i], field_length, cmd_args[i] ?: "", cmd_descs[i]);
+    }
+
+    fprintf(stderr,
+            "\n"
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-15s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-15s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* to keep things easy, we use global variables here */
+static char *store_dir;
+static char *area = "image";
+static unsigned long erase_unit_size = DEFAULT_ERASE_UNIT_SIZE;
+static enum cmd cmd = CMD_MAX;
+static char **cmd_params;
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+    char *endptr;
+    int i;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 's':
+            store_dir = optarg;
+            break;
+        case 'a':
+            if (strcasecmp(optarg, "code") != 0 && strcasecmp(optarg, "data") != 0 &&
+                strcasecmp(optarg, "image") != 0) {
+                fprintf(stderr, "Unknown flash-area '%s'.\n", optarg);
+                usage(argv[0], rc);
+            }
+            area = optarg;
+            break;
+        case 'e':
+            erase_unit_size = strtoul(optarg, &endptr, 0);
+            if (endptr == optarg || *endptr != '\0' || erase_unit_size == 0) {
+                fprintf(stderr, "Invalid erase unit size '%s'.\n", optarg);
+                usage(argv[0], rc);
+            }
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            usage(argv[0], rc);
+            break;
+        case 0:
+            /* getopt_long() set a variable by reference */
+            break;
+        default:
+            rc = EXIT_FAILURE;
+            fprintf(stderr, "Unknown option '%c'.\n", (char)c);
+            usage(argv[0], rc);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    /* check that a command was given as command line argument */
+    if (argc < 1 || !store_dir)
+        usage(program_invocation_short_name, EXIT_FAILURE);
+
+    /* check which command was requested */
+    for (i = 0; i < CMD_MAX; i++) {
+        if (strcasecmp(argv[0], cmd_strings[i]) == 0) {
+            cmd = i;
+            break;
+        }
+    }
+    if (i == CMD_MAX || argc - 1 != cmd_argc[cmd])
+        usage(program_invocation_short_name, EXIT_FAILURE);
+
+    cmd_params = &argv[1];
+}
+
+static struct fw_store store;
+
+static int load_snapshot(const char *name, struct fw_snapshot *snap)
+{
+    if (fw_store_load_snapshot(&store, name, snap)) {
+        if (errno == ENOENT)
+            fprintf(stderr, "Error: there is no snapshot '%s' in the store.\n", name);
+        else
+            fprintf(stderr, "Error: reading snapshot '%s' failed: %m\n", name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int print_list_entry(const char *name, void *ctx)
+{
+    struct fw_snapshot snap;
+
+    (void)ctx;
+
+    if (load_snapshot(name, &snap))
+        return 0;
+
+    printf("%-32s %-5s %8zu", name, snap.area, snap.size);
+    if (snap.has_firmware)
+        printf("  %016" PRIx64 " %08" PRIx32, snap.git_hash, snap.application_checksum);
+    printf("\n");
+
+    fw_snapshot_free(&snap);
+    return 0;
+}
+
+static int cmp_hashes(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(struct fw_store_hash));
+}
+
+static int print_info(const char *name)
+{
+    struct fw_store_hash *sorted;
+    struct fw_snapshot snap;
+    unsigned int i, unique = 0;
+
+    if (load_snapshot(name, &snap))
+        return EXIT_FAILURE;
+
+    /* count the distinct chunks, e.g. blank units are typically stored only once */
+    sorted = malloc((snap.chunk_count ?: 1) * sizeof(*sorted));
+    if (!sorted) {
+        fprintf(stderr, "Error: out of memory\n");
+        fw_snapshot_free(&snap);
+        return EXIT_FAILURE;
+    }
+    memcpy(sorted, snap.chunks, snap.chunk_count * sizeof(*sorted));
+    qsort(sorted, snap.chunk_count, sizeof(*sorted), cmp_hashes);
+    for (i = 0; i < snap.chunk_count; i++)
+        if (i == 0 || cmp_hashes(&sorted[i - 1], &sorted[i]) != 0)
+            unique++;
+    free(sorted);
+
+    printf("Snapshot:             %s\n", name);
+    printf("Flash Area:           %s\n", snap.area);
+    printf("Size:                 %zu\n", snap.size);
+    printf("Erase Unit Size:      %zu\n", snap.erase_unit_size);
+    printf("Erase Units:          %u (%u distinct)\n", snap.chunk_count, unique);
+    if (snap.has_firmware) {
+        printf("Git Hash:             %016" PRIx64 "\n", snap.git_hash);
+        printf("Application Checksum: 0x%08" PRIx32 "\n", snap.application_checksum);
+    }
+    if (snap.from_store)
+        printf("Taken from Store:     0x00000000-0x%08zx (not read from the flash)\n", snap.from_store - 1);
+
+    fw_snapshot_free(&snap);
+    return EXIT_SUCCESS;
+}
+
+static int restore(const char *name, const char *filename)
+{
+    struct fw_snapshot snap;
+    uint8_t *content;
+    int rc = EXIT_FAILURE;
+
+    if (load_snapshot(name, &snap))
+        return EXIT_FAILURE;
+
+    if (fw_mmap_outfile(filename, &content, snap.size)) {
+        fprintf(stderr, "Error: could not create '%s': %m\n", filename);
+        goto free_out;
+    }
+
+    if (fw_store_restore(&store, &snap, content)) {
+        if (errno == EBADMSG)
+            fprintf(stderr, "Error: the store contains a corrupted erase unit of snapshot '%s'.\n", name);
+        else
+            fprintf(stderr, "Error: restoring snapshot '%s' failed: %m\n", name);
+        munmap(content, snap.size);
+        unlink(filename);
+        goto free_out;
+    }
+
+    if (msync(content, snap.size, MS_SYNC) || munmap(content, snap.size)) {
+        fprintf(stderr, "Error: writing '%s' failed: %m\n", filename);
+        goto free_out;
+    }
+
+    rc = EXIT_SUCCESS;
+
+free_out:
+    fw_snapshot_free(&snap);
+    return rc;
+}
+
+/* like diff(1): returns 0 if both snapshots have the same content, 1 otherwise */
+static int diff(const char *name_a, const char *name_b)
+{
+    struct fw_snapshot a, b;
+    unsigned int i, count, differ = 0;
+    int rc = 2;
+
+    if (load_snapshot(name_a, &a))
+        return rc;
+
+    if (load_snapshot(name_b, &b))
+        goto free_a_out;
+
+    if (a.erase_unit_size != b.erase_unit_size) {
+        fprintf(stderr, "Error: the snapshots use different erase unit sizes (%zu and %zu bytes).\n",
+                a.erase_unit_size, b.erase_unit_size);
+        goto free_b_out;
+    }
+
+    if (a.has_firmware != b.has_firmware || a.git_hash != b.git_hash)
+        printf("firmware: %016" PRIx64 " -> %016" PRIx64 "\n",
+               a.has_firmware ? a.git_hash : 0, b.has_firmware ? b.git_hash : 0);
+
+    /* thanks to the hashes, comparing the manifests is enough */
+    count = max(a.chunk_count, b.chunk_count);
+    for (i = 0; i < count; i++) {
+        const char *what;
+
+        if (i >= a.chunk_count)
+            what = "added";
+        else if (i >= b.chunk_count)
+            what = "removed";
+        else if (memcmp(&a.chunks[i], &b.chunks[i], sizeof(a.chunks[i])) != 0)
+            what = "changed";
+        else
+            continue;
+
+        printf("0x%08zx %s\n", i * a.erase_unit_size, what);
+        differ++;
+    }
+
+    if (a.size != b.size)
+        printf("size: %zu -> %zu\n", a.size, b.size);
+
+    printf("%u of %u erase units differ.\n", differ, count);
+    rc = (differ || a.size != b.size) ? 1 : 0;
+
+free_b_out:
+    fw_snapshot_free(&b);
+free_a_out:
+    fw_snapshot_free(&a);
+    return rc;
+}
+
+static int import(const char *filename, const char *name)
+{
+    struct version_app_infoblock info;
+    struct fw_snapshot snap = {};
+    unsigned long len;
+    uint8_t *content;
+    int added, rc = EXIT_FAILURE;
+
+    if (fw_mmap_infile(filename, &content, &len)) {
+        fprintf(stderr, "Error: could not open '%s': %m\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    added = fw_store_put(&store, content, len, erase_unit_size, &snap);
+    if (added < 0) {
+        fprintf(stderr, "Error: adding '%s' to the store failed: %m\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(snap.area, sizeof(snap.area), "%s", area);
+
+    /* images and code flash dumps may carry a firmware */
+    if (strcasecmp(area, "data") != 0 && len >= CODE_FIRMWARE_INFORMATION_START_ADDRESS + sizeof(info)) {
+        memcpy(&info, &content[CODE_FIRMWARE_INFORMATION_START_ADDRESS], sizeof(info));
+        fw_version_app_infoblock_to_host_endianess(&info);
+
+        if (fw_valid_version_app_infoblock(&info)) {
+            snap.has_firmware = true;
+            snap.git_hash = info.git_hash;
+            snap.application_checksum = info.application_checksum;
+        }
+    }
+
+    if (fw_store_save_snapshot(&store, name, &snap)) {
+        fprintf(stderr, "Error: saving snapshot '%s' failed: %m\n", name);
+        goto free_out;
+    }
+
+    /* only code flash dumps have the MCU's layout, so only these can replace reading the MCU;
+     * like for dumps, an existing firmware record is never replaced */
+    if (strcasecmp(area, "code") == 0 && snap.has_firmware &&
+        info.application_size > 0 && info.application_size <= len) {
+        if (fw_store_has_firmware(&store, snap.git_hash, snap.application_checksum)) {
+            printf("Firmware %016" PRIx64 " is already known in the store, keeping it.\n", snap.git_hash);
+        } else if (fw_store_save_firmware(&store, &snap, info.application_size)) {
+            fprintf(stderr, "Error: remembering firmware %016" PRIx64 " failed: %m\n", snap.git_hash);
+            goto free_out;
+        }
+    }
+
+    printf("Snapshot '%s' stored (%u erase units, %d of them new).\n", name, snap.chunk_count, added);
+    rc = EXIT_SUCCESS;
+
+free_out:
+    fw_snapshot_free(&snap);
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    /* only import may create the store */
+    if (fw_store_open(&store, store_dir, cmd == CMD_IMPORT)) {
+        fprintf(stderr, "Error: could not open the store '%s': %m\n", store_dir);
+        return (cmd == CMD_DIFF) ? 2 : EXIT_FAILURE;
+    }
+
+    switch (cmd) {
+    case CMD_LIST:
+        if (fw_store_foreach_snapshot(&store, print_list_entry, NULL) == 0)
+            rc = EXIT_SUCCESS;
+        else
+            fprintf(stderr, "Error: listing the snapshots failed: %m\n");
+        break;
+    case CMD_INFO:
+        rc = print_info(cmd_params[0]);
+        break;
+    case CMD_RESTORE:
+        rc = restore(cmd_params[0], cmd_params[1]);
+        break;
+    case CMD_DIFF:
+        rc = diff(cmd_params[0], cmd_params[1]);
+        break;
+    case CMD_IMPORT:
+        rc = import(cmd_params[0], cmd_params[1]);
+        break;
+    default:
+        break;
+    }
+
+    fw_store_close(&store);
+
+    return rc;
+}
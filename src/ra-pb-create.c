@@ -4,11 +4,20 @@
  *
  * Command line tool to create a binary parameter block file from a YAML file
  *
- * Usage: ra-pb-create [<options>]
+ * Usage: ra-pb-create [<options>] [<input>...]
+ *
+ * Without inputs, a single YAML document is read from the input file and written to the
+ * output file. Inputs can be YAML files, directories (all *.yaml and *.yml files in it) or
+ * glob patterns; each document of these YAML streams is compiled into a parameter block file
+ * named after the input: <name>.bin, or <name>-<n>.bin for inputs with several documents.
+ * The inputs are compiled by a pool of threads, and the output files are replaced atomically.
  *
  * Options:
  *         -i, --infile            use the given filename as input file (default: stdin)
  *         -o, --outfile           use the given filename for output (default: stdout)
+ *         -O, --outdir            directory for the output files of inputs (default: next to the input)
+ *         -j, --jobs              count of threads to use for inputs (default: count of CPUs)
+ *         -u, --dedup             write identical blocks of inputs only once, print '<skipped> <written>' for the others
  *         -D, --debug             print debug output to stderr
  *         -V, --version           print version and exit
  *         -h, --help              print this usage and exit
@@ -17,18 +26,25 @@
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
+#include <dirent.h>
 #include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <glob.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <inttypes.h>
-#include <yaml.h>
+#include <param_block.h>
+#include <param_block_yaml.h>
+#include <tools.h>
 #include <version.h>
-#include "param_block.h"
 
 #ifndef PACKAGE_STRING
 #define PACKAGE_STRING "ra-pb-create (unknown version)"
@@ -38,6 +54,9 @@
 static const struct option long_options[] = {
     { "infile",             required_argument,      0,      'i' },
     { "outfile",            required_argument,      0,      'o' },
+    { "outdir",             required_argument,      0,      'O' },
+    { "jobs",               required_argument,      0,      'j' },
+    { "dedup",              no_argument,            0,      'u' },
 
     { "debug",              no_argument,            0,      'D' },
 
@@ -46,12 +65,15 @@ static const struct option long_options[] = {
     {} /* stop condition for iterator */
 };
 
-static const char *short_options = "i:o:DVh";
+static const char *short_options = "i:o:O:j:uDVh";
 
 /* descriptions for the command line options */
 static const char *long_options_descs[] = {
     "use the given filename as input file (default: stdin)",
     "use the given filename for output (default: stdout)",
+    "directory for the output files of inputs (default: next to the input)",
+    "count of threads to use for inputs (default: count of CPUs)",
+    "write identical blocks of inputs only once, print '<skipped> <written>' for the others",
 
     "print debug output to stderr",
 
@@ -69,7 +91,9 @@ static void usage(char *p, int exitcode)
 
     fprintf(stderr,
             "%s (%s) -- Command line tool to create a binary parameter block file from a YAML file\n\n"
-            "Usage: %s [<options>]\n\n"
+            "Usage: %s [<options>] [<input>...]\n\n"
+            "Inputs can be YAML files, directories or glob patterns; each document is compiled\n"
+            "into <name>.bin, or <name>-<n>.bin for inputs with several documents.\n\n"
             , p, PACKAGE_STRING, p);
 
     fprintf(stderr,
@@ -91,15 +115,20 @@ static void usage(char *p, int exitcode)
 }
 
 /* to keep things easy, we use global variables here */
-char *filename_in = "-";
-char *filename_out = "-";
-FILE *infile, *outfile;
-struct param_block_v2 param_block;
-yaml_parser_t yaml_parser;
-yaml_event_t event;
-bool debug;
-
-void parse_cli(int argc, char *argv[])
+static char *filename_in = "-";
+static char *filename_out = "-";
+static FILE *infile, *outfile;
+static struct param_block_v2 param_block;
+static bool debug;
+
+/* batch mode */
+static char **input_args;
+static int input_arg_count;
+static char *outdir;
+static unsigned int jobs;
+static bool dedup;
+
+static void parse_cli(int argc, char *argv[])
 {
     int rc = EXIT_FAILURE;
     int i;
@@ -118,6 +147,15 @@ void parse_cli(int argc, char *argv[])
         case 'o':
             filename_out = optarg;
             break;
+        case 'O':
+            outdir = optarg;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'u':
+            dedup = true;
+            break;
 
         case 'D':
             debug = true;
@@ -144,9 +182,21 @@ void parse_cli(int argc, char *argv[])
     argc -= optind;
     argv += optind;
 
-    /* check whether additional command line arguments were given */
-    if (argc > 0)
+    /* inputs select the batch mode, the files are handled there */
+    if (argc > 0) {
+        if (strcmp(filename_in, "-") != 0 || strcmp(filename_out, "-") != 0) {
+            fprintf(stderr, "Error: --infile/--outfile cannot be combined with inputs.\n\n");
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        }
+        input_args = argv;
+        input_arg_count = argc;
+        return;
+    }
+
+    if (outdir || dedup) {
+        fprintf(stderr, "Error: --outdir/--dedup require inputs.\n\n");
         usage(program_invocation_short_name, EXIT_FAILURE);
+    }
 
     if (strcmp(filename_in, "-") == 0) {
         infile = stdin;
@@ -169,428 +219,610 @@ void parse_cli(int argc, char *argv[])
     }
 }
 
-#define PRINT_EVENT(indent, type, start_end) \
-        fprintf(stderr, "%*s%s %s\n", (indent) * 2, "", (type), (start_end))
+/* an input file, mapped into memory */
+struct input {
+    char *filename;
+    const char *data;
+    size_t len;
 
-int indent = 0;
+    /* documents found in all chunks of this input */
+    unsigned int doc_count;
+};
+
+/* a compiled document of an input */
+struct doc {
+    struct param_block_v2 param_block;
+    int status; /* one of PB_YAML_... */
+
+    /* diagnostic messages collected while compiling */
+    char *diag;
+    size_t diag_len;
+
+    struct input *input;
+    unsigned int index; /* within the input, starting at 1 */
+    char *outname;
+
+    /* deduplication: chain of unique blocks with the same CRC, and the written original */
+    struct doc *next_same_crc;
+    struct doc *duplicate_of;
+
+    /* errno value of writing the output file */
+    int write_error;
+};
 
-void print_event_type(yaml_event_type_t type)
+/* a part of an input which is parsed on its own, it starts at a document marker */
+struct chunk {
+    struct input *input;
+    const char *data;
+    size_t len;
+    size_t line; /* first line of the chunk within the input, counted from 0 */
+
+    struct doc *docs;
+    unsigned int doc_count;
+
+    /* errno value if the chunk could not be compiled at all */
+    int error;
+};
+
+/* to keep things easy, the batch is global, too */
+static struct input *inputs;
+static size_t input_count;
+static struct chunk *chunks;
+static size_t chunk_count;
+static struct doc **docs;
+static size_t doc_count;
+
+/* a simple worker pool: the calling thread and up to jobs - 1 threads process the
+ * items 0..count-1, each one picks the next unprocessed item until all are done
+ */
+struct pool {
+    void (*fn)(size_t i);
+    size_t count;
+    size_t next;
+};
+
+static void *pool_worker(void *arg)
 {
-    switch (type) {
-    case YAML_STREAM_START_EVENT:   PRINT_EVENT(indent++, "Stream", "start"); break;
-    case YAML_STREAM_END_EVENT:     PRINT_EVENT(--indent, "Stream", "end"); break;
-    case YAML_DOCUMENT_START_EVENT: PRINT_EVENT(indent++, "Document", "start"); break;
-    case YAML_DOCUMENT_END_EVENT:   PRINT_EVENT(--indent, "Document", "end"); break;
-    case YAML_MAPPING_START_EVENT:  PRINT_EVENT(indent++, "Mapping", "start"); break;
-    case YAML_MAPPING_END_EVENT:    PRINT_EVENT(--indent, "Mapping", "end"); break;
-    case YAML_SEQUENCE_START_EVENT: PRINT_EVENT(indent++, "Sequence", "start"); break;
-    case YAML_SEQUENCE_END_EVENT:   PRINT_EVENT(--indent, "Sequence", "end"); break;
-    case YAML_SCALAR_EVENT:         /* Handled below */ break;
-    default: fprintf(stderr, "%*sOther event: %d\n", indent * 2, "", type); break;
+    struct pool *pool = arg;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count)
+        pool->fn(i);
+
+    return NULL;
+}
+
+static void pool_run(void (*fn)(size_t i), size_t count)
+{
+    struct pool pool = { .fn = fn, .count = count };
+    pthread_t *threads = NULL;
+    size_t n = min((size_t)jobs, count);
+    size_t i, started = 0;
+
+    if (n > 1)
+        threads = calloc(n - 1, sizeof(*threads));
+
+    /* when threads cannot be created, the calling thread does the remaining work alone */
+    for (i = 0; threads && i < n - 1; i++) {
+        if (pthread_create(&threads[i], NULL, pool_worker, &pool))
+            break;
+        started++;
     }
+
+    pool_worker(&pool);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
 }
 
-enum param_block_state {
-    PBS_NONE,
-    PBS_VERSION,
-    PBS_PT1000S, /* in the array */
-    PBS_PT1000,  /* in a specific array item */
-    PBS_PT1000_TEMP,
-    PBS_PT1000_OFFSET,
-    PBS_CONTACTORS, /* in the array */
-    PBS_CONTACTOR, /* in a specific array item */
-    PBS_CONTACTOR_TYPE,
-    PBS_CONTACTOR_CLOSE_TIME,
-    PBS_CONTACTOR_OPEN_TIME,
-    PBS_ESTOPS,
-    PBS_RCM_SCALAR,
-    PBS_RCM_MAPPING,
-    PBS_RCM_FAULT_POLARITY,
-    PBS_RCM_TEST_POLARITY,
-    PBS_RCM_TRIGGER_TIME,
-    PBS_RCM_CHECK_TRIPPED_TIME,
-    PBS_RCM_CHECK_NORMAL_TIME,
-    PBS_MAX,
-};
+static int add_input(const char *filename)
+{
+    struct input *in;
 
-static const char *param_block_state_str[PBS_MAX] = {
-    "PBS_NONE",
-    "PBS_VERSION",
-    "PBS_PT1000S",
-    "PBS_PT1000",
-    "PBS_PT1000_TEMP",
-    "PBS_PT1000_OFFSET",
-    "PBS_CONTACTORS",
-    "PBS_CONTACTOR",
-    "PBS_CONTACTOR_TYPE",
-    "PBS_CONTACTOR_CLOSE_TIME",
-    "PBS_CONTACTOR_OPEN_TIME",
-    "PBS_ESTOPS",
-    "PBS_RCM_SCALAR",
-    "PBS_RCM_MAPPING",
-    "PBS_RCM_FAULT_POLARITY",
-    "PBS_RCM_TEST_POLARITY",
-    "PBS_RCM_TRIGGER_TIME",
-    "PBS_RCM_CHECK_TRIPPED_TIME",
-    "PBS_RCM_CHECK_NORMAL_TIME",
-};
+    in = realloc(inputs, (input_count + 1) * sizeof(*inputs));
+    if (!in)
+        return -1;
+    inputs = in;
 
-int main(int argc, char *argv[])
+    in = &inputs[input_count];
+    memset(in, 0, sizeof(*in));
+    in->filename = strdup(filename);
+    if (!in->filename)
+        return -1;
+
+    input_count++;
+    return 0;
+}
+
+static int yaml_filter(const struct dirent *d)
 {
-    enum param_block_state param_block_state = PBS_NONE;
-    int rv = EXIT_FAILURE;
-    int current_temperature_idx = -1;
-    int current_contactor_idx = -1;
-    int current_estop_idx = -1;
-    bool parsing_done = false;
-    uint16_t tmp_u16;
-    int16_t tmp_i16;
-    bool rcm_config = false;
+    const char *ext = strrchr(d->d_name, '.');
 
-    /* handle command line options */
-    parse_cli(argc, argv);
+    return d->d_name[0] != '.' && ext && (strcasecmp(ext, ".yaml") == 0 || strcasecmp(ext, ".yml") == 0);
+}
 
-    if (!yaml_parser_initialize(&yaml_parser)) {
-        fprintf(stderr, "Error while initializing YAML parser.\n");
-        goto err_out;
+static int add_path(const char *path)
+{
+    struct dirent **namelist;
+    struct stat st;
+    int i, n, rv = 0;
+
+    if (stat(path, &st)) {
+        fprintf(stderr, "Error: cannot access '%s': %m\n", path);
+        return -1;
     }
 
-    yaml_parser_set_input_file(&yaml_parser, infile);
+    if (!S_ISDIR(st.st_mode))
+        return add_input(path);
 
-    pb_init(&param_block);
+    /* directories are not searched recursively, the files are added in sorted order */
+    n = scandir(path, &namelist, yaml_filter, alphasort);
+    if (n < 0) {
+        fprintf(stderr, "Error: cannot read directory '%s': %m\n", path);
+        return -1;
+    }
 
-    while (!parsing_done) {
-        if (!yaml_parser_parse(&yaml_parser, &event)) {
-            fprintf(stderr, "YAML parse error: %d\n", yaml_parser.error);
-            break;
+    for (i = 0; i < n; i++) {
+        char *filename;
+
+        if (rv == 0) {
+            if (asprintf(&filename, "%s/%s", path, namelist[i]->d_name) < 0) {
+                rv = -1;
+            } else {
+                rv = add_input(filename);
+                free(filename);
+            }
         }
+        free(namelist[i]);
+    }
+    free(namelist);
 
-        if (debug) {
-            print_event_type(event.type);
+    return rv;
+}
 
-            if (event.type == YAML_SCALAR_EVENT) {
-                PRINT_EVENT(indent, "Scalar:", event.data.scalar.value);
-                fprintf(stderr, "%*sparam_block_state: %s\n", indent * 2, "", param_block_state_str[param_block_state]);
-            }
+static int add_arg(const char *arg)
+{
+    glob_t g;
+    size_t i;
+    int rv;
+
+    /* patterns are expanded here as well, so that they can be passed quoted */
+    if (!strpbrk(arg, "*?["))
+        return add_path(arg);
+
+    rv = glob(arg, 0, NULL, &g);
+    if (rv == GLOB_NOMATCH) {
+        fprintf(stderr, "Error: no input matches '%s'\n", arg);
+        return -1;
+    }
+    if (rv) {
+        fprintf(stderr, "Error: cannot expand '%s'\n", arg);
+        return -1;
+    }
+
+    for (i = 0, rv = 0; rv == 0 && i < g.gl_pathc; i++)
+        rv = add_path(g.gl_pathv[i]);
+
+    globfree(&g);
+    return rv;
+}
+
+static int map_input(struct input *in)
+{
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(in->filename, O_RDONLY);
+    if (fd < 0)
+        goto err_out;
+
+    if (fstat(fd, &st))
+        goto close_out;
+
+    in->len = st.st_size;
+    if (in->len == 0) {
+        /* mmap does not like empty files */
+        in->data = "";
+    } else {
+        data = mmap(NULL, in->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            goto close_out;
+        in->data = data;
+    }
+
+    close(fd);
+    return 0;
+
+close_out:
+    close(fd);
+err_out:
+    fprintf(stderr, "Error: cannot open '%s' for reading: %m\n", in->filename);
+    return -1;
+}
+
+static int add_chunk(struct input *in, const char *data, size_t len, size_t line)
+{
+    struct chunk *c;
+
+    c = realloc(chunks, (chunk_count + 1) * sizeof(*chunks));
+    if (!c)
+        return -1;
+    chunks = c;
+
+    c = &chunks[chunk_count++];
+    memset(c, 0, sizeof(*c));
+    c->input = in;
+    c->data = data;
+    c->len = len;
+    c->line = line;
+
+    return 0;
+}
+
+/* a line which starts with '---' followed by whitespace starts a new document */
+static bool is_document_marker(const char *p, const char *end)
+{
+    if (end - p < 3 || memcmp(p, "---", 3) != 0)
+        return false;
+
+    p += 3;
+    return p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n';
+}
+
+/* split an input at the document markers, so that the documents of a large stream
+ * can be compiled in parallel; YAML forbids such a line within a document's content
+ */
+static int split_input(struct input *in)
+{
+    const char *end = in->data + in->len;
+    const char *start = in->data;
+    const char *p = in->data;
+    size_t line = 0, start_line = 0;
+
+    /* UTF-16 encoded streams and directives (which belong to the following document)
+     * are left to libyaml as a whole
+     */
+    if (in->len >= 2 && (((uint8_t)p[0] == 0xff && (uint8_t)p[1] == 0xfe) ||
+                         ((uint8_t)p[0] == 0xfe && (uint8_t)p[1] == 0xff)))
+        return add_chunk(in, in->data, in->len, 0);
+
+    for (p = in->data; p < end; p++) {
+        if (*p == '%' && (p == in->data || p[-1] == '\n'))
+            return add_chunk(in, in->data, in->len, 0);
+    }
+
+    for (p = in->data; p < end; line++) {
+        const char *eol = memchr(p, '\n', end - p);
+
+        if (p != start && is_document_marker(p, end)) {
+            if (add_chunk(in, start, p - start, start_line))
+                return -1;
+            start = p;
+            start_line = line;
         }
 
-        switch (event.type) {
-        case YAML_SEQUENCE_END_EVENT:
-            switch (param_block_state) {
-            case PBS_PT1000S:
-            case PBS_CONTACTORS:
-            case PBS_ESTOPS:
-                param_block_state = PBS_NONE;
-                break;
-            default:
-                /* nothing */;
-            }
-            break;
+        p = eol ? eol + 1 : end;
+    }
 
-        case YAML_MAPPING_START_EVENT:
-            switch (param_block_state) {
-            case PBS_PT1000S:
-                param_block_state = PBS_PT1000;
-                current_temperature_idx++;
-                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1) {
-                    /* we only warn when more values than allowed are given */
-                    fprintf(stderr, "Warning: ignoring surplus temperature value (#%u)\n",
-                            current_temperature_idx + 1);
-                }
-                break;
-            case PBS_CONTACTORS:
-                param_block_state = PBS_CONTACTOR;
-                current_contactor_idx++;
-                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1) {
-                    /* we only warn when more values than allowed are given */
-                    fprintf(stderr, "Warning: ignoring surplus contactor configuration (#%u)\n",
-                            current_contactor_idx + 1);
-                }
-                break;
-            case PBS_RCM_SCALAR:
-                param_block_state = PBS_RCM_MAPPING;
-                break;
+    return add_chunk(in, start, end - start, start_line);
+}
 
-            default:
-                /* nothing */;
-            }
-            break;
+/* worker: compile all documents of a chunk, diagnostics are collected per document */
+static void compile_chunk(size_t i)
+{
+    struct chunk *c = &chunks[i];
+    yaml_parser_t parser;
+    bool done = false;
 
-        case YAML_MAPPING_END_EVENT:
-            switch (param_block_state) {
-            case PBS_PT1000:
-                param_block_state = PBS_PT1000S;
-                break;
-            case PBS_CONTACTOR:
-                param_block_state = PBS_CONTACTORS;
-                break;
-            case PBS_RCM_MAPPING:
-                param_block_state = PBS_RCM_SCALAR;
-                break;
-
-            default:
-                /* nothing */;
-            }
-            break;
+    if (!yaml_parser_initialize(&parser)) {
+        c->error = ENOMEM;
+        return;
+    }
 
-        case YAML_SCALAR_EVENT:
-            switch (param_block_state) {
-            case PBS_NONE:
-                if (strcasecmp(event.data.scalar.value, "version") == 0)
-                    param_block_state = PBS_VERSION;
-                else if (strcasecmp(event.data.scalar.value, "pt1000s") == 0)
-                    param_block_state = PBS_PT1000S;
-                else if (strcasecmp(event.data.scalar.value, "contactors") == 0)
-                    param_block_state = PBS_CONTACTORS;
-                else if (strcasecmp(event.data.scalar.value, "estops") == 0)
-                    param_block_state = PBS_ESTOPS;
-                else if (strcasecmp(event.data.scalar.value, "rcm") == 0)
-                    param_block_state = PBS_RCM_SCALAR;
-                break;
-            case PBS_VERSION:
-                param_block_state = PBS_NONE;
-                if (str_to_version(event.data.scalar.value, &tmp_u16)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a version value (allowed range: 1-%" PRIu16 ")\n",
-                            event.data.scalar.value, UINT16_MAX);
-                    goto err_out;
-                }
-                param_block.version = tmp_u16;
-                if (param_block.version != PARAMETER_BLOCK_VERSION) {
-                    fprintf(stderr, "Warning: setting version to %" PRIu16 ", but file structure is version %u\n",
-                            param_block.version, PARAMETER_BLOCK_VERSION);
-                }
-                break;
-            case PBS_PT1000:
-                if (strcasecmp(event.data.scalar.value, "abort-temperature") == 0)
-                    param_block_state = PBS_PT1000_TEMP;
-                else if (strcasecmp(event.data.scalar.value, "resistance-offset") == 0)
-                    param_block_state = PBS_PT1000_OFFSET;
-                break;
-            case PBS_PT1000S:
-                current_temperature_idx++;
-                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1) {
-                    /* we only warn when more values than allowed are given */
-                    fprintf(stderr, "Warning: ignoring surplus temperature value (#%u): %s\n",
-                            current_temperature_idx + 1, event.data.scalar.value);
-                    break;
-                }
-                if (str_to_temperature(event.data.scalar.value, &tmp_i16)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a temperature value. Unit (°C) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                param_block.temperature[current_temperature_idx] = tmp_i16;
-                break;
-            case PBS_PT1000_TEMP:
-                param_block_state = PBS_PT1000;
-                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1)
-                    break;
-                if (str_to_temperature(event.data.scalar.value, &tmp_i16)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a temperature value. Unit (°C) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                param_block.temperature[current_temperature_idx] = tmp_i16;
-                break;
-            case PBS_PT1000_OFFSET:
-                param_block_state = PBS_PT1000;
-                if (current_temperature_idx > CB_PROTO_MAX_PT1000S - 1)
-                    break;
-                if (str_to_resistance_offset(event.data.scalar.value, &tmp_i16)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a temperature resistance offset. Unit (Ω) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                param_block.temperature_resistance_offset[current_temperature_idx] = tmp_i16;
-                break;
-            case PBS_CONTACTOR:
-                if (strcasecmp(event.data.scalar.value, "type") == 0)
-                    param_block_state = PBS_CONTACTOR_TYPE;
-                else if (strcasecmp(event.data.scalar.value, "close-time") == 0)
-                    param_block_state = PBS_CONTACTOR_CLOSE_TIME;
-                else if (strcasecmp(event.data.scalar.value, "open-time") == 0)
-                    param_block_state = PBS_CONTACTOR_OPEN_TIME;
-                break;
-            case PBS_CONTACTORS:
-                current_contactor_idx++;
-                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1) {
-                    /* we only warn when more values than allowed are given */
-                    fprintf(stderr, "Warning: ignoring surplus contactor configuration (#%u): %s\n",
-                            current_contactor_idx + 1, event.data.scalar.value);
-                    break;
-                }
-                param_block.contactor_type[current_contactor_idx] =
-                    str_to_contactor_type(event.data.scalar.value);
-                if (param_block.contactor_type[current_contactor_idx] == CONTACTOR_MAX) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a contactor configuration.\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_CONTACTOR_TYPE:
-                param_block_state = PBS_CONTACTOR;
-                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
-                    break;
-                param_block.contactor_type[current_contactor_idx] =
-                    str_to_contactor_type(event.data.scalar.value);
-                if (param_block.contactor_type[current_contactor_idx] == CONTACTOR_MAX) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a contactor type configuration.\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_CONTACTOR_CLOSE_TIME:
-                param_block_state = PBS_CONTACTOR;
-                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
-                    break;
-                if (str_to_contactor_time(event.data.scalar.value, &param_block.contactor_close_time[current_contactor_idx])) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid contactor close time. Unit (ms) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_CONTACTOR_OPEN_TIME:
-                param_block_state = PBS_CONTACTOR;
-                if (current_contactor_idx > CB_PROTO_MAX_CONTACTORS - 1)
-                    break;
-                if (str_to_contactor_time(event.data.scalar.value, &param_block.contactor_open_time[current_contactor_idx])) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid contactor open time. Unit (ms) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_ESTOPS:
-                current_estop_idx++;
-                if (current_estop_idx > CB_PROTO_MAX_ESTOPS - 1) {
-                    /* we only warn when more values than allowed are given */
-                    fprintf(stderr, "Warning: ignoring surplus estop configuration (#%u): %s\n",
-                            current_estop_idx + 1, event.data.scalar.value);
-                    break;
-                }
-                param_block.estop[current_estop_idx] =
-                    str_to_pin_polarity_type(event.data.scalar.value);
-                if (param_block.estop[current_estop_idx] == PIN_POLARITY_MAX) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a estop configuration.\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_SCALAR:
-                param_block_state = PBS_NONE;
-                if (str_to_disabled_flag(event.data.scalar.value, &rcm_config)) {
-                    fprintf(stderr, "Error: Value '%s' not allowed in this context (expected a 'disabled' flag)\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_MAPPING:
-                if (strcasecmp(event.data.scalar.value, "fault-polarity") == 0)
-                    param_block_state = PBS_RCM_FAULT_POLARITY;
-                else if (strcasecmp(event.data.scalar.value, "test-polarity") == 0)
-                    param_block_state = PBS_RCM_TEST_POLARITY;
-                else if (strcasecmp(event.data.scalar.value, "test-trigger-time") == 0)
-                    param_block_state = PBS_RCM_TRIGGER_TIME;
-                else if (strcasecmp(event.data.scalar.value, "test-check-tripped-time") == 0)
-                    param_block_state = PBS_RCM_CHECK_TRIPPED_TIME;
-                else if (strcasecmp(event.data.scalar.value, "test-check-normal-time") == 0)
-                    param_block_state = PBS_RCM_CHECK_NORMAL_TIME;
-                break;
-            case PBS_RCM_FAULT_POLARITY:
-                param_block_state = PBS_RCM_MAPPING;
-                param_block.rcm_fault_polarity = str_to_pin_polarity_type(event.data.scalar.value);
-                if (param_block.rcm_fault_polarity == PIN_POLARITY_MAX) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid pin configuration for RCM fault pin.\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_TEST_POLARITY:
-                param_block_state = PBS_RCM_MAPPING;
-                param_block.rcm_test_polarity = str_to_pin_polarity_type(event.data.scalar.value);
-                if (param_block.rcm_test_polarity == PIN_POLARITY_MAX) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid pin configuration for RCM test pin.\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_TRIGGER_TIME:
-                param_block_state = PBS_RCM_MAPPING;
-                if (str_to_rcm_time(event.data.scalar.value, &param_block.rcm_test_trigger_time)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid RCM test trigger time. Unit (ms) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_CHECK_TRIPPED_TIME:
-                param_block_state = PBS_RCM_MAPPING;
-                if (str_to_rcm_time(event.data.scalar.value, &param_block.rcm_test_check_tripped_time)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid time for RCM tripped check. Unit (ms) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            case PBS_RCM_CHECK_NORMAL_TIME:
-                param_block_state = PBS_RCM_MAPPING;
-                if (str_to_rcm_time(event.data.scalar.value, &param_block.rcm_test_check_normal_time)) {
-                    fprintf(stderr, "Error: Cannot convert '%s' to a valid time for RCM normal check. Unit (ms) missing or wrong whitespace?\n",
-                            event.data.scalar.value);
-                    goto err_out;
-                }
-                break;
-            }
+    yaml_parser_set_input_string(&parser, (const unsigned char *)c->data, c->len);
+
+    while (!done) {
+        struct doc *d;
+        FILE *diag;
+
+        d = realloc(c->docs, (c->doc_count + 1) * sizeof(*c->docs));
+        if (!d) {
+            c->error = errno;
             break;
+        }
+        c->docs = d;
 
-        case YAML_STREAM_END_EVENT:
-            parsing_done = true;
+        d = &c->docs[c->doc_count];
+        memset(d, 0, sizeof(*d));
+
+        diag = open_memstream(&d->diag, &d->diag_len);
+        if (!diag) {
+            c->error = errno;
             break;
+        }
 
-        default:
+        d->status = pb_yaml_parse_document(&parser, &d->param_block, diag, debug);
+        switch (d->status) {
+        case PB_YAML_SUCCESS:
+            pb_refresh_crc_v2(&d->param_block);
+            break;
+        case PB_YAML_ERROR_SYNTAX:
+            pb_yaml_print_syntax_error(&parser, diag, c->line);
+            done = true;
+            break;
+        case PB_YAML_END_OF_STREAM:
+            done = true;
             break;
         }
 
-        yaml_event_delete(&event);
+        fclose(diag);
+
+        if (d->status == PB_YAML_END_OF_STREAM)
+            free(d->diag);
+        else
+            c->doc_count++;
     }
 
-    yaml_parser_delete(&yaml_parser);
+    yaml_parser_delete(&parser);
+}
 
-    /* special case: no properties found at all, e.g. libyaml could not parse, e.g. due to wrong YAML file encoding */
-    if (current_temperature_idx == -1 &&
-        current_contactor_idx == -1 &&
-        current_estop_idx == -1) {
-        fprintf(stderr, "Error: no or wrong input data - YAML file is probably not UTF-8 encoded.\n");
-        goto err_out;
+/* worker: write a parameter block to a temporary file which replaces the output then */
+static void write_doc(size_t i)
+{
+    struct doc *d = docs[i];
+    char *tmpname;
+    FILE *f;
+    int fd;
+
+    if (d->status != PB_YAML_SUCCESS || d->duplicate_of)
+        return;
+
+    if (asprintf(&tmpname, "%s.XXXXXX", d->outname) < 0) {
+        d->write_error = ENOMEM;
+        return;
     }
-    /* check that we saw at least the expected count of parameters, warn otherwise */
-    if (current_temperature_idx < CB_PROTO_MAX_PT1000S - 1)
-        fprintf(stderr, "Warning: only %d temperature value(s) set instead of expected %d.\n", current_temperature_idx + 1, CB_PROTO_MAX_PT1000S);
-    if (current_contactor_idx < CB_PROTO_MAX_CONTACTORS - 1)
-        fprintf(stderr, "Warning: only %d contactor configuration(s) set instead of expected %d.\n", current_contactor_idx + 1, CB_PROTO_MAX_CONTACTORS);
-    if (current_estop_idx < CB_PROTO_MAX_ESTOPS - 1)
-        fprintf(stderr, "Warning: only %d estop configuration(s) set instead of expected %d.\n", current_estop_idx + 1, CB_PROTO_MAX_ESTOPS);
-    /* check RCM configuration for plausibility */
-    if (param_block.rcm_fault_polarity == PIN_POLARITY_NONE && param_block.rcm_test_polarity != PIN_POLARITY_NONE) {
-        fprintf(stderr, "Error: invalid RCM pin polarity configuration: RCM fault pin polarity is also required\n");
-        goto err_out;
+
+    fd = mkstemp(tmpname);
+    if (fd < 0) {
+        d->write_error = errno;
+        goto free_out;
     }
-    if (param_block.rcm_fault_polarity != PIN_POLARITY_NONE) {
-        if (param_block.rcm_test_polarity == PIN_POLARITY_NONE) {
-            fprintf(stderr, "Error: invalid RCM pin polarity configuration: RCM test pin polarity is required\n");
-            goto err_out;
+
+    /* mkstemp creates the file readable for the owner only */
+    if (fchmod(fd, 0644)) {
+        d->write_error = errno;
+        close(fd);
+        goto unlink_out;
+    }
+
+    f = fdopen(fd, "wb");
+    if (!f) {
+        d->write_error = errno;
+        close(fd);
+        goto unlink_out;
+    }
+
+    if (pb_write(&d->param_block, f)) {
+        d->write_error = errno ?: EIO;
+        fclose(f);
+        goto unlink_out;
+    }
+
+    if (fclose(f) || rename(tmpname, d->outname)) {
+        d->write_error = errno;
+        goto unlink_out;
+    }
+
+    free(tmpname);
+    return;
+
+unlink_out:
+    unlink(tmpname);
+free_out:
+    free(tmpname);
+}
+
+static char *output_name(struct doc *d)
+{
+    const char *filename = d->input->filename;
+    const char *base = strrchr(filename, '/');
+    const char *ext;
+    int dir_len, base_len;
+    char *name;
+    int rv;
+
+    base = base ? base + 1 : filename;
+    dir_len = base - filename;
+    base_len = strlen(base);
+
+    ext = strrchr(base, '.');
+    if (ext && (strcasecmp(ext, ".yaml") == 0 || strcasecmp(ext, ".yml") == 0))
+        base_len = ext - base;
+
+    if (d->input->doc_count > 1)
+        rv = asprintf(&name, "%s%s%.*s%.*s-%u.bin", outdir ?: "", outdir ? "/" : "",
+                      outdir ? 0 : dir_len, filename, base_len, base, d->index);
+    else
+        rv = asprintf(&name, "%s%s%.*s%.*s.bin", outdir ?: "", outdir ? "/" : "",
+                      outdir ? 0 : dir_len, filename, base_len, base);
+
+    return rv < 0 ? NULL : name;
+}
+
+static int compare_outname(const void *a, const void *b)
+{
+    return strcmp((*(struct doc **)a)->outname, (*(struct doc **)b)->outname);
+}
+
+/* print the diagnostics of a document, each line prefixed with its origin */
+static void print_diag(struct doc *d)
+{
+    const char *p = d->diag;
+    const char *end = d->diag + d->diag_len;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        int len = eol ? eol - p : end - p;
+
+        if (d->input->doc_count > 1)
+            fprintf(stderr, "%s: document %u: %.*s\n", d->input->filename, d->index, len, p);
+        else
+            fprintf(stderr, "%s: %.*s\n", d->input->filename, len, p);
+
+        p += len + 1;
+    }
+}
+
+static int batch_main(void)
+{
+    struct doc *crc_buckets[256] = { NULL };
+    struct doc **sorted = NULL;
+    bool failed = false;
+    size_t i, j;
+
+    for (i = 0; i < (size_t)input_arg_count; i++)
+        if (add_arg(input_args[i]))
+            return EXIT_FAILURE;
+
+    for (i = 0; i < input_count; i++) {
+        if (map_input(&inputs[i]))
+            return EXIT_FAILURE;
+
+        if (split_input(&inputs[i]))
+            goto err_nomem;
+    }
+
+    pool_run(compile_chunk, chunk_count);
+
+    /* collect the documents in input order and number them per input */
+    for (i = 0; i < chunk_count; i++) {
+        if (chunks[i].error) {
+            fprintf(stderr, "Error: compiling '%s' failed: %s\n", chunks[i].input->filename, strerror(chunks[i].error));
+            failed = true;
         }
-        if (param_block.rcm_test_trigger_time == 0) {
-            fprintf(stderr, "Error: invalid RCM timing: test-trigger-time must not be zero\n");
-            goto err_out;
+        chunks[i].input->doc_count += chunks[i].doc_count;
+        doc_count += chunks[i].doc_count;
+    }
+
+    docs = calloc(doc_count ?: 1, sizeof(*docs));
+    if (!docs)
+        goto err_nomem;
+
+    for (i = 0, doc_count = 0; i < chunk_count; i++) {
+        for (j = 0; j < chunks[i].doc_count; j++) {
+            struct doc *d = &chunks[i].docs[j];
+            struct input *in = chunks[i].input;
+
+            /* the numbering restarts when the chunks of the next input begin */
+            d->input = in;
+            d->index = (doc_count && docs[doc_count - 1]->input == in) ? docs[doc_count - 1]->index + 1 : 1;
+            docs[doc_count++] = d;
         }
-        if (param_block.rcm_test_check_tripped_time == 0) {
-            fprintf(stderr, "Error: invalid RCM timing: test-check-tripped-time must not be zero\n");
-            goto err_out;
+    }
+
+    for (i = 0; i < input_count; i++) {
+        if (inputs[i].doc_count == 0) {
+            fprintf(stderr, "%s: Error: no YAML document found.\n", inputs[i].filename);
+            failed = true;
         }
-        if (param_block.rcm_test_check_normal_time == 0) {
-            fprintf(stderr, "Error: invalid RCM timing: test-check-normal-time must not be zero\n");
-            goto err_out;
+    }
+
+    for (i = 0; i < doc_count; i++) {
+        struct doc *d = docs[i];
+
+        print_diag(d);
+        if (d->status != PB_YAML_SUCCESS) {
+            failed = true;
+            continue;
+        }
+
+        d->outname = output_name(d);
+        if (!d->outname)
+            goto err_nomem;
+
+        if (dedup) {
+            struct doc *o;
+
+            /* the CRC serves as hash, identical blocks have the same one */
+            for (o = crc_buckets[d->param_block.crc]; o; o = o->next_same_crc) {
+                if (memcmp(&o->param_block, &d->param_block, sizeof(d->param_block)) == 0) {
+                    d->duplicate_of = o;
+                    break;
+                }
+            }
+
+            if (!d->duplicate_of) {
+                d->next_same_crc = crc_buckets[d->param_block.crc];
+                crc_buckets[d->param_block.crc] = d;
+            }
         }
     }
 
+    /* refuse to overwrite an output with another one, e.g. for inputs of the same name */
+    sorted = malloc((doc_count ?: 1) * sizeof(*sorted));
+    if (!sorted)
+        goto err_nomem;
+
+    for (i = 0, j = 0; i < doc_count; i++)
+        if (docs[i]->outname)
+            sorted[j++] = docs[i];
+
+    qsort(sorted, j, sizeof(*sorted), compare_outname);
+
+    for (i = 1; i < j; i++) {
+        if (strcmp(sorted[i - 1]->outname, sorted[i]->outname) == 0) {
+            fprintf(stderr, "Error: '%s' would be written for '%s' and '%s'\n", sorted[i]->outname,
+                    sorted[i - 1]->input->filename, sorted[i]->input->filename);
+            free(sorted);
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(sorted);
+
+    pool_run(write_doc, doc_count);
+
+    for (i = 0; i < doc_count; i++) {
+        struct doc *d = docs[i];
+
+        if (d->write_error) {
+            fprintf(stderr, "Error: writing '%s' failed: %s\n", d->outname, strerror(d->write_error));
+            failed = true;
+        } else if (d->duplicate_of) {
+            printf("%s %s\n", d->outname, d->duplicate_of->outname);
+        }
+    }
+
+    /* all other resources are released on exit */
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+err_nomem:
+    fprintf(stderr, "Error: out of memory\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    int rv = EXIT_FAILURE;
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    if (input_arg_count) {
+        if (jobs == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            jobs = cpus > 0 ? cpus : 1;
+        }
+
+        return batch_main();
+    }
+
+    if (pb_read_yaml(infile, &param_block, debug))
+        goto err_out;
+
     if (pb_write(&param_block, outfile)) {
         fprintf(stderr, "Error while writing to '%s': %m\n", filename_out);
         goto err_out;
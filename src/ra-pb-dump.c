@@ -5,8 +5,16 @@
  * This is a command line tool to dump a binary parameter block file as YAML.
  *
  * Usage: ra-pb-dump [<options>] [<filename>]
+ *        ra-pb-dump --audit [<options>] <dir|filename>...
+ *
+ * The audit mode checks many parameter block files or data flash dumps (directories
+ * are searched recursively) and prints an aggregated report: counts per status, layout
+ * and version, the histograms of the settings and the files with problems.
  *
  * Options:
+ *         -a, --audit             audit the given files and directories
+ *         -f, --format            report format of the audit: text, json or csv (default: text)
+ *         -j, --jobs              count of threads to use for the audit (default: count of CPUs)
  *         -V, --version           print version and exit
  *         -h, --help              print this usage and exit
  */
@@ -15,16 +23,22 @@
 #endif
 #include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <param_block.h>
+#include <tools.h>
 #include <version.h>
-#include "param_block.h"
-#include "param_block_crc8.h"
 
 #ifndef PACKAGE_STRING
 #define PACKAGE_STRING "ra-pb-dump (unknown version)"
@@ -32,15 +46,21 @@
 
 /* command line options */
 static const struct option long_options[] = {
+    { "audit",              no_argument,            0,      'a' },
+    { "format",             required_argument,      0,      'f' },
+    { "jobs",               required_argument,      0,      'j' },
     { "version",            no_argument,            0,      'V' },
     { "help",               no_argument,            0,      'h' },
     {} /* stop condition for iterator */
 };
 
-static const char *short_options = "Vh";
+static const char *short_options = "af:j:Vh";
 
 /* descriptions for the command line options */
 static const char *long_options_descs[] = {
+    "audit the given files and directories",
+    "report format of the audit: text, json or csv (default: text)",
+    "count of threads to use for the audit (default: count of CPUs)",
     "print version and exit",
     "print this usage and exit",
     NULL /* stop condition for iterator */
@@ -55,8 +75,9 @@ static void usage(char *p, int exitcode)
 
     fprintf(stderr,
             "%s (%s) -- Command line tool to dump a parameter block file\n\n"
-            "Usage: %s [<options>] [<filename>]\n\n"
-            , p, PACKAGE_STRING, p);
+            "Usage: %s [<options>] [<filename>]\n"
+            "       %s --audit [<options>] <dir|filename>...\n\n"
+            , p, PACKAGE_STRING, p, p);
 
     fprintf(stderr,
             "Options:\n");
@@ -77,10 +98,23 @@ static void usage(char *p, int exitcode)
 }
 
 /* to keep things easy, we use global variables here */
-FILE *f;
-struct param_block_v2 param_block;
+static FILE *f;
+static struct param_block_v2 param_block;
+
+/* audit mode */
+enum audit_format {
+    AUDIT_FORMAT_TEXT,
+    AUDIT_FORMAT_JSON,
+    AUDIT_FORMAT_CSV,
+};
+
+static bool audit;
+static enum audit_format audit_format = AUDIT_FORMAT_TEXT;
+static unsigned int jobs;
+static char **audit_args;
+static int audit_arg_count;
 
-void parse_cli(int argc, char *argv[])
+static void parse_cli(int argc, char *argv[])
 {
     int rc = EXIT_FAILURE;
     int i;
@@ -93,6 +127,24 @@ void parse_cli(int argc, char *argv[])
             break;
 
         switch (c) {
+        case 'a':
+            audit = true;
+            break;
+        case 'f':
+            if (strcasecmp(optarg, "text") == 0) {
+                audit_format = AUDIT_FORMAT_TEXT;
+            } else if (strcasecmp(optarg, "json") == 0) {
+                audit_format = AUDIT_FORMAT_JSON;
+            } else if (strcasecmp(optarg, "csv") == 0) {
+                audit_format = AUDIT_FORMAT_CSV;
+            } else {
+                fprintf(stderr, "Unknown format '%s'.\n", optarg);
+                usage(argv[0], rc);
+            }
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
         case 'V':
             printf("%s (%s)\n", argv[0], PACKAGE_STRING);
             exit(EXIT_SUCCESS);
@@ -114,6 +166,16 @@ void parse_cli(int argc, char *argv[])
     argc -= optind;
     argv += optind;
 
+    if (audit) {
+        if (argc < 1) {
+            fprintf(stderr, "Error: at least one file or directory is required for the audit.\n\n");
+            usage(program_invocation_short_name, EXIT_FAILURE);
+        }
+        audit_args = argv;
+        audit_arg_count = argc;
+        return;
+    }
+
     /* check whether additional command line arguments were given */
     if (argc > 1)
         usage(program_invocation_short_name, EXIT_FAILURE);
@@ -129,6 +191,584 @@ void parse_cli(int argc, char *argv[])
     }
 }
 
+enum audit_status {
+    AUDIT_OK = 0,
+    AUDIT_CRC_ERROR,
+    AUDIT_INVALID,
+    AUDIT_TOO_SHORT,
+    AUDIT_UNREADABLE,
+    AUDIT_STATUS_MAX,
+};
+
+static const char *audit_status_str[AUDIT_STATUS_MAX] = {
+    "ok",
+    "crc-error",
+    "invalid",
+    "too-short",
+    "unreadable",
+};
+
+static const char *layout_str[PB_LAYOUT_MAX] = {
+    "unversioned",
+    "v1",
+    "v2",
+};
+
+/* result of a single file */
+struct audit_result {
+    char *filename;
+    enum audit_status status;
+    enum pb_layout layout;
+    uint16_t version; /* as stored, 0 for unversioned blocks */
+    struct param_block_v2 param_block; /* migrated */
+};
+
+static struct audit_result *results;
+static size_t result_count;
+
+/* the settings for which histograms are built */
+enum setting_kind {
+    SETTING_TEMPERATURE,
+    SETTING_RESISTANCE_OFFSET,
+    SETTING_CONTACTOR_TYPE,
+    SETTING_CONTACTOR_TIME,
+    SETTING_PIN_POLARITY,
+    SETTING_RCM_TIME,
+};
+
+struct histogram_entry {
+    int32_t value;
+    size_t count;
+};
+
+struct setting {
+    char name[48];
+    enum setting_kind kind;
+    size_t offset; /* within struct param_block_v2 */
+
+    struct histogram_entry *entries;
+    size_t entry_count;
+};
+
+#define MAX_SETTINGS (2 * CB_PROTO_MAX_PT1000S + 3 * CB_PROTO_MAX_CONTACTORS + CB_PROTO_MAX_ESTOPS + 5)
+
+static struct setting settings[MAX_SETTINGS];
+static unsigned int setting_count;
+
+static void add_setting(enum setting_kind kind, size_t offset, const char *fmt, int i)
+{
+    struct setting *s = &settings[setting_count++];
+
+    snprintf(s->name, sizeof(s->name), fmt, i);
+    s->kind = kind;
+    s->offset = offset;
+}
+
+static void init_settings(void)
+{
+    int i;
+
+    for (i = 0; i < CB_PROTO_MAX_PT1000S; i++) {
+        add_setting(SETTING_TEMPERATURE, offsetof(struct param_block_v2, temperature[i]),
+                    "pt1000s[%d].abort-temperature", i);
+        add_setting(SETTING_RESISTANCE_OFFSET, offsetof(struct param_block_v2, temperature_resistance_offset[i]),
+                    "pt1000s[%d].resistance-offset", i);
+    }
+
+    for (i = 0; i < CB_PROTO_MAX_CONTACTORS; i++) {
+        add_setting(SETTING_CONTACTOR_TYPE, offsetof(struct param_block_v2, contactor_type[i]),
+                    "contactors[%d].type", i);
+        add_setting(SETTING_CONTACTOR_TIME, offsetof(struct param_block_v2, contactor_close_time[i]),
+                    "contactors[%d].close-time", i);
+        add_setting(SETTING_CONTACTOR_TIME, offsetof(struct param_block_v2, contactor_open_time[i]),
+                    "contactors[%d].open-time", i);
+    }
+
+    for (i = 0; i < CB_PROTO_MAX_ESTOPS; i++)
+        add_setting(SETTING_PIN_POLARITY, offsetof(struct param_block_v2, estop[i]), "estops[%d]", i);
+
+    add_setting(SETTING_PIN_POLARITY, offsetof(struct param_block_v2, rcm_fault_polarity), "rcm.fault-polarity", 0);
+    add_setting(SETTING_PIN_POLARITY, offsetof(struct param_block_v2, rcm_test_polarity), "rcm.test-polarity", 0);
+    add_setting(SETTING_RCM_TIME, offsetof(struct param_block_v2, rcm_test_trigger_time), "rcm.test-trigger-time", 0);
+    add_setting(SETTING_RCM_TIME, offsetof(struct param_block_v2, rcm_test_check_tripped_time),
+                "rcm.test-check-tripped-time", 0);
+    add_setting(SETTING_RCM_TIME, offsetof(struct param_block_v2, rcm_test_check_normal_time),
+                "rcm.test-check-normal-time", 0);
+}
+
+static int32_t setting_value(const struct setting *s, const struct param_block_v2 *pb)
+{
+    const uint8_t *p = (const uint8_t *)pb + s->offset;
+    uint16_t v;
+
+    switch (s->kind) {
+    case SETTING_TEMPERATURE:
+    case SETTING_RESISTANCE_OFFSET:
+        memcpy(&v, p, sizeof(v));
+        return (int16_t)le16toh(v);
+    default:
+        return *p;
+    }
+}
+
+static void setting_value_to_str(char *buffer, size_t size, const struct setting *s, int32_t value)
+{
+    switch (s->kind) {
+    case SETTING_TEMPERATURE:
+        pb_temperature_to_str(buffer, size, htole16(value));
+        break;
+    case SETTING_RESISTANCE_OFFSET:
+        pb_resistance_offset_to_str(buffer, size, htole16(value));
+        break;
+    case SETTING_CONTACTOR_TYPE:
+        snprintf(buffer, size, "%s", pb_contactor_type_to_str(value));
+        break;
+    case SETTING_CONTACTOR_TIME:
+        pb_contactor_time_to_str(buffer, size, value);
+        break;
+    case SETTING_PIN_POLARITY:
+        snprintf(buffer, size, "%s", pb_pin_polarity_type_to_str(value));
+        break;
+    case SETTING_RCM_TIME:
+        pb_rcm_time_to_str(buffer, size, value);
+        break;
+    }
+}
+
+/* there are only few distinct values in a fleet, so a linear search is fine */
+static int histogram_add(struct histogram_entry **entries, size_t *count, int32_t value)
+{
+    struct histogram_entry *e;
+    size_t i;
+
+    for (i = 0; i < *count; i++) {
+        if ((*entries)[i].value == value) {
+            (*entries)[i].count++;
+            return 0;
+        }
+    }
+
+    e = realloc(*entries, (*count + 1) * sizeof(*e));
+    if (!e)
+        return -1;
+
+    e[*count].value = value;
+    e[*count].count = 1;
+    *entries = e;
+    (*count)++;
+
+    return 0;
+}
+
+static int compare_histogram_entry(const void *a, const void *b)
+{
+    const struct histogram_entry *ea = a, *eb = b;
+
+    return (ea->value > eb->value) - (ea->value < eb->value);
+}
+
+static int add_result(const char *filename)
+{
+    struct audit_result *r;
+
+    r = realloc(results, (result_count + 1) * sizeof(*results));
+    if (!r)
+        return -1;
+    results = r;
+
+    r = &results[result_count];
+    memset(r, 0, sizeof(*r));
+    r->filename = strdup(filename);
+    if (!r->filename)
+        return -1;
+
+    result_count++;
+    return 0;
+}
+
+static int nftw_cb(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    (void)sb;
+    (void)ftwbuf;
+
+    if (typeflag == FTW_F)
+        return add_result(fpath);
+
+    /* unreadable directories are reported, but do not stop the audit */
+    if (typeflag == FTW_DNR || typeflag == FTW_NS)
+        fprintf(stderr, "Warning: cannot access '%s'\n", fpath);
+
+    return 0;
+}
+
+static int compare_result_filename(const void *a, const void *b)
+{
+    return strcmp(((const struct audit_result *)a)->filename, ((const struct audit_result *)b)->filename);
+}
+
+/* a parameter block is located at the start of a data flash dump, so only its size is read */
+static void audit_file(struct audit_result *r)
+{
+    uint8_t buf[sizeof(r->param_block)];
+    ssize_t len;
+    int fd;
+
+    fd = open(r->filename, O_RDONLY);
+    if (fd < 0) {
+        r->status = AUDIT_UNREADABLE;
+        return;
+    }
+
+    len = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+    if (len < 0) {
+        r->status = AUDIT_UNREADABLE;
+        return;
+    }
+
+    switch (pb_parse(buf, len, &r->param_block, &r->layout)) {
+    case PB_READ_SUCCESS:
+        r->status = AUDIT_OK;
+        break;
+    case PB_READ_ERROR_CRC:
+        r->status = AUDIT_CRC_ERROR;
+        break;
+    case PB_READ_ERROR_MAGIC:
+        r->status = AUDIT_INVALID;
+        return;
+    default:
+        r->status = AUDIT_TOO_SHORT;
+        return;
+    }
+
+    /* migrated blocks carry the current version, so use the stored one */
+    switch (r->layout) {
+    case PB_LAYOUT_UNVERSIONED:
+        r->version = 0;
+        break;
+    case PB_LAYOUT_V1:
+        r->version = 1;
+        break;
+    default:
+        r->version = r->param_block.version;
+    }
+}
+
+/* work description of a single audit thread */
+struct audit_job {
+    pthread_t thread;
+
+    /* results to fill: [first, last) */
+    size_t first;
+    size_t last;
+};
+
+static void *audit_thread(void *arg)
+{
+    struct audit_job *job = arg;
+    size_t i;
+
+    for (i = job->first; i < job->last; i++)
+        audit_file(&results[i]);
+
+    return NULL;
+}
+
+static void print_json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            printf("\\u%04x", *s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+static void print_csv_string(const char *s)
+{
+    if (!strpbrk(s, ",\"\n")) {
+        fputs(s, stdout);
+        return;
+    }
+
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"')
+            putchar('"');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+/* the report consists of sections with key/count pairs, only the syntax differs per format */
+static bool first_in_section;
+
+static void report_begin(size_t files)
+{
+    switch (audit_format) {
+    case AUDIT_FORMAT_TEXT:
+        printf("files: %zu\n", files);
+        break;
+    case AUDIT_FORMAT_JSON:
+        printf("{\n  \"files\": %zu", files);
+        break;
+    case AUDIT_FORMAT_CSV:
+        printf("category,key,value,count\n");
+        printf("files,,,%zu\n", files);
+        break;
+    }
+}
+
+static void report_section(const char *name)
+{
+    switch (audit_format) {
+    case AUDIT_FORMAT_TEXT:
+        printf("\n%s:\n", name);
+        break;
+    case AUDIT_FORMAT_JSON:
+        printf(",\n  \"%s\": {", name);
+        break;
+    case AUDIT_FORMAT_CSV:
+        break;
+    }
+    first_in_section = true;
+}
+
+static void report_section_end(void)
+{
+    if (audit_format == AUDIT_FORMAT_JSON)
+        printf("%s}", first_in_section ? "" : "\n  ");
+}
+
+/* a group within a section, e.g. a setting with its histogram, or a list of files */
+static void report_group(const char *name, bool list)
+{
+    switch (audit_format) {
+    case AUDIT_FORMAT_TEXT:
+        printf("  %s:\n", name);
+        break;
+    case AUDIT_FORMAT_JSON:
+        printf("%s\n    \"%s\": %c", first_in_section ? "" : ",", name, list ? '[' : '{');
+        break;
+    case AUDIT_FORMAT_CSV:
+        break;
+    }
+    first_in_section = false;
+}
+
+static void report_group_end(bool empty)
+{
+    if (audit_format == AUDIT_FORMAT_JSON)
+        printf("%s}", empty ? "" : "\n    ");
+}
+
+/* a key/count pair in a section (group is NULL) or within a group */
+static void report_count(const char *section, const char *group, bool *first, const char *key, size_t count)
+{
+    switch (audit_format) {
+    case AUDIT_FORMAT_TEXT:
+        printf("%*s%s: %zu\n", group ? 4 : 2, "", key, count);
+        break;
+    case AUDIT_FORMAT_JSON:
+        printf("%s\n%*s", *first ? "" : ",", group ? 6 : 4, "");
+        print_json_string(key);
+        printf(": %zu", count);
+        break;
+    case AUDIT_FORMAT_CSV:
+        printf("%s,", section);
+        print_csv_string(group ?: "");
+        putchar(',');
+        print_csv_string(key);
+        printf(",%zu\n", count);
+        break;
+    }
+    *first = false;
+}
+
+/* files with problems are listed per problem */
+static void report_files(const char *problem, bool (*match)(const struct audit_result *r))
+{
+    bool first = true;
+    size_t i;
+
+    report_group(problem, true);
+
+    for (i = 0; i < result_count; i++) {
+        if (!match(&results[i]))
+            continue;
+
+        switch (audit_format) {
+        case AUDIT_FORMAT_TEXT:
+            printf("    - %s\n", results[i].filename);
+            break;
+        case AUDIT_FORMAT_JSON:
+            printf("%s\n      ", first ? "" : ",");
+            print_json_string(results[i].filename);
+            break;
+        case AUDIT_FORMAT_CSV:
+            printf("problem,%s,", problem);
+            print_csv_string(results[i].filename);
+            printf(",1\n");
+            break;
+        }
+        first = false;
+    }
+
+    if (audit_format == AUDIT_FORMAT_JSON)
+        printf("%s]", first ? "" : "\n    ");
+}
+
+static bool is_crc_error(const struct audit_result *r) { return r->status == AUDIT_CRC_ERROR; }
+static bool is_invalid(const struct audit_result *r) { return r->status == AUDIT_INVALID; }
+static bool is_too_short(const struct audit_result *r) { return r->status == AUDIT_TOO_SHORT; }
+static bool is_unreadable(const struct audit_result *r) { return r->status == AUDIT_UNREADABLE; }
+static bool needs_migration(const struct audit_result *r)
+{
+    return r->status == AUDIT_OK && r->layout != PB_LAYOUT_V2;
+}
+
+static int audit_main(void)
+{
+    size_t status_counts[AUDIT_STATUS_MAX] = { 0 };
+    size_t layout_counts[PB_LAYOUT_MAX] = { 0 };
+    struct histogram_entry *versions = NULL;
+    size_t version_count = 0;
+    struct audit_job *job_list;
+    char buffer[32];
+    bool first;
+    size_t i, n, per_job;
+    unsigned int s;
+    int a;
+
+    for (a = 0; a < audit_arg_count; a++) {
+        struct stat st;
+
+        if (stat(audit_args[a], &st)) {
+            fprintf(stderr, "Error: cannot access '%s': %m\n", audit_args[a]);
+            return EXIT_FAILURE;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (nftw(audit_args[a], nftw_cb, 32, FTW_PHYS)) {
+                fprintf(stderr, "Error: cannot search '%s'\n", audit_args[a]);
+                return EXIT_FAILURE;
+            }
+        } else if (add_result(audit_args[a])) {
+            goto err_nomem;
+        }
+    }
+
+    /* sorted, so that the report does not depend on the directory order */
+    qsort(results, result_count, sizeof(*results), compare_result_filename);
+
+    /* the files are distributed in equal ranges over the threads */
+    n = min((size_t)jobs, max(result_count, (size_t)1));
+    per_job = (result_count + n - 1) / n;
+
+    job_list = calloc(n, sizeof(*job_list));
+    if (!job_list)
+        goto err_nomem;
+
+    for (i = 0; i < n; i++) {
+        job_list[i].first = min(i * per_job, result_count);
+        job_list[i].last = min(job_list[i].first + per_job, result_count);
+
+        if (pthread_create(&job_list[i].thread, NULL, audit_thread, &job_list[i])) {
+            /* do the remaining work here */
+            job_list[i].last = result_count;
+            audit_thread(&job_list[i]);
+            break;
+        }
+    }
+
+    while (i--)
+        pthread_join(job_list[i].thread, NULL);
+
+    free(job_list);
+
+    /* aggregate */
+    init_settings();
+
+    for (i = 0; i < result_count; i++) {
+        struct audit_result *r = &results[i];
+
+        status_counts[r->status]++;
+        if (r->status != AUDIT_OK)
+            continue;
+
+        layout_counts[r->layout]++;
+        if (histogram_add(&versions, &version_count, r->version))
+            goto err_nomem;
+
+        for (s = 0; s < setting_count; s++)
+            if (histogram_add(&settings[s].entries, &settings[s].entry_count,
+                              setting_value(&settings[s], &r->param_block)))
+                goto err_nomem;
+    }
+
+    /* report */
+    report_begin(result_count);
+
+    report_section("status");
+    for (i = 0, first = true; i < AUDIT_STATUS_MAX; i++)
+        report_count("status", NULL, &first, audit_status_str[i], status_counts[i]);
+    report_section_end();
+
+    /* the following sections only consider valid blocks */
+    report_section("layouts");
+    for (i = 0, first = true; i < PB_LAYOUT_MAX; i++)
+        report_count("layout", NULL, &first, layout_str[i], layout_counts[i]);
+    report_section_end();
+
+    report_section("versions");
+    qsort(versions, version_count, sizeof(*versions), compare_histogram_entry);
+    for (i = 0, first = true; i < version_count; i++) {
+        if (versions[i].value)
+            snprintf(buffer, sizeof(buffer), "%" PRId32, versions[i].value);
+        else
+            snprintf(buffer, sizeof(buffer), "unversioned");
+        report_count("version", NULL, &first, buffer, versions[i].count);
+    }
+    report_section_end();
+
+    report_section("settings");
+    for (s = 0; s < setting_count; s++) {
+        struct setting *st = &settings[s];
+
+        qsort(st->entries, st->entry_count, sizeof(*st->entries), compare_histogram_entry);
+
+        report_group(st->name, false);
+        for (i = 0, first = true; i < st->entry_count; i++) {
+            setting_value_to_str(buffer, sizeof(buffer), st, st->entries[i].value);
+            report_count("setting", st->name, &first, buffer, st->entries[i].count);
+        }
+        report_group_end(st->entry_count == 0);
+    }
+    report_section_end();
+
+    report_section("problems");
+    report_files("crc-error", is_crc_error);
+    report_files("invalid", is_invalid);
+    report_files("too-short", is_too_short);
+    report_files("unreadable", is_unreadable);
+    report_files("needs-migration", needs_migration);
+    report_section_end();
+
+    if (audit_format == AUDIT_FORMAT_JSON)
+        printf("\n}\n");
+
+    /* all resources are released on exit */
+    return (status_counts[AUDIT_OK] == result_count) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+err_nomem:
+    fprintf(stderr, "Error: out of memory\n");
+    return EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[])
 {
     int rv = EXIT_FAILURE;
@@ -136,6 +776,15 @@ int main(int argc, char *argv[])
     /* handle command line options */
     parse_cli(argc, argv);
 
+    if (audit) {
+        if (jobs == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            jobs = cpus > 0 ? cpus : 1;
+        }
+
+        return audit_main();
+    }
+
     /* read parameter block and try to auto-detect version, migrate if necessary */
     switch (pb_read(f, &param_block)) {
     case PB_READ_SUCCESS:
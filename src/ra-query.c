@@ -0,0 +1,657 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This is a command line tool to search recorded frame logs (see ra-raw --record)
+ * for the points in time at which a given condition on the decoded safety
+ * controller state holds, e.g.:
+ *
+ *   ra-query -w "contactor2 == undefined && cp_state == C" traffic.log
+ *
+ * Usage: ra-query [<options>] <logfile> [<logfile>...]
+ *
+ * Options:
+ *         -w, --where             condition(s) to match, combined with '&&' (can be given multiple times)
+ *         -s, --since             ignore frames before this time (YYYY-MM-DD[ HH:MM[:SS[.frac]]] or @epoch)
+ *         -u, --until             ignore frames after this time (same format as --since)
+ *         -e, --edges             report only when the condition becomes true
+ *         -c, --count             print only the count of matches
+ *         -p, --print             comma-separated list of additional fields to print
+ *         -l, --list-fields       list the known field names and exit
+ *         -j, --jobs              count of threads to use for scanning (default: count of CPUs)
+ *         -I, --no-index-update   do not create/update the index file '<logfile>.idx'
+ *         -v, --verbose           verbose operation
+ *         -V, --version           print version and exit
+ *         -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_proto_field.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <frame_log.h>
+#include <logging.h>
+#include <tools.h>
+#include <version.h>
+#include "frame_log_index.h"
+
+/* fallback if not set by build system */
+#ifndef PACKAGE_STRING
+#define PACKAGE_STRING "ra-utils (unknown version)"
+#endif
+
+/* command line options */
+static const struct option long_options[] = {
+    { "where",              required_argument,      0,      'w' },
+    { "since",              required_argument,      0,      's' },
+    { "until",              required_argument,      0,      'u' },
+    { "edges",              no_argument,            0,      'e' },
+    { "count",              no_argument,            0,      'c' },
+    { "print",              required_argument,      0,      'p' },
+    { "list-fields",        no_argument,            0,      'l' },
+    { "jobs",               required_argument,      0,      'j' },
+    { "no-index-update",    no_argument,            0,      'I' },
+
+    { "verbose",            no_argument,            0,      'v' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "w:s:u:ecp:lj:IvVh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "condition(s) to match, combined with '&&' (can be given multiple times)",
+    "ignore frames before this time (YYYY-MM-DD[ HH:MM[:SS[.frac]]] or @epoch)",
+    "ignore frames after this time (same format as --since)",
+    "report only when the condition becomes true",
+    "print only the count of matches",
+    "comma-separated list of additional fields to print",
+    "list the known field names and exit",
+    "count of threads to use for scanning (default: count of CPUs)",
+    "do not create/update the index file '<logfile>.idx'",
+
+    "verbose operation",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to search recorded frame logs\n\n"
+            "Usage: %s [<options>] <logfile> [<logfile>...]\n\n",
+            p, PACKAGE_STRING, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-15s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-15s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* upper limit of conditions and fields to print */
+#define MAX_CONDS 16
+#define MAX_PRINT_FIELDS 16
+
+/* to simplify, these are globals */
+static bool verbose = false;
+static bool edges_only = false;
+static bool count_only = false;
+static bool update_index = true;
+static unsigned int jobs = 0;
+static uint64_t since_ns = 0;
+static uint64_t until_ns = UINT64_MAX;
+static struct cb_proto_cond conds[MAX_CONDS];
+static unsigned int cond_count = 0;
+static const struct cb_proto_field *print_fields[MAX_PRINT_FIELDS];
+static unsigned int print_field_count = 0;
+
+/* frame types which carry at least one of the condition fields */
+static bool com_is_relevant[COM_MAX + 1];
+
+static void debug_cb(const char *format, va_list args)
+{
+    if (verbose) {
+        fprintf(stderr, "debug: ");
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+    }
+}
+
+static void error_cb(const char *format, va_list args)
+{
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+/* parse 'YYYY-MM-DD[ HH:MM[:SS[.frac]]]' (local time) or '@<epoch>[.frac]' into ns */
+static int parse_time(const char *s, uint64_t *ns)
+{
+    static const char *formats[] = {
+        "%Y-%m-%d %H:%M:%S",
+        "%Y-%m-%dT%H:%M:%S",
+        "%Y-%m-%d %H:%M",
+        "%Y-%m-%dT%H:%M",
+        "%Y-%m-%d",
+    };
+    unsigned int i;
+
+    if (*s == '@') {
+        char *endptr;
+        double d;
+
+        errno = 0;
+        d = strtod(s + 1, &endptr);
+        if (errno || endptr == s + 1 || *endptr || d < 0)
+            return -1;
+
+        *ns = (uint64_t)(d * 1e9);
+        return 0;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++) {
+        struct tm tm = {};
+        const char *rest;
+        uint64_t frac = 0;
+        time_t t;
+
+        rest = strptime(s, formats[i], &tm);
+        if (!rest)
+            continue;
+
+        /* optional fractional seconds */
+        if (*rest == '.') {
+            uint64_t scale = 100000000;
+
+            for (rest++; *rest >= '0' && *rest <= '9'; rest++) {
+                frac += (*rest - '0') * scale;
+                scale /= 10;
+            }
+        }
+
+        if (*rest)
+            continue;
+
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+        if (t == (time_t)-1)
+            return -1;
+
+        *ns = (uint64_t)t * 1000000000ULL + frac;
+        return 0;
+    }
+
+    return -1;
+}
+
+/* split the given expression at '&&' and add each condition */
+static int add_conditions(char *expr)
+{
+    char *s = expr;
+
+    while (s) {
+        char *next = strstr(s, "&&");
+
+        if (next) {
+            *next = '\0';
+            next += 2;
+        }
+
+        if (cond_count == MAX_CONDS) {
+            error("too many conditions (max. %d)", MAX_CONDS);
+            return -1;
+        }
+
+        if (cb_proto_cond_parse(s, &conds[cond_count]))
+            return -1;
+
+        cond_count++;
+        s = next;
+    }
+
+    return 0;
+}
+
+static int add_print_fields(char *list)
+{
+    char *saveptr = NULL;
+    char *name;
+
+    for (name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+        const struct cb_proto_field *field = cb_proto_field_find(name);
+
+        if (!field) {
+            error("unknown field '%s' (use --list-fields)", name);
+            return -1;
+        }
+
+        if (print_field_count == MAX_PRINT_FIELDS) {
+            error("too many fields to print (max. %d)", MAX_PRINT_FIELDS);
+            return -1;
+        }
+
+        print_fields[print_field_count++] = field;
+    }
+
+    return 0;
+}
+
+static void list_fields(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < cb_proto_field_count(); i++) {
+        const struct cb_proto_field *field = cb_proto_field_by_index(i);
+
+        printf("%-20s %s", field->name, cb_uart_com_to_str(field->com));
+
+        if (field->type == CB_PROTO_FIELD_ENUM) {
+            int v;
+
+            printf(" (");
+            for (v = 0; v < field->max; v++)
+                printf("%s%s", v ? ", " : "", field->to_str(v));
+            printf(")");
+        } else if (field->type == CB_PROTO_FIELD_BOOL) {
+            printf(" (yes, no)");
+        }
+
+        printf("\n");
+    }
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'w':
+            if (add_conditions(optarg))
+                exit(EXIT_FAILURE);
+            break;
+        case 's':
+            if (parse_time(optarg, &since_ns)) {
+                error("could not parse time '%s'", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'u':
+            if (parse_time(optarg, &until_ns)) {
+                error("could not parse time '%s'", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'e':
+            edges_only = true;
+            break;
+        case 'c':
+            count_only = true;
+            break;
+        case 'p':
+            if (add_print_fields(optarg))
+                exit(EXIT_FAILURE);
+            break;
+        case 'l':
+            list_fields();
+            exit(EXIT_SUCCESS);
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'I':
+            update_index = false;
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            /* fall-through */
+        default:
+            usage(argv[0], rc);
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "Error: at least one log file is required.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+}
+
+/* work description and result of a single scan thread */
+struct scan_job {
+    pthread_t thread;
+
+    const struct frame_log_map *map;
+    const struct frame_log_index *idx;
+
+    /* blocks to scan: [first_block, last_block) */
+    size_t first_block;
+    size_t last_block;
+
+    /* indexes of the matching records */
+    size_t *matches;
+    size_t match_count;
+    size_t match_alloc;
+
+    int rv;
+};
+
+static bool block_may_match(const struct frame_log_index_block *block)
+{
+    unsigned int i;
+
+    if (block->last_ts < since_ns || block->first_ts > until_ns)
+        return false;
+
+    for (i = 0; i < cond_count; i++) {
+        /* the registry is a plain array, so the index can be derived from the pointer */
+        unsigned int f = conds[i].field - cb_proto_field_by_index(0);
+
+        if (!cb_proto_cond_may_match(&conds[i], block->min[f], block->max[f]))
+            return false;
+    }
+
+    return true;
+}
+
+static bool conds_eval(struct safety_controller *ctx)
+{
+    unsigned int i;
+
+    for (i = 0; i < cond_count; i++)
+        if (!cb_proto_cond_eval(&conds[i], ctx))
+            return false;
+
+    return true;
+}
+
+static int job_add_match(struct scan_job *job, size_t r)
+{
+    if (job->match_count == job->match_alloc) {
+        size_t n = job->match_alloc ? job->match_alloc * 2 : 1024;
+        size_t *m = realloc(job->matches, n * sizeof(*m));
+
+        if (!m)
+            return -1;
+
+        job->matches = m;
+        job->match_alloc = n;
+    }
+
+    job->matches[job->match_count++] = r;
+    return 0;
+}
+
+static void *scan_thread(void *arg)
+{
+    struct scan_job *job = arg;
+    size_t b;
+
+    for (b = job->first_block; b < job->last_block; b++) {
+        const struct frame_log_index_block *block = &job->idx->blocks[b];
+        size_t start = b * FRAME_LOG_INDEX_BLOCK_RECORDS;
+        size_t end = min(start + FRAME_LOG_INDEX_BLOCK_RECORDS, job->map->count);
+        struct safety_controller ctx;
+        bool prev;
+        size_t r;
+
+        /* a skipped block does not match anywhere, so it is not relevant for edge detection either */
+        if (!block_may_match(block))
+            continue;
+
+        frame_log_index_seed_ctx(block, &ctx);
+        prev = conds_eval(&ctx);
+
+        for (r = start; r < end; r++) {
+            const struct frame_log_record *rec = &job->map->records[r];
+            uint64_t ts;
+            bool match;
+
+            cb_proto_store_frame(&ctx, rec->com, frame_log_record_data(rec));
+
+            if (!com_is_relevant[rec->com])
+                continue;
+
+            match = conds_eval(&ctx);
+            ts = frame_log_record_ts(rec);
+
+            if (match && (!edges_only || !prev) && ts >= since_ns && ts <= until_ns) {
+                if (job_add_match(job, r)) {
+                    job->rv = -1;
+                    return NULL;
+                }
+            }
+
+            prev = match;
+        }
+    }
+
+    return NULL;
+}
+
+static void print_record(const char *prefix, const struct frame_log_record *rec, struct safety_controller *ctx)
+{
+    uint64_t ts = frame_log_record_ts(rec);
+    time_t t = ts / 1000000000ULL;
+    char tbuf[32], vbuf[48];
+    struct tm tm;
+    unsigned int i;
+
+    localtime_r(&t, &tm);
+    strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+
+    printf("%s%s.%06" PRIu64 " %s %-22s", prefix, tbuf, (uint64_t)((ts % 1000000000ULL) / 1000),
+           (rec->flags & FRAME_LOG_FLAG_TX) ? "TX" : "RX", cb_uart_com_to_str(rec->com));
+
+    for (i = 0; i < cond_count; i++) {
+        cb_proto_field_value_to_str(conds[i].field, conds[i].field->get(ctx), vbuf, sizeof(vbuf));
+        printf(" %s=%s", conds[i].field->name, vbuf);
+    }
+
+    for (i = 0; i < print_field_count; i++) {
+        cb_proto_field_value_to_str(print_fields[i], print_fields[i]->get(ctx), vbuf, sizeof(vbuf));
+        printf(" %s=%s", print_fields[i]->name, vbuf);
+    }
+
+    printf("\n");
+}
+
+/* print the matches, for this the state is replayed from the start of each match's block */
+static void print_matches(const char *prefix, const struct frame_log_map *map, const struct frame_log_index *idx,
+                          const size_t *matches, size_t count)
+{
+    struct safety_controller ctx;
+    size_t pos = SIZE_MAX; /* record index up to which ctx is valid (exclusive) */
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        size_t r = matches[i];
+
+        /* replaying from the seed of the block is cheaper than replaying more than a block */
+        if (pos == SIZE_MAX || pos > r || r - pos > FRAME_LOG_INDEX_BLOCK_RECORDS) {
+            size_t b = r / FRAME_LOG_INDEX_BLOCK_RECORDS;
+
+            frame_log_index_seed_ctx(&idx->blocks[b], &ctx);
+            pos = b * FRAME_LOG_INDEX_BLOCK_RECORDS;
+        }
+
+        for (; pos <= r; pos++)
+            cb_proto_store_frame(&ctx, map->records[pos].com, frame_log_record_data(&map->records[pos]));
+
+        print_record(prefix, &map->records[r], &ctx);
+    }
+}
+
+static int query_file(const char *filename, bool with_prefix, size_t *total)
+{
+    struct frame_log_index idx;
+    struct frame_log_map map;
+    struct scan_job *job_list;
+    size_t first_block, last_block, per_job;
+    unsigned int n, i;
+    bool failed = false;
+    char *prefix = "";
+    int rv = -1;
+
+    if (frame_log_map(&map, filename)) {
+        error("could not open '%s': %m", filename);
+        return -1;
+    }
+
+    if (frame_log_index_load(&idx, filename, &map, update_index)) {
+        error("could not index '%s': %m", filename);
+        goto unmap_out;
+    }
+
+    /* use the index to narrow the range of blocks by time */
+    first_block = frame_log_index_find_ts(&idx, since_ns);
+    last_block = frame_log_index_find_ts(&idx, until_ns);
+    if (last_block < idx.block_count)
+        last_block++;
+
+    debug("'%s': %zu records in %zu blocks, scanning blocks %zu...%zu",
+          filename, map.count, idx.block_count, first_block, last_block);
+
+    /* there is no sense in starting more threads than we have blocks */
+    n = min((size_t)jobs, max(last_block - first_block, (size_t)1));
+    per_job = (last_block - first_block + n - 1) / n;
+
+    job_list = calloc(n, sizeof(*job_list));
+    if (!job_list)
+        goto free_idx_out;
+
+    for (i = 0; i < n; i++) {
+        struct scan_job *job = &job_list[i];
+
+        job->map = &map;
+        job->idx = &idx;
+        job->first_block = min(first_block + i * per_job, last_block);
+        job->last_block = min(job->first_block + per_job, last_block);
+
+        if (pthread_create(&job->thread, NULL, scan_thread, job)) {
+            error("could not create thread: %m");
+            failed = true;
+            /* only join the already started ones */
+            n = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        pthread_join(job_list[i].thread, NULL);
+        if (job_list[i].rv) {
+            error("out of memory while scanning '%s'", filename);
+            failed = true;
+        }
+    }
+
+    if (!failed) {
+        rv = 0;
+
+        if (with_prefix && asprintf(&prefix, "%s: ", filename) < 0)
+            prefix = NULL;
+
+        /* threads scanned consecutive block ranges, so the results are already sorted */
+        for (i = 0; i < n; i++) {
+            *total += job_list[i].match_count;
+            if (!count_only)
+                print_matches(prefix ? prefix : "", &map, &idx, job_list[i].matches, job_list[i].match_count);
+        }
+
+        if (with_prefix)
+            free(prefix);
+    }
+
+    for (i = 0; i < n; i++)
+        free(job_list[i].matches);
+    free(job_list);
+
+free_idx_out:
+    frame_log_index_free(&idx);
+unmap_out:
+    frame_log_unmap(&map);
+    return rv;
+}
+
+int main(int argc, char *argv[])
+{
+    int rc = EXIT_SUCCESS;
+    size_t total = 0;
+    unsigned int i;
+    int f;
+
+    /* register debug and error message callbacks */
+    ra_utils_set_error_msg_cb(error_cb);
+    ra_utils_set_debug_msg_cb(debug_cb);
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    if (jobs == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? cpus : 1;
+    }
+
+    /* without any condition, each frame is reported */
+    for (i = 0; i <= COM_MAX; i++) {
+        unsigned int c;
+
+        com_is_relevant[i] = (cond_count == 0);
+        for (c = 0; c < cond_count; c++)
+            if (cb_proto_field_is_carried_by(conds[c].field, i))
+                com_is_relevant[i] = true;
+    }
+
+    for (f = optind; f < argc; f++) {
+        if (query_file(argv[f], argc - optind > 1, &total))
+            rc = EXIT_FAILURE;
+    }
+
+    if (count_only)
+        printf("%zu\n", total);
+
+    return rc;
+}
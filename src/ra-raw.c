@@ -9,7 +9,7 @@
  * Usage: ra-raw [<options>]
  *
  *  Options:
- *          -d, --uart              UART interface (default: /dev/ttyLP2)
+ *          -d, --uart              UART interface (default: /dev/ttyLP2), repeat to monitor several controllers
  *          -S, --sync              initial receive sync (default: send packet first)
  *          -D, --no-dump           don't dump data (useful only in verbose mode to print only received frames)
  *          -C, --no-charge-control don't send Charge Control frames automatically
@@ -18,10 +18,24 @@
  *          -m, --md-gpio           GPIO name for controlling MD pin of MCU (default: SAFETY_BOOTMODE_SET)
  *          -p, --reset-period      reset duration (in ms, default: 500)
  *          -R, --no-reset          don't reset the safety controller before starting UART communication
+ *          -T, --reset-stagger     offset between the initial resets of several controllers (in ms, default: 0, all together)
  *          -M, --can-mirror        mirror RX/TX traffic to given CAN interface
+ *          -L, --record            record RX/TX traffic into given frame log file (appending)
+ *          -F, --refresh-rate      maximum screen updates per second (default: 10, 0: after each frame)
+ *          -f, --format            output format: screen, jsonl or csv (default: screen)
+ *          -O, --changes-only      jsonl/csv: output only frames which changed a decoded value
+ *          -i, --flush-interval    jsonl/csv: flush output at most every N ms (default: 0, after each frame)
+ *          -P, --scenario          execute the given scenario file and exit with its result
+ *          -x, --metrics-file      write OpenMetrics textfile periodically (e.g. for node_exporter)
+ *          -I, --metrics-interval  interval for writing the metrics textfile (in ms, default: 15000)
+ *          -X, --metrics-listen    serve OpenMetrics on given socket: unix:<path>, <port> or <host>:<port>
  *          -v, --verbose           verbose operation
  *          -V, --version           print version and exit
  *          -h, --help              print this usage and exit
+ *
+ *  The options -d, -c, -r, -m and -M can be given once per controller: the n-th
+ *  occurrence applies to the n-th controller, the last one given also to all
+ *  following controllers.
  */
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -31,7 +45,7 @@
 #include <endian.h>
 #include <fcntl.h>
 #include <getopt.h>
-#include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -39,15 +53,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
+#include <cb_proto_field.h>
 #include <cb_protocol.h>
+#include <cb_metrics.h>
 #include <cb_uart.h>
+#include <frame_log.h>
 #include <logging.h>
 #include <tools.h>
 #include <uart.h>
 #include <version.h>
 #include "ra_gpio.h"
+#include "ra_reset.h"
+#include "outbuf.h"
+#include "scenario.h"
+#include "screen.h"
 #include "stringify.h"
 #include "gpio-defaults.h"
 #include "uart-defaults.h"
@@ -57,6 +80,27 @@
 #define PACKAGE_STRING "ra-utils (unknown version)"
 #endif
 
+/* screen updates per second */
+#define DEFAULT_REFRESH_RATE 10
+
+/* interval for writing the metrics textfile, in ms */
+#define DEFAULT_METRICS_INTERVAL 15000
+
+/* upper limit of registered fields we can handle in jsonl/csv output */
+#define FRAME_FIELDS_MAX 64
+
+/* maximum count of safety controllers monitored at the same time */
+#define MAX_TARGETS 4
+
+/* count of field changes shown in the timeline of the combined view */
+#define TIMELINE_ENTRIES 10
+
+enum output_format {
+    FORMAT_SCREEN,
+    FORMAT_JSONL,
+    FORMAT_CSV,
+};
+
 /* command line options */
 static const struct option long_options[] = {
     { "uart",               required_argument,      0,      'd' },
@@ -68,7 +112,17 @@ static const struct option long_options[] = {
     { "md-gpio",            required_argument,      0,      'm' },
     { "reset-period",       required_argument,      0,      'p' },
     { "no-reset",           no_argument,            0,      'R' },
+    { "reset-stagger",      required_argument,      0,      'T' },
     { "can-mirror",         required_argument,      0,      'M' },
+    { "record",             required_argument,      0,      'L' },
+    { "refresh-rate",       required_argument,      0,      'F' },
+    { "format",             required_argument,      0,      'f' },
+    { "changes-only",       no_argument,            0,      'O' },
+    { "flush-interval",     required_argument,      0,      'i' },
+    { "scenario",           required_argument,      0,      'P' },
+    { "metrics-file",       required_argument,      0,      'x' },
+    { "metrics-interval",   required_argument,      0,      'I' },
+    { "metrics-listen",     required_argument,      0,      'X' },
 
     { "verbose",            no_argument,            0,      'v' },
     { "version",            no_argument,            0,      'V' },
@@ -76,11 +130,11 @@ static const struct option long_options[] = {
     {} /* stop condition for iterator */
 };
 
-static const char *short_options = "d:SDCc:r:m:p:RM:vVh";
+static const char *short_options = "d:SDCc:r:m:p:RT:M:L:F:f:Oi:P:x:I:X:vVh";
 
 /* descriptions for the command line options */
 static const char *long_options_descs[] = {
-    "UART interface (default: " DEFAULT_UART_INTERFACE ")",
+    "UART interface (default: " DEFAULT_UART_INTERFACE "), repeat to monitor several controllers",
     "initial receive sync (default: send packet first)",
     "don't dump data (useful only in verbose mode to print only received frames)",
     "don't send Charge Control frames automatically",
@@ -89,7 +143,17 @@ static const char *long_options_descs[] = {
     "GPIO name for controlling MD pin of MCU (default: " DEFAULT_RA_GPIO_MD_PIN ")",
     "reset duration (in ms, default: " __stringify(DEFAULT_RA_RESET_DELAY) ")",
     "don't reset the safety controller before starting UART communication",
+    "offset between the initial resets of several controllers (in ms, default: 0, all together)",
     "mirror RX/TX traffic to given CAN interface",
+    "record RX/TX traffic into given frame log file (appending)",
+    "maximum screen updates per second (default: " __stringify(DEFAULT_REFRESH_RATE) ", 0: after each frame)",
+    "output format: screen, jsonl or csv (default: screen)",
+    "jsonl/csv: output only frames which changed a decoded value",
+    "jsonl/csv: flush output at most every N ms (default: 0, after each frame)",
+    "execute the given scenario file and exit with its result",
+    "write OpenMetrics textfile periodically (e.g. for node_exporter)",
+    "interval for writing the metrics textfile (in ms, default: " __stringify(DEFAULT_METRICS_INTERVAL) ")",
+    "serve OpenMetrics on given socket: unix:<path>, <port> or <host>:<port>",
 
     "verbose operation",
     "print version and exit",
@@ -133,24 +197,136 @@ static bool intial_sync = false;
 static bool no_dump = false;
 static bool send_charge_control = true;
 static bool no_reset = false;
-static char *gpiochip = DEFAULT_RA_GPIOCHIP;
-static char *reset_gpioname = DEFAULT_RA_GPIO_RESET_PIN;
-static char *md_gpioname = DEFAULT_RA_GPIO_MD_PIN;
 static unsigned int reset_duration = DEFAULT_RA_RESET_DELAY;
-static char *uart_device = DEFAULT_UART_INTERFACE;
-static char *can_mirror_device = NULL;
+static unsigned int reset_stagger = 0;
+static char *frame_log_filename = NULL;
+static unsigned int refresh_rate = DEFAULT_REFRESH_RATE;
+static enum output_format format = FORMAT_SCREEN;
+static bool changes_only = false;
+static unsigned int flush_interval = 0;
+static char *scenario_filename = NULL;
+static char *metrics_filename = NULL;
+static unsigned int metrics_interval = DEFAULT_METRICS_INTERVAL;
+static char *metrics_address = NULL;
+
+/* per-target command line options; the n-th occurrence applies to the n-th target,
+ * the last one given also to all remaining targets
+ */
+struct target_option {
+    char *values[MAX_TARGETS];
+    unsigned int count;
+};
+
+static struct target_option opt_uart_device;
+static struct target_option opt_gpiochip;
+static struct target_option opt_reset_gpioname;
+static struct target_option opt_md_gpioname;
+static struct target_option opt_can_mirror_device;
+
+enum target_state {
+    STATE_INIT_FW_VERSION,
+    STATE_INIT_PNM1,
+    STATE_INIT_PNM2,
+    STATE_INIT_CHIPINFO,
+    STATE_INIT_GIT_HASH,
+    STATE_RUN_LOOP,
+};
+
+/* a safety controller we talk to */
+struct target {
+    unsigned int index;
+
+    char *uart_device;
+    char *gpiochip;
+    char *reset_gpioname;
+    char *md_gpioname;
+    char *can_mirror_device;
+
+    struct uart_ctx uart;
+    struct safety_controller ctx;
+    struct cb_metrics metrics;
+    enum target_state state;
+
+    /* type of the last received frame */
+    enum cb_uart_com com;
+
+    /* last decoded value of each field, to detect changes */
+    int32_t values[FRAME_FIELDS_MAX];
+    bool seen[FRAME_FIELDS_MAX];
+};
+
+static struct target targets[MAX_TARGETS];
+static unsigned int target_count;
+
+/* the RESET and MD lines of all targets, kept for the whole runtime */
+static struct ra_reset *reset_engine;
+
+/* the target which keyboard commands apply to */
+static unsigned int selected_target;
+
+/* shared frame log of all targets */
+static struct frame_log *frame_log;
+
+/* field indexes carried by each frame type */
+static uint8_t fields_by_com[COM_MAX + 1][FRAME_FIELDS_MAX];
+static uint8_t field_count_by_com[COM_MAX + 1];
+
+/* common time base of all targets */
+static struct timespec ts_start;
+
+/* recent field changes of all targets, shown when monitoring several targets */
+struct timeline_entry {
+    struct timespec mono;
+    unsigned int target;
+    unsigned int field;
+    int32_t old_value;
+    int32_t new_value;
+};
+
+static struct timeline_entry timeline[TIMELINE_ENTRIES];
+static unsigned int timeline_head;
+static unsigned int timeline_count;
+
+/* differential screen output */
+static struct screen screen = INIT_SCREEN;
+static bool render_pending = false;
+static struct timespec next_render;
+
+/* next due time of writing the metrics file */
+static struct timespec next_metrics_write;
+
+/* maximum count of concurrently served metrics connections */
+#define MAX_METRICS_CONNS 4
+
+/* metrics connections in progress, driven by the main loop */
+static struct cb_metrics_conn *metrics_conns[MAX_METRICS_CONNS];
+
+/* streaming output (jsonl/csv) */
+static struct stream {
+    struct outbuf ob;
+    struct timespec next_flush;
+} *stream;
+
+/* set by SIGINT/SIGTERM, the regular way to stop streaming */
+static volatile sig_atomic_t stream_terminate = 0;
 
 static void debug_cb(const char *format, va_list args)
 {
+    /* when streaming, stdout carries the data only */
+    FILE *f = stream ? stderr : stdout;
+
     if (verbose) {
-        printf("debug: ");
-        vprintf(format, args);
-        printf("\r\n");
+        fprintf(f, "debug: ");
+        vfprintf(f, format, args);
+        fprintf(f, "\r\n");
     }
 }
 
 static void error_cb(const char *format, va_list args)
 {
+    /* the message scrolls the screen, so that a full redraw is required */
+    screen_invalidate(&screen);
+
     fprintf(stderr, "Error: ");
     vfprintf(stderr, format, args);
     fprintf(stderr, "\r\n");
@@ -166,7 +342,7 @@ static void xdebug(const char *format, ...)
     }
 }
 
-void make_stdin_unbuffered(struct termios *orig)
+static void make_stdin_unbuffered(struct termios *orig)
 {
     struct termios termios_new;
 
@@ -176,7 +352,348 @@ void make_stdin_unbuffered(struct termios *orig)
     tcsetattr(STDIN_FILENO, TCSANOW, &termios_new);
 }
 
-void parse_cli(int argc, char *argv[])
+static void init_field_table(void)
+{
+    unsigned int count = cb_proto_field_count();
+    unsigned int com, f;
+
+    for (com = 0; com <= COM_MAX; com++)
+        for (f = 0; f < count && f < FRAME_FIELDS_MAX; f++)
+            if (cb_proto_field_is_carried_by(cb_proto_field_by_index(f), com))
+                fields_by_com[com][field_count_by_com[com]++] = f;
+}
+
+/* update the remembered field values of the target and note all changes in the timeline;
+ * returns true if any field carried by this frame type changed
+ */
+static bool target_update_fields(struct target *t, uint8_t com, const struct timespec *mono)
+{
+    bool changed = false;
+    unsigned int i;
+
+    for (i = 0; i < field_count_by_com[com]; i++) {
+        unsigned int f = fields_by_com[com][i];
+        int32_t v = cb_proto_field_by_index(f)->get(&t->ctx);
+
+        if (t->seen[f] && t->values[f] == v)
+            continue;
+
+        /* the initial values are no changes worth to note */
+        if (target_count > 1 && t->seen[f]) {
+            struct timeline_entry *e = &timeline[timeline_head];
+
+            e->mono = *mono;
+            e->target = t->index;
+            e->field = f;
+            e->old_value = t->values[f];
+            e->new_value = v;
+
+            timeline_head = (timeline_head + 1) % TIMELINE_ENTRIES;
+            if (timeline_count < TIMELINE_ENTRIES)
+                timeline_count++;
+        }
+
+        t->values[f] = v;
+        t->seen[f] = true;
+        changed = true;
+    }
+
+    return changed;
+}
+
+static void print_timeline(FILE *f)
+{
+    unsigned int i;
+
+    fprintf(f, "== Timeline (ms since start) ==\r\n");
+
+    for (i = 0; i < TIMELINE_ENTRIES; i++) {
+        unsigned int idx = (timeline_head + TIMELINE_ENTRIES - timeline_count + i) % TIMELINE_ENTRIES;
+        const struct timeline_entry *e = &timeline[idx];
+        const struct cb_proto_field *field;
+        char old_str[32], new_str[32];
+
+        /* print empty lines, so that the screen layout is stable */
+        if (i >= timeline_count) {
+            fprintf(f, "\r\n");
+            continue;
+        }
+
+        field = cb_proto_field_by_index(e->field);
+        cb_proto_field_value_to_str(field, e->old_value, old_str, sizeof(old_str));
+        cb_proto_field_value_to_str(field, e->new_value, new_str, sizeof(new_str));
+
+        fprintf(f, "%12.3f  [%u] %s: %s -> %s\r\n",
+                timespec_to_us(timespec_sub(e->mono, ts_start)) / 1000.0,
+                e->target + 1, field->name, old_str, new_str);
+    }
+}
+
+static void print_commands(FILE *f, struct safety_controller *ctx)
+{
+    if (!cb_proto_is_mcs_mode(ctx)) {
+        fprintf(f, "== Available commands ==\r\n"
+                   "  e -- enable PWM                   E -- disable PWM\r\n"
+                   "  r -- enable PWM with 5%%           t -- enable PWM with 10%%          z -- enable PWM with 100%%\r\n"
+                   "  0 -- set PWM duty cycle to 0%%     5 -- set PWM duty cycle to 5%%     9 -- set PWM duty cycle to 100%%\r\n"
+                   "  - -- decrease PWM value by 1%%     + -- increase PMW value by 1%%     6 -- set PWM duty cycle to 10%%\r\n"
+                   "  1 -- toggle contactor 1           2 -- toggle contactor 2           3 -- toggle contactor 3\r\n"
+                   "  c -- (manually) send a Charge Control frame                         T -- start RCM test\r\n"
+                   "  s -- toggle auto sending of Charge Control frames (auto-sending: %s)\r\n"
+                   "  q -- quit the program\r\n", send_charge_control ? "on" : "off");
+    } else {
+        fprintf(f, "== Available commands ==\r\n"
+                   "  r -- set CCS Ready to Ready       R -- set CCS Ready to Not Ready\r\n"
+                   "  e -- set CCS Ready to Emergency Stop\r\n"
+                   "  c -- (manually) send a Charge Control frame\r\n"
+                   "  s -- toggle auto sending of Charge Control frames (auto-sending: %s)\r\n"
+                   "  q -- quit the program\r\n", send_charge_control ? "on" : "off");
+    }
+
+    if (target_count > 1)
+        fprintf(f, "  Tab -- select next controller (commands apply to controller %u)\r\n", selected_target + 1);
+}
+
+static void print_all(FILE *f)
+{
+    unsigned int i;
+
+    for (i = 0; i < target_count; i++) {
+        if (target_count > 1)
+            fprintf(f, "######## Controller %u: %s%s ########\r\n", i + 1, targets[i].uart_device,
+                    i == selected_target ? " (selected)" : "");
+
+        cb_proto_fdump(&targets[i].ctx, f);
+        fprintf(f, "\r\n");
+    }
+
+    if (target_count > 1) {
+        print_timeline(f);
+        fprintf(f, "\r\n");
+    }
+
+    print_commands(f, &targets[selected_target].ctx);
+}
+
+static void render(void)
+{
+    FILE *f;
+
+    render_pending = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &next_render);
+    if (refresh_rate)
+        timespec_add_ms(&next_render, 1000 / refresh_rate);
+
+    /* in verbose mode, debug output is interleaved, so don't address the cursor */
+    if (verbose) {
+        print_all(stdout);
+        fflush(stdout);
+        return;
+    }
+
+    f = screen_begin(&screen);
+    if (!f)
+        return;
+
+    print_all(f);
+
+    if (screen_commit(&screen, stdout) < 0)
+        error("updating the screen failed: %m");
+}
+
+/* render immediately if the refresh interval has elapsed, otherwise remember it */
+static void request_render(void)
+{
+    struct timespec now;
+
+    if (no_dump)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (timespec_compare(&now, &next_render) >= 0)
+        render();
+    else
+        render_pending = true;
+}
+
+/* the poll timeout until a pending screen update is due */
+static int render_timeout(void)
+{
+    struct timespec now;
+    long long ms;
+
+    if (!render_pending)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &next_render) >= 0)
+        return 0;
+
+    ms = timespec_to_ms(timespec_sub(next_render, now));
+
+    /* round up, so that we don't wake up too early */
+    return ms + 1;
+}
+
+static int stream_init(void)
+{
+    unsigned int count = cb_proto_field_count();
+    unsigned int f;
+
+    stream = calloc(1, sizeof(*stream));
+    if (!stream)
+        return -1;
+
+    stream->ob.f = stdout;
+
+    if (format == FORMAT_CSV) {
+        if (target_count > 1)
+            ob_puts(&stream->ob, "target,");
+        ob_puts(&stream->ob, "mono,ts,com,data");
+        for (f = 0; f < count && f < FRAME_FIELDS_MAX; f++) {
+            ob_putc(&stream->ob, ',');
+            ob_puts(&stream->ob, cb_proto_field_by_index(f)->name);
+        }
+        ob_putc(&stream->ob, '\n');
+    }
+
+    return 0;
+}
+
+static int stream_flush(void)
+{
+    int rv = 0;
+
+    if (ob_flush(&stream->ob) || fflush(stdout)) {
+        error("writing to stdout failed: %m");
+        rv = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stream->next_flush);
+    timespec_add_ms(&stream->next_flush, flush_interval);
+
+    return rv;
+}
+
+/* flush immediately if the flush interval has elapsed */
+static int request_stream_flush(void)
+{
+    struct timespec now;
+
+    if (!stream->ob.len)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (timespec_compare(&now, &stream->next_flush) >= 0)
+        return stream_flush();
+
+    return 0;
+}
+
+/* the poll timeout until buffered output must be flushed */
+static int stream_flush_timeout(void)
+{
+    struct timespec now;
+
+    if (!stream->ob.len)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &stream->next_flush) >= 0)
+        return 0;
+
+    return timespec_to_ms(timespec_sub(stream->next_flush, now)) + 1;
+}
+
+/* one record for a received frame; the frame must already be stored in the context */
+static void stream_frame(struct target *t, uint8_t com, uint64_t data, const struct timespec *mono, bool changed)
+{
+    const struct timespec *wall = &t->ctx.ts_recv_com[com];
+    struct outbuf *ob = &stream->ob;
+    unsigned int i;
+
+    if (changes_only && !changed)
+        return;
+
+    if (format == FORMAT_JSONL) {
+        ob_putc(ob, '{');
+        if (target_count > 1) {
+            ob_puts(ob, "\"target\":");
+            ob_u64(ob, t->index + 1, 1);
+            ob_putc(ob, ',');
+        }
+        ob_puts(ob, "\"mono\":");
+        ob_ts_epoch(ob, timespec_to_ns(*mono));
+        ob_puts(ob, ",\"ts\":");
+        ob_ts_epoch(ob, timespec_to_ns(*wall));
+        ob_puts(ob, ",\"com\":\"");
+        ob_puts(ob, cb_uart_com_to_str(com));
+        ob_puts(ob, "\",\"data\":\"");
+        ob_hex64(ob, data);
+        ob_puts(ob, "\",\"fields\":{");
+        for (i = 0; i < field_count_by_com[com]; i++) {
+            unsigned int f = fields_by_com[com][i];
+            const struct cb_proto_field *field = cb_proto_field_by_index(f);
+
+            if (i)
+                ob_putc(ob, ',');
+            ob_putc(ob, '"');
+            ob_puts(ob, field->name);
+            ob_puts(ob, "\":");
+            ob_field_value(ob, field, t->values[f], true, true);
+        }
+        ob_puts(ob, "}}\n");
+    } else {
+        if (target_count > 1) {
+            ob_u64(ob, t->index + 1, 1);
+            ob_putc(ob, ',');
+        }
+        ob_ts_epoch(ob, timespec_to_ns(*mono));
+        ob_putc(ob, ',');
+        ob_ts_epoch(ob, timespec_to_ns(*wall));
+        ob_putc(ob, ',');
+        ob_puts(ob, cb_uart_com_to_str(com));
+        ob_putc(ob, ',');
+        ob_hex64(ob, data);
+        for (i = 0; i < cb_proto_field_count() && i < FRAME_FIELDS_MAX; i++) {
+            const struct cb_proto_field *field = cb_proto_field_by_index(i);
+
+            ob_putc(ob, ',');
+            ob_field_value(ob, field, field->get(&t->ctx), false, true);
+        }
+        ob_putc(ob, '\n');
+    }
+}
+
+static void stream_signal_handler(int sig)
+{
+    (void)sig;
+    stream_terminate = 1;
+}
+
+static void add_target_option(struct target_option *opt, char *value, char *p)
+{
+    if (opt->count == MAX_TARGETS) {
+        fprintf(stderr, "Error: option given too often (max. %d targets).\n\n", MAX_TARGETS);
+        usage(p, EXIT_FAILURE);
+    }
+
+    opt->values[opt->count++] = value;
+}
+
+/* value of a per-target option for the given target index */
+static char *target_option(const struct target_option *opt, unsigned int idx, char *def)
+{
+    if (!opt->count)
+        return def;
+
+    return opt->values[idx < opt->count ? idx : opt->count - 1];
+}
+
+static void parse_cli(int argc, char *argv[])
 {
     int rc = EXIT_FAILURE;
     int i;
@@ -190,7 +707,7 @@ void parse_cli(int argc, char *argv[])
 
         switch (c) {
         case 'd':
-            uart_device = optarg;
+            add_target_option(&opt_uart_device, optarg, argv[0]);
             break;
         case 'S':
             intial_sync = true;
@@ -202,13 +719,13 @@ void parse_cli(int argc, char *argv[])
             send_charge_control = false;
             break;
         case 'c':
-            gpiochip = optarg;
+            add_target_option(&opt_gpiochip, optarg, argv[0]);
             break;
         case 'r':
-            reset_gpioname = optarg;
+            add_target_option(&opt_reset_gpioname, optarg, argv[0]);
             break;
         case 'm':
-            md_gpioname = optarg;
+            add_target_option(&opt_md_gpioname, optarg, argv[0]);
             break;
         case 'p':
             reset_duration = atoi(optarg);
@@ -216,8 +733,47 @@ void parse_cli(int argc, char *argv[])
         case 'R':
             no_reset = true;
             break;
+        case 'T':
+            reset_stagger = atoi(optarg);
+            break;
         case 'M':
-            can_mirror_device = optarg;
+            add_target_option(&opt_can_mirror_device, optarg, argv[0]);
+            break;
+        case 'L':
+            frame_log_filename = optarg;
+            break;
+        case 'F':
+            refresh_rate = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "screen") == 0) {
+                format = FORMAT_SCREEN;
+            } else if (strcmp(optarg, "jsonl") == 0) {
+                format = FORMAT_JSONL;
+            } else if (strcmp(optarg, "csv") == 0) {
+                format = FORMAT_CSV;
+            } else {
+                fprintf(stderr, "Unknown output format '%s'.\n", optarg);
+                usage(argv[0], EXIT_FAILURE);
+            }
+            break;
+        case 'O':
+            changes_only = true;
+            break;
+        case 'i':
+            flush_interval = atoi(optarg);
+            break;
+        case 'P':
+            scenario_filename = optarg;
+            break;
+        case 'x':
+            metrics_filename = optarg;
+            break;
+        case 'I':
+            metrics_interval = atoi(optarg);
+            break;
+        case 'X':
+            metrics_address = optarg;
             break;
 
         case 'v':
@@ -249,59 +805,644 @@ void parse_cli(int argc, char *argv[])
         usage(program_invocation_short_name, EXIT_FAILURE);
 }
 
-int reset_controller(const char *gpiochip,
-                     const char *reset_gpioname, const char *md_gpioname,
-                     const unsigned int reset_duration)
+/* each --uart option defines a target, at least one target is always used */
+static void setup_targets(char *def_uart_device, char *def_gpiochip, char *def_reset_gpioname, char *def_md_gpioname)
+{
+    unsigned int i;
+
+    target_count = opt_uart_device.count ? opt_uart_device.count : 1;
+
+    for (i = 0; i < target_count; i++) {
+        struct target *t = &targets[i];
+
+        t->index = i;
+        t->uart_device = target_option(&opt_uart_device, i, def_uart_device);
+        t->gpiochip = target_option(&opt_gpiochip, i, def_gpiochip);
+        t->reset_gpioname = target_option(&opt_reset_gpioname, i, def_reset_gpioname);
+        t->md_gpioname = target_option(&opt_md_gpioname, i, def_md_gpioname);
+        t->can_mirror_device = target_option(&opt_can_mirror_device, i, NULL);
+        t->uart = (struct uart_ctx)INIT_UART_CTX;
+        t->state = STATE_INIT_FW_VERSION;
+    }
+
+    /* since the last value of an option repeats, several controllers easily end up with
+     * the same GPIO lines or CAN mirror device, which only fails later or mixes their frames */
+    for (i = 0; i < target_count; i++) {
+        struct target *a = &targets[i];
+        unsigned int j;
+
+        for (j = i + 1; j < target_count; j++) {
+            struct target *b = &targets[j];
+            const char *line = NULL;
+
+            if (!no_reset && strcmp(a->gpiochip, b->gpiochip) == 0) {
+                if (strcmp(a->reset_gpioname, b->reset_gpioname) == 0 || strcmp(a->reset_gpioname, b->md_gpioname) == 0)
+                    line = a->reset_gpioname;
+                else if (strcmp(a->md_gpioname, b->md_gpioname) == 0 || strcmp(a->md_gpioname, b->reset_gpioname) == 0)
+                    line = a->md_gpioname;
+            }
+
+            if (line) {
+                fprintf(stderr, "Error: safety controllers %u and %u both use GPIO '%s' of '%s', "
+                        "please give -r and -m for each one (or use -R).\n", i + 1, j + 1, line, a->gpiochip);
+                exit(EXIT_FAILURE);
+            }
+
+            if (a->can_mirror_device && b->can_mirror_device &&
+                strcmp(a->can_mirror_device, b->can_mirror_device) == 0) {
+                fprintf(stderr, "Error: safety controllers %u and %u both mirror to '%s', "
+                        "please give -M for each one.\n", i + 1, j + 1, a->can_mirror_device);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+static int target_send_charge_control(struct target *t)
+{
+    enum cb_uart_com com = cb_proto_cc_get_com(&t->ctx);
+    uint64_t data = cb_proto_cc_get_data(&t->ctx);
+    int rv;
+
+    /* remember the timestamp */
+    cb_proto_set_ts(&t->ctx, com);
+
+    rv = cb_uart_send(&t->uart, com, data);
+    if (rv) {
+        error("error while sending charge control frame: %m");
+        return rv;
+    }
+
+    cb_proto_cc_sent(&t->ctx, data);
+
+    return 0;
+}
+
+/* send what is due after the last event: an inquiry during initialization,
+ * or a Charge Control frame in reply to a Charge State frame
+ */
+static int target_kick(struct target *t)
 {
-    struct gpio_ctx *gpio;
+    enum cb_uart_com com;
     int rv;
 
-    gpio = ra_gpio_init(gpiochip, reset_gpioname, md_gpioname);
-    if (!gpio) {
+    switch (t->state) {
+    case STATE_INIT_FW_VERSION:
+        com = COM_FW_VERSION;
+        break;
+    case STATE_INIT_PNM1:
+        com = COM_PARTNUMBER_1;
+        break;
+    case STATE_INIT_PNM2:
+        com = COM_PARTNUMBER_2;
+        break;
+    case STATE_INIT_CHIPINFO:
+        com = COM_CHIPINFO;
+        break;
+    case STATE_INIT_GIT_HASH:
+        com = COM_GIT_HASH;
+        break;
+    default:
+        /* send out charge control frame when last received frame was a charge state one */
+        if ((t->com == COM_CHARGE_STATE || t->com == COM_CHARGE_STATE_2) && send_charge_control)
+            return target_send_charge_control(t);
+        return 0;
+    }
+
+    rv = cb_send_uart_inquiry(&t->uart, com);
+    if (rv) {
+        error("error while sending inquiry frame for '%s': %m", cb_uart_com_to_str(com));
+        return rv;
+    }
+
+    /* start sending charge control frames together with the last inquiry already */
+    if (t->state == STATE_INIT_GIT_HASH && send_charge_control)
+        return target_send_charge_control(t);
+
+    return 0;
+}
+
+static int target_sync(struct target *t)
+{
+    enum cb_uart_com com;
+    uint64_t data;
+    int rv;
+
+    if (intial_sync) {
+        /* sync the receiving side */
+        rv = cb_uart_recv_and_sync(&t->uart, &com, &data);
+        if (rv) {
+            error("could not synchronize to the safety controller %u: %m", t->index + 1);
+            return rv;
+        }
+    }
+
+    t->state = STATE_INIT_FW_VERSION;
+
+    return 0;
+}
+
+/* acquire the GPIOs of all targets once, so that resets don't need to open the chips again */
+static int targets_request_gpios(void)
+{
+    unsigned int i;
+
+    reset_engine = ra_reset_new();
+    if (!reset_engine) {
+        error("out of memory");
+        return -1;
+    }
+
+    for (i = 0; i < target_count; i++) {
+        struct target *t = &targets[i];
+
+        if (ra_reset_add(reset_engine, t->gpiochip, t->reset_gpioname, t->md_gpioname) < 0) {
+            error("could not add safety controller %u: %m", t->index + 1);
+            return -1;
+        }
+    }
+
+    if (ra_reset_request(reset_engine)) {
         error("could not acquire GPIOs: %m");
         return -1;
     }
 
-    ra_set_reset_duration(gpio, reset_duration);
+    return 0;
+}
+
+/* reset all targets together (or staggered) and wait once until they are ready */
+static int targets_reset(void)
+{
+    struct ra_reset_sequence seq = {
+        .mask = (1U << target_count) - 1,
+        .mode = RA_RESET_NORMAL,
+        .duration = reset_duration,
+        .stagger = reset_stagger,
+    };
+    unsigned int i;
+    int rv;
 
-    rv = ra_reset_to_normal(gpio);
+    /* unless not desired, reset the safety controllers via GPIO */
+    if (!no_reset) {
+        rv = ra_reset_run(reset_engine, &seq);
+        if (rv) {
+            error("resetting safety controllers failed: %m");
+            return rv;
+        }
 
-    /* release the GPIOs immediately so that programs in parallel can acquire them */
-    ra_gpio_close(gpio);
+        /* when successfully reseted, sleep until the controllers are ready again */
+        msleep(CB_PROTO_STARTUP_DELAY);
+    }
 
+    for (i = 0; i < target_count; i++) {
+        rv = target_sync(&targets[i]);
+        if (rv)
+            return rv;
+    }
+
+    return 0;
+}
+
+static int target_reset(struct target *t)
+{
+    int rv;
+
+    /* unless not desired, reset the safety controller via GPIO */
+    if (!no_reset) {
+        rv = ra_reset_one(reset_engine, t->index, RA_RESET_NORMAL, reset_duration);
+        if (rv) {
+            error("resetting safety controller %u failed: %m", t->index + 1);
+            return rv;
+        }
+
+        /* when successfully reseted, sleep until controller is ready again */
+        msleep(CB_PROTO_STARTUP_DELAY);
+    }
+
+    return target_sync(t);
+}
+
+static int target_receive(struct target *t)
+{
+    struct timespec ts_mono;
+    enum cb_uart_com com;
+    uint64_t data;
+    bool changed;
+    int rv;
+
+    rv = cb_uart_recv(&t->uart, &com, &data);
     if (rv) {
-        error("resetting safety controller failed: %m");
-        return rv;
+        uint8_t buf[64];
+        ssize_t c;
+
+        error("error while receiving frame from the safety controller %u: %m", t->index + 1);
+
+        c = read(t->uart.fd, &buf, sizeof(buf));
+        if (c < 0) {
+            error("error while receiving unprocessed data: %m");
+            return -1;
+        }
+
+        error("unprocessed data in input buffer follows (%zu bytes):", c);
+
+        uart_dump_frame(false, false, buf, c);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_mono);
+    cb_proto_set_ts(&t->ctx, com);
+
+    cb_proto_store_frame(&t->ctx, com, data);
+    t->com = com;
+
+    changed = target_update_fields(t, com, &ts_mono);
+
+    if (stream)
+        stream_frame(t, com, data, &ts_mono, changed);
+
+    switch (com) {
+    case COM_FW_VERSION:
+        /* fw version prior to 0.2.9 does not support part number reading,
+         * so we have to skip directly to git hash reading */
+        if (compare_version(t->ctx.fw_version_str, "0.2.9") <= 0)
+            t->state = STATE_INIT_GIT_HASH;
+        else
+            t->state = STATE_INIT_PNM1;
+        break;
+    case COM_GIT_HASH:
+        t->state = STATE_RUN_LOOP;
+        break;
+    case COM_PARTNUMBER_1:
+        t->state = STATE_INIT_PNM2;
+        break;
+    case COM_PARTNUMBER_2:
+        t->state = STATE_INIT_CHIPINFO;
+        break;
+    case COM_CHIPINFO:
+        t->state = STATE_INIT_GIT_HASH;
+        break;
+    default:
+        /* not yet implemented */
+    }
+
+    return target_kick(t);
+}
+
+enum command_result {
+    COMMAND_OK,
+    COMMAND_QUIT,
+    COMMAND_RESTART,
+    COMMAND_ERROR,
+};
+
+/* handle a key press which changes the Charge Control of the given target; returns false for unknown keys */
+static bool handle_charge_control_command(struct target *t, char cmd)
+{
+    struct safety_controller *ctx = &t->ctx;
+
+    if (!cb_proto_is_mcs_mode(ctx)) {
+        switch (cmd) {
+        case 'e':
+            cb_proto_set_pwm_active(ctx, 1);
+            return true;
+        case 'E':
+            cb_proto_set_pwm_active(ctx, 0);
+            return true;
+        case 'r':
+            cb_proto_set_duty_cycle(ctx, 50);
+            cb_proto_set_pwm_active(ctx, 1);
+            return true;
+        case 't':
+            cb_proto_set_duty_cycle(ctx, 100);
+            cb_proto_set_pwm_active(ctx, 1);
+            return true;
+        case 'T':
+            cb_send_uart_action_inquiry(&t->uart, ACTION_ID_RCM_SELFTEST);
+            return true;
+        case 'z':
+            cb_proto_set_duty_cycle(ctx, 1000);
+            cb_proto_set_pwm_active(ctx, 1);
+            return true;
+        case '1':
+        case '2':
+        case '3':
+            cb_proto_contactorN_set_state(ctx, cmd - '1', !cb_proto_contactorN_get_target_state(ctx, cmd - '1'));
+            return true;
+        case '0':
+            cb_proto_set_duty_cycle(ctx, 0);
+            return true;
+        case '5':
+            cb_proto_set_duty_cycle(ctx, 50);
+            return true;
+        case '6':
+            cb_proto_set_duty_cycle(ctx, 100);
+            return true;
+        case '9':
+            cb_proto_set_duty_cycle(ctx, 1000);
+            return true;
+        case '-': {
+            unsigned int duty_cycle = cb_proto_get_target_duty_cycle(ctx) - 10;
+            /* check for underflow */
+            if (duty_cycle > 1000)
+                duty_cycle = 0;
+            cb_proto_set_duty_cycle(ctx, duty_cycle);
+            return true;
+        }
+        case '+':
+            /* overflow is already checked in library */
+            cb_proto_set_duty_cycle(ctx, cb_proto_get_target_duty_cycle(ctx) + 10);
+            return true;
+        }
+    } else {
+        switch (cmd) {
+        case 'r':
+            cb_proto_set_ccs_ready(ctx, true);
+            return true;
+        case 'R':
+            cb_proto_set_ccs_ready(ctx, false);
+            return true;
+        case 'e':
+            cb_proto_set_estop(ctx, true);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* handle a key press for the given target */
+static enum command_result handle_command(struct target *t, char cmd)
+{
+    struct safety_controller *ctx = &t->ctx;
+    bool handled;
+
+    /* common commands */
+    switch (cmd) {
+    case 's':
+        send_charge_control = !send_charge_control;
+        return COMMAND_OK;
+    case 'c':
+        if (target_send_charge_control(t))
+            return COMMAND_ERROR;
+        return COMMAND_OK;
+    case 'q':
+    case 0x03: /* Ctrl-C */
+        return COMMAND_QUIT;
+    case 0x12: /* Ctrl-R */
+        return COMMAND_RESTART;
+    case '\t':
+        selected_target = (selected_target + 1) % target_count;
+        return COMMAND_OK;
+    case 0x0c: /* Ctrl-L */
+        screen_invalidate(&screen);
+        return COMMAND_OK;
+    case '\r':
+    case '\n':
+        printf("\r\n");
+        screen_invalidate(&screen);
+        return COMMAND_OK;
+    }
+
+    /* keys which set several fields take effect with one frame; safety-relevant
+     * changes are sent right away, see flush_urgent_charge_control()
+     */
+    cb_proto_cc_begin(ctx);
+    handled = handle_charge_control_command(t, cmd);
+    cb_proto_cc_commit(ctx);
+
+    if (handled)
+        return COMMAND_OK;
+
+    if (isprint(cmd))
+        error("Unknown command '%c', use 'h' or '?' to show available commands.", cmd);
+    else
+        error("Unknown command '0x%02x', use 'h' or '?' to show available commands.", cmd);
+
+    return COMMAND_OK;
+}
+
+static void metrics_sources(struct cb_metrics_source *sources)
+{
+    unsigned int i;
+
+    for (i = 0; i < target_count; i++) {
+        sources[i].name = targets[i].uart_device;
+        sources[i].metrics = &targets[i].metrics;
+        sources[i].ctx = &targets[i].ctx;
+    }
+}
+
+/* the poll timeout until the metrics file must be written */
+static int metrics_timeout(void)
+{
+    struct timespec now;
+
+    if (!metrics_filename)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_compare(&now, &next_metrics_write) >= 0)
+        return 0;
+
+    return timespec_to_ms(timespec_sub(next_metrics_write, now)) + 1;
+}
+
+/* write the metrics file if the interval has elapsed */
+static void request_metrics_write(void)
+{
+    struct cb_metrics_source sources[MAX_TARGETS];
+
+    if (metrics_timeout() != 0)
+        return;
+
+    metrics_sources(sources);
+
+    /* errors are already reported, we try again next time */
+    cb_metrics_write_textfile(metrics_filename, sources, target_count);
+
+    clock_gettime(CLOCK_MONOTONIC, &next_metrics_write);
+    timespec_add_ms(&next_metrics_write, metrics_interval);
+}
+
+/* send safety-relevant Charge Control changes committed by interactive commands without
+ * waiting for the next Charge State */
+static int flush_urgent_charge_control(void)
+{
+    unsigned int i;
+
+    if (!send_charge_control)
+        return 0;
+
+    for (i = 0; i < target_count; i++) {
+        if (cb_proto_cc_send_urgent(&targets[i].ctx, &targets[i].uart) < 0) {
+            error("error while sending charge control frame: %m");
+            return -1;
+        }
     }
 
-    /* when successfully reseted, sleep until controller is ready again */
-    msleep(CB_PROTO_STARTUP_DELAY);
+    return 0;
+}
+
+/* the poll timeout until a rate-limited urgent Charge Control frame may be sent */
+static int urgent_charge_control_timeout(void)
+{
+    int timeout = -1;
+    unsigned int i;
+
+    if (!send_charge_control)
+        return -1;
+
+    for (i = 0; i < target_count; i++) {
+        int t = cb_proto_cc_urgent_timeout(&targets[i].ctx);
+
+        if (t >= 0 && (timeout < 0 || t < timeout))
+            timeout = t;
+    }
+
+    return timeout;
+}
+
+/* the shorter one of two poll timeouts, -1 meaning infinite */
+static int min_timeout(int a, int b)
+{
+    if (a < 0)
+        return b;
+    if (b < 0)
+        return a;
+
+    return min(a, b);
+}
+
+/* epoll tags besides the target indexes */
+#define EPOLL_TAG_STDIN    0x100
+#define EPOLL_TAG_SCENARIO 0x101
+#define EPOLL_TAG_METRICS  0x102
+/* followed by one tag per metrics connection */
+#define EPOLL_TAG_METRICS_CONN 0x103
+
+static int epoll_set(int epfd, int op, int fd, uint32_t events, uint32_t tag)
+{
+    struct epoll_event ev = { .events = events, .data.u32 = tag };
+
+    if (epoll_ctl(epfd, op, fd, &ev)) {
+        error("epoll_ctl() failed: %m");
+        return -1;
+    }
 
     return 0;
 }
 
+static int epoll_add(int epfd, int fd, uint32_t tag)
+{
+    return epoll_set(epfd, EPOLL_CTL_ADD, fd, EPOLLIN, tag);
+}
+
+/* the poll timeout until a metrics connection must be processed */
+static int metrics_conns_timeout(void)
+{
+    int timeout = -1;
+    unsigned int i;
+
+    for (i = 0; i < MAX_METRICS_CONNS; i++)
+        if (metrics_conns[i])
+            timeout = min_timeout(timeout, cb_metrics_conn_get_timeout(metrics_conns[i]));
+
+    return timeout;
+}
+
+static void metrics_conn_close(unsigned int i)
+{
+    /* closing the fd also removes it from the epoll set */
+    cb_metrics_conn_free(metrics_conns[i]);
+    metrics_conns[i] = NULL;
+}
+
+/* drive a metrics connection with the given events (0 on timeout); the poll and epoll
+ * event bits are the same on Linux */
+static void metrics_conn_process(int epfd, unsigned int i, uint32_t revents)
+{
+    struct cb_metrics_conn *c = metrics_conns[i];
+    struct cb_metrics_source sources[MAX_TARGETS];
+    short events = cb_metrics_conn_get_events(c);
+    int rv;
+
+    metrics_sources(sources);
+
+    rv = cb_metrics_conn_process(c, revents, sources, target_count);
+    if (rv < 0)
+        error("serving metrics failed: %m");
+    if (rv <= 0) {
+        metrics_conn_close(i);
+        return;
+    }
+
+    if (cb_metrics_conn_get_events(c) != events &&
+        epoll_set(epfd, EPOLL_CTL_MOD, cb_metrics_conn_get_fd(c), cb_metrics_conn_get_events(c),
+                  EPOLL_TAG_METRICS_CONN + i))
+        metrics_conn_close(i);
+}
+
+/* process the metrics connections whose deadline has passed */
+static void metrics_conns_expire(int epfd)
+{
+    unsigned int i;
+
+    for (i = 0; i < MAX_METRICS_CONNS; i++)
+        if (metrics_conns[i] && cb_metrics_conn_get_timeout(metrics_conns[i]) == 0)
+            metrics_conn_process(epfd, i, 0);
+}
+
+/* accept all pending connections of the metrics socket */
+static void metrics_accept(int epfd, int listen_fd)
+{
+    while (1) {
+        struct cb_metrics_conn *c = cb_metrics_accept(listen_fd);
+        unsigned int i;
+
+        if (!c) {
+            if (errno != EAGAIN)
+                error("accepting a metrics connection failed: %m");
+            return;
+        }
+
+        for (i = 0; i < MAX_METRICS_CONNS; i++)
+            if (!metrics_conns[i])
+                break;
+
+        if (i == MAX_METRICS_CONNS) {
+            debug("too many metrics connections, dropping a new one");
+            cb_metrics_conn_free(c);
+            continue;
+        }
+
+        if (epoll_set(epfd, EPOLL_CTL_ADD, cb_metrics_conn_get_fd(c), cb_metrics_conn_get_events(c),
+                      EPOLL_TAG_METRICS_CONN + i)) {
+            cb_metrics_conn_free(c);
+            continue;
+        }
+
+        metrics_conns[i] = c;
+    }
+}
+
 int main(int argc, char *argv[])
 {
     struct termios termios_orig;
-    struct pollfd poll_fds[2]; /* stdin at [0], UART fd at [1] */
-    int fds = 2;
+    sigset_t sigmask_orig;
+    struct epoll_event events[MAX_TARGETS + 3 + MAX_METRICS_CONNS];
+    char *uart_device = DEFAULT_UART_INTERFACE;
+    char *gpiochip = DEFAULT_RA_GPIOCHIP;
+    char *reset_gpioname = DEFAULT_RA_GPIO_RESET_PIN;
+    char *md_gpioname = DEFAULT_RA_GPIO_MD_PIN;
     char *env_uart_device = NULL;
     char *env_gpiochip = NULL;
     char *env_reset_gpioname = NULL;
     char *env_md_gpioname = NULL;
-    struct uart_ctx uart = INIT_UART_CTX;
-    struct safety_controller ctx = {};
-    enum cb_uart_com com;
-    uint64_t data;
-    enum {
-        STATE_INIT_FW_VERSION,
-        STATE_INIT_PNM1,
-        STATE_INIT_PNM2,
-        STATE_INIT_CHIPINFO,
-        STATE_INIT_GIT_HASH,
-        STATE_RUN_LOOP,
-    } state = STATE_INIT_FW_VERSION;
+    struct scenario *scenario = NULL;
+    int metrics_fd = -1;
+    int epfd = -1;
     int rc = EXIT_FAILURE;
+    unsigned int i;
     int rv;
 
     /* let's save the current termios settings first, so that we don't another flag and can restore
@@ -330,381 +1471,291 @@ int main(int argc, char *argv[])
 
     /* handle command line options */
     parse_cli(argc, argv);
+    setup_targets(uart_device, gpiochip, reset_gpioname, md_gpioname);
+    init_field_table();
 
     /* register debug and error message callbacks */
     ra_utils_set_error_msg_cb(error_cb);
     ra_utils_set_debug_msg_cb(debug_cb);
 
-    /* the baudrate of the MCU with running firmware should be 115200 */
-    rv = uart_open(&uart, uart_device, 115200);
-    if (rv) {
-        error("opening '%s' failed: %m", uart_device);
-        return -1;
+    /* in streaming mode, we don't touch the terminal but must flush on termination;
+     * the signals are only delivered within epoll_pwait(), so that one which arrives
+     * after checking stream_terminate cannot leave the main loop waiting */
+    sigprocmask(SIG_SETMASK, NULL, &sigmask_orig);
+    if (format != FORMAT_SCREEN) {
+        struct sigaction sa = { .sa_handler = stream_signal_handler };
+        sigset_t sigmask;
+
+        if (stream_init()) {
+            error("out of memory");
+            return -1;
+        }
+
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        sigemptyset(&sigmask);
+        sigaddset(&sigmask, SIGINT);
+        sigaddset(&sigmask, SIGTERM);
+        sigprocmask(SIG_BLOCK, &sigmask, &sigmask_orig);
+    }
+
+    /* parse the scenario early, so that we don't start in case of errors */
+    if (scenario_filename) {
+        scenario = scenario_load(scenario_filename);
+        if (!scenario)
+            return EXIT_FAILURE;
     }
 
-    /* ensure virgin start state and add stdin */
-    memset(poll_fds, 0, sizeof(poll_fds));
-    poll_fds[0].fd = STDIN_FILENO;
-    poll_fds[0].events = POLLIN;
-    poll_fds[1].fd = uart.fd;
-    poll_fds[1].events = POLLIN;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        error("epoll_create1() failed: %m");
+        goto close_out;
+    }
 
-    /* maybe this need yet another option flag */
-    uart_trace(&uart, verbose);
+    if (!stream && epoll_add(epfd, STDIN_FILENO, EPOLL_TAG_STDIN))
+        goto close_out;
 
-    /* enable CAN mirroring if requested */
-    if (can_mirror_device) {
-        rv = uart_can_mirror_enable(&uart, can_mirror_device);
-        if (rv) {
-            error("opening '%s' failed: %m", can_mirror_device);
+    if (scenario && epoll_add(epfd, scenario->tfd, EPOLL_TAG_SCENARIO))
+        goto close_out;
+
+    if (metrics_address) {
+        metrics_fd = cb_metrics_listen(metrics_address);
+        if (metrics_fd < 0 || epoll_add(epfd, metrics_fd, EPOLL_TAG_METRICS))
             goto close_out;
-        }
     }
 
-    /* unless not desired, reset the safety controller via GPIO */
-    if (!no_reset) {
-restart_reset:
-        rv = reset_controller(gpiochip, reset_gpioname, md_gpioname, reset_duration);
-        if (rv) {
-            error("resetting safety controller failed: %m");
+    /* all targets record into the same log, distinguished by the source id */
+    if (frame_log_filename) {
+        frame_log = frame_log_open(frame_log_filename);
+        if (!frame_log) {
+            error("opening '%s' failed: %m", frame_log_filename);
             goto close_out;
         }
     }
 
-    if (intial_sync) {
-        /* sync the receiving side */
-        rv = cb_uart_recv_and_sync(&uart, &com, &data);
+    for (i = 0; i < target_count; i++) {
+        struct target *t = &targets[i];
+
+        /* the baudrate of the MCU with running firmware should be 115200 */
+        rv = uart_open(&t->uart, t->uart_device, 115200);
         if (rv) {
-            error("could not synchronize to the safety controller: %m");
+            error("opening '%s' failed: %m", t->uart_device);
             goto close_out;
         }
-    }
 
-    /* make stdin unbuffered: otherwise poll will only react on <Enter> */
-    make_stdin_unbuffered(&termios_orig);
-
-    while (1) {
-        int rv;
+        if (epoll_add(epfd, t->uart.fd, i))
+            goto close_out;
 
-        switch (state) {
-        case STATE_INIT_FW_VERSION:
-            com = COM_FW_VERSION;
-            break;
-        case STATE_INIT_PNM1:
-            com = COM_PARTNUMBER_1;
-            break;
-        case STATE_INIT_PNM2:
-            com = COM_PARTNUMBER_2;
-            break;
-        case STATE_INIT_CHIPINFO:
-            com = COM_CHIPINFO;
-            break;
-        case STATE_INIT_GIT_HASH:
-            com = COM_GIT_HASH;
-            break;
-        default:
-            /* no inquiry */
-            break;
-        }
+        /* maybe this need yet another option flag */
+        uart_trace(&t->uart, verbose);
 
-        switch (state) {
-        case STATE_RUN_LOOP:
-            if (com == COM_CHARGE_STATE || com == COM_CHARGE_STATE_2) {
-                if (send_charge_control) {
-send_charge_control_frame:
-                    /* remember the timestamp */
-                    cb_proto_set_ts_str(&ctx, cb_proto_is_mcs_mode(&ctx) ? COM_CHARGE_CONTROL_2 : COM_CHARGE_CONTROL);
-                    /* send out charge control frame 1 when last received frame was a charge state 1 one */
-                    rv = cb_uart_send(&uart, cb_proto_is_mcs_mode(&ctx) ? COM_CHARGE_CONTROL_2 : COM_CHARGE_CONTROL, ctx.charge_control);
-                    if (rv) {
-                        error("error while sending charge control frame: %m");
-                        goto close_out;
-                    }
-                }
-            }
-            break;
-        default:
-            rv = cb_send_uart_inquiry(&uart, com);
+        /* enable CAN mirroring if requested */
+        if (t->can_mirror_device) {
+            rv = uart_can_mirror_enable(&t->uart, t->can_mirror_device);
             if (rv) {
-                error("error while sending inquiry frame for '%s': %m", cb_uart_com_to_str(com));
+                error("opening '%s' failed: %m", t->can_mirror_device);
                 goto close_out;
             }
-            if (state == STATE_INIT_GIT_HASH) {
-                // this is a little bit tricky/small hack: in case we want to send out
-                // charge control frames automatically, we just jump over the else condition
-                // otherwise we had to duplicate code here
-                if (send_charge_control)
-                    goto send_charge_control_frame;
-            }
-            break;
         }
 
-        rv = poll(poll_fds, fds, -1);
-        if (rv == -1) {
+        if (frame_log)
+            uart_frame_log_attach(&t->uart, frame_log, i);
+
+        if (metrics_filename || metrics_address)
+            uart_metrics_attach(&t->uart, &t->metrics);
+    }
+
+    if (!no_reset && targets_request_gpios())
+        goto close_out;
+
+    if (targets_reset())
+        goto close_out;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+
+    /* make stdin unbuffered: otherwise poll will only react on <Enter> */
+    if (!stream)
+        make_stdin_unbuffered(&termios_orig);
+
+    for (i = 0; i < target_count; i++)
+        if (target_kick(&targets[i]))
+            goto close_out;
+
+    while (1) {
+        int n;
+
+        /* the signals are blocked outside of epoll_pwait(), so a signal which arrived
+         * meanwhile is either seen here or interrupts the wait right away */
+        if (stream_terminate) {
+            rc = EXIT_SUCCESS;
+            goto close_out;
+        }
+
+        /* wait for input, and update the screen or the metrics file when it is due meanwhile */
+        n = epoll_pwait(epfd, events, ARRAY_SIZE(events),
+                        min_timeout(min_timeout(stream ? stream_flush_timeout() : render_timeout(), metrics_timeout()),
+                                    min_timeout(urgent_charge_control_timeout(), metrics_conns_timeout())),
+                        &sigmask_orig);
+        if (n == -1) {
             if (errno == EINTR)
-                goto close_out;
+                continue;
 
-            error("poll() failed: %m");
+            error("epoll_pwait() failed: %m");
             continue;
         }
-        if (rv == 0)
-            continue;
 
-        /* check stdin */
-        if ((poll_fds[0].revents & POLLIN) != 0) {
-            ssize_t len;
-            char cmd;
+        request_metrics_write();
+        metrics_conns_expire(epfd);
 
-            len = read(poll_fds[0].fd, &cmd, sizeof(cmd));
-            if (len < 0) {
-                error("Could not read command from STDIN: %m");
-                goto close_out;
-            }
-            if (len == sizeof(cmd)) {
-                if (!cb_proto_is_mcs_mode(&ctx)) {
-                    switch (cmd) {
-                    case 'e':
-                        cb_proto_set_pwm_active(&ctx, 1);
-                        break;
-                    case 'E':
-                        cb_proto_set_pwm_active(&ctx, 0);
-                        break;
-                    case 'r':
-                        cb_proto_set_duty_cycle(&ctx, 50);
-                        cb_proto_set_pwm_active(&ctx, 1);
-                        break;
-                    case 't':
-                        cb_proto_set_duty_cycle(&ctx, 100);
-                        cb_proto_set_pwm_active(&ctx, 1);
-                        break;
-                    case 'T':
-                        cb_send_uart_action_inquiry(&uart, ACTION_ID_RCM_SELFTEST);
-                        break;
-                    case 'z':
-                        cb_proto_set_duty_cycle(&ctx, 1000);
-                        cb_proto_set_pwm_active(&ctx, 1);
-                        break;
-                    case '1':
-                    case '2':
-                    case '3':
-                        cb_proto_contactorN_set_state(&ctx, cmd - '1', !cb_proto_contactorN_get_target_state(&ctx, cmd - '1'));
-                        break;
-                    case '0':
-                        cb_proto_set_duty_cycle(&ctx, 0);
-                        break;
-                    case '5':
-                        cb_proto_set_duty_cycle(&ctx, 50);
-                        break;
-                    case '6':
-                        cb_proto_set_duty_cycle(&ctx, 100);
-                        break;
-                    case '9':
-                        cb_proto_set_duty_cycle(&ctx, 1000);
-                        break;
-                    case '-': {
-                        unsigned int duty_cycle = cb_proto_get_target_duty_cycle(&ctx) - 10;
-                        /* check for underflow */
-                        if (duty_cycle > 1000)
-                            duty_cycle = 0;
-                        cb_proto_set_duty_cycle(&ctx, duty_cycle);
-                        break;
-                    }
-                    case '+':
-                        /* overflow is already checked in library */
-                        cb_proto_set_duty_cycle(&ctx, cb_proto_get_target_duty_cycle(&ctx) + 10);
-                        break;
-                    case 's':
-                        send_charge_control = !send_charge_control;
-                        break;
-                    case 'c':
-                        cb_proto_set_ts_str(&ctx, COM_CHARGE_CONTROL);
-                        rv = cb_uart_send(&uart, COM_CHARGE_CONTROL, ctx.charge_control);
-                        if (rv) {
-                            error("error while sending charge control frame: %m");
-                            goto close_out;
-                        }
-                        break;
-                    case 'q':
-                    case 0x03: /* Ctrl-C */
-                        goto close_out;
-                    case 0x12: /* Ctrl-R */
-                        state = STATE_INIT_FW_VERSION;
-                        /* restore terminal settings */
-                        tcsetattr(STDIN_FILENO, TCSANOW, &termios_orig);
-                        goto restart_reset;
-                    case '\r':
-                    case '\n':
-                        printf("\r\n");
-                        break;
-                    default:
-                        if (isprint(cmd))
-                            error("Unknown command '%c', use 'h' or '?' to show available commands.", cmd);
-                        else
-                            error("Unknown command '0x%02x', use 'h' or '?' to show available commands.", cmd);
-                    }
-                } else {
-                    switch (cmd) {
-                    case 'r':
-                        cb_proto_set_ccs_ready(&ctx, true);
-                        break;
-                    case 'R':
-                        cb_proto_set_ccs_ready(&ctx, false);
-                        break;
-                    case 'e':
-                        cb_proto_set_estop(&ctx, true);
-                        break;
-                     case 's':
-                        send_charge_control = !send_charge_control;
-                        break;
-                    case 'c':
-                        cb_proto_set_ts_str(&ctx, COM_CHARGE_CONTROL_2);
-                        rv = cb_uart_send(&uart, COM_CHARGE_CONTROL_2, ctx.charge_control);
-                        if (rv) {
-                            error("error while sending charge control frame: %m");
-                            goto close_out;
-                        }
-                        break;
-                    case 'q':
-                    case 0x03: /* Ctrl-C */
-                        goto close_out;
-                    case 0x12: /* Ctrl-R */
-                        state = STATE_INIT_FW_VERSION;
-                        /* restore terminal settings */
-                        tcsetattr(STDIN_FILENO, TCSANOW, &termios_orig);
-                        goto restart_reset;
-                    case '\r':
-                    case '\n':
-                        printf("\r\n");
-                        break;
-                    default:
-                        if (isprint(cmd))
-                            error("Unknown command '%c', use 'h' or '?' to show available commands.", cmd);
-                        else
-                            error("Unknown command '0x%02x', use 'h' or '?' to show available commands.", cmd);
-                    }
-                }
+        if (flush_urgent_charge_control())
+            goto close_out;
+
+        if (n == 0) {
+            if (stream) {
+                if (stream_flush_timeout() == 0 && stream_flush())
+                    goto close_out;
+            } else if (render_timeout() == 0) {
+                render();
             }
+            continue;
         }
 
-        /* check UART input */
-        if ((poll_fds[1].revents & POLLIN) != 0) {
-            rv = cb_uart_recv(&uart, &com, &data);
-            if (rv) {
-                uint8_t buf[64];
-                ssize_t c;
+        for (i = 0; i < (unsigned int)n; i++) {
+            uint32_t tag = events[i].data.u32;
 
-                error("error while receiving frame from the safety controller: %m");
+            if (tag == EPOLL_TAG_STDIN) {
+                struct target *t = &targets[selected_target];
+                ssize_t len;
+                char cmd;
 
-                c = read(uart.fd, &buf, sizeof(buf));
-                if (c < 0) {
-                    error("error while receiving unprocessed data: %m");
+                len = read(STDIN_FILENO, &cmd, sizeof(cmd));
+                if (len < 0) {
+                    error("Could not read command from STDIN: %m");
                     goto close_out;
                 }
+                if (len != sizeof(cmd))
+                    continue;
+
+                switch (handle_command(t, cmd)) {
+                case COMMAND_OK:
+                    break;
+                case COMMAND_QUIT:
+                case COMMAND_ERROR:
+                    goto close_out;
+                case COMMAND_RESTART:
+                    /* restore terminal settings */
+                    tcsetattr(STDIN_FILENO, TCSANOW, &termios_orig);
+                    if (target_reset(t))
+                        goto close_out;
+                    make_stdin_unbuffered(&termios_orig);
+                    break;
+                }
+
+                /* as before, a command is followed by the frame which is due now */
+                if (target_kick(t))
+                    goto close_out;
 
-                error("unprocessed data in input buffer follows (%zu bytes):", c);
+            } else if (tag == EPOLL_TAG_METRICS) {
+                metrics_accept(epfd, metrics_fd);
 
-                uart_dump_frame(false, false, buf, c);
-                goto close_out;
+            } else if (tag >= EPOLL_TAG_METRICS_CONN && tag < EPOLL_TAG_METRICS_CONN + MAX_METRICS_CONNS) {
+                /* the connection might have been closed while handling a previous event */
+                if (metrics_conns[tag - EPOLL_TAG_METRICS_CONN])
+                    metrics_conn_process(epfd, tag - EPOLL_TAG_METRICS_CONN, events[i].events);
+
+            } else if (tag == EPOLL_TAG_SCENARIO) {
+                /* the scenario timer expired, execute the due steps */
+                if (scenario_process(scenario, true))
+                    goto close_out;
+
+            } else {
+                struct target *t = &targets[tag];
+
+                if (target_receive(t))
+                    goto close_out;
+
+                /* the scenario runs on the first target and starts as soon as its initial inquiries are done */
+                if (scenario && t->index == 0 && t->state == STATE_RUN_LOOP) {
+                    if (scenario->started)
+                        rv = scenario_process(scenario, false);
+                    else
+                        rv = scenario_start(scenario, &t->ctx, &t->uart);
+                    if (rv)
+                        goto close_out;
+                }
             }
 
-            cb_proto_set_ts_str(&ctx, com);
-
-            switch (com) {
-            case COM_CHARGE_STATE_2:
-                // in case we connect to an already running firmware we could receive
-                // a Charge State 2 frame before we derived the platform from Firmware Version frame
-                // so set this already here too
-                cb_proto_set_mcs_mode(&ctx, true);
-                __attribute__ ((fallthrough));
-            case COM_CHARGE_STATE:
-                ctx.charge_state = data;
-                break;
-            case COM_PT1000_STATE:
-                ctx.pt1000 = data;
-                break;
-            case COM_ERROR_MESSAGE:
-                ctx.error_message = data;
-                break;
-            case COM_FW_VERSION:
-                ctx.fw_version = data;
-                cb_proto_set_fw_version_str(&ctx);
-                if (cb_proto_fw_get_platform_type(&ctx) == FW_PLATFORM_TYPE_CCY)
-                    cb_proto_set_mcs_mode(&ctx, true);
-
-                /* fw version prior to 0.2.9 does not support part number reading,
-                 * so we have to skip directly to git hash reading */
-                if (compare_version(ctx.fw_version_str, "0.2.9") <= 0)
-                    state = STATE_INIT_GIT_HASH;
-                else
-                    state = STATE_INIT_PNM1;
-                break;
-            case COM_GIT_HASH:
-                ctx.git_hash = data;
-                cb_proto_set_git_hash_str(&ctx);
-                state = STATE_RUN_LOOP;
-                break;
-            case COM_PARTNUMBER_1:
-                ctx.partnumber1 = data;
-                state = STATE_INIT_PNM2;
-                break;
-            case COM_PARTNUMBER_2:
-                ctx.partnumber2 = data;
-                cb_proto_set_partnumber_str(&ctx);
-                state = STATE_INIT_CHIPINFO;
-                break;
-            case COM_CHIPINFO:
-                ctx.chipinfo = data;
-                state = STATE_INIT_GIT_HASH;
-                break;
-            case COM_ACTION:
-                ctx.action_ack = data;
-                break;
-            default:
-                /* not yet implemented */
+            if (scenario && scenario_is_finished(scenario)) {
+                rc = scenario_passed(scenario) ? EXIT_SUCCESS : EXIT_FAILURE;
+                goto close_out;
             }
         }
 
-        /* clear screen (in verbose mode, this does not make sense) */
-        if (!verbose)
-            printf("\033[H\033[J");
-
-        if (!no_dump) {
-            /* dump it */
-            cb_proto_dump(&ctx);
-
-            printf("\r\n");
-            if (!cb_proto_is_mcs_mode(&ctx)) {
-                printf("== Available commands ==\r\n"
-                       "  e -- enable PWM                   E -- disable PWM\r\n"
-                       "  r -- enable PWM with 5%%           t -- enable PWM with 10%%          z -- enable PWM with 100%%\r\n"
-                       "  0 -- set PWM duty cycle to 0%%     5 -- set PWM duty cycle to 5%%     9 -- set PWM duty cycle to 100%%\r\n"
-                       "  - -- decrease PWM value by 1%%     + -- increase PMW value by 1%%     6 -- set PWM duty cycle to 10%%\r\n"
-                       "  1 -- toggle contactor 1           2 -- toggle contactor 2           3 -- toggle contactor 3\r\n"
-                       "  c -- (manually) send a Charge Control frame                         T -- start RCM test\r\n"
-                       "  s -- toggle auto sending of Charge Control frames (auto-sending: %s)\r\n"
-                       "  q -- quit the program\r\n", send_charge_control ? "on" : "off");
-            } else {
-                printf("== Available commands ==\r\n"
-                       "  r -- set CCS Ready to Ready       R -- set CCS Ready to Not Ready\r\n"
-                       "  e -- set CCS Ready to Emergency Stop\r\n"
-                       "  c -- (manually) send a Charge Control frame\r\n"
-                       "  s -- toggle auto sending of Charge Control frames (auto-sending: %s)\r\n"
-                       "  q -- quit the program\r\n", send_charge_control ? "on" : "off");
-            }
+        /* a command might have requested one; scenario steps don't need this, they send
+         * their Charge Control frame right away themselves */
+        if (flush_urgent_charge_control())
+            goto close_out;
+
+        if (stream) {
+            if (request_stream_flush())
+                goto close_out;
+        } else {
+            request_render();
         }
     }
 
     rc = EXIT_SUCCESS;
 
 close_out:
-    if (uart.fd != -1) {
-        rv = uart_close(&uart);
+    for (i = 0; i < target_count; i++) {
+        struct target *t = &targets[i];
+
+        if (uart_frame_log_enabled(&t->uart))
+            uart_frame_log_disable(&t->uart);
+
+        if (t->uart.fd != -1) {
+            rv = uart_close(&t->uart);
+            if (rv)
+                error("closing UART failed: %m");
+        }
+    }
+
+    if (frame_log) {
+        rv = frame_log_close(frame_log);
         if (rv)
-            error("closing UART failed: %m");
+            error("closing '%s' failed: %m", frame_log_filename);
     }
 
+    for (i = 0; i < MAX_METRICS_CONNS; i++)
+        if (metrics_conns[i])
+            metrics_conn_close(i);
+
+    if (metrics_address)
+        cb_metrics_close(metrics_fd, metrics_address);
+
+    ra_reset_free(reset_engine);
+
+    if (epfd >= 0)
+        close(epfd);
+
     /* restore terminal settings */
     tcsetattr(STDIN_FILENO, TCSANOW, &termios_orig);
 
+    screen_free(&screen);
+
+    if (scenario) {
+        if (scenario->started)
+            scenario_report(scenario, stream ? stderr : stdout);
+        scenario_free(scenario);
+    }
+
+    if (stream) {
+        if (stream_flush())
+            rc = EXIT_FAILURE;
+        free(stream);
+    }
+
     return rc;
 }
@@ -0,0 +1,1002 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This is a command line tool which simulates the safety controller firmware
+ * on a pseudo terminal, so that ra-raw, ra-stress and other users of the
+ * library can be tested and benchmarked without hardware. It sends Charge
+ * State, PT1000 and error message frames periodically, answers inquiries,
+ * follows the received Charge Control frames and can inject faults into
+ * the sent frames. At exit, it prints statistics including the latency of
+ * the host's Charge Control responses.
+ *
+ * Usage: ra-sim [<options>]
+ *
+ *  Options:
+ *          -l, --link              create a symlink with this name to the pty (e.g. /tmp/ttySIM)
+ *          -c, --cs-interval       Charge State interval (in ms, default: 100)
+ *          -j, --jitter            maximum random deviation from the Charge State interval (in ms, default: 0)
+ *          -t, --pt1000-interval   PT1000 State interval (in ms, default: 1000, 0: disabled)
+ *          -e, --error-interval    Error Message interval (in ms, default: 0 = disabled)
+ *          -a, --reaction-delay    delay until Charge Control changes are reflected (in ms, default: 20)
+ *          -A, --response-delay    delay until inquiries are answered (in ms, default: 2)
+ *          -n, --contactors        count of used contactors (default: 2)
+ *          -C, --crc-faults        corrupt the CRC of 1 in N sent frames (default: 0 = never)
+ *          -S, --sof-faults        corrupt the SOF of 1 in N sent frames (default: 0 = never)
+ *          -E, --eof-faults        corrupt the EOF of 1 in N sent frames (default: 0 = never)
+ *          -D, --drop-bytes        drop one byte of 1 in N sent frames (default: 0 = never)
+ *          -s, --seed              seed for the random generator (default: time based)
+ *          -d, --duration          exit after this time (in s, default: 0 = run until SIGINT/SIGTERM)
+ *          -o, --stats             write the statistics to this file instead of stdout
+ *          -v, --verbose           verbose operation
+ *          -V, --version           print version and exit
+ *          -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <logging.h>
+#include <tools.h>
+#include <uart.h>
+#include <version.h>
+
+/* fallback if not set by build system */
+#ifndef PACKAGE_STRING
+#define PACKAGE_STRING "ra-utils (unknown version)"
+#endif
+
+/* command line options */
+static const struct option long_options[] = {
+    { "link",               required_argument,      0,      'l' },
+    { "cs-interval",        required_argument,      0,      'c' },
+    { "jitter",             required_argument,      0,      'j' },
+    { "pt1000-interval",    required_argument,      0,      't' },
+    { "error-interval",     required_argument,      0,      'e' },
+    { "reaction-delay",     required_argument,      0,      'a' },
+    { "response-delay",     required_argument,      0,      'A' },
+    { "contactors",         required_argument,      0,      'n' },
+    { "crc-faults",         required_argument,      0,      'C' },
+    { "sof-faults",         required_argument,      0,      'S' },
+    { "eof-faults",         required_argument,      0,      'E' },
+    { "drop-bytes",         required_argument,      0,      'D' },
+    { "seed",               required_argument,      0,      's' },
+    { "duration",           required_argument,      0,      'd' },
+    { "stats",              required_argument,      0,      'o' },
+    { "verbose",            no_argument,            0,      'v' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "l:c:j:t:e:a:A:n:C:S:E:D:s:d:o:vVh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "create a symlink with this name to the pty (e.g. /tmp/ttySIM)",
+    "Charge State interval (in ms, default: 100)",
+    "maximum random deviation from the Charge State interval (in ms, default: 0)",
+    "PT1000 State interval (in ms, default: 1000, 0: disabled)",
+    "Error Message interval (in ms, default: 0 = disabled)",
+    "delay until Charge Control changes are reflected (in ms, default: 20)",
+    "delay until inquiries are answered (in ms, default: 2)",
+    "count of used contactors (default: 2)",
+    "corrupt the CRC of 1 in N sent frames (default: 0 = never)",
+    "corrupt the SOF of 1 in N sent frames (default: 0 = never)",
+    "corrupt the EOF of 1 in N sent frames (default: 0 = never)",
+    "drop one byte of 1 in N sent frames (default: 0 = never)",
+    "seed for the random generator (default: time based)",
+    "exit after this time (in s, default: 0 = run until SIGINT/SIGTERM)",
+    "write the statistics to this file instead of stdout",
+
+    "verbose operation",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to simulate the safety MCU on a pseudo terminal\n\n"
+            "Usage: %s [<options>]\n\n",
+            p, PACKAGE_STRING, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-15s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-15s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* what the simulated firmware reports about itself */
+#define SIM_FW_VERSION_MAJOR 0
+#define SIM_FW_VERSION_MINOR 3
+#define SIM_FW_VERSION_BUILD 0
+#define SIM_FW_PLATFORM 0x81 /* Charge SOM */
+#define SIM_FW_APPLICATION_TYPE 3 /* firmware */
+#define SIM_FW_PARAM_VERSION 1
+#define SIM_PARTNUMBER "RA-SIM-0001"
+#define SIM_GIT_HASH 0x5349d0c0ffee1234ULL
+#define SIM_CHIPINFO_MCU_VERSION 1
+
+/* initial temperature of the simulated PT1000 channels, in 0.1 °C */
+#define SIM_PT1000_TEMP 250
+#define SIM_PT1000_CHANNELS 2
+
+/* maximum count of queued inquiry responses */
+#define MAX_RESPONSES 64
+
+/* resolution and range of the latency histogram */
+#define LATENCY_BUCKET_US 10
+#define LATENCY_BUCKETS 10000
+
+enum fault {
+    FAULT_CRC,
+    FAULT_SOF,
+    FAULT_EOF,
+    FAULT_DROP,
+    FAULT_MAX,
+};
+
+static const char *fault_names[FAULT_MAX] = { "crc", "sof", "eof", "drop" };
+
+/* to simplify, these are globals */
+static bool verbose = false;
+static char *link_name = NULL;
+static unsigned int cs_interval = CB_PROTO_CHARGE_STATE_INTERVAL;
+static unsigned int jitter = 0;
+static unsigned int pt1000_interval = 1000;
+static unsigned int error_interval = 0;
+static unsigned int reaction_delay = 20;
+static unsigned int response_delay = 2;
+static unsigned int contactor_count = 2;
+static unsigned int fault_rate[FAULT_MAX];
+static unsigned int seed = 0;
+static bool seed_given = false;
+static unsigned int duration = 0;
+static char *stats_filename = NULL;
+
+static volatile sig_atomic_t terminate = 0;
+
+struct response {
+    struct timespec due;
+    enum cb_uart_com com;
+    uint64_t data;
+};
+
+struct sim_stats {
+    unsigned long tx_frames;
+    unsigned long tx_dropped; /* pty buffer full, i.e. nobody reads */
+    unsigned long cs_frames;
+    unsigned long pt1000_frames;
+    unsigned long error_frames;
+    unsigned long responses;
+    unsigned long faults[FAULT_MAX];
+
+    unsigned long rx_frames;
+    unsigned long rx_bad_frames;
+    unsigned long rx_skipped_bytes;
+    unsigned long cc_frames;
+    unsigned long inquiries;
+    unsigned long unknown_inquiries;
+
+    /* time from sending a Charge State frame until the next Charge Control frame */
+    uint32_t latency_hist[LATENCY_BUCKETS];
+    unsigned long latency_count;
+    long long latency_sum_us;
+    long long latency_max_us;
+};
+
+struct sim {
+    /* only used for the frame helpers, fd is the pty master */
+    struct uart_ctx uart;
+
+    /* kept open so that the line settings persist and the master never reads EIO */
+    int slave_fd;
+    char *slave_name;
+
+    unsigned int rand_state;
+
+    /* the simulated state, as sent on the wire */
+    uint64_t charge_state;
+    uint64_t pt1000;
+    uint64_t error_message;
+    unsigned int pt1000_temp[SIM_PT1000_CHANNELS];
+
+    /* last received Charge Control, applied to the Charge State once due */
+    uint64_t charge_control;
+    bool cc_pending;
+    struct timespec cc_due;
+
+    struct timespec next_cs;
+    struct timespec next_pt1000;
+    struct timespec next_error;
+
+    struct response responses[MAX_RESPONSES];
+    unsigned int response_count;
+
+    uint8_t rx_buf[4 * CB_UART_FRAME_SIZE];
+    size_t rx_len;
+
+    /* send time of the last intact Charge State frame which was not answered yet */
+    struct timespec cs_sent;
+    bool cs_unanswered;
+
+    struct sim_stats stats;
+};
+
+static void debug_cb(const char *format, va_list args)
+{
+    if (verbose) {
+        fprintf(stderr, "debug: ");
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+    }
+}
+
+static void error_cb(const char *format, va_list args)
+{
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    terminate = 1;
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'l':
+            link_name = optarg;
+            break;
+        case 'c':
+            cs_interval = atoi(optarg);
+            break;
+        case 'j':
+            jitter = atoi(optarg);
+            break;
+        case 't':
+            pt1000_interval = atoi(optarg);
+            break;
+        case 'e':
+            error_interval = atoi(optarg);
+            break;
+        case 'a':
+            reaction_delay = atoi(optarg);
+            break;
+        case 'A':
+            response_delay = atoi(optarg);
+            break;
+        case 'n':
+            contactor_count = atoi(optarg);
+            break;
+        case 'C':
+            fault_rate[FAULT_CRC] = atoi(optarg);
+            break;
+        case 'S':
+            fault_rate[FAULT_SOF] = atoi(optarg);
+            break;
+        case 'E':
+            fault_rate[FAULT_EOF] = atoi(optarg);
+            break;
+        case 'D':
+            fault_rate[FAULT_DROP] = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            seed_given = true;
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'o':
+            stats_filename = optarg;
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            /* fall-through */
+        default:
+            usage(argv[0], rc);
+        }
+    }
+
+    if (cs_interval == 0) {
+        fprintf(stderr, "Error: the Charge State interval must not be zero.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    if (jitter >= cs_interval) {
+        fprintf(stderr, "Error: the jitter must be smaller than the Charge State interval.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    if (contactor_count > CB_PROTO_MAX_CONTACTORS) {
+        fprintf(stderr, "Error: at most %d contactors are supported.\n\n", CB_PROTO_MAX_CONTACTORS);
+        usage(argv[0], EXIT_FAILURE);
+    }
+}
+
+static inline void set_bits(uint64_t *dst, unsigned int bit, unsigned int len, uint64_t value)
+{
+    uint64_t mask = ((1ULL << len) - 1) << bit;
+
+    *dst = (*dst & ~mask) | ((value << bit) & mask);
+}
+
+static inline uint64_t get_bits(uint64_t src, unsigned int bit, unsigned int len)
+{
+    return (src >> bit) & ((1ULL << len) - 1);
+}
+
+/* true with a probability of 1/n, never if n is zero */
+static bool one_in(struct sim *sim, unsigned int n)
+{
+    return n && (rand_r(&sim->rand_state) % n) == 0;
+}
+
+static void timespec_add_us(struct timespec *ts, long long usec)
+{
+    set_normalized_timespec(ts, ts->tv_sec, ts->tv_nsec + usec * 1000);
+}
+
+static int sim_open_pty(struct sim *sim)
+{
+    struct termios tio;
+    int fd;
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        error("posix_openpt failed: %m");
+        return -1;
+    }
+
+    if (grantpt(fd) || unlockpt(fd)) {
+        error("could not unlock the pty: %m");
+        goto close_out;
+    }
+
+    sim->slave_name = strdup(ptsname(fd));
+    if (!sim->slave_name) {
+        error("out of memory");
+        goto close_out;
+    }
+
+    sim->slave_fd = open(sim->slave_name, O_RDWR | O_NOCTTY);
+    if (sim->slave_fd < 0) {
+        error("could not open '%s': %m", sim->slave_name);
+        goto free_out;
+    }
+
+    /* no echo or line processing until the host configures the line itself */
+    if (tcgetattr(sim->slave_fd, &tio)) {
+        error("tcgetattr failed for '%s': %m", sim->slave_name);
+        goto close_slave_out;
+    }
+    cfmakeraw(&tio);
+    if (tcsetattr(sim->slave_fd, TCSANOW, &tio)) {
+        error("tcsetattr failed for '%s': %m", sim->slave_name);
+        goto close_slave_out;
+    }
+
+    if (link_name) {
+        struct stat st;
+
+        /* replace a stale symlink of a previous run, but nothing else */
+        if (lstat(link_name, &st) == 0 && S_ISLNK(st.st_mode))
+            unlink(link_name);
+
+        if (symlink(sim->slave_name, link_name)) {
+            error("could not create symlink '%s': %m", link_name);
+            goto close_slave_out;
+        }
+    }
+
+    sim->uart.fd = fd;
+    sim->uart.device = sim->slave_name;
+    return 0;
+
+close_slave_out:
+    close(sim->slave_fd);
+free_out:
+    free(sim->slave_name);
+close_out:
+    close(fd);
+    return -1;
+}
+
+static void sim_close_pty(struct sim *sim)
+{
+    if (link_name)
+        unlink(link_name);
+
+    close(sim->slave_fd);
+    close(sim->uart.fd);
+    free(sim->slave_name);
+}
+
+/* sends a frame, possibly damaged as requested; returns true if it was sent intact */
+static bool sim_send(struct sim *sim, enum cb_uart_com com, uint64_t data)
+{
+    uint8_t buf[CB_UART_FRAME_SIZE];
+    size_t len = sizeof(buf);
+    bool intact = true;
+    ssize_t rv;
+
+    cb_uart_frame_pack(&sim->uart, buf, com, data);
+
+    if (one_in(sim, fault_rate[FAULT_CRC])) {
+        buf[CB_UART_FRAME_SIZE - 2] ^= 0xff;
+        sim->stats.faults[FAULT_CRC]++;
+        intact = false;
+    }
+    if (one_in(sim, fault_rate[FAULT_SOF])) {
+        buf[0] ^= 0xff;
+        sim->stats.faults[FAULT_SOF]++;
+        intact = false;
+    }
+    if (one_in(sim, fault_rate[FAULT_EOF])) {
+        buf[CB_UART_FRAME_SIZE - 1] ^= 0xff;
+        sim->stats.faults[FAULT_EOF]++;
+        intact = false;
+    }
+    if (one_in(sim, fault_rate[FAULT_DROP])) {
+        unsigned int pos = rand_r(&sim->rand_state) % len;
+
+        memmove(&buf[pos], &buf[pos + 1], len - pos - 1);
+        len--;
+        sim->stats.faults[FAULT_DROP]++;
+        intact = false;
+    }
+
+    /* the pty buffer only fills up when nobody reads, so drop frames then like a real UART */
+    rv = write(sim->uart.fd, buf, len);
+    if (rv != (ssize_t)len) {
+        if (rv < 0 && errno != EAGAIN)
+            debug("write failed: %m");
+        sim->stats.tx_dropped++;
+        return false;
+    }
+
+    sim->stats.tx_frames++;
+    return intact;
+}
+
+static void sim_init_state(struct sim *sim)
+{
+    unsigned int i;
+
+    sim->charge_state = 0;
+    set_bits(&sim->charge_state, 40, 3, CP_STATE_B);
+    set_bits(&sim->charge_state, 32, 3, PP_STATE_32A);
+    set_bits(&sim->charge_state, 22, 2, RCM_STATE_MONITORING);
+    set_bits(&sim->charge_state, 58, 2, CS_SAFESTATE_ACTIVE_NORMAL);
+
+    for (i = 0; i < CB_PROTO_MAX_CONTACTORS; i++)
+        set_bits(&sim->charge_state, 24 + 2 * i, 2, i < contactor_count ? CONTACTOR_STATE_OPEN : CONTACTOR_STATE_UNUSED);
+
+    for (i = 0; i < CB_PROTO_MAX_ESTOPS; i++)
+        set_bits(&sim->charge_state, 16 + 2 * i, 2, i == 0 ? ESTOP_STATE_NOT_TRIPPED : ESTOP_STATE_UNUSED);
+
+    for (i = 0; i < SIM_PT1000_CHANNELS; i++)
+        sim->pt1000_temp[i] = SIM_PT1000_TEMP;
+
+    sim->error_message = 0;
+}
+
+/* reflect the last received Charge Control in the Charge State, like a connected vehicle would */
+static void sim_apply_charge_control(struct sim *sim)
+{
+    uint64_t cc = sim->charge_control;
+    bool pwm = get_bits(cc, 63, 1);
+    bool hv_ready = contactor_count > 0;
+    unsigned int i;
+
+    set_bits(&sim->charge_state, 63, 1, pwm);
+    set_bits(&sim->charge_state, 48, 10, get_bits(cc, 48, 10));
+    set_bits(&sim->charge_state, 40, 3, pwm ? CP_STATE_C : CP_STATE_B);
+
+    for (i = 0; i < contactor_count; i++) {
+        bool closed = get_bits(cc, 40 + i, 1);
+
+        set_bits(&sim->charge_state, 24 + 2 * i, 2, closed ? CONTACTOR_STATE_CLOSED : CONTACTOR_STATE_OPEN);
+        hv_ready = hv_ready && closed;
+    }
+
+    set_bits(&sim->charge_state, 30, 1, hv_ready);
+}
+
+static void sim_update_pt1000(struct sim *sim)
+{
+    unsigned int ch;
+
+    sim->pt1000 = 0;
+
+    for (ch = 0; ch < CB_PROTO_MAX_PT1000S; ch++) {
+        uint16_t d = PT1000_TEMPERATURE_UNUSED << 2;
+
+        if (ch < SIM_PT1000_CHANNELS) {
+            /* random walk of +-0.1 °C around the initial temperature */
+            int step = (int)(rand_r(&sim->rand_state) % 3) - 1;
+
+            if (abs((int)sim->pt1000_temp[ch] + step - SIM_PT1000_TEMP) <= 50)
+                sim->pt1000_temp[ch] += step;
+
+            d = (uint16_t)(sim->pt1000_temp[ch] << 2);
+        }
+
+        set_bits(&sim->pt1000, 16 * (CB_PROTO_MAX_PT1000S - 1 - ch), 16, d);
+    }
+}
+
+static void sim_update_error_message(struct sim *sim)
+{
+    bool active = !get_bits(sim->error_message, 63, 1);
+
+    set_bits(&sim->error_message, 63, 1, active);
+    set_bits(&sim->error_message, 48, 15, ERRMSG_MODULE_APP_TEMP);
+    set_bits(&sim->error_message, 32, 16, 1);
+    set_bits(&sim->error_message, 16, 16, sim->stats.error_frames);
+}
+
+static uint64_t partnumber_data(unsigned int part)
+{
+    static const char partnumber[16] = SIM_PARTNUMBER;
+    uint64_t data = 0;
+    unsigned int i;
+
+    /* the first character is the most significant byte */
+    for (i = 0; i < 8; i++)
+        data = (data << 8) | (uint8_t)partnumber[8 * part + i];
+
+    return data;
+}
+
+static int sim_queue_response(struct sim *sim, const struct timespec *now, enum cb_uart_com com, uint64_t data)
+{
+    struct response *r;
+
+    if (sim->response_count == MAX_RESPONSES) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    r = &sim->responses[sim->response_count++];
+    r->due = *now;
+    timespec_add_ms(&r->due, response_delay);
+    r->com = com;
+    r->data = data;
+    return 0;
+}
+
+static void sim_handle_inquiry(struct sim *sim, const struct timespec *now, uint64_t data)
+{
+    enum cb_uart_com com = get_bits(data, 56, 8);
+    uint64_t response = 0;
+
+    sim->stats.inquiries++;
+
+    switch (com) {
+    case COM_ACTION:
+        set_bits(&response, 56, 8, get_bits(data, 48, 8));
+        break;
+    case COM_FW_VERSION:
+        set_bits(&response, 56, 8, SIM_FW_VERSION_MAJOR);
+        set_bits(&response, 48, 8, SIM_FW_VERSION_MINOR);
+        set_bits(&response, 40, 8, SIM_FW_VERSION_BUILD);
+        set_bits(&response, 32, 8, SIM_FW_PLATFORM);
+        set_bits(&response, 24, 8, SIM_FW_APPLICATION_TYPE);
+        set_bits(&response, 8, 16, SIM_FW_PARAM_VERSION);
+        break;
+    case COM_GIT_HASH:
+        response = SIM_GIT_HASH;
+        break;
+    case COM_PARTNUMBER_1:
+        response = partnumber_data(0);
+        break;
+    case COM_PARTNUMBER_2:
+        response = partnumber_data(1);
+        break;
+    case COM_CHIPINFO:
+        set_bits(&response, 56, 8, SIM_CHIPINFO_MCU_VERSION);
+        break;
+    case COM_CHARGE_STATE:
+        response = sim->charge_state;
+        break;
+    case COM_PT1000_STATE:
+        response = sim->pt1000;
+        break;
+    case COM_ERROR_MESSAGE:
+        response = sim->error_message;
+        break;
+    default:
+        debug("ignoring inquiry for %s", cb_uart_com_to_str(com));
+        sim->stats.unknown_inquiries++;
+        return;
+    }
+
+    if (sim_queue_response(sim, now, com, response))
+        error("too many unanswered inquiries, dropping inquiry for %s", cb_uart_com_to_str(com));
+}
+
+static void sim_record_latency(struct sim *sim, const struct timespec *now)
+{
+    long long us = timespec_to_us(timespec_sub(*now, sim->cs_sent));
+    unsigned int bucket = us / LATENCY_BUCKET_US;
+
+    if (bucket >= LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS - 1;
+
+    sim->stats.latency_hist[bucket]++;
+    sim->stats.latency_count++;
+    sim->stats.latency_sum_us += us;
+    if (us > sim->stats.latency_max_us)
+        sim->stats.latency_max_us = us;
+
+    sim->cs_unanswered = false;
+}
+
+static void sim_handle_frame(struct sim *sim, const struct timespec *now, enum cb_uart_com com, uint64_t data)
+{
+    sim->stats.rx_frames++;
+
+    switch (com) {
+    case COM_CHARGE_CONTROL:
+        sim->stats.cc_frames++;
+        if (sim->cs_unanswered)
+            sim_record_latency(sim, now);
+
+        if (data != sim->charge_control && !sim->cc_pending) {
+            sim->cc_pending = true;
+            sim->cc_due = *now;
+            timespec_add_ms(&sim->cc_due, reaction_delay);
+        }
+        sim->charge_control = data;
+        break;
+    case COM_INQUIRY:
+        sim_handle_inquiry(sim, now, data);
+        break;
+    default:
+        debug("ignoring received frame %s", cb_uart_com_to_str(com));
+        break;
+    }
+}
+
+static int sim_receive(struct sim *sim, const struct timespec *now)
+{
+    size_t pos = 0;
+    ssize_t rv;
+
+    rv = read(sim->uart.fd, &sim->rx_buf[sim->rx_len], sizeof(sim->rx_buf) - sim->rx_len);
+    if (rv < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+        error("read failed: %m");
+        return -1;
+    }
+
+    sim->rx_len += rv;
+
+    /* the host has no reason to send garbage, so sync on SOF and skip bytes of broken frames */
+    while (sim->rx_len - pos >= CB_UART_FRAME_SIZE) {
+        enum cb_uart_com com;
+        uint64_t data;
+
+        if (sim->rx_buf[pos] != CB_UART_SOF) {
+            sim->stats.rx_skipped_bytes++;
+            pos++;
+            continue;
+        }
+
+        if (cb_uart_frame_unpack(&sim->uart, &sim->rx_buf[pos], &com, &data)) {
+            sim->stats.rx_bad_frames++;
+            pos++;
+            continue;
+        }
+
+        sim_handle_frame(sim, now, com, data);
+        pos += CB_UART_FRAME_SIZE;
+    }
+
+    memmove(sim->rx_buf, &sim->rx_buf[pos], sim->rx_len - pos);
+    sim->rx_len -= pos;
+
+    return 0;
+}
+
+/* send everything which is due and return the time of the next event */
+static struct timespec sim_run_timers(struct sim *sim, const struct timespec *now)
+{
+    struct timespec next;
+    unsigned int i;
+
+    if (sim->cc_pending && timespec_compare(&sim->cc_due, now) <= 0) {
+        sim_apply_charge_control(sim);
+        sim->cc_pending = false;
+    }
+
+    for (i = 0; i < sim->response_count; ) {
+        struct response *r = &sim->responses[i];
+
+        if (timespec_compare(&r->due, now) > 0) {
+            i++;
+            continue;
+        }
+
+        sim_send(sim, r->com, r->data);
+        sim->stats.responses++;
+
+        memmove(r, r + 1, (sim->response_count - i - 1) * sizeof(*r));
+        sim->response_count--;
+    }
+
+    if (timespec_compare(&sim->next_cs, now) <= 0) {
+        long long interval_us = cs_interval * 1000LL;
+
+        if (jitter)
+            interval_us += (long long)(rand_r(&sim->rand_state) % (2 * jitter * 1000 + 1)) - jitter * 1000LL;
+
+        if (sim_send(sim, COM_CHARGE_STATE, sim->charge_state)) {
+            sim->cs_sent = *now;
+            sim->cs_unanswered = true;
+        }
+        sim->stats.cs_frames++;
+
+        /* schedule based on the planned time, so that the cadence does not drift */
+        timespec_add_us(&sim->next_cs, interval_us);
+        if (timespec_compare(&sim->next_cs, now) <= 0) {
+            sim->next_cs = *now;
+            timespec_add_us(&sim->next_cs, interval_us);
+        }
+    }
+
+    if (pt1000_interval) {
+        if (timespec_compare(&sim->next_pt1000, now) <= 0) {
+            sim_update_pt1000(sim);
+            sim_send(sim, COM_PT1000_STATE, sim->pt1000);
+            sim->stats.pt1000_frames++;
+            timespec_add_ms(&sim->next_pt1000, pt1000_interval);
+        }
+    }
+
+    if (error_interval) {
+        if (timespec_compare(&sim->next_error, now) <= 0) {
+            sim_update_error_message(sim);
+            sim_send(sim, COM_ERROR_MESSAGE, sim->error_message);
+            sim->stats.error_frames++;
+            timespec_add_ms(&sim->next_error, error_interval);
+        }
+    }
+
+    /* the earliest deadline, once every timer was serviced */
+    next = sim->next_cs;
+    for (i = 0; i < sim->response_count; i++)
+        if (timespec_compare(&sim->responses[i].due, &next) < 0)
+            next = sim->responses[i].due;
+    if (pt1000_interval && timespec_compare(&sim->next_pt1000, &next) < 0)
+        next = sim->next_pt1000;
+    if (error_interval && timespec_compare(&sim->next_error, &next) < 0)
+        next = sim->next_error;
+    if (sim->cc_pending && timespec_compare(&sim->cc_due, &next) < 0)
+        next = sim->cc_due;
+
+    return next;
+}
+
+/* returns the upper bound of the bucket which contains the given per mille, in us */
+static long long latency_permille(const struct sim_stats *st, unsigned int permille)
+{
+    unsigned long long target = (st->latency_count * permille + 999) / 1000;
+    unsigned long long sum = 0;
+    unsigned int i;
+
+    if (!st->latency_count)
+        return 0;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        sum += st->latency_hist[i];
+        if (sum >= target)
+            return (long long)(i + 1) * LATENCY_BUCKET_US;
+    }
+
+    return (long long)LATENCY_BUCKETS * LATENCY_BUCKET_US;
+}
+
+static void print_stats(FILE *f, const struct sim_stats *st, double elapsed)
+{
+    unsigned int i;
+
+    fprintf(f, "elapsed_s %.3f\n", elapsed);
+    fprintf(f, "seed %u\n", seed);
+    fprintf(f, "tx_frames %lu\n", st->tx_frames);
+    fprintf(f, "tx_dropped %lu\n", st->tx_dropped);
+    fprintf(f, "cs_frames %lu\n", st->cs_frames);
+    fprintf(f, "pt1000_frames %lu\n", st->pt1000_frames);
+    fprintf(f, "error_frames %lu\n", st->error_frames);
+    fprintf(f, "responses %lu\n", st->responses);
+    for (i = 0; i < FAULT_MAX; i++)
+        fprintf(f, "faults_%s %lu\n", fault_names[i], st->faults[i]);
+    fprintf(f, "rx_frames %lu\n", st->rx_frames);
+    fprintf(f, "rx_bad_frames %lu\n", st->rx_bad_frames);
+    fprintf(f, "rx_skipped_bytes %lu\n", st->rx_skipped_bytes);
+    fprintf(f, "cc_frames %lu\n", st->cc_frames);
+    fprintf(f, "inquiries %lu\n", st->inquiries);
+    fprintf(f, "unknown_inquiries %lu\n", st->unknown_inquiries);
+    fprintf(f, "cc_latency_count %lu\n", st->latency_count);
+    fprintf(f, "cc_latency_avg_us %lld\n", st->latency_count ? st->latency_sum_us / (long long)st->latency_count : 0);
+    fprintf(f, "cc_latency_p50_us %lld\n", latency_permille(st, 500));
+    fprintf(f, "cc_latency_p90_us %lld\n", latency_permille(st, 900));
+    fprintf(f, "cc_latency_p99_us %lld\n", latency_permille(st, 990));
+    fprintf(f, "cc_latency_p999_us %lld\n", latency_permille(st, 999));
+    fprintf(f, "cc_latency_max_us %lld\n", st->latency_max_us);
+}
+
+static int write_stats(const struct sim_stats *st, double elapsed)
+{
+    FILE *f = stdout;
+
+    if (stats_filename) {
+        f = fopen(stats_filename, "w");
+        if (!f) {
+            error("could not open '%s': %m", stats_filename);
+            return -1;
+        }
+    }
+
+    print_stats(f, st, elapsed);
+
+    if (f != stdout)
+        return fclose(f);
+
+    fflush(f);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction sa = { .sa_handler = signal_handler };
+    struct timespec ts_start, ts_end, now;
+    struct sim *sim = NULL;
+    int rc = EXIT_FAILURE;
+
+    /* register debug and error message callbacks */
+    ra_utils_set_error_msg_cb(error_cb);
+    ra_utils_set_debug_msg_cb(debug_cb);
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    if (!seed_given)
+        seed = time(NULL) ^ getpid();
+
+    sim = calloc(1, sizeof(*sim));
+    if (!sim) {
+        error("out of memory");
+        goto out;
+    }
+
+    sim->uart = (struct uart_ctx)INIT_UART_CTX;
+    sim->rand_state = seed;
+
+    if (sim_open_pty(sim))
+        goto free_out;
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* the host goes away and comes back, this must not kill us */
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%s\n", link_name ? link_name : sim->slave_name);
+    fflush(stdout);
+    if (link_name)
+        debug("pty '%s' linked as '%s'", sim->slave_name, link_name);
+
+    sim_init_state(sim);
+    sim_update_pt1000(sim);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    ts_end = ts_start;
+    timespec_add_ms(&ts_end, duration * 1000LL);
+
+    sim->next_cs = ts_start;
+    sim->next_pt1000 = ts_start;
+    sim->next_error = ts_start;
+    timespec_add_ms(&sim->next_pt1000, pt1000_interval);
+    timespec_add_ms(&sim->next_error, error_interval);
+
+    while (!terminate) {
+        struct pollfd pfd = { sim->uart.fd, POLLIN, 0 };
+        struct timespec next;
+        long long timeout_us;
+        int rv;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (duration && timespec_compare(&now, &ts_end) >= 0)
+            break;
+
+        next = sim_run_timers(sim, &now);
+        if (duration && timespec_compare(&ts_end, &next) < 0)
+            next = ts_end;
+
+        /* round up, otherwise we would spin until the deadline */
+        timeout_us = timespec_to_us(timespec_sub(next, now));
+        rv = poll(&pfd, 1, timeout_us > 0 ? (timeout_us + 999) / 1000 : 0);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            error("poll failed: %m");
+            goto close_out;
+        }
+
+        if (rv > 0 && (pfd.revents & POLLIN)) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (sim_receive(sim, &now))
+                goto close_out;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (write_stats(&sim->stats, timespec_to_us(timespec_sub(now, ts_start)) / 1000000.0) == 0)
+        rc = EXIT_SUCCESS;
+
+close_out:
+    sim_close_pty(sim);
+free_out:
+    free(sim);
+out:
+    return rc;
+}
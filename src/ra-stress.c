@@ -0,0 +1,799 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This is a command line tool to determine how many inquiries per second the
+ * safety controller firmware can answer, and how fast. It sends inquiries
+ * at a ramping rate, correlates the responses, and watches the Charge State
+ * cadence and error messages meanwhile. The result is a capacity curve
+ * with one line per rate step.
+ *
+ * Usage: ra-stress [<options>]
+ *
+ *  Options:
+ *          -d, --uart              UART interface (default: /dev/ttyLP2)
+ *          -S, --sync              initial receive sync (default: send packet first)
+ *          -c, --gpiochip          GPIO chip device (default: /dev/gpiochip2)
+ *          -r, --reset-gpio        GPIO name for controlling RESET pin of MCU (default: nSAFETY_RESET_INT)
+ *          -m, --md-gpio           GPIO name for controlling MD pin of MCU (default: SAFETY_BOOTMODE_SET)
+ *          -p, --reset-period      reset duration (in ms, default: 500)
+ *          -R, --no-reset          don't reset the safety controller before starting UART communication
+ *          -i, --inquiries         comma-separated list of frame types to inquire (default: fw_version,git_hash)
+ *          -s, --start-rate        inquiry rate of first step (per s, default: 10)
+ *          -e, --end-rate          inquiry rate of last step (per s, default: 500)
+ *          -t, --step-rate         rate increment per step (per s, default: 10)
+ *          -T, --step-duration     duration of each step (in s, default: 5)
+ *          -l, --max-loss          stop when more than this percentage of inquiries is lost (default: 50)
+ *          -f, --format            output format: table or csv (default: table)
+ *          -v, --verbose           verbose operation
+ *          -V, --version           print version and exit
+ *          -h, --help              print this usage and exit
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <cb_protocol.h>
+#include <cb_uart.h>
+#include <logging.h>
+#include <tools.h>
+#include <uart.h>
+#include <version.h>
+#include "ra_gpio.h"
+#include "stringify.h"
+#include "gpio-defaults.h"
+#include "uart-defaults.h"
+
+/* fallback if not set by build system */
+#ifndef PACKAGE_STRING
+#define PACKAGE_STRING "ra-utils (unknown version)"
+#endif
+
+/* command line options */
+static const struct option long_options[] = {
+    { "uart",               required_argument,      0,      'd' },
+    { "sync",               no_argument,            0,      'S' },
+    { "gpiochip",           required_argument,      0,      'c' },
+    { "reset-gpio"   ,      required_argument,      0,      'r' },
+    { "md-gpio",            required_argument,      0,      'm' },
+    { "reset-period",       required_argument,      0,      'p' },
+    { "no-reset",           no_argument,            0,      'R' },
+    { "inquiries",          required_argument,      0,      'i' },
+    { "start-rate",         required_argument,      0,      's' },
+    { "end-rate",           required_argument,      0,      'e' },
+    { "step-rate",          required_argument,      0,      't' },
+    { "step-duration",      required_argument,      0,      'T' },
+    { "max-loss",           required_argument,      0,      'l' },
+    { "format",             required_argument,      0,      'f' },
+
+    { "verbose",            no_argument,            0,      'v' },
+    { "version",            no_argument,            0,      'V' },
+    { "help",               no_argument,            0,      'h' },
+    {} /* stop condition for iterator */
+};
+
+static const char *short_options = "d:Sc:r:m:p:Ri:s:e:t:T:l:f:vVh";
+
+/* descriptions for the command line options */
+static const char *long_options_descs[] = {
+    "UART interface (default: " DEFAULT_UART_INTERFACE ")",
+    "initial receive sync (default: send packet first)",
+    "GPIO chip device (default: " DEFAULT_RA_GPIOCHIP ")",
+    "GPIO name for controlling RESET pin of MCU (default: " DEFAULT_RA_GPIO_RESET_PIN ")",
+    "GPIO name for controlling MD pin of MCU (default: " DEFAULT_RA_GPIO_MD_PIN ")",
+    "reset duration (in ms, default: " __stringify(DEFAULT_RA_RESET_DELAY) ")",
+    "don't reset the safety controller before starting UART communication",
+    "comma-separated list of frame types to inquire (default: fw_version,git_hash)",
+    "inquiry rate of first step (per s, default: 10)",
+    "inquiry rate of last step (per s, default: 500)",
+    "rate increment per step (per s, default: 10)",
+    "duration of each step (in s, default: 5)",
+    "stop when more than this percentage of inquiries is lost (default: 50)",
+    "output format: table or csv (default: table)",
+
+    "verbose operation",
+    "print version and exit",
+    "print this usage and exit",
+    NULL /* stop condition for iterator */
+};
+
+static void usage(char *p, int exitcode)
+{
+    const char **desc = long_options_descs;
+    const struct option *op = long_options;
+
+    fprintf(stderr,
+            "%s (%s) -- Command line tool to measure the inquiry capacity of the safety MCU\n\n"
+            "Usage: %s [<options>]\n\n",
+            p, PACKAGE_STRING, p);
+
+    fprintf(stderr,
+            "Options:\n");
+
+    while (op->name && desc) {
+        if (op->val > 1) {
+            fprintf(stderr, "\t-%c, --%-13s\t%s\n", op->val, op->name, *desc);
+        } else {
+            fprintf(stderr, "\t    --%-13s\t%s\n", op->name, *desc);
+        }
+        op++;
+        desc++;
+    }
+
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+/* maximum count of different frame types to inquire */
+#define MAX_INQUIRIES 8
+
+/* maximum count of unanswered inquiries per frame type */
+#define MAX_PENDING 256
+
+/* an inquiry without response after this time is considered lost, in ms */
+#define LOST_TIMEOUT_MS 1000
+
+/* after each step, wait this long for outstanding responses, in ms */
+#define STEP_GRACE_MS 200
+
+/* resolution and range of the RTT histogram */
+#define RTT_BUCKET_US 100
+#define RTT_BUCKETS (LOST_TIMEOUT_MS * 1000 / RTT_BUCKET_US)
+
+/* a Charge State frame is considered late when its gap exceeds the interval by 50 % */
+#define CS_LATE_US (CB_PROTO_CHARGE_STATE_INTERVAL * 1000 * 3 / 2)
+
+/* to simplify, these are globals */
+static bool verbose = false;
+static bool intial_sync = false;
+static bool no_reset = false;
+static bool csv_output = false;
+static char *gpiochip = DEFAULT_RA_GPIOCHIP;
+static char *reset_gpioname = DEFAULT_RA_GPIO_RESET_PIN;
+static char *md_gpioname = DEFAULT_RA_GPIO_MD_PIN;
+static unsigned int reset_duration = DEFAULT_RA_RESET_DELAY;
+static char *uart_device = DEFAULT_UART_INTERFACE;
+static unsigned int start_rate = 10;
+static unsigned int end_rate = 500;
+static unsigned int step_rate = 10;
+static unsigned int step_duration = 5;
+static unsigned int max_loss = 50;
+
+/* the frame types to inquire, round-robin */
+static enum cb_uart_com inquiries[MAX_INQUIRIES] = { COM_FW_VERSION, COM_GIT_HASH };
+static unsigned int inquiry_count = 2;
+
+/* send timestamps of outstanding inquiries, per inquired frame type; each inquiry is
+ * tagged with the step it was sent in, so that responses which arrive after the step
+ * ended can be told apart from the responses to the inquiries of the current step */
+struct pending_fifo {
+    struct timespec ts[MAX_PENDING];
+    unsigned int step[MAX_PENDING];
+    unsigned int head;
+    unsigned int count;
+};
+
+struct step_stats {
+    unsigned int rate;
+
+    unsigned long sent;
+    unsigned long answered;
+    unsigned long late; /* answered, but after CB_PROTO_RESPONSE_TIMEOUT_MS */
+    unsigned long lost;
+    unsigned long overflow; /* could not be sent, too many outstanding */
+
+    uint32_t rtt_hist[RTT_BUCKETS];
+    long long rtt_max_us;
+
+    unsigned long cs_frames;
+    unsigned long cs_late;
+    long long cs_gap_max_us;
+
+    unsigned long errmsgs;
+    unsigned long rx_errors;
+};
+
+struct stress_ctx {
+    struct uart_ctx *uart;
+    struct safety_controller ctx;
+    struct pending_fifo pending[MAX_INQUIRIES];
+    unsigned int next_inquiry;
+    unsigned int step;
+    struct timespec last_cs;
+};
+
+static void debug_cb(const char *format, va_list args)
+{
+    if (verbose) {
+        fprintf(stderr, "debug: ");
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+    }
+}
+
+static void error_cb(const char *format, va_list args)
+{
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+/* 'fw_version' or 'COM_FW_VERSION' -> COM_FW_VERSION */
+static int parse_com(const char *s, enum cb_uart_com *com)
+{
+    unsigned int i;
+
+    if (strncasecmp(s, "COM_", 4) == 0)
+        s += 4;
+
+    for (i = 0; i < COM_MAX; i++) {
+        const char *name = cb_uart_com_to_str(i);
+
+        if (strcmp(name, "UNKNOWN") != 0 && strcasecmp(name + 4, s) == 0) {
+            *com = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void parse_inquiries(char *list)
+{
+    char *saveptr = NULL;
+    char *name;
+
+    inquiry_count = 0;
+
+    for (name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+        if (inquiry_count == MAX_INQUIRIES) {
+            error("too many frame types to inquire (max. %d)", MAX_INQUIRIES);
+            exit(EXIT_FAILURE);
+        }
+
+        if (parse_com(name, &inquiries[inquiry_count])) {
+            error("unknown frame type '%s'", name);
+            exit(EXIT_FAILURE);
+        }
+
+        /* these are sent periodically anyway, so responses could not be correlated */
+        if (inquiries[inquiry_count] == COM_CHARGE_STATE || inquiries[inquiry_count] == COM_CHARGE_STATE_2) {
+            error("inquiring Charge State frames is not supported");
+            exit(EXIT_FAILURE);
+        }
+
+        inquiry_count++;
+    }
+
+    if (!inquiry_count) {
+        error("at least one frame type to inquire is required");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void parse_cli(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    while (1) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        /* detect the end of the options */
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'd':
+            uart_device = optarg;
+            break;
+        case 'S':
+            intial_sync = true;
+            break;
+        case 'c':
+            gpiochip = optarg;
+            break;
+        case 'r':
+            reset_gpioname = optarg;
+            break;
+        case 'm':
+            md_gpioname = optarg;
+            break;
+        case 'p':
+            reset_duration = atoi(optarg);
+            break;
+        case 'R':
+            no_reset = true;
+            break;
+        case 'i':
+            parse_inquiries(optarg);
+            break;
+        case 's':
+            start_rate = atoi(optarg);
+            break;
+        case 'e':
+            end_rate = atoi(optarg);
+            break;
+        case 't':
+            step_rate = atoi(optarg);
+            break;
+        case 'T':
+            step_duration = atoi(optarg);
+            break;
+        case 'l':
+            max_loss = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                csv_output = true;
+            } else if (strcmp(optarg, "table") == 0) {
+                csv_output = false;
+            } else {
+                fprintf(stderr, "Error: unknown output format '%s'.\n\n", optarg);
+                usage(argv[0], EXIT_FAILURE);
+            }
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+        case 'V':
+            printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+            exit(EXIT_SUCCESS);
+        case '?':
+        case 'h':
+            rc = EXIT_SUCCESS;
+            /* fall-through */
+        default:
+            usage(argv[0], rc);
+        }
+    }
+
+    if (start_rate == 0 || end_rate < start_rate || step_rate == 0 || step_duration == 0) {
+        fprintf(stderr, "Error: invalid rate/step parameters.\n\n");
+        usage(argv[0], EXIT_FAILURE);
+    }
+}
+
+static int inquiry_index(enum cb_uart_com com)
+{
+    unsigned int i;
+
+    for (i = 0; i < inquiry_count; i++)
+        if (inquiries[i] == com)
+            return i;
+
+    return -1;
+}
+
+static void record_rtt(struct step_stats *st, long long rtt_us)
+{
+    unsigned int bucket = rtt_us / RTT_BUCKET_US;
+
+    if (bucket >= RTT_BUCKETS)
+        bucket = RTT_BUCKETS - 1;
+
+    st->rtt_hist[bucket]++;
+    st->answered++;
+
+    if (rtt_us > st->rtt_max_us)
+        st->rtt_max_us = rtt_us;
+    if (rtt_us > CB_PROTO_RESPONSE_TIMEOUT_MS * 1000)
+        st->late++;
+}
+
+/* returns the upper bound of the bucket which contains the given percentile, in us */
+static long long rtt_percentile(const struct step_stats *st, unsigned int percent)
+{
+    unsigned long long target = (st->answered * percent + 99) / 100;
+    unsigned long long sum = 0;
+    unsigned int i;
+
+    if (!st->answered)
+        return 0;
+
+    for (i = 0; i < RTT_BUCKETS; i++) {
+        sum += st->rtt_hist[i];
+        if (sum >= target)
+            return (long long)(i + 1) * RTT_BUCKET_US;
+    }
+
+    return (long long)RTT_BUCKETS * RTT_BUCKET_US;
+}
+
+static int send_charge_control(struct stress_ctx *sc)
+{
+    enum cb_uart_com com = cb_proto_is_mcs_mode(&sc->ctx) ? COM_CHARGE_CONTROL_2 : COM_CHARGE_CONTROL;
+
+    return cb_uart_send(sc->uart, com, sc->ctx.charge_control);
+}
+
+static int handle_frame(struct stress_ctx *sc, struct step_stats *st, enum cb_uart_com com, uint64_t data,
+                        const struct timespec *now)
+{
+    int idx;
+
+    cb_proto_store_frame(&sc->ctx, com, data);
+
+    idx = inquiry_index(com);
+    if (idx >= 0) {
+        struct pending_fifo *fifo = &sc->pending[idx];
+
+        if (fifo->count) {
+            /* already accounted as lost in its own step */
+            if (fifo->step[fifo->head] == sc->step)
+                record_rtt(st, timespec_to_us(timespec_sub(*now, fifo->ts[fifo->head])));
+            else
+                debug("discarding response %s to an inquiry of a previous step", cb_uart_com_to_str(com));
+            fifo->head = (fifo->head + 1) % MAX_PENDING;
+            fifo->count--;
+        } else {
+            debug("unexpected response %s", cb_uart_com_to_str(com));
+        }
+
+        return 0;
+    }
+
+    switch (com) {
+    case COM_CHARGE_STATE:
+    case COM_CHARGE_STATE_2:
+        st->cs_frames++;
+
+        if (timespec_is_set(&sc->last_cs)) {
+            long long gap = timespec_to_us(timespec_sub(*now, sc->last_cs));
+
+            if (gap > st->cs_gap_max_us)
+                st->cs_gap_max_us = gap;
+            if (gap > CS_LATE_US)
+                st->cs_late++;
+        }
+        sc->last_cs = *now;
+
+        /* keep the safety controller happy, as ra-raw does */
+        return send_charge_control(sc);
+
+    case COM_ERROR_MESSAGE:
+        if (cb_proto_errmsg_is_active(&sc->ctx)) {
+            enum errmsg_module module = cb_proto_errmsg_get_module(&sc->ctx);
+
+            st->errmsgs++;
+            debug("error message: module %s, reason %s",
+                  cb_proto_errmsg_module_to_str(module),
+                  cb_proto_errmsg_reason_to_str(module, cb_proto_errmsg_get_reason(&sc->ctx)));
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static void expire_pending(struct stress_ctx *sc, struct step_stats *st, const struct timespec *now, long long timeout_us)
+{
+    unsigned int i;
+
+    for (i = 0; i < inquiry_count; i++) {
+        struct pending_fifo *fifo = &sc->pending[i];
+
+        while (fifo->count && timespec_to_us(timespec_sub(*now, fifo->ts[fifo->head])) >= timeout_us) {
+            if (fifo->step[fifo->head] == sc->step)
+                st->lost++;
+            fifo->head = (fifo->head + 1) % MAX_PENDING;
+            fifo->count--;
+        }
+    }
+}
+
+static int send_next_inquiry(struct stress_ctx *sc, struct step_stats *st)
+{
+    unsigned int idx = sc->next_inquiry;
+    struct pending_fifo *fifo = &sc->pending[idx];
+    struct timespec now;
+    int rv;
+
+    sc->next_inquiry = (sc->next_inquiry + 1) % inquiry_count;
+
+    if (fifo->count == MAX_PENDING) {
+        st->overflow++;
+        return 0;
+    }
+
+    rv = cb_send_uart_inquiry(sc->uart, inquiries[idx]);
+    if (rv)
+        return rv;
+
+    /* cb_uart_send drains the UART, so our own transmit time is not part of the RTT */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fifo->ts[(fifo->head + fifo->count) % MAX_PENDING] = now;
+    fifo->step[(fifo->head + fifo->count) % MAX_PENDING] = sc->step;
+    fifo->count++;
+    st->sent++;
+
+    return 0;
+}
+
+/* receive (and send inquiries with the given rate, if non-zero) until 'end' */
+static int run_phase(struct stress_ctx *sc, struct step_stats *st, unsigned int rate, const struct timespec *end)
+{
+    struct pollfd pfd = { .fd = sc->uart->fd, .events = POLLIN };
+    struct timespec now, next_send, period;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    next_send = now;
+    if (rate)
+        set_normalized_timespec(&period, 0, 1000000000LL / rate);
+
+    while (timespec_compare(&now, end) < 0) {
+        struct timespec deadline = *end, timeout;
+        int rv;
+
+        if (rate && timespec_compare(&next_send, &deadline) < 0)
+            deadline = next_send;
+
+        timeout = timespec_compare(&deadline, &now) > 0 ? timespec_sub(deadline, now) : (struct timespec){ 0, 0 };
+
+        rv = ppoll(&pfd, 1, &timeout, NULL);
+        if (rv < 0) {
+            if (errno == EINTR)
+                return -1;
+            error("ppoll() failed: %m");
+            return -1;
+        }
+
+        if (rv > 0 && (pfd.revents & POLLIN)) {
+            enum cb_uart_com com;
+            uint64_t data;
+
+            rv = cb_uart_recv_and_sync(sc->uart, &com, &data);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            if (rv) {
+                st->rx_errors++;
+            } else if (handle_frame(sc, st, com, data, &now)) {
+                error("error while sending charge control frame: %m");
+                return -1;
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        expire_pending(sc, st, &now, LOST_TIMEOUT_MS * 1000LL);
+
+        if (rate && timespec_compare(&now, &next_send) >= 0) {
+            if (send_next_inquiry(sc, st)) {
+                error("error while sending inquiry frame: %m");
+                return -1;
+            }
+
+            next_send = timespec_add(next_send, period);
+
+            /* when we cannot keep up, don't send bursts to catch up but report the achieved rate */
+            if (timespec_compare(&now, &next_send) > 0)
+                next_send = timespec_add(now, period);
+        }
+    }
+
+    return 0;
+}
+
+static int run_step(struct stress_ctx *sc, struct step_stats *st)
+{
+    struct timespec end;
+    unsigned int i, j;
+
+    sc->step++;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    timespec_add_ms(&end, step_duration * 1000LL);
+
+    if (run_phase(sc, st, st->rate, &end))
+        return -1;
+
+    /* collect late responses without sending new inquiries */
+    timespec_add_ms(&end, STEP_GRACE_MS);
+    if (run_phase(sc, st, 0, &end))
+        return -1;
+
+    /* everything outstanding of this step is now accounted as lost; the entries stay
+     * queued until their responses arrive or they expire, so that they do not get
+     * matched against the inquiries of the next step */
+    for (i = 0; i < inquiry_count; i++) {
+        struct pending_fifo *fifo = &sc->pending[i];
+
+        for (j = 0; j < fifo->count; j++)
+            if (fifo->step[(fifo->head + j) % MAX_PENDING] == sc->step)
+                st->lost++;
+    }
+
+    return 0;
+}
+
+static void print_header(void)
+{
+    if (csv_output) {
+        printf("rate,achieved_rate,sent,answered,late,lost,overflow,rtt_p50_us,rtt_p90_us,rtt_p99_us,rtt_max_us,"
+               "cs_frames,cs_late,cs_gap_max_us,errmsgs,rx_errors\n");
+    } else {
+        printf("%6s %8s %7s %6s %6s %6s %8s %8s %8s %8s %7s %10s %7s %6s\n",
+               "rate", "achieved", "sent", "loss%", "late", "lost", "p50[ms]", "p90[ms]", "p99[ms]", "max[ms]",
+               "cs_late", "cs_gap[ms]", "errmsg", "rxerr");
+    }
+}
+
+static void print_step(const struct step_stats *st)
+{
+    double achieved = (double)st->sent / step_duration;
+    double loss = st->sent ? 100.0 * st->lost / st->sent : 0.0;
+
+    if (csv_output) {
+        printf("%u,%.1f,%lu,%lu,%lu,%lu,%lu,%lld,%lld,%lld,%lld,%lu,%lu,%lld,%lu,%lu\n",
+               st->rate, achieved, st->sent, st->answered, st->late, st->lost, st->overflow,
+               rtt_percentile(st, 50), rtt_percentile(st, 90), rtt_percentile(st, 99), st->rtt_max_us,
+               st->cs_frames, st->cs_late, st->cs_gap_max_us, st->errmsgs, st->rx_errors);
+    } else {
+        printf("%6u %8.1f %7lu %6.1f %6lu %6lu %8.1f %8.1f %8.1f %8.1f %7lu %10.1f %7lu %6lu\n",
+               st->rate, achieved, st->sent, loss, st->late, st->lost,
+               rtt_percentile(st, 50) / 1000.0, rtt_percentile(st, 90) / 1000.0,
+               rtt_percentile(st, 99) / 1000.0, st->rtt_max_us / 1000.0,
+               st->cs_late, st->cs_gap_max_us / 1000.0, st->errmsgs, st->rx_errors);
+    }
+
+    fflush(stdout);
+}
+
+/* inquire the firmware version once, so that we know whether the MCS protocol variant is used */
+static int init_controller(struct stress_ctx *sc)
+{
+    struct step_stats dummy = {};
+    struct timespec end;
+
+    if (cb_send_uart_inquiry(sc->uart, COM_FW_VERSION)) {
+        error("error while sending inquiry frame: %m");
+        return -1;
+    }
+    if (send_charge_control(sc)) {
+        error("error while sending charge control frame: %m");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    timespec_add_ms(&end, 2 * CB_PROTO_CHARGE_STATE_INTERVAL);
+
+    if (run_phase(sc, &dummy, 0, &end))
+        return -1;
+
+    if (sc->ctx.fw_version_str[0] == '\0') {
+        error("safety controller did not report its firmware version");
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    debug("firmware version: %s (%s mode)", sc->ctx.fw_version_str, cb_proto_is_mcs_mode(&sc->ctx) ? "MCS" : "AC/DC");
+
+    /* the Charge State gap measurement should not include this phase */
+    memset(&sc->last_cs, 0, sizeof(sc->last_cs));
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char *env_uart_device = NULL;
+    char *env_gpiochip = NULL;
+    char *env_reset_gpioname = NULL;
+    char *env_md_gpioname = NULL;
+    struct uart_ctx uart = INIT_UART_CTX;
+    struct stress_ctx *sc = NULL;
+    struct step_stats *st = NULL;
+    unsigned int rate;
+    int rc = EXIT_FAILURE;
+    int rv;
+
+    /* check whether any of the environment variables SAFETY_MCU_... is set and use it
+     * as default; so the resulting order is:
+     * compiled-in default -> can be overridden by environment -> can be overridden by cmdline
+     */
+    env_uart_device = getenv(GETENV_UART_KEY);
+    if (env_uart_device)
+        uart_device = env_uart_device;
+
+    env_gpiochip = getenv(GETENV_GPIOCHIP_KEY);
+    if (env_gpiochip)
+        gpiochip = env_gpiochip;
+
+    env_reset_gpioname = getenv(GETENV_RESET_PIN_KEY);
+    if (env_reset_gpioname)
+        reset_gpioname = env_reset_gpioname;
+
+    env_md_gpioname = getenv(GETENV_MD_PIN_KEY);
+    if (env_md_gpioname)
+        md_gpioname = env_md_gpioname;
+
+    /* register debug and error message callbacks */
+    ra_utils_set_error_msg_cb(error_cb);
+    ra_utils_set_debug_msg_cb(debug_cb);
+
+    /* handle command line options */
+    parse_cli(argc, argv);
+
+    sc = calloc(1, sizeof(*sc));
+    st = calloc(1, sizeof(*st));
+    if (!sc || !st) {
+        error("out of memory");
+        goto free_out;
+    }
+
+    /* the baudrate of the MCU with running firmware should be 115200 */
+    rv = uart_open(&uart, uart_device, 115200);
+    if (rv) {
+        error("opening '%s' failed: %m", uart_device);
+        goto free_out;
+    }
+
+    sc->uart = &uart;
+
+    /* unless not desired, reset the safety controller via GPIO */
+    if (!no_reset) {
+        rv = ra_gpio_reset_controller(gpiochip, reset_gpioname, md_gpioname, reset_duration);
+        if (rv)
+            goto close_out;
+    }
+
+    if (intial_sync) {
+        enum cb_uart_com com;
+        uint64_t data;
+
+        /* sync the receiving side */
+        rv = cb_uart_recv_and_sync(&uart, &com, &data);
+        if (rv) {
+            error("could not synchronize to the safety controller: %m");
+            goto close_out;
+        }
+    }
+
+    if (init_controller(sc))
+        goto close_out;
+
+    print_header();
+
+    for (rate = start_rate; rate <= end_rate; rate += step_rate) {
+        memset(st, 0, sizeof(*st));
+        st->rate = rate;
+
+        if (run_step(sc, st))
+            goto close_out;
+
+        print_step(st);
+
+        if (st->sent && 100 * st->lost > (unsigned long)max_loss * st->sent) {
+            debug("stopping: loss exceeds %u %%", max_loss);
+            break;
+        }
+    }
+
+    rc = EXIT_SUCCESS;
+
+close_out:
+    rv = uart_close(&uart);
+    if (rv)
+        error("closing UART failed: %m");
+
+free_out:
+    free(st);
+    free(sc);
+
+    return rc;
+}
@@ -19,7 +19,13 @@
  *         chipinfo             -- print chip info
  *         erase                -- erase MCU's flash
  *         flash <filename>     -- write given filename to MCU's flash
- *         dump [<filename>]    -- dump the MCU's flash content to stdout or filename (if given)
+ *         dump [<filename>]    -- dump the MCU's flash content to stdout or filename (if given),
+ *                                 or only to the snapshot store (if --store is given without filename)
+ *         pb-get [<filename>]  -- print the parameter block in data flash as YAML, or save it to filename (if given)
+ *         pb-set <filename>    -- write the parameter block from the given YAML or binary file to data flash,
+ *                                 unless it is already present; only the required erase units are touched
+ *         patch <filename>     -- apply the given firmware patch file (see ra-fw-patch) to the code flash,
+ *                                 if the MCU runs the patch's source firmware
  *
  * Options:
  *         -c, --gpiochip          GPIO chip device (default: /dev/gpiochip2)
@@ -29,6 +35,13 @@
  *         -p, --reset-period      reset duration (in ms, default: 500)
  *         -a, --flash-area        target flash area (code or data, default: code)
  *         -N, --no-verify         don't verify during after flashing (default: read back flash and compare)
+ *             --verify            verification after flashing the firmware: full (read back flash and compare),
+ *                                 boot (read back the infoblock and a sample, then check that the firmware boots
+ *                                 and reports the expected version and git hash) or none (default: full)
+ *         -s, --store             store the dump as snapshot in the given snapshot store directory (see ra-fw-store)
+ *         -S, --snapshot          name of the snapshot (default: <flash-area>-<date>T<time>)
+ *             --trust-store       take the application of a firmware known in the store from there instead of
+ *                                 reading it, when a sample of it matches the flash (dump with --store only)
  *         -v, --verbose           verbose operation
  *         -V, --version           print version and exit
  *         -h, --help              print this usage and exit
@@ -36,6 +49,8 @@
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
+#include <ctype.h>
+#include <endian.h>
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
@@ -47,14 +62,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 #include <ra_protocol.h>
 #include <cb_protocol.h>
 #include <logging.h>
+#include <param_block.h>
+#include <param_block_yaml.h>
 #include <tools.h>
 #include <uart.h>
 #include <version.h>
 #include "fw_file.h"
+#include "fw_patch.h"
+#include "fw_store.h"
 #include "ra_gpio.h"
 #include "stringify.h"
 #include "gpio-defaults.h"
@@ -75,6 +95,9 @@ enum cmd {
     CMD_ERASE,
     CMD_FLASH,
     CMD_DUMP,
+    CMD_PB_GET,
+    CMD_PB_SET,
+    CMD_PATCH,
     CMD_MAX
 };
 
@@ -87,6 +110,9 @@ static const char *cmd_strings[CMD_MAX] = {
     "erase",
     "flash",
     "dump",
+    "pb-get",
+    "pb-set",
+    "patch",
 };
 
 static const char *cmd_args[CMD_MAX] = {
@@ -98,6 +124,9 @@ static const char *cmd_args[CMD_MAX] = {
     NULL,
     "<filename>",
     "[<filename>]",
+    "[<filename>]",
+    "<filename>",
+    "<filename>",
 };
 
 static const char *cmd_descs[CMD_MAX] = {
@@ -108,7 +137,10 @@ static const char *cmd_descs[CMD_MAX] = {
     "print chip info",
     "erase MCU's flash",
     "write given filename to MCU's flash",
-    "dump the MCU's flash content to stdout or filename (if given)",
+    "dump the MCU's flash content to stdout or filename (if given), or only to the store (--store)",
+    "print the parameter block in data flash as YAML, or save it to filename (if given)",
+    "write the parameter block from the given YAML or binary file to data flash, unless it is already present",
+    "apply the given firmware patch file to the code flash, if the MCU runs the patch's source firmware",
 };
 
 /* command line options */
@@ -120,6 +152,10 @@ static const struct option long_options[] = {
     { "reset-period",       required_argument,      0,      'p' },
     { "flash-area",         required_argument,      0,      'a' },
     { "no-verify",          no_argument,            0,      'N' },
+    { "verify",             required_argument,      0,      1 },
+    { "store",              required_argument,      0,      's' },
+    { "snapshot",           required_argument,      0,      'S' },
+    { "trust-store",        no_argument,            0,      2 },
 
     { "verbose",            no_argument,            0,      'v' },
     { "version",            no_argument,            0,      'V' },
@@ -127,7 +163,7 @@ static const struct option long_options[] = {
     {} /* stop condition for iterator */
 };
 
-static const char *short_options = "c:r:m:d:p:a:NvVh";
+static const char *short_options = "c:r:m:d:p:a:Ns:S:vVh";
 
 /* descriptions for the command line options */
 static const char *long_options_descs[] = {
@@ -138,6 +174,10 @@ static const char *long_options_descs[] = {
     "reset duration (in ms, default: " __stringify(DEFAULT_RA_RESET_DELAY) ")",
     "target flash area (code or data, default: code)",
     "don't verify during after flashing (default: read back flash and compare)",
+    "verification after flashing the firmware: full, boot or none (default: full)",
+    "store the dump as snapshot in the given snapshot store directory",
+    "name of the snapshot (default: <flash-area>-<date>T<time>)",
+    "take a known firmware from the store when a sample of it matches the flash",
 
     "verbose operation",
     "print version and exit",
@@ -173,7 +213,7 @@ static void usage(char *p, int exitcode)
             "Options:\n");
 
     while (op->name && desc) {
-        if (op->val > 1) {
+        if (isalpha(op->val)) {
             fprintf(stderr, "\t-%c, --%-12s\t%s\n", op->val, op->name, *desc);
         } else {
             fprintf(stderr, "\t    --%-12s\t%s\n", op->name, *desc);
@@ -197,8 +237,17 @@ static char *md_gpioname = DEFAULT_RA_GPIO_MD_PIN;
 static char *uart_device = DEFAULT_UART_INTERFACE;
 static unsigned int reset_duration = DEFAULT_RA_RESET_DELAY;
 static enum cmd cmd = CMD_MAX;
-static bool verify = true;
+static enum verify_mode {
+    VERIFY_NONE,
+    /* read back the whole flash area and compare */
+    VERIFY_FULL,
+    /* read back the infoblock and a sample of write units, then let the firmware confirm its identity */
+    VERIFY_BOOT,
+} verify = VERIFY_FULL;
 static char *fw_filename = NULL;
+static char *store_dir = NULL;
+static char *snapshot_name = NULL;
+static bool trust_store = false;
 static struct ra_chipinfo chipinfo;
 static struct ra_flash_area_info *flash_area_info = &chipinfo.code; /* default to code */
 
@@ -245,7 +294,7 @@ static void xprint(const char *format, ...)
     va_end(args);
 }
 
-void parse_cli(int argc, char *argv[])
+static void parse_cli(int argc, char *argv[])
 {
     int rc = EXIT_FAILURE;
     int i;
@@ -285,7 +334,28 @@ void parse_cli(int argc, char *argv[])
             }
             break;
         case 'N':
-            verify = false;
+            verify = VERIFY_NONE;
+            break;
+        case 1:
+            if (strcasecmp(optarg, "full") == 0) {
+                verify = VERIFY_FULL;
+            } else if (strcasecmp(optarg, "boot") == 0) {
+                verify = VERIFY_BOOT;
+            } else if (strcasecmp(optarg, "none") == 0) {
+                verify = VERIFY_NONE;
+            } else {
+                fprintf(stderr, "Unknown verify mode '%s'.\n", optarg);
+                usage(argv[0], rc);
+            }
+            break;
+        case 's':
+            store_dir = optarg;
+            break;
+        case 'S':
+            snapshot_name = optarg;
+            break;
+        case 2:
+            trust_store = true;
             break;
 
         case 'v':
@@ -334,8 +404,8 @@ void parse_cli(int argc, char *argv[])
     argc -= 1;
     argv += 1;
 
-    /* the flash command requires a second argument */
-    if (cmd == CMD_FLASH) {
+    /* the flash, pb-set and patch commands require a second argument */
+    if (cmd == CMD_FLASH || cmd == CMD_PB_SET || cmd == CMD_PATCH) {
         if (argc == 1) {
             fw_filename = argv[0];
             return;
@@ -351,8 +421,8 @@ void parse_cli(int argc, char *argv[])
         if (argc == 0)
             return;
     }
-    /* for dump it is optional, too */
-    if (cmd == CMD_DUMP) {
+    /* for dump and pb-get it is optional, too */
+    if (cmd == CMD_DUMP || cmd == CMD_PB_GET) {
         if (argc == 1) {
             fw_filename = argv[0];
             return;
@@ -421,9 +491,632 @@ static int setup_uart_communication(struct gpio_ctx *gpio, struct uart_ctx *uart
     return 0;
 }
 
+/* read a parameter block from a binary (detected by the leading marker) or a YAML file,
+ * the returned block has a valid CRC */
+static int pb_load_file(const char *filename, struct param_block_v2 *param_block)
+{
+    uint32_t sob;
+    FILE *f;
+    int rv = -1;
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        xerror("Could not open '%s': %m", filename);
+        return -1;
+    }
+
+    if (fread(&sob, sizeof(sob), 1, f) == 1 && sob == htole32(PB_MARKER)) {
+        rewind(f);
+
+        switch (pb_read(f, param_block)) {
+        case PB_READ_SUCCESS:
+            rv = 0;
+            break;
+        case PB_READ_ERROR_MAGIC:
+            xerror("'%s' is not a valid parameter block (end marker mismatch).", filename);
+            break;
+        case PB_READ_ERROR_CRC:
+            xerror("'%s' is not a valid parameter block (CRC mismatch).", filename);
+            break;
+        default:
+            xerror("Reading parameter block from '%s' failed (file too short?).", filename);
+        }
+    } else {
+        rewind(f);
+
+        rv = pb_read_yaml(f, param_block, false);
+        if (rv)
+            xerror("Could not parse '%s' as YAML parameter block.", filename);
+    }
+
+    fclose(f);
+
+    if (rv == 0)
+        pb_refresh_crc_v2(param_block);
+
+    return rv;
+}
+
+/* erase only the erase units which hold the parameter block at the start of the data flash,
+ * then write the block padded to the write unit size and read it back (if desired) */
+static int pb_flash(struct uart_ctx *uart, struct param_block_v2 *param_block)
+{
+    struct ra_flash_area_info *ai = &chipinfo.data;
+    uint8_t *buffer, *readback = NULL;
+    size_t erase_len;
+    int rv = -1;
+
+    if (ai->erase_unit_size == 0 || ai->write_unit_size == 0) {
+        xerror("The MCU reported no usable data flash area.");
+        return -1;
+    }
+
+    /* the erase unit size is a multiple of the write unit size, so whole erase units can be
+     * written back */
+    erase_len = ROUND_UP(sizeof(*param_block), ai->erase_unit_size);
+    if (erase_len > ai->size || erase_len % ai->write_unit_size) {
+        xerror("The parameter block does not fit into the data flash area.");
+        return -1;
+    }
+
+    buffer = malloc(erase_len);
+    if (verify)
+        readback = malloc(erase_len);
+    if (!buffer || (verify && !readback)) {
+        xerror("Could not allocate memory: %m");
+        goto free_out;
+    }
+
+    /* erasing clears the whole erase units, so preserve what follows the parameter block */
+    if (ra_read(uart, buffer, ai->start_address, erase_len)) {
+        xerror("Reading the data flash failed: %m");
+        goto free_out;
+    }
+    memcpy(buffer, param_block, sizeof(*param_block));
+
+    xdebug("erasing and writing 0x%08" PRIx32 "-0x%08" PRIx32,
+           ai->start_address, (uint32_t)(ai->start_address + erase_len - 1));
+
+    if (ra_rwe_cmd(uart, RWE_ERASE, ai->start_address, ai->start_address + erase_len - 1)) {
+        xerror("Erasing the parameter block failed: %m");
+        goto free_out;
+    }
+
+    if (ra_write(uart, ai->start_address, buffer, erase_len)) {
+        xerror("Writing the parameter block failed: %m");
+        goto free_out;
+    }
+
+    if (verify) {
+        if (ra_read(uart, readback, ai->start_address, erase_len)) {
+            xerror("Reading back the parameter block failed: %m");
+            goto free_out;
+        }
+
+        if (memcmp(readback, buffer, erase_len) != 0) {
+            xerror("Verify after flashing failed.");
+            goto free_out;
+        }
+    }
+
+    rv = 0;
+
+free_out:
+    free(readback);
+    free(buffer);
+    return rv;
+}
+
+/* write the raw parameter block as read from the MCU to the given file */
+static int pb_save_file(const char *filename, struct param_block_v2 *param_block)
+{
+    FILE *f;
+
+    f = fopen(filename, "wb");
+    if (!f) {
+        xerror("Could not create '%s': %m", filename);
+        return -1;
+    }
+
+    if (fwrite(param_block, sizeof(*param_block), 1, f) != 1) {
+        xerror("Writing to '%s' failed: %m", filename);
+        fclose(f);
+        return -1;
+    }
+
+    if (fclose(f) == EOF) {
+        xerror("Closing '%s' failed: %m", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* read the version app infoblock of the firmware in code flash, converted to host endianness */
+static int fw_read_infoblock(struct uart_ctx *uart, struct version_app_infoblock *info)
+{
+    if (ra_read(uart, (uint8_t *)info,
+                chipinfo.code.start_address + CODE_FIRMWARE_INFORMATION_START_ADDRESS, sizeof(*info))) {
+        xerror("Reading version app infoblock failed: %m");
+        return -1;
+    }
+
+    fw_version_app_infoblock_to_host_endianess(info);
+
+    return 0;
+}
+
+/* count of write units which are read back in addition to the infoblock with --verify=boot */
+#define BOOT_VERIFY_SAMPLES 16
+
+/* time the firmware has to report its identity after the reset (in ms) */
+#define BOOT_VERIFY_TIMEOUT 3000
+
+static int boot_verify_range(struct uart_ctx *uart, const uint8_t *content, size_t offset, size_t len, uint8_t *buf)
+{
+    uint32_t address = flash_area_info->start_address + offset;
+
+    if (ra_read(uart, buf, address, len)) {
+        xerror("Reading back 0x%08" PRIx32 " failed: %m", address);
+        return -1;
+    }
+
+    if (memcmp(buf, content + offset, len) != 0) {
+        xerror("Verify of 0x%08" PRIx32 "-0x%08" PRIx32 " after flashing failed.",
+               address, (uint32_t)(address + len - 1));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* read back the write units holding the infoblock and one random write unit out of each of
+ * BOOT_VERIFY_SAMPLES equally sized strides of the image, plus the last one; since the
+ * sample differs from run to run, systematic write errors are caught over several updates */
+static int boot_verify_readback(struct uart_ctx *uart, const uint8_t *content, size_t len)
+{
+    size_t wus = flash_area_info->write_unit_size;
+    size_t units = len / wus;
+    size_t info_start = CODE_FIRMWARE_INFORMATION_START_ADDRESS / wus * wus;
+    size_t info_len = ROUND_UP(CODE_FIRMWARE_INFORMATION_END_ADDRESS + 1, wus) - info_start;
+    size_t stride = max(units / BOOT_VERIFY_SAMPLES, 1);
+    size_t unit;
+    uint8_t *buf;
+    int rv = -1;
+
+    buf = malloc(max(wus, info_len));
+    if (!buf) {
+        xerror("Could not allocate memory: %m");
+        return -1;
+    }
+
+    if (boot_verify_range(uart, content, info_start, info_len, buf))
+        goto free_out;
+
+    srandom(time(NULL) ^ getpid());
+
+    for (unit = 0; unit < units; unit += stride) {
+        size_t sample = unit + random() % min(stride, units - unit);
+
+        xdebug("verifying write unit %zu of %zu", sample, units);
+
+        if (boot_verify_range(uart, content, sample * wus, wus, buf))
+            goto free_out;
+    }
+
+    if (boot_verify_range(uart, content, (units - 1) * wus, wus, buf))
+        goto free_out;
+
+    rv = 0;
+
+free_out:
+    free(buf);
+    return rv;
+}
+
+static long boot_verify_elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/* reset the MCU into normal mode and wait until the firmware reports the version and git hash
+ * of the given infoblock (host endianness); the UART is re-opened for the firmware protocol */
+static int boot_verify_firmware(struct gpio_ctx *gpio, struct uart_ctx *uart, const struct version_app_infoblock *info)
+{
+    struct safety_controller ctx = {};
+    bool have_version = false, have_git_hash = false;
+    struct timespec start;
+    enum cb_uart_com com;
+    uint64_t data;
+    long elapsed;
+
+    if (ra_reset_to_normal(gpio)) {
+        xerror("Resetting into normal mode failed: %m");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (uart_close(uart)) {
+        xerror("Closing UART failed: %m");
+        return -1;
+    }
+
+    /* the baudrate of the MCU with running firmware should be 115200 */
+    if (uart_open(uart, uart_device, 115200)) {
+        xerror("Opening '%s' failed: %m", uart_device);
+        return -1;
+    }
+
+    /* drop any left-overs of the bootloader communication */
+    if (uart_flush_input(uart)) {
+        xerror("Flushing UART input failed: %m");
+        return -1;
+    }
+
+    /* the inquiries are repeated with each received frame until they are answered,
+     * since the first ones are probably sent while the firmware still starts up */
+    while (!have_version || !have_git_hash) {
+        elapsed = boot_verify_elapsed_ms(&start);
+        if (elapsed > BOOT_VERIFY_TIMEOUT) {
+            xerror("The firmware did not report its %s within %d ms after the reset.",
+                   have_version ? "git hash" : "version", BOOT_VERIFY_TIMEOUT);
+            return -1;
+        }
+
+        if ((!have_version && cb_send_uart_inquiry(uart, COM_FW_VERSION)) ||
+            (!have_git_hash && cb_send_uart_inquiry(uart, COM_GIT_HASH))) {
+            xerror("Sending an inquiry to the firmware failed: %m");
+            return -1;
+        }
+
+        if (cb_uart_recv_and_sync(uart, &com, &data)) {
+            if (errno == ETIMEDOUT || errno == EBADMSG)
+                continue;
+            xerror("Receiving from the firmware failed: %m");
+            return -1;
+        }
+
+        cb_proto_store_frame(&ctx, com, data);
+
+        if (com == COM_FW_VERSION)
+            have_version = true;
+        else if (com == COM_GIT_HASH)
+            have_git_hash = true;
+    }
+
+    elapsed = boot_verify_elapsed_ms(&start);
+
+    if (cb_proto_fw_get_major(&ctx) != info->sw_major_version ||
+        cb_proto_fw_get_minor(&ctx) != info->sw_minor_version ||
+        cb_proto_fw_get_build(&ctx) != info->sw_build_version) {
+        xerror("The MCU reports firmware version %s instead of %u.%u.%u after flashing.", ctx.fw_version_str,
+               info->sw_major_version, info->sw_minor_version, info->sw_build_version);
+        return -1;
+    }
+
+    if (ctx.git_hash != info->git_hash) {
+        xerror("The MCU reports git hash %s instead of %016" PRIx64 " after flashing.",
+               ctx.git_hash_str, info->git_hash);
+        return -1;
+    }
+
+    xprint("Firmware %s (%s) is up and running, %ld ms after the reset.", ctx.fw_version_str, ctx.git_hash_str, elapsed);
+
+    return 0;
+}
+
+static bool is_blank(const uint8_t *p, size_t len)
+{
+    while (len--)
+        if (*p++ != 0xff)
+            return false;
+
+    return true;
+}
+
+/* read back one randomly chosen write unit of each erase unit taken from the store and compare
+ * it; non-blank write units are preferred, since an interrupted patch or update leaves erase
+ * units which are either rewritten or erased; a short write unit at the end of the content is
+ * compared as far as it goes; returns 0 if all match, 1 on a mismatch and -1 on error */
+static int store_check_sample(struct uart_ctx *uart, const uint8_t *content, size_t len)
+{
+    size_t eus = flash_area_info->erase_unit_size;
+    size_t wus = flash_area_info->write_unit_size;
+    uint8_t buf[wus];
+    size_t unit;
+
+    srandom(time(NULL) ^ getpid());
+
+    for (unit = 0; unit < len; unit += eus) {
+        size_t count = DIV_ROUND_UP(min(eus, len - unit), wus);
+        size_t start, i, offset, n;
+
+        if (count == 0)
+            break;
+
+        /* the first non-blank write unit from the random start on, if any */
+        start = random() % count;
+        for (i = 0; i < count; i++) {
+            offset = unit + ((start + i) % count) * wus;
+            if (!is_blank(content + offset, min(wus, len - offset)))
+                break;
+        }
+        if (i == count)
+            offset = unit + start * wus;
+        n = min(wus, len - offset);
+
+        if (ra_read(uart, buf, flash_area_info->start_address + offset, n)) {
+            xerror("Reading the flash content failed: %m");
+            return -1;
+        }
+
+        if (memcmp(buf, content + offset, n) != 0) {
+            xprint("The flash at 0x%08zx differs from the firmware in the store, reading it completely.",
+                   flash_area_info->start_address + offset);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* when the MCU runs a firmware which is already known in the store, then fill the erase units
+ * of its application from there instead of reading them; since this trusts the infoblock,
+ * which e.g. still names the source firmware during an interrupted patch, it must be requested
+ * with --trust-store and a sample of the units is compared with the flash; returns the count
+ * of bytes filled at the start of the buffer, or -1 on error */
+static ssize_t store_fill_known_firmware(struct uart_ctx *uart, struct fw_store *store, uint8_t *buf)
+{
+    struct version_app_infoblock info;
+    struct fw_snapshot app;
+    ssize_t known = 0;
+
+    /* only the code flash holds a firmware */
+    if (flash_area_info != &chipinfo.code)
+        return 0;
+
+    if (fw_read_infoblock(uart, &info))
+        return -1;
+
+    if (!fw_valid_version_app_infoblock(&info))
+        return 0;
+
+    if (fw_store_load_firmware(store, info.git_hash, info.application_checksum, &app)) {
+        xdebug("firmware %016" PRIx64 " is not known in the store yet", info.git_hash);
+        return 0;
+    }
+
+    if (app.erase_unit_size != chipinfo.code.erase_unit_size || app.size > chipinfo.code.size) {
+        xdebug("firmware %016" PRIx64 " was stored for a different code flash layout", info.git_hash);
+    } else if (fw_store_restore(store, &app, buf)) {
+        xdebug("restoring firmware %016" PRIx64 " from the store failed: %m", info.git_hash);
+    } else {
+        int rv = store_check_sample(uart, buf, app.size);
+
+        if (rv < 0) {
+            known = -1;
+        } else if (rv == 0) {
+            xdebug("took %zu bytes of firmware %016" PRIx64 " from the store", app.size, info.git_hash);
+            known = app.size;
+        }
+    }
+
+    fw_snapshot_free(&app);
+    return known;
+}
+
+/* add a dump to the store, recording the count of bytes which were taken from the store;
+ * the application of a valid firmware in code flash is remembered, too, unless it is
+ * already known */
+static int store_dump(struct fw_store *store, const uint8_t *buf, size_t len, size_t from_store)
+{
+    struct version_app_infoblock info;
+    struct fw_snapshot snap = {};
+    char default_name[64];
+    const char *name = snapshot_name;
+    time_t now;
+    struct tm tm;
+    int added, rv = -1;
+
+    added = fw_store_put(store, buf, len, flash_area_info->erase_unit_size, &snap);
+    if (added < 0) {
+        xerror("Adding the dump to the store '%s' failed: %m", store_dir);
+        return -1;
+    }
+
+    strcpy(snap.area, (flash_area_info == &chipinfo.code) ? "code" : "data");
+    snap.from_store = from_store;
+
+    if (flash_area_info == &chipinfo.code && len >= CODE_FIRMWARE_INFORMATION_START_ADDRESS + sizeof(info)) {
+        memcpy(&info, &buf[CODE_FIRMWARE_INFORMATION_START_ADDRESS], sizeof(info));
+        fw_version_app_infoblock_to_host_endianess(&info);
+
+        if (fw_valid_version_app_infoblock(&info)) {
+            snap.has_firmware = true;
+            snap.git_hash = info.git_hash;
+            snap.application_checksum = info.application_checksum;
+        }
+    }
+
+    if (!name) {
+        now = time(NULL);
+        localtime_r(&now, &tm);
+        snprintf(default_name, sizeof(default_name), "%s-", snap.area);
+        strftime(default_name + strlen(default_name), sizeof(default_name) - strlen(default_name),
+                 "%Y%m%dT%H%M%S", &tm);
+        name = default_name;
+    }
+
+    if (fw_store_save_snapshot(store, name, &snap)) {
+        xerror("Saving snapshot '%s' failed: %m", name);
+        goto free_out;
+    }
+
+    /* an existing firmware record is never replaced: a flash which differs from it (e.g. after
+     * an interrupted patch) still carries the infoblock of the known firmware */
+    if (snap.has_firmware && !from_store &&
+        info.application_size > 0 && info.application_size <= len &&
+        !fw_store_has_firmware(store, snap.git_hash, snap.application_checksum) &&
+        fw_store_save_firmware(store, &snap, info.application_size)) {
+        xerror("Remembering firmware %016" PRIx64 " in the store failed: %m", snap.git_hash);
+        goto free_out;
+    }
+
+    xprint("Snapshot '%s' stored (%u erase units, %d of them new).", name, snap.chunk_count, added);
+    rv = 0;
+
+free_out:
+    fw_snapshot_free(&snap);
+    return rv;
+}
+
+struct patch_ctx {
+    struct uart_ctx *uart;
+    size_t erase_unit_size;
+    uint8_t *readback;
+};
+
+static int patch_check_unit(uint32_t offset, const uint8_t *data, size_t length, void *ctx)
+{
+    struct patch_ctx *p = ctx;
+
+    (void)data;
+    (void)length;
+
+    if ((size_t)offset + p->erase_unit_size > chipinfo.code.size) {
+        xerror("The patch unit at 0x%08" PRIx32 " lies outside of the code flash area.", offset);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int patch_write_unit(uint32_t offset, const uint8_t *data, size_t length, void *ctx)
+{
+    struct patch_ctx *p = ctx;
+    uint32_t address = chipinfo.code.start_address + offset;
+
+    xdebug("patching 0x%08" PRIx32 "-0x%08" PRIx32 " (%s)",
+           address, (uint32_t)(address + p->erase_unit_size - 1), data ? "write" : "erase only");
+
+    if (ra_rwe_cmd(p->uart, RWE_ERASE, address, address + p->erase_unit_size - 1)) {
+        xerror("Erasing 0x%08" PRIx32 " failed: %m", address);
+        return -1;
+    }
+
+    if (data && ra_write(p->uart, address, data, length)) {
+        xerror("Writing 0x%08" PRIx32 " failed: %m", address);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int patch_verify_unit(uint32_t offset, const uint8_t *data, size_t length, void *ctx)
+{
+    struct patch_ctx *p = ctx;
+    uint32_t address = chipinfo.code.start_address + offset;
+    size_t i;
+
+    if (ra_read(p->uart, p->readback, address, p->erase_unit_size)) {
+        xerror("Reading back 0x%08" PRIx32 " failed: %m", address);
+        return -1;
+    }
+
+    if (data) {
+        if (memcmp(p->readback, data, length) == 0)
+            return 0;
+    } else {
+        for (i = 0; i < p->erase_unit_size && p->readback[i] == 0xff; i++)
+            ;
+        if (i == p->erase_unit_size)
+            return 0;
+    }
+
+    xerror("Verify of 0x%08" PRIx32 " after patching failed.", address);
+    return -1;
+}
+
+/* apply a patch to the code flash: only the listed erase units are rewritten, and only
+ * when the MCU runs the source firmware of the patch; returns 1 if the target firmware
+ * is already present */
+static int patch_flash(struct uart_ctx *uart, const struct fw_patch *patch)
+{
+    struct ra_flash_area_info *ai = &chipinfo.code;
+    struct version_app_infoblock info;
+    struct patch_ctx ctx = { .uart = uart, .erase_unit_size = patch->header.erase_unit_size };
+    int rv = -1;
+
+    if (patch->header.erase_unit_size != ai->erase_unit_size ||
+        ai->write_unit_size == 0 || ai->erase_unit_size % ai->write_unit_size != 0) {
+        xerror("The patch was created for an erase unit size of %" PRIu32 " bytes, but the MCU uses %zu bytes.",
+               patch->header.erase_unit_size, ai->erase_unit_size);
+        return -1;
+    }
+
+    if (patch->header.dst_size > ai->size) {
+        xerror("The patched firmware does not fit into the code flash area.");
+        return -1;
+    }
+
+    /* the firmware in code flash must be the one the patch was made from */
+    if (fw_read_infoblock(uart, &info))
+        return -1;
+
+    if (fw_patch_matches_dst(patch, &info))
+        return 1;
+
+    if (!fw_patch_matches_src(patch, &info)) {
+        xerror("The MCU does not run the source firmware of the patch (git hash %016" PRIx64 ").",
+               patch->header.src_git_hash);
+        return -1;
+    }
+
+    /* the patch file itself does not know the flash size, so check all units before erasing any */
+    if (fw_patch_foreach_unit(patch, false, patch_check_unit, &ctx))
+        return -1;
+
+    /* in reverse order, so that the first unit with the infoblock is written last: an
+     * interrupted patch still looks like the source firmware and can simply be re-applied */
+    if (fw_patch_foreach_unit(patch, true, patch_write_unit, &ctx))
+        return -1;
+
+    if (verify) {
+        ctx.readback = malloc(ctx.erase_unit_size);
+        if (!ctx.readback) {
+            xerror("Could not allocate memory: %m");
+            return -1;
+        }
+
+        rv = fw_patch_foreach_unit(patch, false, patch_verify_unit, &ctx);
+        free(ctx.readback);
+        if (rv)
+            return -1;
+
+        if (fw_read_infoblock(uart, &info))
+            return -1;
+
+        if (!fw_patch_matches_dst(patch, &info)) {
+            xerror("The patched firmware does not identify as the target firmware.");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    struct param_block_v2 param_block, current_param_block;
     struct version_app_infoblock version_info;
+    struct fw_patch patch;
+    struct fw_store store = {};
+    ssize_t known = 0;
     char *env_uart_device = NULL;
     char *env_gpiochip = NULL;
     char *env_reset_gpioname = NULL;
@@ -475,8 +1168,10 @@ int main(int argc, char *argv[])
         ra_set_reset_duration(gpio, reset_duration);
     }
 
-    /* when not dumping flash content if fw_filename is set, then make the file content via mmap available */
-    if (cmd != CMD_DUMP && fw_filename) {
+    /* when not dumping flash content if fw_filename is set, then make the file content via mmap available;
+     * the parameter block commands handle their (small) files on their own
+     */
+    if (cmd != CMD_DUMP && cmd != CMD_PB_GET && cmd != CMD_PB_SET && fw_filename) {
         rv = fw_mmap_infile(fw_filename, &fw_content, &fw_filesize);
         if (rv) {
             xerror("Could not open '%s': %m", fw_filename);
@@ -581,6 +1276,21 @@ int main(int argc, char *argv[])
                        flash_area_info->write_unit_size);
                 goto reset_to_normal_out;
             }
+            /* the firmware must be able to identify itself for the boot check */
+            if (verify == VERIFY_BOOT && flash_area_info == &chipinfo.code) {
+                if (fw_filesize < CODE_FIRMWARE_INFORMATION_END_ADDRESS + 1) {
+                    xerror("This file is too small to contain a version app infoblock, it cannot be verified by booting it.");
+                    goto reset_to_normal_out;
+                }
+
+                memcpy(&version_info, &fw_content[CODE_FIRMWARE_INFORMATION_START_ADDRESS], sizeof(version_info));
+                fw_version_app_infoblock_to_host_endianess(&version_info);
+
+                if (!fw_valid_version_app_infoblock(&version_info)) {
+                    xerror("This file has no valid version app infoblock, it cannot be verified by booting it.");
+                    goto reset_to_normal_out;
+                }
+            }
         }
 
         /* to keep it simple, we erase the whole area */
@@ -597,6 +1307,24 @@ int main(int argc, char *argv[])
                 goto reset_to_normal_out;
             }
 
+            /* the boot check only applies to the firmware, the data flash is always read back completely */
+            if (verify == VERIFY_BOOT && flash_area_info == &chipinfo.code) {
+                rv = boot_verify_readback(&uart, fw_content, fw_filesize);
+                if (rv) {
+                    /* no error logging here required, already done */
+                    goto reset_to_normal_out;
+                }
+
+                /* this leaves the MCU running in normal mode */
+                rv = boot_verify_firmware(gpio, &uart, &version_info);
+                if (rv) {
+                    /* no error logging here required, already done */
+                    goto close_out;
+                }
+
+                break;
+            }
+
             /* when verify is desired, then jump over into CMD_DUMP */
             if (verify)
                 goto verify_after_flash;
@@ -606,6 +1334,11 @@ int main(int argc, char *argv[])
         break;
 
     case CMD_DUMP:
+        if (store_dir && fw_store_open(&store, store_dir, true)) {
+            xerror("Could not open the store '%s': %m", store_dir);
+            goto close_out;
+        }
+
         rv = setup_uart_communication(gpio, &uart);
         if (rv) {
             /* no error logging here required, already done */
@@ -628,6 +1361,13 @@ int main(int argc, char *argv[])
                 xerror("Could not create '%s': %m", fw_filename);
                 goto close_out;
             }
+        } else if (store_dir) {
+            /* only the store is filled */
+            flash_content = malloc(fw_filesize);
+            if (!flash_content) {
+                xerror("Could not allocate memory: %m");
+                goto close_out;
+            }
         } else {
 verify_after_flash:
             /* otherwise we need to allocate memory to buffer the data for later */
@@ -638,13 +1378,26 @@ verify_after_flash:
             }
         }
 
-        rv = ra_read(&uart, flash_content, flash_area_info->start_address, fw_filesize);
+        /* with a trusted store, a known firmware need not be read again */
+        if (cmd == CMD_DUMP && store_dir && trust_store) {
+            known = store_fill_known_firmware(&uart, &store, flash_content);
+            if (known < 0)
+                goto reset_to_normal_out;
+        }
+
+        rv = ra_read(&uart, flash_content + known, flash_area_info->start_address + known, fw_filesize - known);
         if (rv) {
             xerror("Reading the flash content failed: %m");
             goto reset_to_normal_out;
         }
 
         if (cmd == CMD_DUMP) {
+            if (store_dir) {
+                rv = store_dump(&store, flash_content, fw_filesize, known);
+                if (rv)
+                    goto reset_to_normal_out;
+            }
+
             if (fw_filename) {
                 rv = msync(flash_content, fw_filesize, MS_SYNC);
                 if (rv) {
@@ -657,7 +1410,7 @@ verify_after_flash:
                     xerror("Unmapping memory failed: %m");
                     goto reset_to_normal_out;
                 }
-            } else {
+            } else if (!store_dir) {
                 /* dump data to stdout */
                 size_t dumped = 0;
 
@@ -681,6 +1434,115 @@ verify_after_flash:
         reset_to_normal_on_exit = true;
         break;
 
+    case CMD_PB_GET:
+    case CMD_PB_SET:
+        /* parse the requested block before touching the MCU at all */
+        if (cmd == CMD_PB_SET) {
+            rv = pb_load_file(fw_filename, &param_block);
+            if (rv) {
+                /* no error logging here required, already done */
+                goto close_out;
+            }
+        }
+
+        rv = setup_uart_communication(gpio, &uart);
+        if (rv) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        rv = ra_get_chipinfo(&uart, &chipinfo, verbose);
+        if (rv) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        /* the parameter block lives at the start of the data flash, we only read what we need */
+        rv = ra_read(&uart, (uint8_t *)&current_param_block, chipinfo.data.start_address, sizeof(current_param_block));
+        if (rv) {
+            xerror("Reading the parameter block failed: %m");
+            goto reset_to_normal_out;
+        }
+
+        if (cmd == CMD_PB_GET) {
+            if (fw_filename) {
+                rv = pb_save_file(fw_filename, &current_param_block);
+                if (rv)
+                    goto reset_to_normal_out;
+            } else {
+                /* decoding also migrates older parameter block versions */
+                rv = pb_parse((const uint8_t *)&current_param_block, sizeof(current_param_block),
+                              &param_block, NULL);
+
+                switch (rv) {
+                case PB_READ_SUCCESS:
+                    break;
+                case PB_READ_ERROR_CRC:
+                    xerror("The parameter block in data flash has an invalid CRC.");
+                    goto reset_to_normal_out;
+                default:
+                    xerror("The data flash does not contain a valid parameter block.");
+                    goto reset_to_normal_out;
+                }
+
+                pb_dump(&param_block);
+            }
+
+            reset_to_normal_on_exit = true;
+            break;
+        }
+
+        /* byte-wise comparison, so the stored CRC is checked, too */
+        if (memcmp(&current_param_block, &param_block, sizeof(param_block)) == 0) {
+            xprint("Parameter block is already up-to-date, data flash left untouched.");
+            reset_to_normal_on_exit = true;
+            break;
+        }
+
+        rv = pb_flash(&uart, &param_block);
+        if (rv) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        xprint("Parameter block written.");
+
+        reset_to_normal_on_exit = true;
+        break;
+
+    case CMD_PATCH:
+        /* check the patch file before touching the MCU at all */
+        if (fw_patch_parse(fw_content, fw_filesize, &patch)) {
+            xerror("'%s' is not a valid firmware patch file.", fw_filename);
+            goto close_out;
+        }
+
+        rv = setup_uart_communication(gpio, &uart);
+        if (rv) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        rv = ra_get_chipinfo(&uart, &chipinfo, verbose);
+        if (rv) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        rv = patch_flash(&uart, &patch);
+        if (rv < 0) {
+            /* no error logging here required, already done */
+            goto reset_to_normal_out;
+        }
+
+        if (rv > 0)
+            xprint("Firmware is already up-to-date, code flash left untouched.");
+        else
+            xprint("Firmware patched (%" PRIu16 " erase units).", patch.header.unit_count);
+
+        reset_to_normal_on_exit = true;
+        break;
+
     case CMD_CHIPINFO:
         rv = setup_uart_communication(gpio, &uart);
         if (rv) {
@@ -720,6 +1582,7 @@ close_out:
     }
     if (gpio)
         ra_gpio_close(gpio);
+    fw_store_close(&store);
 
     return rc;
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Multicall binary which contains all tools of ra-utils (see RA_UTILS_BUILD_MULTICALL).
+ * The tool is selected by the name the binary is called with, usually via a symlink
+ * like ra-update -> ra-utils, or by the first argument.
+ *
+ * Usage: ra-utils <tool> [<options>] [<parameter>...]
+ *        ra-utils --list
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <version.h>
+
+/* the entry points of the tools */
+#define APPLET(name, entry) int entry(int argc, char *argv[]);
+#include "ra-utils-applets.h"
+#undef APPLET
+
+struct applet {
+    const char *name;
+    int (*main)(int argc, char *argv[]);
+};
+
+static const struct applet applets[] = {
+#define APPLET(name, entry) { name, entry },
+#include "ra-utils-applets.h"
+#undef APPLET
+    {} /* stop condition for iterator */
+};
+
+static const struct applet *find_applet(const char *name)
+{
+    const struct applet *a;
+
+    for (a = applets; a->name; a++)
+        if (strcmp(a->name, name) == 0)
+            return a;
+
+    return NULL;
+}
+
+static void list_applets(FILE *f)
+{
+    const struct applet *a;
+
+    for (a = applets; a->name; a++)
+        fprintf(f, "%s\n", a->name);
+}
+
+static void usage(char *p, int exitcode)
+{
+    fprintf(stderr,
+            "%s (%s) -- Multicall binary of all ra-utils tools\n\n"
+            "Usage: %s <tool> [<options>] [<parameter>...]\n"
+            "       %s --list\n\n"
+            "The tool can also be selected by calling this binary via a symlink named like the tool.\n"
+            "Tools:\n",
+            p, PACKAGE_STRING, p, p);
+
+    list_applets(stderr);
+    fprintf(stderr, "\n");
+
+    exit(exitcode);
+}
+
+static const char *base_name(const char *path)
+{
+    const char *p = strrchr(path, '/');
+
+    return p ? p + 1 : path;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct applet *a;
+
+    /* called via a symlink */
+    a = find_applet(base_name(argv[0]));
+    if (a)
+        return a->main(argc, argv);
+
+    if (argc < 2)
+        usage(program_invocation_short_name, EXIT_FAILURE);
+
+    if (strcmp(argv[1], "-l") == 0 || strcmp(argv[1], "--list") == 0) {
+        list_applets(stdout);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "-V") == 0 || strcmp(argv[1], "--version") == 0) {
+        printf("%s (%s)\n", argv[0], PACKAGE_STRING);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)
+        usage(program_invocation_short_name, EXIT_SUCCESS);
+
+    a = find_applet(base_name(argv[1]));
+    if (!a) {
+        fprintf(stderr, "Error: unknown tool '%s'.\n", argv[1]);
+        usage(program_invocation_short_name, EXIT_FAILURE);
+    }
+
+    /* the tools use their own name in messages and usage */
+    argc -= 1;
+    argv += 1;
+    program_invocation_name = argv[0];
+    program_invocation_short_name = (char *)base_name(argv[0]);
+
+    return a->main(argc, argv);
+}
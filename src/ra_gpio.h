@@ -20,3 +20,10 @@ int ra_reset_to_normal(struct gpio_ctx *ctx);
 int ra_hold_reset(struct gpio_ctx *ctx);
 
 void ra_set_reset_duration(struct gpio_ctx *ctx, unsigned int rst_duration);
+
+/* reset the MCU into normal mode and wait until the firmware is ready to communicate;
+ * the GPIOs are only acquired during the reset
+ */
+int ra_gpio_reset_controller(const char *gpiochip,
+                             const char *reset_gpioname, const char *md_gpioname,
+                             unsigned int reset_duration);
@@ -0,0 +1,445 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gpiod.h>
+#include <logging.h>
+#include <tools.h>
+#include "ra_reset.h"
+
+struct ra_reset_controller {
+    const char *gpiochip;
+    const char *rst_pin;
+    const char *md_pin;
+
+    /* index of the chip in the engine */
+    unsigned int chip;
+    unsigned int rst_offset;
+    unsigned int md_offset;
+
+    bool have_edges;
+    struct ra_reset_edges edges;
+};
+
+struct ra_reset_chip {
+    const char *path;
+    struct gpiod_line_request *line_request;
+};
+
+struct ra_reset {
+    struct ra_reset_controller ctrls[RA_RESET_MAX_CONTROLLERS];
+    unsigned int count;
+
+    /* controllers on the same GPIO chip share one line request */
+    struct ra_reset_chip chips[RA_RESET_MAX_CONTROLLERS];
+    unsigned int chip_count;
+};
+
+enum ra_reset_event_type {
+    RA_RESET_EVENT_ASSERT,
+    RA_RESET_EVENT_RELEASE,
+};
+
+struct ra_reset_event {
+    struct timespec deadline;
+    enum ra_reset_event_type type;
+    unsigned int ctrl;
+};
+
+struct ra_reset *ra_reset_new(void)
+{
+    return calloc(1, sizeof(struct ra_reset));
+}
+
+void ra_reset_free(struct ra_reset *r)
+{
+    unsigned int i;
+
+    if (!r)
+        return;
+
+    for (i = 0; i < r->chip_count; i++)
+        if (r->chips[i].line_request)
+            gpiod_line_request_release(r->chips[i].line_request);
+
+    free(r);
+}
+
+int ra_reset_add(struct ra_reset *r, const char *gpiochip, const char *reset_gpioname, const char *md_gpioname)
+{
+    struct ra_reset_controller *ctrl;
+    unsigned int i;
+
+    if (r->count == RA_RESET_MAX_CONTROLLERS) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    ctrl = &r->ctrls[r->count];
+    ctrl->gpiochip = gpiochip;
+    ctrl->rst_pin = reset_gpioname;
+    ctrl->md_pin = md_gpioname;
+
+    for (i = 0; i < r->chip_count; i++)
+        if (strcmp(r->chips[i].path, gpiochip) == 0)
+            break;
+
+    if (i == r->chip_count)
+        r->chips[r->chip_count++].path = gpiochip;
+
+    ctrl->chip = i;
+
+    return r->count++;
+}
+
+unsigned int ra_reset_count(struct ra_reset *r)
+{
+    return r->count;
+}
+
+static int ra_reset_request_chip(struct ra_reset *r, unsigned int chip_idx)
+{
+    struct ra_reset_chip *c = &r->chips[chip_idx];
+    struct gpiod_chip *chip = NULL;
+    struct gpiod_line_settings *line_settings = NULL;
+    struct gpiod_line_config *line_config = NULL;
+    struct gpiod_request_config *req_config = NULL;
+    unsigned int offsets[2 * RA_RESET_MAX_CONTROLLERS];
+    unsigned int offset_count = 0;
+    unsigned int i, j;
+    int rv = -1;
+
+    chip = gpiod_chip_open(c->path);
+    if (!chip) {
+        error("could not open '%s': %m", c->path);
+        return -1;
+    }
+
+    for (i = 0; i < r->count; i++) {
+        struct ra_reset_controller *ctrl = &r->ctrls[i];
+        int offset;
+
+        if (ctrl->chip != chip_idx)
+            continue;
+
+        offset = gpiod_chip_get_line_offset_from_name(chip, ctrl->rst_pin);
+        if (offset == -1) {
+            error("could not use GPIO '%s' for RESET control: %m", ctrl->rst_pin);
+            goto err_out;
+        }
+        ctrl->rst_offset = offset;
+
+        offset = gpiod_chip_get_line_offset_from_name(chip, ctrl->md_pin);
+        if (offset == -1) {
+            error("could not use GPIO '%s' for MD control: %m", ctrl->md_pin);
+            goto err_out;
+        }
+        ctrl->md_offset = offset;
+
+        offsets[offset_count++] = ctrl->rst_offset;
+        offsets[offset_count++] = ctrl->md_offset;
+    }
+
+    /* a line driven by two controllers is surely a configuration mistake */
+    for (i = 0; i < offset_count; i++) {
+        for (j = i + 1; j < offset_count; j++) {
+            if (offsets[i] == offsets[j]) {
+                error("GPIO line %u of '%s' is used twice", offsets[i], c->path);
+                errno = EINVAL;
+                goto err_out;
+            }
+        }
+    }
+
+    line_settings = gpiod_line_settings_new();
+    line_config = gpiod_line_config_new();
+    req_config = gpiod_request_config_new();
+
+    if (!line_settings || !line_config || !req_config)
+        goto err_out;
+
+    gpiod_request_config_set_consumer(req_config, program_invocation_name);
+
+    if (gpiod_line_settings_set_direction(line_settings, GPIOD_LINE_DIRECTION_OUTPUT))
+        goto err_out;
+    if (gpiod_line_settings_set_output_value(line_settings, GPIOD_LINE_VALUE_ACTIVE))
+        goto err_out;
+
+    if (gpiod_line_config_add_line_settings(line_config, offsets, offset_count, line_settings))
+        goto err_out;
+
+    c->line_request = gpiod_chip_request_lines(chip, req_config, line_config);
+    if (!c->line_request)
+        goto err_out;
+
+    rv = 0;
+
+err_out:
+    gpiod_request_config_free(req_config);
+    gpiod_line_settings_free(line_settings);
+    gpiod_line_config_free(line_config);
+    gpiod_chip_close(chip);
+    return rv;
+}
+
+int ra_reset_request(struct ra_reset *r)
+{
+    unsigned int i;
+
+    for (i = 0; i < r->chip_count; i++) {
+        if (r->chips[i].line_request)
+            continue;
+
+        if (ra_reset_request_chip(r, i))
+            return -1;
+    }
+
+    return 0;
+}
+
+static int ra_reset_event_compare(const void *a, const void *b)
+{
+    const struct ra_reset_event *lhs = a, *rhs = b;
+    int rv;
+
+    rv = timespec_compare(&lhs->deadline, &rhs->deadline);
+    if (rv)
+        return rv;
+
+    /* at the same time, assert before release so that a pulse has at least the duration of the requests */
+    if (lhs->type != rhs->type)
+        return lhs->type == RA_RESET_EVENT_ASSERT ? -1 : 1;
+
+    return (lhs->ctrl > rhs->ctrl) - (lhs->ctrl < rhs->ctrl);
+}
+
+static int ra_reset_sleep_until(const struct timespec *deadline)
+{
+    int rv;
+
+    do {
+        rv = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+    } while (rv == EINTR);
+
+    if (rv) {
+        errno = rv;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* drive the lines of the given events, which are all due at the same time,
+ * with one request per chip and record the edge times
+ */
+static int ra_reset_apply(struct ra_reset *r, const struct ra_reset_event *events, unsigned int count,
+                          enum ra_reset_mode mode)
+{
+    unsigned int offsets[2 * RA_RESET_MAX_CONTROLLERS];
+    enum gpiod_line_value values[2 * RA_RESET_MAX_CONTROLLERS];
+    unsigned int chip, i;
+
+    for (chip = 0; chip < r->chip_count; chip++) {
+        unsigned int n = 0;
+        struct timespec now;
+
+        for (i = 0; i < count; i++) {
+            struct ra_reset_controller *ctrl = &r->ctrls[events[i].ctrl];
+
+            if (ctrl->chip != chip)
+                continue;
+
+            offsets[n] = ctrl->rst_offset;
+
+            if (events[i].type == RA_RESET_EVENT_ASSERT) {
+                values[n++] = GPIOD_LINE_VALUE_INACTIVE;
+
+                /* choose boot mode by setting MD together with RESET */
+                offsets[n] = ctrl->md_offset;
+                values[n++] = mode == RA_RESET_BOOTLOADER ? GPIOD_LINE_VALUE_INACTIVE : GPIOD_LINE_VALUE_ACTIVE;
+            } else {
+                values[n++] = GPIOD_LINE_VALUE_ACTIVE;
+            }
+        }
+
+        if (!n)
+            continue;
+
+        if (gpiod_line_request_set_values_subset(r->chips[chip].line_request, n, offsets, values))
+            return -1;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (i = 0; i < count; i++) {
+            struct ra_reset_controller *ctrl = &r->ctrls[events[i].ctrl];
+
+            if (ctrl->chip != chip)
+                continue;
+
+            if (events[i].type == RA_RESET_EVENT_ASSERT) {
+                ctrl->edges.asserted = now;
+                ctrl->edges.assert_lateness = timespec_to_ns(timespec_sub(now, events[i].deadline));
+            } else {
+                ctrl->edges.released = now;
+                ctrl->edges.release_lateness = timespec_to_ns(timespec_sub(now, events[i].deadline));
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* set RESET high again for all selected controllers, e.g. after an error */
+static void ra_reset_release_all(struct ra_reset *r, uint32_t mask)
+{
+    unsigned int i;
+
+    for (i = 0; i < r->count; i++) {
+        struct ra_reset_controller *ctrl = &r->ctrls[i];
+
+        if (mask & (1U << i))
+            gpiod_line_request_set_value(r->chips[ctrl->chip].line_request, ctrl->rst_offset,
+                                         GPIOD_LINE_VALUE_ACTIVE);
+    }
+}
+
+int ra_reset_run(struct ra_reset *r, const struct ra_reset_sequence *seq)
+{
+    struct ra_reset_event events[2 * RA_RESET_MAX_CONTROLLERS];
+    unsigned int event_count = 0, selected = 0;
+    struct timespec t0;
+    unsigned int i, j, k;
+    int saved_errno;
+
+    if (!seq->mask || seq->mask >> r->count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < r->count; i++) {
+        if (!r->chips[r->ctrls[i].chip].line_request && (seq->mask & (1U << i))) {
+            errno = EBADF;
+            return -1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (i = 0; i < r->count; i++) {
+        struct ra_reset_event *ev;
+
+        if (!(seq->mask & (1U << i)))
+            continue;
+
+        ev = &events[event_count++];
+        ev->type = RA_RESET_EVENT_ASSERT;
+        ev->ctrl = i;
+        ev->deadline = t0;
+        timespec_add_ms(&ev->deadline, (long long)selected * seq->stagger);
+
+        if (!seq->hold_until_signal) {
+            events[event_count] = *ev;
+            ev = &events[event_count++];
+            ev->type = RA_RESET_EVENT_RELEASE;
+            timespec_add_ms(&ev->deadline, seq->duration);
+        }
+
+        r->ctrls[i].have_edges = false;
+        memset(&r->ctrls[i].edges, 0, sizeof(r->ctrls[i].edges));
+        r->ctrls[i].edges.requested_width = seq->hold_until_signal ? 0 : seq->duration * 1000000LL;
+        selected++;
+    }
+
+    qsort(events, event_count, sizeof(events[0]), ra_reset_event_compare);
+
+    for (i = 0; i < event_count; i = j) {
+        /* all events due at the same time are applied at once */
+        for (j = i + 1; j < event_count; j++)
+            if (timespec_compare(&events[i].deadline, &events[j].deadline))
+                break;
+
+        if (ra_reset_sleep_until(&events[i].deadline))
+            goto err_out;
+
+        if (ra_reset_apply(r, &events[i], j - i, seq->mode))
+            goto err_out;
+
+        /* time the release from the actual falling edge, so that the pulse is never shorter than requested */
+        for (k = j; k < event_count; k++) {
+            struct ra_reset_controller *ctrl = &r->ctrls[events[k].ctrl];
+
+            if (events[k].type == RA_RESET_EVENT_RELEASE && timespec_is_set(&ctrl->edges.asserted)) {
+                events[k].deadline = ctrl->edges.asserted;
+                timespec_add_ms(&events[k].deadline, seq->duration);
+            }
+        }
+        qsort(&events[j], event_count - j, sizeof(events[0]), ra_reset_event_compare);
+    }
+
+    if (seq->hold_until_signal) {
+        pause();
+
+        for (i = 0; i < event_count; i++) {
+            clock_gettime(CLOCK_MONOTONIC, &events[i].deadline);
+            events[i].type = RA_RESET_EVENT_RELEASE;
+        }
+
+        if (ra_reset_apply(r, events, event_count, seq->mode))
+            goto err_out;
+
+        /* pause sets errno, but here we wanted it so reset errno to zero */
+        errno = 0;
+    }
+
+    for (i = 0; i < r->count; i++) {
+        struct ra_reset_controller *ctrl = &r->ctrls[i];
+
+        if (!(seq->mask & (1U << i)))
+            continue;
+
+        ctrl->have_edges = true;
+        ctrl->edges.width = timespec_to_ns(timespec_sub(ctrl->edges.released, ctrl->edges.asserted));
+
+        debug("controller %u: RESET held low for %lld.%03lld ms (requested %u ms), edges %lld/%lld us late",
+              i + 1, ctrl->edges.width / 1000000, ctrl->edges.width / 1000 % 1000,
+              seq->hold_until_signal ? 0 : seq->duration,
+              ctrl->edges.assert_lateness / 1000, ctrl->edges.release_lateness / 1000);
+    }
+
+    return 0;
+
+err_out:
+    saved_errno = errno;
+    ra_reset_release_all(r, seq->mask);
+    errno = saved_errno;
+    return -1;
+}
+
+int ra_reset_one(struct ra_reset *r, unsigned int index, enum ra_reset_mode mode, unsigned int duration)
+{
+    struct ra_reset_sequence seq = {
+        .mask = 1U << index,
+        .mode = mode,
+        .duration = duration,
+    };
+
+    return ra_reset_run(r, &seq);
+}
+
+int ra_reset_get_edges(struct ra_reset *r, unsigned int index, struct ra_reset_edges *edges)
+{
+    if (index >= r->count || !r->ctrls[index].have_edges) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    *edges = r->ctrls[index].edges;
+    return 0;
+}
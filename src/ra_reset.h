@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Reset engine for one or several safety controllers.
+ *
+ * The RESET and MD lines of all added controllers are requested once and kept
+ * until the engine is freed, with one line request per GPIO chip. A reset drives
+ * the lines of the selected controllers either together (with a single request
+ * per chip) or staggered by a fixed offset; the edges are timed with absolute
+ * CLOCK_MONOTONIC deadlines and the actual edge times are recorded per controller.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* maximum count of controllers handled by one engine */
+#define RA_RESET_MAX_CONTROLLERS 8
+
+/* opaque context */
+struct ra_reset;
+
+enum ra_reset_mode {
+    /* start the firmware */
+    RA_RESET_NORMAL,
+    /* enter the boot firmware of the MCU */
+    RA_RESET_BOOTLOADER,
+};
+
+struct ra_reset_sequence {
+    /* bitmask of the controllers to reset (bit n for the controller with index n) */
+    uint32_t mask;
+
+    enum ra_reset_mode mode;
+
+    /* time to hold RESET low (in ms) */
+    unsigned int duration;
+
+    /* offset between the resets of the selected controllers (in ms), 0 resets them together */
+    unsigned int stagger;
+
+    /* hold RESET low until a signal arrives instead of the duration */
+    bool hold_until_signal;
+};
+
+/* measured edges of the last reset of a controller */
+struct ra_reset_edges {
+    /* CLOCK_MONOTONIC times when RESET was driven low and released again */
+    struct timespec asserted;
+    struct timespec released;
+
+    /* requested and measured pulse width (in ns) */
+    long long requested_width;
+    long long width;
+
+    /* deviation of the edges from their deadlines (in ns) */
+    long long assert_lateness;
+    long long release_lateness;
+};
+
+struct ra_reset *ra_reset_new(void);
+void ra_reset_free(struct ra_reset *r);
+
+/* add a controller; returns its index or -1 on error */
+int ra_reset_add(struct ra_reset *r, const char *gpiochip, const char *reset_gpioname, const char *md_gpioname);
+
+/* request the lines of all added controllers, RESET and MD are driven high initially */
+int ra_reset_request(struct ra_reset *r);
+
+/* the count of added controllers */
+unsigned int ra_reset_count(struct ra_reset *r);
+
+/* run the given sequence; returns 0 on success, -1 on error */
+int ra_reset_run(struct ra_reset *r, const struct ra_reset_sequence *seq);
+
+/* shortcut to reset a single controller without staggering */
+int ra_reset_one(struct ra_reset *r, unsigned int index, enum ra_reset_mode mode, unsigned int duration);
+
+/* the edges of the last reset of the given controller; returns -1 if it was not reset yet */
+int ra_reset_get_edges(struct ra_reset *r, unsigned int index, struct ra_reset_edges *edges);
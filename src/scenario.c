@@ -0,0 +1,586 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/timerfd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <cb_uart.h>
+#include <logging.h>
+#include <tools.h>
+#include "scenario.h"
+
+/* default timeout of 'wait' steps, in ms */
+#define SCENARIO_DEFAULT_WAIT_TIMEOUT 1000
+
+static char *trim(char *s)
+{
+    char *end;
+
+    while (isspace((unsigned char)*s))
+        s++;
+
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+
+    return s;
+}
+
+/* '200', '1.5s', '+100ms' */
+static int parse_time(const char *s, bool *relative, long long *ms)
+{
+    char *endptr;
+    double v;
+
+    *relative = (*s == '+');
+    if (*relative)
+        s++;
+
+    errno = 0;
+    v = strtod(s, &endptr);
+    if (errno || endptr == s || v < 0)
+        return -1;
+
+    if (*endptr == '\0' || strcmp(endptr, "ms") == 0)
+        *ms = v;
+    else if (strcmp(endptr, "s") == 0)
+        *ms = v * 1000;
+    else
+        return -1;
+
+    return 0;
+}
+
+static int parse_on_off(const char *s, const char *on, const char *off, bool *value)
+{
+    if (strcasecmp(s, on) == 0) {
+        *value = true;
+        return 0;
+    }
+    if (strcasecmp(s, off) == 0) {
+        *value = false;
+        return 0;
+    }
+
+    return -1;
+}
+
+/* split the given expression at '&&' and parse each condition */
+static int parse_conditions(struct scenario_step *step, char *expr)
+{
+    char *s = expr;
+
+    while (s) {
+        char *next = strstr(s, "&&");
+
+        if (next) {
+            *next = '\0';
+            next += 2;
+        }
+
+        if (step->cond_count == SCENARIO_MAX_CONDS) {
+            error("too many conditions (max. %d)", SCENARIO_MAX_CONDS);
+            return -1;
+        }
+
+        if (cb_proto_cond_parse(s, &step->conds[step->cond_count]))
+            return -1;
+
+        step->cond_count++;
+        s = next;
+    }
+
+    return 0;
+}
+
+static int parse_step(struct scenario_step *step, char *line)
+{
+    char *time, *cmd, *args, *saveptr = NULL;
+
+    time = strtok_r(line, " \t", &saveptr);
+    cmd = strtok_r(NULL, " \t", &saveptr);
+    args = trim(saveptr ? saveptr : "");
+
+    if (!time || !cmd) {
+        error("time and command expected");
+        return -1;
+    }
+
+    if (parse_time(time, &step->relative, &step->offset_ms)) {
+        error("invalid time '%s'", time);
+        return -1;
+    }
+
+    step->latency_us = -1;
+
+    if (strcasecmp(cmd, "pwm") == 0) {
+        step->cmd = SCENARIO_CMD_PWM;
+        if (parse_on_off(args, "on", "off", &step->on)) {
+            error("'on' or 'off' expected");
+            return -1;
+        }
+    } else if (strcasecmp(cmd, "duty") == 0) {
+        char *endptr;
+        double v;
+
+        step->cmd = SCENARIO_CMD_DUTY;
+        v = strtod(args, &endptr);
+        if (endptr == args || (*endptr && strcmp(endptr, "%") != 0) || v < 0 || v > 100) {
+            error("duty cycle in percent expected");
+            return -1;
+        }
+        step->arg = v * 10 + 0.5;
+    } else if (strcasecmp(cmd, "contactor") == 0) {
+        char *state;
+
+        step->cmd = SCENARIO_CMD_CONTACTOR;
+        step->arg = strtoul(args, &state, 10);
+        if (step->arg < 1 || step->arg > CB_PROTO_MAX_CONTACTORS ||
+            parse_on_off(trim(state), "close", "open", &step->on)) {
+            error("contactor number and 'close' or 'open' expected");
+            return -1;
+        }
+        step->arg--;
+    } else if (strcasecmp(cmd, "ccs_ready") == 0) {
+        step->cmd = SCENARIO_CMD_CCS_READY;
+        if (parse_on_off(args, "ready", "not_ready", &step->on)) {
+            error("'ready' or 'not_ready' expected");
+            return -1;
+        }
+    } else if (strcasecmp(cmd, "estop") == 0) {
+        step->cmd = SCENARIO_CMD_ESTOP;
+    } else if (strcasecmp(cmd, "send") == 0) {
+        step->cmd = SCENARIO_CMD_SEND;
+    } else if (strcasecmp(cmd, "action") == 0) {
+        const struct cb_proto_field *field = cb_proto_field_find("confirmed_action");
+        int32_t v;
+
+        step->cmd = SCENARIO_CMD_ACTION;
+        if (cb_proto_field_parse_value(field, args, &v) || v == ACTION_ID_NO_ACTION) {
+            error("unknown action '%s'", args);
+            return -1;
+        }
+        step->arg = v;
+    } else if (strcasecmp(cmd, "wait") == 0 || strcasecmp(cmd, "expect") == 0) {
+        char *within;
+
+        step->cmd = (tolower((unsigned char)cmd[0]) == 'w') ? SCENARIO_CMD_WAIT : SCENARIO_CMD_EXPECT;
+        step->timeout_ms = SCENARIO_DEFAULT_WAIT_TIMEOUT;
+
+        within = strstr(args, " within ");
+        if (within) {
+            bool relative;
+
+            if (step->cmd != SCENARIO_CMD_WAIT) {
+                error("'within' is only allowed for 'wait'");
+                return -1;
+            }
+
+            *within = '\0';
+            if (parse_time(trim(within + 8), &relative, &step->timeout_ms) || relative) {
+                error("invalid timeout '%s'", trim(within + 8));
+                return -1;
+            }
+        }
+
+        if (parse_conditions(step, args))
+            return -1;
+    } else {
+        error("unknown command '%s'", cmd);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct scenario *scenario_load(const char *filename)
+{
+    struct scenario *sc;
+    unsigned int lineno = 0;
+    char *line = NULL;
+    size_t len = 0;
+    FILE *f;
+
+    sc = calloc(1, sizeof(*sc));
+    if (!sc)
+        return NULL;
+
+    sc->tfd = -1;
+    sc->filename = strdup(filename);
+    if (!sc->filename)
+        goto err_out;
+
+    f = fopen(filename, "r");
+    if (!f) {
+        error("could not open '%s': %m", filename);
+        goto err_out;
+    }
+
+    while (getline(&line, &len, f) >= 0) {
+        struct scenario_step *steps, *step;
+        char *p, *s;
+
+        lineno++;
+
+        p = strchr(line, '#');
+        if (p)
+            *p = '\0';
+
+        s = trim(line);
+        if (!*s)
+            continue;
+
+        steps = realloc(sc->steps, (sc->step_count + 1) * sizeof(*steps));
+        if (!steps)
+            goto close_out;
+        sc->steps = steps;
+
+        step = &sc->steps[sc->step_count];
+        memset(step, 0, sizeof(*step));
+        step->line = lineno;
+        step->text = strdup(s);
+        if (!step->text)
+            goto close_out;
+        sc->step_count++;
+
+        if (parse_step(step, s)) {
+            error("%s:%u: invalid step", filename, lineno);
+            errno = EINVAL;
+            goto close_out;
+        }
+    }
+
+    if (ferror(f))
+        goto close_out;
+
+    free(line);
+    fclose(f);
+
+    if (!sc->step_count) {
+        error("scenario '%s' does not contain any step", filename);
+        errno = EINVAL;
+        goto err_out;
+    }
+
+    sc->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (sc->tfd < 0) {
+        error("timerfd_create() failed: %m");
+        goto err_out;
+    }
+
+    return sc;
+
+close_out:
+    free(line);
+    fclose(f);
+err_out:
+    scenario_free(sc);
+    return NULL;
+}
+
+void scenario_free(struct scenario *sc)
+{
+    unsigned int i;
+
+    if (!sc)
+        return;
+
+    if (sc->tfd >= 0)
+        close(sc->tfd);
+
+    for (i = 0; i < sc->step_count; i++)
+        free(sc->steps[i].text);
+
+    free(sc->steps);
+    free(sc->filename);
+    free(sc);
+}
+
+static int arm_timer(struct scenario *sc, const struct timespec *when)
+{
+    struct itimerspec its = { .it_value = *when };
+
+    /* an all-zero value would disarm the timer */
+    if (!timespec_is_set(&its.it_value))
+        its.it_value.tv_nsec = 1;
+
+    if (timerfd_settime(sc->tfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        error("timerfd_settime() failed: %m");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void disarm_timer(struct scenario *sc)
+{
+    struct itimerspec its = {};
+
+    timerfd_settime(sc->tfd, 0, &its, NULL);
+}
+
+int scenario_start(struct scenario *sc, struct safety_controller *ctx, struct uart_ctx *uart)
+{
+    unsigned int i;
+
+    /* CCS Ready only exists in Charge Control 2, otherwise these bits belong to the duty cycle;
+     * MCS mode is only known after the first frames, so this cannot be checked when loading */
+    for (i = 0; i < sc->step_count; i++) {
+        const struct scenario_step *step = &sc->steps[i];
+
+        if ((step->cmd == SCENARIO_CMD_CCS_READY || step->cmd == SCENARIO_CMD_ESTOP) &&
+            !cb_proto_is_mcs_mode(ctx)) {
+            error("%s:%u: '%s' requires an MCS safety controller", sc->filename, step->line, step->text);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    sc->ctx = ctx;
+    sc->uart = uart;
+    sc->current = 0;
+    sc->started = true;
+    sc->finished = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &sc->t0);
+    sc->last_done = sc->t0;
+    sc->last_command = sc->t0;
+
+    return scenario_process(sc, false);
+}
+
+static bool conds_met(struct scenario *sc, const struct scenario_step *step)
+{
+    unsigned int i;
+
+    for (i = 0; i < step->cond_count; i++)
+        if (!cb_proto_cond_eval(&step->conds[i], sc->ctx))
+            return false;
+
+    return true;
+}
+
+static int send_charge_control(struct scenario *sc)
+{
+    enum cb_uart_com com = cb_proto_cc_get_com(sc->ctx);
+    uint64_t data = cb_proto_cc_get_data(sc->ctx);
+    int rv;
+
+    cb_proto_set_ts(sc->ctx, com);
+    rv = cb_uart_send(sc->uart, com, data);
+    if (rv) {
+        error("error while sending charge control frame: %m");
+        return rv;
+    }
+
+    cb_proto_cc_sent(sc->ctx, data);
+
+    clock_gettime(CLOCK_MONOTONIC, &sc->last_command);
+
+    return 0;
+}
+
+/* execute the step; returns 1 when the step is completed, 0 if it has to wait, -1 on error */
+static int execute_step(struct scenario *sc, struct scenario_step *step, const struct timespec *now)
+{
+    int rv;
+
+    switch (step->cmd) {
+    case SCENARIO_CMD_PWM:
+        cb_proto_set_pwm_active(sc->ctx, step->on);
+        break;
+    case SCENARIO_CMD_DUTY:
+        cb_proto_set_duty_cycle(sc->ctx, step->arg);
+        break;
+    case SCENARIO_CMD_CONTACTOR:
+        cb_proto_contactorN_set_state(sc->ctx, step->arg, step->on);
+        break;
+    case SCENARIO_CMD_CCS_READY:
+        cb_proto_set_ccs_ready(sc->ctx, step->on);
+        break;
+    case SCENARIO_CMD_ESTOP:
+        cb_proto_set_estop(sc->ctx, true);
+        break;
+    case SCENARIO_CMD_SEND:
+        break;
+
+    case SCENARIO_CMD_ACTION:
+        rv = cb_send_uart_action_inquiry(sc->uart, step->arg);
+        if (rv) {
+            error("error while sending action inquiry: %m");
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &sc->last_command);
+        step->result = SCENARIO_RESULT_PASS;
+        return 1;
+
+    case SCENARIO_CMD_EXPECT:
+        step->result = conds_met(sc, step) ? SCENARIO_RESULT_PASS : SCENARIO_RESULT_FAIL;
+        return 1;
+
+    case SCENARIO_CMD_WAIT:
+        if (conds_met(sc, step)) {
+            step->latency_us = timespec_to_us(timespec_sub(*now, sc->last_command));
+            step->result = SCENARIO_RESULT_PASS;
+            return 1;
+        }
+
+        if (timespec_to_ms(timespec_sub(*now, step->started)) >= step->timeout_ms) {
+            step->result = SCENARIO_RESULT_TIMEOUT;
+            return 1;
+        }
+
+        if (!step->waiting) {
+            struct timespec deadline = step->started;
+
+            timespec_add_ms(&deadline, step->timeout_ms);
+            if (arm_timer(sc, &deadline))
+                return -1;
+            step->waiting = true;
+        }
+        return 0;
+    }
+
+    /* all setters end up here */
+    if (send_charge_control(sc))
+        return -1;
+
+    step->result = SCENARIO_RESULT_PASS;
+    return 1;
+}
+
+int scenario_process(struct scenario *sc, bool timer_expired)
+{
+    if (timer_expired) {
+        uint64_t expirations;
+
+        /* just acknowledge, we check the time ourselves */
+        if (read(sc->tfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+            error("reading timerfd failed: %m");
+            return -1;
+        }
+    }
+
+    if (!sc->started || sc->finished)
+        return 0;
+
+    while (sc->current < sc->step_count) {
+        struct scenario_step *step = &sc->steps[sc->current];
+        struct timespec now;
+        int rv;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (!step->waiting) {
+            step->scheduled = step->relative ? sc->last_done : sc->t0;
+            timespec_add_ms(&step->scheduled, step->offset_ms);
+
+            if (timespec_compare(&now, &step->scheduled) < 0)
+                return arm_timer(sc, &step->scheduled);
+
+            step->started = now;
+            debug("scenario: executing line %u: %s", step->line, step->text);
+        }
+
+        rv = execute_step(sc, step, &now);
+        if (rv <= 0)
+            return rv;
+
+        clock_gettime(CLOCK_MONOTONIC, &step->finished);
+        sc->last_done = step->finished;
+        step->waiting = false;
+        sc->current++;
+
+        if (step->result != SCENARIO_RESULT_PASS) {
+            error("scenario: line %u failed: %s", step->line, step->text);
+            break;
+        }
+    }
+
+    sc->finished = true;
+    disarm_timer(sc);
+
+    return 0;
+}
+
+bool scenario_is_finished(const struct scenario *sc)
+{
+    return sc->finished;
+}
+
+bool scenario_passed(const struct scenario *sc)
+{
+    unsigned int i;
+
+    if (!sc->finished)
+        return false;
+
+    for (i = 0; i < sc->step_count; i++)
+        if (sc->steps[i].result != SCENARIO_RESULT_PASS)
+            return false;
+
+    return true;
+}
+
+static const char *scenario_result_to_str(enum scenario_result result)
+{
+    switch (result) {
+    case SCENARIO_RESULT_PENDING:
+        return "skipped";
+    case SCENARIO_RESULT_PASS:
+        return "pass";
+    case SCENARIO_RESULT_FAIL:
+        return "FAIL";
+    case SCENARIO_RESULT_TIMEOUT:
+        return "TIMEOUT";
+    default:
+        return "unknown";
+    }
+}
+
+void scenario_report(const struct scenario *sc, FILE *f)
+{
+    long long max_slip_us = 0;
+    unsigned int i, passed = 0;
+
+    fprintf(f, "Scenario: %s\n", sc->filename);
+    fprintf(f, "%5s %10s %10s %12s %8s  %s\n", "line", "start[ms]", "slip[ms]", "latency[ms]", "result", "step");
+
+    for (i = 0; i < sc->step_count; i++) {
+        const struct scenario_step *step = &sc->steps[i];
+        long long start_us, slip_us;
+
+        if (step->result == SCENARIO_RESULT_PENDING) {
+            fprintf(f, "%5u %10s %10s %12s %8s  %s\n", step->line, "-", "-", "-",
+                    scenario_result_to_str(step->result), step->text);
+            continue;
+        }
+
+        start_us = timespec_to_us(timespec_sub(step->started, sc->t0));
+        slip_us = timespec_to_us(timespec_sub(step->started, step->scheduled));
+
+        if (slip_us > max_slip_us)
+            max_slip_us = slip_us;
+        if (step->result == SCENARIO_RESULT_PASS)
+            passed++;
+
+        fprintf(f, "%5u %10.3f %10.3f ", step->line, start_us / 1000.0, slip_us / 1000.0);
+        if (step->latency_us >= 0)
+            fprintf(f, "%12.3f ", step->latency_us / 1000.0);
+        else
+            fprintf(f, "%12s ", "-");
+        fprintf(f, "%8s  %s\n", scenario_result_to_str(step->result), step->text);
+    }
+
+    fprintf(f, "Result: %s (%u of %u steps passed, max. slippage %.3f ms)\n",
+            scenario_passed(sc) ? "PASS" : "FAIL", passed, sc->step_count, max_slip_us / 1000.0);
+}
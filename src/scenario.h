@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <cb_proto_field.h>
+#include <cb_protocol.h>
+
+/*
+ * A scenario is a text file with one timed step per line, for example:
+ *
+ *   # time   command
+ *   0        pwm on
+ *   0        duty 5
+ *   200      contactor 1 close
+ *   +0       action rcm_selftest
+ *   +0       wait confirmed_action == rcm_selftest within 500
+ *   +100     expect contactor1 == closed && hv_ready == yes
+ *
+ * The time is given in ms (or with suffix 's' in seconds), either absolute,
+ * i.e. relative to the start of the scenario, or with a leading '+' relative
+ * to the completion of the previous step. A step is never executed before
+ * its predecessor has completed.
+ *
+ * Commands:
+ *   pwm on|off                     enable/disable PWM
+ *   duty <percent>                 set the PWM duty cycle (0.1 % resolution)
+ *   contactor <1..3> close|open    set the requested contactor state
+ *   ccs_ready ready|not_ready      set CCS Ready (MCS only, refused otherwise)
+ *   estop                          set CCS Ready to Emergency Stop (MCS only, refused otherwise)
+ *   send                           send a Charge Control frame
+ *   action <name>                  send an action inquiry, e.g. 'rcm_selftest'
+ *   wait <conditions> [within <t>] wait until the conditions are met (default: 1000 ms)
+ *   expect <conditions>            check that the conditions are met right now
+ *
+ * Conditions use the field names and syntax of ra-query, combined with '&&'.
+ * The setter commands send a Charge Control frame immediately, so that the
+ * reaction latency of a following 'wait' is measured from this frame on.
+ */
+
+/* maximum count of conditions per step */
+#define SCENARIO_MAX_CONDS 8
+
+enum scenario_cmd {
+    SCENARIO_CMD_PWM,
+    SCENARIO_CMD_DUTY,
+    SCENARIO_CMD_CONTACTOR,
+    SCENARIO_CMD_CCS_READY,
+    SCENARIO_CMD_ESTOP,
+    SCENARIO_CMD_SEND,
+    SCENARIO_CMD_ACTION,
+    SCENARIO_CMD_WAIT,
+    SCENARIO_CMD_EXPECT,
+};
+
+enum scenario_result {
+    SCENARIO_RESULT_PENDING,
+    SCENARIO_RESULT_PASS,
+    SCENARIO_RESULT_FAIL,
+    SCENARIO_RESULT_TIMEOUT,
+};
+
+struct scenario_step {
+    /* line number and text within the scenario file, for reporting */
+    unsigned int line;
+    char *text;
+
+    /* when to execute this step */
+    bool relative;
+    long long offset_ms;
+
+    enum scenario_cmd cmd;
+    unsigned int arg;
+    bool on;
+
+    struct cb_proto_cond conds[SCENARIO_MAX_CONDS];
+    unsigned int cond_count;
+    long long timeout_ms;
+
+    /* results */
+    enum scenario_result result;
+    bool waiting;
+    struct timespec scheduled;
+    struct timespec started;
+    struct timespec finished;
+    long long latency_us; /* wait: from the last command sent to the MCU, -1 if not applicable */
+};
+
+struct scenario {
+    char *filename;
+
+    struct scenario_step *steps;
+    unsigned int step_count;
+    unsigned int current;
+
+    /* timerfd (CLOCK_MONOTONIC) to be polled for readability */
+    int tfd;
+
+    struct timespec t0;
+    struct timespec last_done;
+    struct timespec last_command;
+
+    struct safety_controller *ctx;
+    struct uart_ctx *uart;
+
+    bool started;
+    bool finished;
+};
+
+/* parse the given scenario file; returns NULL on error */
+struct scenario *scenario_load(const char *filename);
+
+void scenario_free(struct scenario *sc);
+
+/* start executing the scenario now, using the given controller context and UART;
+ * returns 0 on success, -1 on error
+ */
+int scenario_start(struct scenario *sc, struct safety_controller *ctx, struct uart_ctx *uart);
+
+/* execute all due steps, to be called when the timerfd is readable and
+ * after each received frame; returns 0 on success, -1 on communication errors
+ */
+int scenario_process(struct scenario *sc, bool timer_expired);
+
+bool scenario_is_finished(const struct scenario *sc);
+
+/* true when all steps were executed and passed */
+bool scenario_passed(const struct scenario *sc);
+
+/* print a summary of all steps with timing and result */
+void scenario_report(const struct scenario *sc, FILE *f);
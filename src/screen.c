@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <logging.h>
+#include "screen.h"
+
+static int out_append(struct screen *s, const char *p, size_t len)
+{
+    if (s->out_len + len > s->out_alloc) {
+        size_t alloc = s->out_alloc ? s->out_alloc : 4096;
+        char *buf;
+
+        while (s->out_len + len > alloc)
+            alloc *= 2;
+
+        buf = realloc(s->out_buf, alloc);
+        if (!buf)
+            return -1;
+
+        s->out_buf = buf;
+        s->out_alloc = alloc;
+    }
+
+    memcpy(&s->out_buf[s->out_len], p, len);
+    s->out_len += len;
+
+    return 0;
+}
+
+static int out_printf(struct screen *s, const char *format, ...)
+{
+    char buf[32];
+    va_list args;
+    int rv;
+
+    va_start(args, format);
+    rv = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (rv < 0 || (size_t)rv >= sizeof(buf))
+        return -1;
+
+    return out_append(s, buf, rv);
+}
+
+static int set_line(struct screen *s, unsigned int row, const char *line, size_t len)
+{
+    char *copy;
+
+    if (row >= s->line_alloc) {
+        unsigned int alloc = s->line_alloc ? s->line_alloc * 2 : 64;
+        char **lines;
+
+        lines = realloc(s->lines, alloc * sizeof(*lines));
+        if (!lines)
+            return -1;
+
+        memset(&lines[s->line_alloc], 0, (alloc - s->line_alloc) * sizeof(*lines));
+        s->lines = lines;
+        s->line_alloc = alloc;
+    }
+
+    copy = strndup(line, len);
+    if (!copy)
+        return -1;
+
+    free(s->lines[row]);
+    s->lines[row] = copy;
+
+    return 0;
+}
+
+FILE *screen_begin(struct screen *s)
+{
+    if (s->mem) {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    s->mem = open_memstream(&s->mem_buf, &s->mem_size);
+    if (!s->mem)
+        error("open_memstream() failed: %m");
+
+    return s->mem;
+}
+
+int screen_commit(struct screen *s, FILE *out)
+{
+    unsigned int row = 0, old_count = s->line_count, i;
+    int changed = 0;
+    char *p, *end;
+    int rv = -1;
+
+    if (!s->mem) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (fclose(s->mem)) {
+        s->mem = NULL;
+        goto free_out;
+    }
+    s->mem = NULL;
+
+    s->out_len = 0;
+
+    if (!s->valid) {
+        /* unknown content: clear all and force an update for all lines */
+        if (out_append(s, "\033[H\033[J", 6))
+            goto free_out;
+        old_count = 0;
+    }
+
+    p = s->mem_buf;
+    end = s->mem_buf + s->mem_size;
+
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        size_t len = (nl ? nl : end) - p;
+
+        if (len && p[len - 1] == '\r')
+            len--;
+
+        if (row >= old_count || strlen(s->lines[row]) != len || memcmp(s->lines[row], p, len) != 0) {
+            if (out_printf(s, "\033[%u;1H", row + 1) ||
+                out_append(s, p, len) ||
+                out_append(s, "\033[K", 3))
+                goto free_out;
+
+            if (set_line(s, row, p, len))
+                goto free_out;
+
+            changed++;
+        }
+
+        row++;
+        p = nl ? nl + 1 : end;
+    }
+
+    /* the new content is shorter: clear the rest of the screen */
+    if (row < old_count) {
+        if (out_printf(s, "\033[%u;1H\033[J", row + 1))
+            goto free_out;
+        changed++;
+    }
+
+    for (i = row; i < s->line_count; i++) {
+        free(s->lines[i]);
+        s->lines[i] = NULL;
+    }
+    s->line_count = row;
+    s->valid = true;
+
+    /* park the cursor below the content, so that other output does not clobber it */
+    if (changed && out_printf(s, "\033[%u;1H", row + 1))
+        goto free_out;
+
+    if (s->out_len && fwrite(s->out_buf, s->out_len, 1, out) != 1)
+        goto free_out;
+
+    fflush(out);
+
+    rv = changed;
+
+free_out:
+    if (rv < 0)
+        s->valid = false;
+
+    free(s->mem_buf);
+    s->mem_buf = NULL;
+    s->mem_size = 0;
+
+    return rv;
+}
+
+void screen_invalidate(struct screen *s)
+{
+    s->valid = false;
+}
+
+void screen_free(struct screen *s)
+{
+    unsigned int i;
+
+    if (s->mem) {
+        fclose(s->mem);
+        s->mem = NULL;
+    }
+    free(s->mem_buf);
+    s->mem_buf = NULL;
+
+    for (i = 0; i < s->line_count; i++)
+        free(s->lines[i]);
+    free(s->lines);
+    s->lines = NULL;
+    s->line_count = s->line_alloc = 0;
+
+    free(s->out_buf);
+    s->out_buf = NULL;
+    s->out_len = s->out_alloc = 0;
+
+    s->valid = false;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2026 chargebyte GmbH
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * A minimal differential renderer for VT100 compatible terminals:
+ * the caller renders the complete screen content into a memory stream,
+ * and only the lines which differ from the previous content are sent
+ * to the terminal, each using cursor addressing.
+ */
+struct screen {
+    /* lines currently shown on the terminal, without line endings */
+    char **lines;
+    unsigned int line_count;
+    unsigned int line_alloc;
+
+    /* false when the terminal content is unknown, i.e. a full redraw is required */
+    bool valid;
+
+    /* memory stream for the new content */
+    FILE *mem;
+    char *mem_buf;
+    size_t mem_size;
+
+    /* buffer for the escape sequences to send */
+    char *out_buf;
+    size_t out_len;
+    size_t out_alloc;
+};
+
+#define INIT_SCREEN { .valid = false }
+
+/* returns a stream to render the new screen content into, or NULL on error;
+ * lines may end with '\n' or "\r\n"
+ */
+FILE *screen_begin(struct screen *s);
+
+/* compare the rendered content with the current one and write the changes to 'out';
+ * returns the count of changed lines or -1 on error
+ */
+int screen_commit(struct screen *s, FILE *out);
+
+/* forget the current terminal content, e.g. when other output was written */
+void screen_invalidate(struct screen *s);
+
+void screen_free(struct screen *s);